@@ -0,0 +1,457 @@
+/* redshiftgtk-apply-pipeline.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "redshiftgtk-apply-pipeline.h"
+#include "redshiftgtk-snapshot.h"
+#include "redshiftgtk-trace.h"
+
+struct _RedshiftGtkApplyPipeline
+{
+        RedshiftGtkBackend *backend;
+        RedshiftGtkSettingsModel *settings;
+        /* Of the run in flight, NULL when there is none */
+        GCancellable *cancellable;
+        GTask *task;
+        /* What the last successful persist wrote */
+        GVariant *applied;
+        /* Scheduled runs, see _schedule() */
+        ApplyPipelineRunFunc run_func;
+        gpointer run_data;
+        guint debounce_id;
+        guint persist_id;
+        guint debounce_ms;
+        guint persist_ms;
+        /* Putting the model back, that is nothing to schedule for */
+        gboolean reverting;
+};
+
+typedef struct {
+        RedshiftGtkApplyPipeline *pipeline;
+        ApplyFlags flags;
+        ApplyStage stage;
+        GVariant *settings;
+        gboolean autostart;
+        gboolean changed;
+        /* Returned, its source may still fire once */
+        gboolean done;
+} ApplyRun;
+
+static const gchar * const stage_names[] = {
+        [APPLY_STAGE_COLLECT] = "collect",
+        [APPLY_STAGE_DIFF] = "diff",
+        [APPLY_STAGE_PERSIST] = "persist",
+        [APPLY_STAGE_START] = "start",
+        [APPLY_STAGE_AUTOSTART] = "autostart",
+};
+
+G_STATIC_ASSERT (G_N_ELEMENTS (stage_names) == N_APPLY_STAGES);
+
+static void
+apply_run_free (ApplyRun *run)
+{
+        g_clear_pointer (&run->settings, g_variant_unref);
+        g_free (run);
+}
+
+RedshiftGtkApplyPipeline*
+redshiftgtk_apply_pipeline_new (RedshiftGtkBackend       *backend,
+                                RedshiftGtkSettingsModel *settings)
+{
+        RedshiftGtkApplyPipeline *self = g_new0 (RedshiftGtkApplyPipeline, 1);
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (backend));
+        g_assert (REDSHIFTGTK_IS_SETTINGS_MODEL (settings));
+
+        self->backend = g_object_ref (backend);
+        self->settings = g_object_ref (settings);
+        self->debounce_ms = APPLY_PIPELINE_DEBOUNCE_MS;
+        self->persist_ms = APPLY_PIPELINE_PERSIST_INTERVAL_MS;
+
+        return self;
+}
+
+void
+redshiftgtk_apply_pipeline_free (RedshiftGtkApplyPipeline *self)
+{
+        /* A run in flight sees this before it looks at us again */
+        redshiftgtk_apply_pipeline_cancel (self);
+
+        if (self->debounce_id)
+                g_source_remove (self->debounce_id);
+        if (self->persist_id)
+                g_source_remove (self->persist_id);
+
+        g_clear_pointer (&self->applied, g_variant_unref);
+        g_clear_object (&self->settings);
+        g_clear_object (&self->backend);
+        g_free (self);
+}
+
+/* Everything but autostart, which is its own stage, and whether
+ * redshift runs, which is no setting
+ */
+static GVariant*
+redshiftgtk_apply_pipeline_collect_settings (RedshiftGtkApplyPipeline *self)
+{
+        g_autoptr (GVariant) snapshot = NULL;
+        g_autoptr (GVariantDict) dict = NULL;
+
+        snapshot = g_variant_ref_sink (redshiftgtk_snapshot_new (self->backend));
+        dict = g_variant_dict_new (snapshot);
+        g_variant_dict_remove (dict, SNAPSHOT_KEY_AUTOSTART);
+        g_variant_dict_remove (dict, SNAPSHOT_KEY_RUNNING);
+
+        return g_variant_ref_sink (g_variant_dict_end (dict));
+}
+
+static gboolean
+redshiftgtk_apply_pipeline_run_stage (RedshiftGtkApplyPipeline  *self,
+                                      ApplyRun                  *run,
+                                      GError                   **error)
+{
+        GError *local_error = NULL;
+
+        switch (run->stage) {
+        case APPLY_STAGE_COLLECT: {
+                REDSHIFTGTK_TRACE_SPAN ("apply.collect");
+
+                redshiftgtk_settings_model_commit (self->settings, self->backend);
+                g_object_get (self->settings, "autostart", &run->autostart, NULL);
+                break;
+        }
+        case APPLY_STAGE_DIFF: {
+                REDSHIFTGTK_TRACE_SPAN ("apply.diff");
+
+                run->settings = redshiftgtk_apply_pipeline_collect_settings (self);
+                run->changed = !self->applied || !g_variant_equal (self->applied, run->settings);
+                break;
+        }
+        case APPLY_STAGE_PERSIST: {
+                REDSHIFTGTK_TRACE_SPAN ("apply.persist");
+
+                if (!run->changed || (run->flags & APPLY_FLAGS_NO_PERSIST))
+                        break;
+
+                redshiftgtk_backend_apply_changes (self->backend, &local_error);
+                if (local_error)
+                        break;
+
+                g_clear_pointer (&self->applied, g_variant_unref);
+                self->applied = g_variant_ref (run->settings);
+                break;
+        }
+        case APPLY_STAGE_START: {
+                REDSHIFTGTK_TRACE_SPAN ("apply.start");
+
+                if (run->flags & APPLY_FLAGS_NO_START)
+                        break;
+
+                /* Always, something else may have stopped it since */
+                redshiftgtk_backend_start (self->backend, &local_error);
+                break;
+        }
+        case APPLY_STAGE_AUTOSTART: {
+                REDSHIFTGTK_TRACE_SPAN ("apply.autostart");
+
+                /* A file too */
+                if (run->flags & APPLY_FLAGS_NO_PERSIST)
+                        break;
+
+                if (run->autostart != redshiftgtk_backend_get_autostart (self->backend))
+                        redshiftgtk_backend_set_autostart (self->backend, run->autostart,
+                                                           &local_error);
+
+                /* Show what is really in effect, without applying again */
+                if (local_error) {
+                        self->reverting = TRUE;
+                        g_object_set (self->settings, "autostart",
+                                      redshiftgtk_backend_get_autostart (self->backend), NULL);
+                        self->reverting = FALSE;
+                }
+                break;
+        }
+        default:
+                g_assert_not_reached ();
+        }
+
+        if (local_error) {
+                g_propagate_error (error, local_error);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+static void
+redshiftgtk_apply_pipeline_finish_run (RedshiftGtkApplyPipeline *self,
+                                       GTask                    *task)
+{
+        ApplyRun *run = g_task_get_task_data (task);
+
+        run->done = TRUE;
+
+        /* Only if nothing superseded it in the meantime */
+        if (self->task == task) {
+                g_clear_object (&self->cancellable);
+                self->task = NULL;
+        }
+}
+
+static gboolean
+redshiftgtk_apply_pipeline_step_cb (gpointer user_data)
+{
+        GTask *task = user_data;
+        ApplyRun *run = g_task_get_task_data (task);
+        GError *error = NULL;
+
+        if (run->done)
+                return G_SOURCE_REMOVE;
+
+        /* Superseded or cancelled, the rest would be obsolete. The
+         * pipeline may be gone already, don't touch it.
+         */
+        if (g_task_return_error_if_cancelled (task)) {
+                run->done = TRUE;
+                return G_SOURCE_REMOVE;
+        }
+
+        if (!redshiftgtk_apply_pipeline_run_stage (run->pipeline, run, &error)) {
+                redshiftgtk_apply_pipeline_finish_run (run->pipeline, task);
+                g_task_return_error (task, error);
+                return G_SOURCE_REMOVE;
+        }
+
+        if (++run->stage == N_APPLY_STAGES) {
+                redshiftgtk_apply_pipeline_finish_run (run->pipeline, task);
+                g_task_return_boolean (task, TRUE);
+                return G_SOURCE_REMOVE;
+        }
+
+        return G_SOURCE_CONTINUE;
+}
+
+/**
+ * redshiftgtk_apply_pipeline_run
+ *
+ * Commit the settings model to the backend, write what changed
+ * since the last run, (re)start redshift and update autostart, short
+ * of what @flags leave out. Supersedes a run still in flight, which
+ * then finishes with G_IO_ERROR_CANCELLED.
+ */
+void
+redshiftgtk_apply_pipeline_run (RedshiftGtkApplyPipeline *self,
+                                ApplyFlags                flags,
+                                GAsyncReadyCallback       callback,
+                                gpointer                  user_data)
+{
+        g_autoptr (GTask) task = NULL;
+        g_autoptr (GSource) source = NULL;
+        ApplyRun *run;
+
+        redshiftgtk_apply_pipeline_cancel (self);
+        self->cancellable = g_cancellable_new ();
+
+        run = g_new0 (ApplyRun, 1);
+        run->pipeline = self;
+        run->flags = flags;
+        run->stage = APPLY_STAGE_COLLECT;
+
+        task = g_task_new (NULL, self->cancellable, callback, user_data);
+        g_task_set_source_tag (task, redshiftgtk_apply_pipeline_run);
+        g_task_set_task_data (task, run, (GDestroyNotify) apply_run_free);
+        /* Kept alive by its source until it is done */
+        self->task = task;
+
+        source = g_idle_source_new ();
+        g_source_set_priority (source, G_PRIORITY_DEFAULT_IDLE);
+        g_task_attach_source (task, source, redshiftgtk_apply_pipeline_step_cb);
+}
+
+/**
+ * redshiftgtk_apply_pipeline_run_finish
+ *
+ * Whether the run got through every stage. If not, @failed_stage
+ * tells where it stopped, unless it was cancelled.
+ */
+gboolean
+redshiftgtk_apply_pipeline_run_finish (RedshiftGtkApplyPipeline  *self,
+                                       GAsyncResult              *result,
+                                       ApplyStage                *failed_stage,
+                                       GError                   **error)
+{
+        g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+        g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) ==
+                              redshiftgtk_apply_pipeline_run, FALSE);
+
+        if (failed_stage)
+                *failed_stage = ((ApplyRun *) g_task_get_task_data (G_TASK (result)))->stage;
+
+        return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/* Cancel the run in flight, if any */
+void
+redshiftgtk_apply_pipeline_cancel (RedshiftGtkApplyPipeline *self)
+{
+        if (!self->cancellable)
+                return;
+
+        g_cancellable_cancel (self->cancellable);
+        g_clear_object (&self->cancellable);
+        self->task = NULL;
+}
+
+/**
+ * redshiftgtk_apply_pipeline_flush
+ *
+ * Run what is left of the run in flight right now, for when there
+ * is no main loop to come back to, like a window closing
+ */
+void
+redshiftgtk_apply_pipeline_flush (RedshiftGtkApplyPipeline *self)
+{
+        g_autoptr (GTask) task = NULL;
+
+        if (!self->task)
+                return;
+
+        task = g_object_ref (self->task);
+        while (redshiftgtk_apply_pipeline_step_cb (task) == G_SOURCE_CONTINUE)
+                ;
+}
+
+gboolean
+redshiftgtk_apply_pipeline_is_running (RedshiftGtkApplyPipeline *self)
+{
+        return self->cancellable != NULL;
+}
+
+static gboolean
+redshiftgtk_apply_pipeline_persist_cb (gpointer user_data)
+{
+        RedshiftGtkApplyPipeline *self = user_data;
+
+        /* Not in the middle of a run, that would cancel it */
+        if (redshiftgtk_apply_pipeline_is_running (self))
+                return G_SOURCE_CONTINUE;
+
+        self->persist_id = 0;
+        self->run_func (self, APPLY_FLAGS_NO_START, self->run_data);
+
+        return G_SOURCE_REMOVE;
+}
+
+static gboolean
+redshiftgtk_apply_pipeline_debounce_cb (gpointer user_data)
+{
+        RedshiftGtkApplyPipeline *self = user_data;
+
+        self->debounce_id = 0;
+
+        /* redshift starts from a runtime config, the user's file is
+         * written once things have been quiet for a while
+         */
+        self->run_func (self, APPLY_FLAGS_NO_PERSIST, self->run_data);
+
+        if (!self->persist_id)
+                self->persist_id = g_timeout_add (self->persist_ms,
+                                                  redshiftgtk_apply_pipeline_persist_cb, self);
+
+        return G_SOURCE_REMOVE;
+}
+
+/**
+ * redshiftgtk_apply_pipeline_schedule
+ *
+ * Have @func start a run without writing anything once changes
+ * stop coming for a moment, and one that only writes a while
+ * after the first of those. Only the last of a burst counts.
+ * Ignored while a failed run puts the settings model back.
+ */
+void
+redshiftgtk_apply_pipeline_schedule (RedshiftGtkApplyPipeline *self,
+                                     ApplyPipelineRunFunc      func,
+                                     gpointer                  user_data)
+{
+        if (self->reverting)
+                return;
+
+        self->run_func = func;
+        self->run_data = user_data;
+
+        if (self->debounce_id)
+                g_source_remove (self->debounce_id);
+        self->debounce_id = g_timeout_add (self->debounce_ms,
+                                           redshiftgtk_apply_pipeline_debounce_cb, self);
+}
+
+/* Drop a scheduled start, what is left to write still gets written */
+void
+redshiftgtk_apply_pipeline_unschedule (RedshiftGtkApplyPipeline *self)
+{
+        if (!self->debounce_id)
+                return;
+
+        g_source_remove (self->debounce_id);
+        self->debounce_id = 0;
+}
+
+/**
+ * redshiftgtk_apply_pipeline_run_scheduled
+ *
+ * Start what is scheduled right away, in a single run, for when
+ * there is no main loop to come back to. FALSE if nothing was.
+ */
+gboolean
+redshiftgtk_apply_pipeline_run_scheduled (RedshiftGtkApplyPipeline *self)
+{
+        ApplyFlags flags = self->debounce_id ? APPLY_FLAGS_NONE : APPLY_FLAGS_NO_START;
+
+        if (!self->debounce_id && !self->persist_id)
+                return FALSE;
+
+        if (self->debounce_id) {
+                g_source_remove (self->debounce_id);
+                self->debounce_id = 0;
+        }
+        if (self->persist_id) {
+                g_source_remove (self->persist_id);
+                self->persist_id = 0;
+        }
+
+        self->run_func (self, flags, self->run_data);
+
+        return TRUE;
+}
+
+/* Tests don't wait as long as a user would */
+void
+redshiftgtk_apply_pipeline_set_delays (RedshiftGtkApplyPipeline *self,
+                                       guint                     debounce_ms,
+                                       guint                     persist_ms)
+{
+        self->debounce_ms = debounce_ms;
+        self->persist_ms = persist_ms;
+}
+
+const gchar*
+redshiftgtk_apply_stage_name (ApplyStage stage)
+{
+        g_return_val_if_fail (stage < N_APPLY_STAGES, NULL);
+
+        return stage_names[stage];
+}
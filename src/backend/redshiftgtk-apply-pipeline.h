@@ -0,0 +1,106 @@
+/* redshiftgtk-apply-pipeline.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "redshiftgtk-backend.h"
+#include "redshiftgtk-settings-model.h"
+
+G_BEGIN_DECLS
+
+/* What one Apply goes through, in this order. Stopping is part of
+ * starting, which replaces the running instance without a reset.
+ */
+typedef enum {
+        APPLY_STAGE_COLLECT,
+        APPLY_STAGE_DIFF,
+        APPLY_STAGE_PERSIST,
+        APPLY_STAGE_START,
+        APPLY_STAGE_AUTOSTART,
+        N_APPLY_STAGES
+} ApplyStage;
+
+typedef enum {
+        APPLY_FLAGS_NONE = 0,
+        /* Start from what is in memory, leave the files for later */
+        APPLY_FLAGS_NO_PERSIST = 1 << 0,
+        /* Only write, the running instance already has it */
+        APPLY_FLAGS_NO_START = 1 << 1,
+} ApplyFlags;
+
+/* With auto-apply, a burst of changes is applied once it settles,
+ * and written out at most this often
+ */
+#define APPLY_PIPELINE_DEBOUNCE_MS 250
+#define APPLY_PIPELINE_PERSIST_INTERVAL_MS 5000
+
+/* Applies from the settings model to the backend, one run at a time:
+ * a new run cancels the one in flight, which stops before its next
+ * stage. Stages run from the main loop at idle priority, so input
+ * and redraws get in between.
+ */
+typedef struct _RedshiftGtkApplyPipeline RedshiftGtkApplyPipeline;
+
+/* Starts a run with @flags once a scheduled one is due */
+typedef void (*ApplyPipelineRunFunc) (RedshiftGtkApplyPipeline *pipeline,
+                                      ApplyFlags                flags,
+                                      gpointer                  user_data);
+
+RedshiftGtkApplyPipeline*
+redshiftgtk_apply_pipeline_new           (RedshiftGtkBackend       *backend,
+                                          RedshiftGtkSettingsModel *settings);
+void
+redshiftgtk_apply_pipeline_free          (RedshiftGtkApplyPipeline *self);
+
+void
+redshiftgtk_apply_pipeline_run           (RedshiftGtkApplyPipeline *self,
+                                          ApplyFlags                flags,
+                                          GAsyncReadyCallback       callback,
+                                          gpointer                  user_data);
+gboolean
+redshiftgtk_apply_pipeline_run_finish    (RedshiftGtkApplyPipeline *self,
+                                          GAsyncResult             *result,
+                                          ApplyStage               *failed_stage,
+                                          GError                  **error);
+void
+redshiftgtk_apply_pipeline_cancel        (RedshiftGtkApplyPipeline *self);
+void
+redshiftgtk_apply_pipeline_flush         (RedshiftGtkApplyPipeline *self);
+gboolean
+redshiftgtk_apply_pipeline_is_running    (RedshiftGtkApplyPipeline *self);
+
+void
+redshiftgtk_apply_pipeline_schedule      (RedshiftGtkApplyPipeline *self,
+                                          ApplyPipelineRunFunc      func,
+                                          gpointer                  user_data);
+void
+redshiftgtk_apply_pipeline_unschedule    (RedshiftGtkApplyPipeline *self);
+gboolean
+redshiftgtk_apply_pipeline_run_scheduled (RedshiftGtkApplyPipeline *self);
+void
+redshiftgtk_apply_pipeline_set_delays    (RedshiftGtkApplyPipeline *self,
+                                          guint                     debounce_ms,
+                                          guint                     persist_ms);
+
+const gchar*
+redshiftgtk_apply_stage_name             (ApplyStage                stage);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RedshiftGtkApplyPipeline, redshiftgtk_apply_pipeline_free)
+
+G_END_DECLS
@@ -16,25 +16,57 @@
  */
 
 #include "redshiftgtk-backend.h"
+#include "redshiftgtk-gsettings-backend.h"
+#include "redshiftgtk-metrics.h"
+#include "redshiftgtk-redshift-wrapper.h"
+#include "redshiftgtk-trace.h"
 
 G_DEFINE_INTERFACE (RedshiftGtkBackend, redshiftgtk_backend, G_TYPE_OBJECT)
 
 static void
 redshiftgtk_backend_default_init (RedshiftGtkBackendInterface *iface)
 {
-    /* add properties and signals to the interface here */
+        /**
+         * RedshiftGtkBackend::changed:
+         *
+         * Emitted when the stored settings changed, either through
+         * redshiftgtk_backend_apply_changes() or by someone else
+         */
+        g_signal_new ("changed",
+                      G_TYPE_FROM_INTERFACE (iface),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL, NULL, NULL,
+                      G_TYPE_NONE, 0);
+
+        /**
+         * RedshiftGtkBackend::autostart-failed:
+         * @message: What went wrong
+         *
+         * Emitted when the launcher redshiftgtk_backend_set_autostart()
+         * asked for could not be written after it returned. The
+         * autostart state goes back to what is on disk.
+         */
+        g_signal_new ("autostart-failed",
+                      G_TYPE_FROM_INTERFACE (iface),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL, NULL, NULL,
+                      G_TYPE_NONE, 1, G_TYPE_STRING);
 }
 
 /**
  * redshiftgtk_backend_start
  *
- * Start redshift
+ * Start redshift, or replace the running instance without
+ * resetting the screen in between
  */
 void
 redshiftgtk_backend_start (RedshiftGtkBackend *self,
                            GError            **error)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.start");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
         g_assert (error == NULL || *error == NULL);
@@ -55,6 +87,7 @@ void
 redshiftgtk_backend_stop (RedshiftGtkBackend *self)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.stop");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -64,6 +97,24 @@ redshiftgtk_backend_stop (RedshiftGtkBackend *self)
         iface->stop (self);
 }
 
+/**
+ * redshiftgtk_backend_is_running
+ *
+ * Whether redshift was started, or adopted, and not stopped since
+ */
+gboolean
+redshiftgtk_backend_is_running (RedshiftGtkBackend *self)
+{
+        RedshiftGtkBackendInterface *iface;
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->is_running != NULL);
+
+        return iface->is_running (self);
+}
+
 /**
  * redshiftgtk_backend_get_temperature
  *
@@ -74,6 +125,7 @@ redshiftgtk_backend_get_temperature (RedshiftGtkBackend *self,
                                      TimePeriod          period)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_temperature");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -94,6 +146,7 @@ redshiftgtk_backend_set_temperature (RedshiftGtkBackend *self,
                                      gdouble             temperature)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.set_temperature");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -112,6 +165,7 @@ LocationProvider
 redshiftgtk_backend_get_location_provider (RedshiftGtkBackend *self)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_location_provider");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -131,6 +185,7 @@ redshiftgtk_backend_set_location_provider (RedshiftGtkBackend *self,
                                            LocationProvider    provider)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.set_location_provider");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -149,6 +204,7 @@ gdouble
 redshiftgtk_backend_get_latitude (RedshiftGtkBackend *self)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_latitude");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -168,6 +224,7 @@ redshiftgtk_backend_set_latitude (RedshiftGtkBackend *self,
                                   gdouble             latitude)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.set_latitude");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -186,6 +243,7 @@ gdouble
 redshiftgtk_backend_get_longtitude (RedshiftGtkBackend *self)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_longtitude");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -205,6 +263,7 @@ redshiftgtk_backend_set_longtitude (RedshiftGtkBackend *self,
                                     gdouble             longtitude)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.set_longtitude");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -224,6 +283,7 @@ redshiftgtk_backend_get_brightness (RedshiftGtkBackend *self,
                                     TimePeriod          period)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_brightness");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -244,6 +304,7 @@ redshiftgtk_backend_set_brightness (RedshiftGtkBackend *self,
                                     gdouble             brightness)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.set_brightness");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -265,6 +326,7 @@ redshiftgtk_backend_get_gamma (RedshiftGtkBackend *self,
                                TimePeriod          period)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_gamma");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -287,6 +349,7 @@ redshiftgtk_backend_set_gamma (RedshiftGtkBackend *self,
                                gdouble             blue)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.set_gamma");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -305,6 +368,7 @@ AdjustmentMethod
 redshiftgtk_backend_get_adjustment_method (RedshiftGtkBackend *self)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_adjustment_method");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -324,6 +388,7 @@ redshiftgtk_backend_set_adjustment_method (RedshiftGtkBackend *self,
                                            AdjustmentMethod    method)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.set_adjustment_method");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -342,6 +407,7 @@ gboolean
 redshiftgtk_backend_get_smooth_transition (RedshiftGtkBackend *self)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_smooth_transition");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -361,6 +427,7 @@ redshiftgtk_backend_set_smooth_transition (RedshiftGtkBackend *self,
                                            gboolean            transition)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.set_smooth_transition");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -374,6 +441,7 @@ gboolean
 redshiftgtk_backend_get_autostart (RedshiftGtkBackend *self)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_autostart");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
 
@@ -389,6 +457,7 @@ redshiftgtk_backend_set_autostart (RedshiftGtkBackend *self,
                                    GError            **error)
 {
         RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.set_autostart");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
         g_assert (error == NULL || *error == NULL);
@@ -409,6 +478,8 @@ redshiftgtk_backend_apply_changes (RedshiftGtkBackend *self,
                                    GError            **error)
 {
         RedshiftGtkBackendInterface *iface;
+        gint64 begin;
+        REDSHIFTGTK_TRACE_SPAN ("backend.apply_changes");
 
         g_assert (REDSHIFTGTK_IS_BACKEND (self));
         g_assert (error == NULL || *error == NULL);
@@ -416,5 +487,323 @@ redshiftgtk_backend_apply_changes (RedshiftGtkBackend *self,
         iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
         g_assert (iface->apply_changes != NULL);
 
+        begin = g_get_monotonic_time ();
         iface->apply_changes (self, error);
+
+        redshiftgtk_metrics_count (METRIC_APPLIES, 1);
+        redshiftgtk_metrics_observe (METRIC_APPLY_DURATION,
+                                     (g_get_monotonic_time () - begin) / (gdouble) G_USEC_PER_SEC);
+}
+
+/**
+ * redshiftgtk_backend_preview_temperature
+ *
+ * Show the temperature on screen right away, using the brightness
+ * and gamma of the specified time period. Nothing is saved.
+ */
+void
+redshiftgtk_backend_preview_temperature (RedshiftGtkBackend *self,
+                                         TimePeriod          period,
+                                         gdouble             temperature)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.preview_temperature");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->preview_temperature != NULL);
+
+        iface->preview_temperature (self, period, temperature);
+}
+
+/**
+ * redshiftgtk_backend_end_preview
+ *
+ * Drop any pending preview and hand the screen back
+ * to the regular redshift instance
+ */
+void
+redshiftgtk_backend_end_preview (RedshiftGtkBackend *self)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.end_preview");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->end_preview != NULL);
+
+        iface->end_preview (self);
+}
+
+/**
+ * redshiftgtk_backend_list_profiles
+ *
+ * Names of all named profiles, sorted. The default settings
+ * aren't listed. Free with g_strfreev().
+ */
+gchar**
+redshiftgtk_backend_list_profiles (RedshiftGtkBackend *self)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.list_profiles");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->list_profiles != NULL);
+
+        return iface->list_profiles (self);
+}
+
+/**
+ * redshiftgtk_backend_get_profile
+ *
+ * Name of the active profile, NULL while the default settings are active
+ */
+const gchar*
+redshiftgtk_backend_get_profile (RedshiftGtkBackend *self)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_profile");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->get_profile != NULL);
+
+        return iface->get_profile (self);
+}
+
+/**
+ * redshiftgtk_backend_switch_profile
+ *
+ * Make @name the active profile, or go back to the default settings
+ * if @name is NULL or empty. An unknown name creates a new profile
+ * from the current settings, it is saved on the next apply. Overrides
+ * are dropped before they could be copied into it.
+ * A running redshift picks up the new values right away.
+ */
+void
+redshiftgtk_backend_switch_profile (RedshiftGtkBackend *self,
+                                    const gchar        *name,
+                                    GError            **error)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.switch_profile");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->switch_profile != NULL);
+
+        iface->switch_profile (self, name, error);
+}
+
+/**
+ * redshiftgtk_backend_set_override
+ *
+ * Override the redshift.conf key @key with @value for as long as the
+ * backend lives, on top of both configuration files. Overrides are
+ * never saved. A NULL @value drops the override again.
+ */
+void
+redshiftgtk_backend_set_override (RedshiftGtkBackend *self,
+                                  const gchar        *key,
+                                  const gchar        *value,
+                                  GError            **error)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.set_override");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+        g_assert (key != NULL);
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->set_override != NULL);
+
+        iface->set_override (self, key, value, error);
+}
+
+/**
+ * redshiftgtk_backend_get_source
+ *
+ * Which layer the current value of the redshift.conf key @key comes from
+ */
+ConfigLayer
+redshiftgtk_backend_get_source (RedshiftGtkBackend *self,
+                                const gchar        *key)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_source");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->get_source != NULL);
+
+        return iface->get_source (self, key);
+}
+
+/**
+ * redshiftgtk_backend_list_foreign
+ *
+ * redshift instances of the user that this backend neither started
+ * nor adopted, as RedshiftGtkProcess. Ones our autostart launcher or
+ * an earlier RedshiftGtk started are not listed, start and stop adopt
+ * those by themselves. Listing changes nothing.
+ */
+GPtrArray*
+redshiftgtk_backend_list_foreign (RedshiftGtkBackend *self)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.list_foreign");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->list_foreign != NULL);
+
+        return iface->list_foreign (self);
+}
+
+/**
+ * redshiftgtk_backend_adopt
+ *
+ * Treat the foreign instance @pid as our own: stopping redshift
+ * terminates it, starting replaces it
+ */
+void
+redshiftgtk_backend_adopt (RedshiftGtkBackend *self,
+                           GPid                pid,
+                           GError            **error)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.adopt");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+        g_assert (error == NULL || *error == NULL);
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->adopt != NULL);
+
+        iface->adopt (self, pid, error);
+}
+
+/**
+ * redshiftgtk_backend_leave
+ *
+ * Keep the foreign instance @pid running untouched. Starting fails
+ * while it runs, rather than having two redshifts fight over the
+ * ramps.
+ */
+void
+redshiftgtk_backend_leave (RedshiftGtkBackend *self,
+                           GPid                pid)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.leave");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->leave != NULL);
+
+        iface->leave (self, pid);
+}
+
+/**
+ * redshiftgtk_backend_list_outputs
+ *
+ * The outputs redshift can adjust right now, as RedshiftGtkOutput.
+ * Empty if they can't be told apart.
+ */
+GPtrArray*
+redshiftgtk_backend_list_outputs (RedshiftGtkBackend *self)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.list_outputs");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->list_outputs != NULL);
+
+        return iface->list_outputs (self);
+}
+
+/**
+ * redshiftgtk_backend_get_output_setting
+ *
+ * The value of the redshift.conf key @key for the output called
+ * @output, or NULL if the output uses the one of the active profile
+ */
+gchar*
+redshiftgtk_backend_get_output_setting (RedshiftGtkBackend *self,
+                                        const gchar        *output,
+                                        const gchar        *key)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.get_output_setting");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+        g_assert (output != NULL);
+        g_assert (key != NULL);
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->get_output_setting != NULL);
+
+        return iface->get_output_setting (self, output, key);
+}
+
+/**
+ * redshiftgtk_backend_set_output_setting
+ *
+ * Give the output called @output a value of its own for the
+ * redshift.conf key @key, saved on the next apply. Only the
+ * temperatures, brightnesses and gammas can differ per output.
+ * A NULL @value makes the output follow the active profile again.
+ */
+void
+redshiftgtk_backend_set_output_setting (RedshiftGtkBackend *self,
+                                        const gchar        *output,
+                                        const gchar        *key,
+                                        const gchar        *value,
+                                        GError            **error)
+{
+        RedshiftGtkBackendInterface *iface;
+        REDSHIFTGTK_TRACE_SPAN ("backend.set_output_setting");
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (self));
+        g_assert (output != NULL);
+        g_assert (key != NULL);
+        g_assert (error == NULL || *error == NULL);
+
+        iface = REDSHIFTGTK_BACKEND_GET_IFACE (self);
+        g_assert (iface->set_output_setting != NULL);
+
+        iface->set_output_setting (self, output, key, value, error);
+}
+
+/**
+ * redshiftgtk_backend_new_local
+ *
+ * A backend keeping the settings in this process. Settings live in
+ * GSettings when REDSHIFTGTK_SETTINGS_BACKEND is "gsettings" and the
+ * schema is installed, in redshift.conf otherwise.
+ */
+RedshiftGtkBackend*
+redshiftgtk_backend_new_local (void)
+{
+        if (g_strcmp0 (g_getenv ("REDSHIFTGTK_SETTINGS_BACKEND"), "gsettings") == 0) {
+                if (redshiftgtk_gsettings_backend_is_available ())
+                        return redshiftgtk_gsettings_backend_new ();
+
+                g_warning ("redshiftgtk_backend_new_local\n\
+        redshiftgtk_gsettings_backend_is_available: %s\n",
+                           "schema " REDSHIFTGTK_GSETTINGS_SCHEMA_ID " not installed");
+        }
+
+        return redshiftgtk_redshift_wrapper_new ();
 }
@@ -20,6 +20,8 @@
 #include <glib-object.h>
 
 #include "enums.h"
+#include "redshiftgtk-outputs.h"
+#include "redshiftgtk-process-scan.h"
 
 G_BEGIN_DECLS
 
@@ -34,6 +36,7 @@ struct _RedshiftGtkBackendInterface
         void     (*start)                      (RedshiftGtkBackend *self,
                                                 GError           **error);
         void     (*stop)                       (RedshiftGtkBackend *self);
+        gboolean (*is_running)                 (RedshiftGtkBackend *self);
         gdouble  (*get_temperature)            (RedshiftGtkBackend *self,
                                                 TimePeriod          period);
         void     (*set_temperature)            (RedshiftGtkBackend *self,
@@ -74,11 +77,46 @@ struct _RedshiftGtkBackendInterface
                                                 GError            **error);
         void     (*apply_changes)              (RedshiftGtkBackend *self,
                                                 GError            **error);
+        void     (*preview_temperature)        (RedshiftGtkBackend *self,
+                                                TimePeriod          period,
+                                                gdouble             temperature);
+        void     (*end_preview)                (RedshiftGtkBackend *self);
+        gchar**  (*list_profiles)              (RedshiftGtkBackend *self);
+        const gchar*
+                 (*get_profile)                (RedshiftGtkBackend *self);
+        void     (*switch_profile)             (RedshiftGtkBackend *self,
+                                                const gchar        *name,
+                                                GError            **error);
+        void     (*set_override)               (RedshiftGtkBackend *self,
+                                                const gchar        *key,
+                                                const gchar        *value,
+                                                GError            **error);
+        ConfigLayer
+                 (*get_source)                 (RedshiftGtkBackend *self,
+                                                const gchar        *key);
+        GPtrArray*
+                 (*list_foreign)               (RedshiftGtkBackend *self);
+        void     (*adopt)                      (RedshiftGtkBackend *self,
+                                                GPid                pid,
+                                                GError            **error);
+        void     (*leave)                      (RedshiftGtkBackend *self,
+                                                GPid                pid);
+        GPtrArray*
+                 (*list_outputs)               (RedshiftGtkBackend *self);
+        gchar*   (*get_output_setting)         (RedshiftGtkBackend *self,
+                                                const gchar        *output,
+                                                const gchar        *key);
+        void     (*set_output_setting)         (RedshiftGtkBackend *self,
+                                                const gchar        *output,
+                                                const gchar        *key,
+                                                const gchar        *value,
+                                                GError            **error);
 };
 
 void redshiftgtk_backend_start                 (RedshiftGtkBackend *self,
                                                 GError            **error);
 void redshiftgtk_backend_stop                  (RedshiftGtkBackend *self);
+gboolean redshiftgtk_backend_is_running        (RedshiftGtkBackend *self);
 gdouble
      redshiftgtk_backend_get_temperature       (RedshiftGtkBackend *self,
                                                 TimePeriod          period);
@@ -121,5 +159,44 @@ void redshiftgtk_backend_set_autostart         (RedshiftGtkBackend *self,
                                                 GError            **error);
 void redshiftgtk_backend_apply_changes         (RedshiftGtkBackend *self,
                                                 GError            **error);
+void redshiftgtk_backend_preview_temperature   (RedshiftGtkBackend *self,
+                                                TimePeriod          period,
+                                                gdouble             temperature);
+void redshiftgtk_backend_end_preview           (RedshiftGtkBackend *self);
+gchar**
+     redshiftgtk_backend_list_profiles         (RedshiftGtkBackend *self);
+const gchar*
+     redshiftgtk_backend_get_profile           (RedshiftGtkBackend *self);
+void redshiftgtk_backend_switch_profile        (RedshiftGtkBackend *self,
+                                                const gchar        *name,
+                                                GError            **error);
+void redshiftgtk_backend_set_override          (RedshiftGtkBackend *self,
+                                                const gchar        *key,
+                                                const gchar        *value,
+                                                GError            **error);
+ConfigLayer
+     redshiftgtk_backend_get_source            (RedshiftGtkBackend *self,
+                                                const gchar        *key);
+GPtrArray*
+     redshiftgtk_backend_list_foreign          (RedshiftGtkBackend *self);
+void redshiftgtk_backend_adopt                 (RedshiftGtkBackend *self,
+                                                GPid                pid,
+                                                GError            **error);
+void redshiftgtk_backend_leave                 (RedshiftGtkBackend *self,
+                                                GPid                pid);
+GPtrArray*
+     redshiftgtk_backend_list_outputs          (RedshiftGtkBackend *self);
+gchar*
+     redshiftgtk_backend_get_output_setting    (RedshiftGtkBackend *self,
+                                                const gchar        *output,
+                                                const gchar        *key);
+void redshiftgtk_backend_set_output_setting    (RedshiftGtkBackend *self,
+                                                const gchar        *output,
+                                                const gchar        *key,
+                                                const gchar        *value,
+                                                GError            **error);
+
+RedshiftGtkBackend*
+     redshiftgtk_backend_new_local             (void);
 
 G_END_DECLS
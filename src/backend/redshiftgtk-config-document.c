@@ -0,0 +1,305 @@
+/* redshiftgtk-config-document.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "redshiftgtk-config-document.h"
+
+/* Byte offsets of one key=value line */
+typedef struct {
+        GQuark group;
+        gsize line_start;
+        gsize key_start;
+        gsize key_end;
+        gsize value_start;
+        gsize value_end;
+        gsize line_end;
+} Entry;
+
+/* Where new keys of a group go: after its last key, or after the header */
+typedef struct {
+        GQuark group;
+        gsize end;
+} Group;
+
+struct _RedshiftGtkConfigDocument
+{
+        GString *buffer;
+        GArray *entries;
+        GArray *groups;
+        gboolean modified;
+};
+
+static gboolean
+is_blank (gchar c)
+{
+        return c == ' ' || c == '\t';
+}
+
+/* Index every group header and key=value line of the buffer */
+static void
+redshiftgtk_config_document_parse (RedshiftGtkConfigDocument *self)
+{
+        const gchar *data = self->buffer->str;
+        gsize length = self->buffer->len;
+        GQuark group = 0;
+        gsize position = 0;
+
+        g_array_set_size (self->entries, 0);
+        g_array_set_size (self->groups, 0);
+
+        while (position < length) {
+                const gchar *newline = memchr (data + position, '\n', length - position);
+                gsize line_start = position;
+                gsize line_end = newline ? (gsize) (newline - data) + 1 : length;
+                gsize content_end = newline ? (gsize) (newline - data) : length;
+                gsize p = line_start;
+                const gchar *equals;
+
+                position = line_end;
+
+                if (content_end > line_start && data[content_end - 1] == '\r')
+                        content_end--;
+
+                while (p < content_end && is_blank (data[p]))
+                        p++;
+
+                /* Blank lines and comments */
+                if (p == content_end || data[p] == '#' || data[p] == ';')
+                        continue;
+
+                if (data[p] == '[') {
+                        const gchar *bracket = memchr (data + p, ']', content_end - p);
+                        g_autofree gchar *name = NULL;
+                        Group header;
+
+                        if (!bracket)
+                                continue;
+
+                        name = g_strndup (data + p + 1, bracket - (data + p + 1));
+                        group = g_quark_from_string (name);
+
+                        header.group = group;
+                        header.end = line_end;
+                        g_array_append_val (self->groups, header);
+                        continue;
+                }
+
+                equals = memchr (data + p, '=', content_end - p);
+                if (equals) {
+                        Entry entry;
+
+                        entry.group = group;
+                        entry.line_start = line_start;
+                        entry.key_start = p;
+                        entry.key_end = equals - data;
+                        while (entry.key_end > p && is_blank (data[entry.key_end - 1]))
+                                entry.key_end--;
+
+                        entry.value_start = (equals - data) + 1;
+                        while (entry.value_start < content_end && is_blank (data[entry.value_start]))
+                                entry.value_start++;
+                        entry.value_end = content_end;
+                        while (entry.value_end > entry.value_start && is_blank (data[entry.value_end - 1]))
+                                entry.value_end--;
+                        entry.line_end = line_end;
+
+                        g_array_append_val (self->entries, entry);
+
+                        if (self->groups->len > 0)
+                                g_array_index (self->groups, Group, self->groups->len - 1).end = line_end;
+                }
+        }
+}
+
+/** redshiftgtk_config_document_new
+ *
+ * Wrap a copy of @data, which is expected to be a key file
+ */
+RedshiftGtkConfigDocument*
+redshiftgtk_config_document_new (const gchar *data,
+                                 gsize        length)
+{
+        RedshiftGtkConfigDocument *self = g_slice_new0 (RedshiftGtkConfigDocument);
+
+        self->buffer = g_string_new_len (data, length);
+        self->entries = g_array_new (FALSE, FALSE, sizeof (Entry));
+        self->groups = g_array_new (FALSE, FALSE, sizeof (Group));
+
+        redshiftgtk_config_document_parse (self);
+
+        return self;
+}
+
+void
+redshiftgtk_config_document_free (RedshiftGtkConfigDocument *self)
+{
+        g_string_free (self->buffer, TRUE);
+        g_array_unref (self->entries);
+        g_array_unref (self->groups);
+        g_slice_free (RedshiftGtkConfigDocument, self);
+}
+
+/* Like GKeyFile, the last occurrence of a key wins */
+static Entry*
+redshiftgtk_config_document_lookup (RedshiftGtkConfigDocument *self,
+                                    GQuark                     group,
+                                    const gchar               *key)
+{
+        gsize key_length = strlen (key);
+        guint i;
+
+        for (i = self->entries->len; i > 0; i--) {
+                Entry *entry = &g_array_index (self->entries, Entry, i - 1);
+
+                if (entry->group == group &&
+                    entry->key_end - entry->key_start == key_length &&
+                    memcmp (self->buffer->str + entry->key_start, key, key_length) == 0)
+                        return entry;
+        }
+
+        return NULL;
+}
+
+static Group*
+redshiftgtk_config_document_lookup_group (RedshiftGtkConfigDocument *self,
+                                          GQuark                     group)
+{
+        guint i;
+
+        for (i = self->groups->len; i > 0; i--) {
+                Group *header = &g_array_index (self->groups, Group, i - 1);
+
+                if (header->group == group)
+                        return header;
+        }
+
+        return NULL;
+}
+
+static void
+redshiftgtk_config_document_splice (RedshiftGtkConfigDocument *self,
+                                    gsize                      start,
+                                    gsize                      end,
+                                    const gchar               *text)
+{
+        g_string_erase (self->buffer, start, end - start);
+        g_string_insert (self->buffer, start, text);
+
+        self->modified = TRUE;
+
+        /* Edits only happen on apply, re-indexing is cheaper than
+         * getting every offset shift right
+         */
+        redshiftgtk_config_document_parse (self);
+}
+
+/** redshiftgtk_config_document_set
+ *
+ * Set @key in @group to @value, or remove the key if @value is NULL.
+ * Only the value itself is replaced; new keys go after the last key of
+ * their group and new groups at the end of the file. Returns TRUE if
+ * any bytes changed.
+ */
+gboolean
+redshiftgtk_config_document_set (RedshiftGtkConfigDocument *self,
+                                 const gchar               *group,
+                                 const gchar               *key,
+                                 const gchar               *value)
+{
+        GQuark quark = g_quark_from_string (group);
+        Entry *entry = NULL;
+        Group *header = NULL;
+        g_autofree gchar *line = NULL;
+        gsize position;
+
+        entry = redshiftgtk_config_document_lookup (self, quark, key);
+
+        /* Every occurrence, an earlier one would win once the last is gone */
+        if (entry && !value) {
+                do {
+                        redshiftgtk_config_document_splice (self, entry->line_start,
+                                                            entry->line_end, "");
+                        entry = redshiftgtk_config_document_lookup (self, quark, key);
+                } while (entry);
+
+                return TRUE;
+        }
+
+        if (entry) {
+
+                if (entry->value_end - entry->value_start == strlen (value) &&
+                    memcmp (self->buffer->str + entry->value_start, value, strlen (value)) == 0)
+                        return FALSE;
+
+                redshiftgtk_config_document_splice (self, entry->value_start,
+                                                    entry->value_end, value);
+                return TRUE;
+        }
+
+        if (!value)
+                return FALSE;
+
+        header = redshiftgtk_config_document_lookup_group (self, quark);
+
+        if (header) {
+                position = header->end;
+                line = g_strdup_printf ("%s%s=%s\n",
+                                        (position > 0 && self->buffer->str[position - 1] != '\n') ? "\n" : "",
+                                        key, value);
+        } else {
+                position = self->buffer->len;
+                line = g_strdup_printf ("%s%s[%s]\n%s=%s\n",
+                                        (position > 0 && self->buffer->str[position - 1] != '\n') ? "\n" : "",
+                                        (position > 0) ? "\n" : "",
+                                        group, key, value);
+        }
+
+        redshiftgtk_config_document_splice (self, position, position, line);
+
+        return TRUE;
+}
+
+/** redshiftgtk_config_document_get_data
+ *
+ * Return the current bytes of the document
+ */
+const gchar*
+redshiftgtk_config_document_get_data (RedshiftGtkConfigDocument *self,
+                                      gsize                     *length)
+{
+        if (length)
+                *length = self->buffer->len;
+
+        return self->buffer->str;
+}
+
+/** redshiftgtk_config_document_is_modified
+ *
+ * Whether anything changed since the document was loaded or last saved
+ */
+gboolean
+redshiftgtk_config_document_is_modified (RedshiftGtkConfigDocument *self)
+{
+        return self->modified;
+}
+
+void
+redshiftgtk_config_document_mark_saved (RedshiftGtkConfigDocument *self)
+{
+        self->modified = FALSE;
+}
@@ -0,0 +1,51 @@
+/* redshiftgtk-config-document.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The bytes of a key file as they are on disk. Values are edited in place,
+ * everything else (comments, blank lines, ordering, spacing) is left alone.
+ */
+typedef struct _RedshiftGtkConfigDocument RedshiftGtkConfigDocument;
+
+RedshiftGtkConfigDocument*
+redshiftgtk_config_document_new         (const gchar               *data,
+                                         gsize                      length);
+void
+redshiftgtk_config_document_free        (RedshiftGtkConfigDocument *self);
+
+gboolean
+redshiftgtk_config_document_set         (RedshiftGtkConfigDocument *self,
+                                         const gchar               *group,
+                                         const gchar               *key,
+                                         const gchar               *value);
+
+const gchar*
+redshiftgtk_config_document_get_data    (RedshiftGtkConfigDocument *self,
+                                         gsize                     *length);
+gboolean
+redshiftgtk_config_document_is_modified (RedshiftGtkConfigDocument *self);
+void
+redshiftgtk_config_document_mark_saved  (RedshiftGtkConfigDocument *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RedshiftGtkConfigDocument, redshiftgtk_config_document_free)
+
+G_END_DECLS
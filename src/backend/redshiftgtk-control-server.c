@@ -0,0 +1,556 @@
+/* redshiftgtk-control-server.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * A line based protocol on a unix socket, meant for hotkeys.
+ * Every request is a single line, every reply is a single line
+ * starting with either "OK" or "ERR".
+ *
+ *   query                       OK temp-day=6500 temp-night=4500 enabled=1
+ *   set [day|night] KELVIN      OK temp-night=3500
+ *   nudge [day|night] +-KELVIN  OK temp-night=4000
+ *   toggle                      OK enabled=0
+ *
+ * The period defaults to night. Temperatures are runtime overrides,
+ * redshift is handed over to an instance that follows them on its
+ * own schedule and redshift.conf is never written.
+ *
+ * A held down hotkey sends a burst of nudges. Those are only
+ * previewed, and the last one is handed over once the burst is
+ * NUDGE_COMMIT_MS old.
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "redshiftgtk-control-server.h"
+#include "redshiftgtk-settings-schema.h"
+#include "redshiftgtk-stall-monitor.h"
+
+#define NUDGE_COMMIT_MS 500
+
+struct _RedshiftGtkControlServer
+{
+        GObject parent_instance;
+
+        RedshiftGtkBackend *backend;
+        GSocketService *service;
+        gchar *path;
+
+        /* Previewed but not handed over yet, 0 if nothing is */
+        gdouble nudged[TIME_PERIOD_NIGHT + 1];
+        guint commit_id;
+};
+
+typedef struct {
+        RedshiftGtkControlServer *server;
+        GSocketConnection *connection;
+        GDataInputStream *input;
+} ControlClient;
+
+G_DEFINE_TYPE (RedshiftGtkControlServer, redshiftgtk_control_server, G_TYPE_OBJECT)
+
+static void redshiftgtk_control_server_commit (RedshiftGtkControlServer *self,
+                                               gboolean                  start,
+                                               GError                  **error);
+
+static void
+redshiftgtk_control_server_dispose (GObject *object)
+{
+        RedshiftGtkControlServer *self = REDSHIFTGTK_CONTROL_SERVER (object);
+        g_autoptr (GError) error = NULL;
+
+        /* A burst that ended right before, don't lose its last value */
+        if (self->commit_id) {
+                redshiftgtk_control_server_commit (self, TRUE, &error);
+                if (error)
+                        g_warning ("redshiftgtk_control_server_dispose\n\
+        redshiftgtk_control_server_commit: %s\n", error->message);
+        }
+
+        redshiftgtk_control_server_stop (self);
+        g_clear_object (&self->backend);
+
+        G_OBJECT_CLASS (redshiftgtk_control_server_parent_class)->dispose (object);
+}
+
+static void
+redshiftgtk_control_server_class_init (RedshiftGtkControlServerClass *klass)
+{
+        GObjectClass *obj_class = G_OBJECT_CLASS (klass);
+
+        obj_class->dispose = redshiftgtk_control_server_dispose;
+}
+
+static void
+redshiftgtk_control_server_init (RedshiftGtkControlServer *self)
+{
+}
+
+RedshiftGtkControlServer*
+redshiftgtk_control_server_new (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkControlServer *self;
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (backend));
+
+        self = g_object_new (REDSHIFTGTK_TYPE_CONTROL_SERVER, NULL);
+        self->backend = g_object_ref (backend);
+
+        return self;
+}
+
+/**
+ * redshiftgtk_control_socket_path
+ *
+ * Return the default socket location inside $XDG_RUNTIME_DIR
+ */
+gchar*
+redshiftgtk_control_socket_path (void)
+{
+        return g_build_filename (g_get_user_runtime_dir (), "redshiftgtk.sock", NULL);
+}
+
+/* What the last command left it at, nudged or not */
+static gdouble
+redshiftgtk_control_server_get_temperature (RedshiftGtkControlServer *self,
+                                            TimePeriod                period)
+{
+        if (self->nudged[period] != 0)
+                return self->nudged[period];
+
+        return redshiftgtk_backend_get_temperature (self->backend, period);
+}
+
+/* Clamp @temperature and format it the way redshift.conf would */
+static gdouble
+redshiftgtk_control_server_validate (TimePeriod period,
+                                     gdouble    temperature,
+                                     gchar      string[G_ASCII_DTOSTR_BUF_SIZE])
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (SETTING_TEMP_DAY + period);
+        SettingValue value = { temperature, temperature, temperature };
+
+        redshiftgtk_settings_schema_validate (SETTING_TEMP_DAY + period, value);
+        g_ascii_formatd (string, G_ASCII_DTOSTR_BUF_SIZE, info->format, value[0]);
+
+        return value[0];
+}
+
+/* A runtime override, this never ends up in redshift.conf */
+static void
+redshiftgtk_control_server_override (RedshiftGtkControlServer *self,
+                                     TimePeriod                period,
+                                     gdouble                   temperature,
+                                     GError                  **error)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (SETTING_TEMP_DAY + period);
+        gchar string[G_ASCII_DTOSTR_BUF_SIZE];
+
+        redshiftgtk_control_server_validate (period, temperature, string);
+        redshiftgtk_backend_set_override (self->backend, info->key, string, error);
+}
+
+/* Turn pending nudges into overrides and, with @start, hand them
+ * to a new instance. Without it whatever was previewed is put back.
+ */
+static void
+redshiftgtk_control_server_commit (RedshiftGtkControlServer *self,
+                                   gboolean                  start,
+                                   GError                  **error)
+{
+        gboolean pending = FALSE;
+        guint period;
+
+        if (self->commit_id) {
+                g_source_remove (self->commit_id);
+                self->commit_id = 0;
+        }
+
+        for (period = TIME_PERIOD_DAY; period <= TIME_PERIOD_NIGHT; period++) {
+                if (self->nudged[period] == 0)
+                        continue;
+
+                pending = TRUE;
+                redshiftgtk_control_server_override (self, period, self->nudged[period],
+                                                     error);
+                self->nudged[period] = 0;
+                if (error && *error) {
+                        redshiftgtk_backend_end_preview (self->backend);
+                        return;
+                }
+        }
+
+        /* A start replaces the preview on its own, without
+         * resetting the screen in between
+         */
+        if (start) {
+                redshiftgtk_backend_start (self->backend, error);
+                if (error && *error)
+                        redshiftgtk_backend_end_preview (self->backend);
+        } else if (pending) {
+                redshiftgtk_backend_end_preview (self->backend);
+        }
+}
+
+static gboolean
+redshiftgtk_control_server_commit_cb (gpointer user_data)
+{
+        RedshiftGtkControlServer *self = user_data;
+        g_autoptr (GError) error = NULL;
+
+        self->commit_id = 0;
+        redshiftgtk_control_server_commit (self, TRUE, &error);
+        if (error)
+                g_warning ("redshiftgtk_control_server_commit_cb\n\
+        redshiftgtk_control_server_commit: %s\n", error->message);
+
+        return G_SOURCE_REMOVE;
+}
+
+static gchar*
+redshiftgtk_control_server_set_temperature (RedshiftGtkControlServer *self,
+                                            TimePeriod                period,
+                                            gdouble                   temperature)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (SETTING_TEMP_DAY + period);
+        gchar string[G_ASCII_DTOSTR_BUF_SIZE];
+        g_autoptr (GError) error = NULL;
+
+        temperature = redshiftgtk_control_server_validate (period, temperature, string);
+
+        /* Supersedes a nudge still waiting on the same period */
+        self->nudged[period] = 0;
+        redshiftgtk_control_server_override (self, period, temperature, &error);
+        if (error)
+                return g_strdup_printf ("ERR %s", error->message);
+
+        /* Not a preview, that would pause the schedule for good and
+         * show the day temperature at night
+         */
+        if (redshiftgtk_backend_is_running (self->backend)) {
+                redshiftgtk_control_server_commit (self, TRUE, &error);
+                if (error)
+                        return g_strdup_printf ("ERR %s", error->message);
+        }
+
+        return g_strdup_printf ("OK %s=%s", info->key, string);
+}
+
+static gchar*
+redshiftgtk_control_server_nudge (RedshiftGtkControlServer *self,
+                                  TimePeriod                period,
+                                  gdouble                   delta)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (SETTING_TEMP_DAY + period);
+        gchar string[G_ASCII_DTOSTR_BUF_SIZE];
+        g_autoptr (GError) error = NULL;
+        gdouble temperature;
+
+        temperature = redshiftgtk_control_server_get_temperature (self, period) + delta;
+        temperature = redshiftgtk_control_server_validate (period, temperature, string);
+
+        /* Nothing on screen to preview over, remembered for later */
+        if (!redshiftgtk_backend_is_running (self->backend)) {
+                redshiftgtk_control_server_override (self, period, temperature, &error);
+                if (error)
+                        return g_strdup_printf ("ERR %s", error->message);
+
+                return g_strdup_printf ("OK %s=%s", info->key, string);
+        }
+
+        /* A one-shot redshift per step, one hand-over per burst */
+        self->nudged[period] = temperature;
+        redshiftgtk_backend_preview_temperature (self->backend, period, temperature);
+
+        if (self->commit_id)
+                g_source_remove (self->commit_id);
+        self->commit_id = g_timeout_add (NUDGE_COMMIT_MS,
+                                         redshiftgtk_control_server_commit_cb,
+                                         self);
+
+        return g_strdup_printf ("OK %s=%s", info->key, string);
+}
+
+static gchar*
+redshiftgtk_control_server_toggle (RedshiftGtkControlServer *self)
+{
+        g_autoptr (GError) error = NULL;
+
+        if (redshiftgtk_backend_is_running (self->backend)) {
+                /* Keep the nudged values for when it is back on */
+                redshiftgtk_control_server_commit (self, FALSE, &error);
+                if (error)
+                        return g_strdup_printf ("ERR %s", error->message);
+                redshiftgtk_backend_stop (self->backend);
+        } else {
+                redshiftgtk_backend_start (self->backend, &error);
+                if (error)
+                        return g_strdup_printf ("ERR %s", error->message);
+        }
+
+        return g_strdup_printf ("OK enabled=%d",
+                                redshiftgtk_backend_is_running (self->backend));
+}
+
+/**
+ * redshiftgtk_control_server_handle
+ *
+ * Run a single protocol command and return the reply line,
+ * without the trailing newline
+ */
+gchar*
+redshiftgtk_control_server_handle (RedshiftGtkControlServer *self,
+                                   const gchar              *command)
+{
+        g_auto (GStrv) tokens = NULL;
+        const gchar *argv[4] = { NULL };
+        TimePeriod period = TIME_PERIOD_NIGHT;
+        gdouble value;
+        gchar *end = NULL;
+        guint argc = 0, i;
+
+        g_assert (REDSHIFTGTK_IS_CONTROL_SERVER (self));
+
+        /* Split on whitespace, ignoring repeated separators */
+        tokens = g_strsplit_set (command, " \t\r\n", -1);
+        for (i = 0; tokens[i] != NULL; i++) {
+                if (*tokens[i] == '\0')
+                        continue;
+                if (argc == G_N_ELEMENTS (argv))
+                        return g_strdup ("ERR too many arguments");
+                argv[argc++] = tokens[i];
+        }
+
+        if (argc == 0)
+                return g_strdup ("ERR empty command");
+
+        if (g_strcmp0 (argv[0], "query") == 0 && argc == 1) {
+                return g_strdup_printf ("OK temp-day=%.0f temp-night=%.0f enabled=%d",
+                        redshiftgtk_control_server_get_temperature (self, TIME_PERIOD_DAY),
+                        redshiftgtk_control_server_get_temperature (self, TIME_PERIOD_NIGHT),
+                        redshiftgtk_backend_is_running (self->backend));
+        }
+
+        if (g_strcmp0 (argv[0], "toggle") == 0 && argc == 1)
+                return redshiftgtk_control_server_toggle (self);
+
+        if (g_strcmp0 (argv[0], "set") != 0 && g_strcmp0 (argv[0], "nudge") != 0)
+                return g_strdup_printf ("ERR unknown command %s", argv[0]);
+
+        /* set and nudge take an optional period before the value */
+        if (argc == 3) {
+                if (g_strcmp0 (argv[1], "day") == 0)
+                        period = TIME_PERIOD_DAY;
+                else if (g_strcmp0 (argv[1], "night") != 0)
+                        return g_strdup_printf ("ERR unknown period %s", argv[1]);
+        } else if (argc != 2) {
+                return g_strdup_printf ("ERR usage: %s [day|night] VALUE", argv[0]);
+        }
+
+        value = g_ascii_strtod (argv[argc - 1], &end);
+        if (end == argv[argc - 1] || *end != '\0')
+                return g_strdup_printf ("ERR not a number: %s", argv[argc - 1]);
+
+        if (g_strcmp0 (argv[0], "nudge") == 0)
+                return redshiftgtk_control_server_nudge (self, period, value);
+
+        return redshiftgtk_control_server_set_temperature (self, period, value);
+}
+
+static void
+control_client_free (ControlClient *client)
+{
+        g_io_stream_close (G_IO_STREAM (client->connection), NULL, NULL);
+        g_clear_object (&client->input);
+        g_clear_object (&client->connection);
+        g_clear_object (&client->server);
+        g_slice_free (ControlClient, client);
+}
+
+static void
+control_client_read_line_cb (GObject      *source_object,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+        ControlClient *client = user_data;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *line = NULL;
+        g_autofree gchar *reply = NULL;
+        GOutputStream *output;
+
+        line = g_data_input_stream_read_line_finish (client->input, result, NULL, &error);
+
+        /* Connection closed or broken */
+        if (!line) {
+                if (error)
+                        g_debug ("control_client_read_line_cb\n\
+        g_data_input_stream_read_line_finish: %s\n", error->message);
+                control_client_free (client);
+                return;
+        }
+
+        reply = redshiftgtk_control_server_handle (client->server, line);
+
+        /* Replies are tiny, they fit in the socket buffer right away */
+        output = g_io_stream_get_output_stream (G_IO_STREAM (client->connection));
+        if (!g_output_stream_write_all (output, reply, strlen (reply), NULL, NULL, &error) ||
+            !g_output_stream_write_all (output, "\n", 1, NULL, NULL, &error)) {
+                g_debug ("control_client_read_line_cb\n\
+        g_output_stream_write_all: %s\n", error->message);
+                control_client_free (client);
+                return;
+        }
+
+        g_data_input_stream_read_line_async (client->input, G_PRIORITY_DEFAULT, NULL,
+                                             control_client_read_line_cb, client);
+}
+
+static gboolean
+service_incoming_cb (GSocketService    *service,
+                     GSocketConnection *connection,
+                     GObject           *source_object,
+                     gpointer           user_data)
+{
+        RedshiftGtkControlServer *self = user_data;
+        ControlClient *client;
+
+        client = g_slice_new0 (ControlClient);
+        client->server = g_object_ref (self);
+        client->connection = g_object_ref (connection);
+        client->input = g_data_input_stream_new (
+                g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+
+        g_data_input_stream_read_line_async (client->input, G_PRIORITY_DEFAULT, NULL,
+                                             control_client_read_line_cb, client);
+
+        return TRUE;
+}
+
+/**
+ * redshiftgtk_control_server_start
+ *
+ * Start listening on @path, or on redshiftgtk_control_socket_path()
+ * if @path is NULL. Fails with G_IO_ERROR_EXISTS if another process
+ * already serves the socket; a stale socket file is replaced.
+ */
+gboolean
+redshiftgtk_control_server_start (RedshiftGtkControlServer *self,
+                                  const gchar              *path,
+                                  GError                  **error)
+{
+        g_autoptr (GSocketAddress) address = NULL;
+        g_autofree gchar *reply = NULL;
+        g_autoptr (GError) probe_error = NULL;
+
+        g_assert (REDSHIFTGTK_IS_CONTROL_SERVER (self));
+        g_assert (error == NULL || *error == NULL);
+        g_return_val_if_fail (self->service == NULL, FALSE);
+
+        self->path = path ? g_strdup (path) : redshiftgtk_control_socket_path ();
+
+        /* Somebody answering means the socket is in use */
+        if (g_file_test (self->path, G_FILE_TEST_EXISTS)) {
+                reply = redshiftgtk_control_send (self->path, "query", &probe_error);
+                if (reply) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                                     "%s is already being served", self->path);
+                        g_clear_pointer (&self->path, g_free);
+                        return FALSE;
+                }
+                g_unlink (self->path);
+        }
+
+        address = g_unix_socket_address_new (self->path);
+        self->service = g_socket_service_new ();
+
+        if (!g_socket_listener_add_address (G_SOCKET_LISTENER (self->service),
+                                            address,
+                                            G_SOCKET_TYPE_STREAM,
+                                            G_SOCKET_PROTOCOL_DEFAULT,
+                                            NULL, NULL, error)) {
+                g_clear_object (&self->service);
+                g_clear_pointer (&self->path, g_free);
+                return FALSE;
+        }
+
+        REDSHIFTGTK_SIGNAL_CONNECT (self->service, "incoming",
+                                    service_incoming_cb, self);
+        g_socket_service_start (self->service);
+
+        return TRUE;
+}
+
+void
+redshiftgtk_control_server_stop (RedshiftGtkControlServer *self)
+{
+        g_assert (REDSHIFTGTK_IS_CONTROL_SERVER (self));
+
+        if (!self->service)
+                return;
+
+        g_socket_service_stop (self->service);
+        g_socket_listener_close (G_SOCKET_LISTENER (self->service));
+        g_clear_object (&self->service);
+
+        g_unlink (self->path);
+        g_clear_pointer (&self->path, g_free);
+}
+
+/**
+ * redshiftgtk_control_send
+ *
+ * Send one command to the socket at @path and wait for the reply
+ */
+gchar*
+redshiftgtk_control_send (const gchar *path,
+                          const gchar *command,
+                          GError     **error)
+{
+        g_autoptr (GSocketClient) socket_client = NULL;
+        g_autoptr (GSocketAddress) address = NULL;
+        g_autoptr (GSocketConnection) connection = NULL;
+        g_autoptr (GDataInputStream) input = NULL;
+        g_autofree gchar *request = NULL;
+        GOutputStream *output;
+        gchar *reply;
+
+        g_assert (error == NULL || *error == NULL);
+
+        socket_client = g_socket_client_new ();
+        address = g_unix_socket_address_new (path);
+        connection = g_socket_client_connect (socket_client,
+                                              G_SOCKET_CONNECTABLE (address),
+                                              NULL, error);
+        if (!connection)
+                return NULL;
+
+        request = g_strconcat (command, "\n", NULL);
+        output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+        if (!g_output_stream_write_all (output, request, strlen (request), NULL, NULL, error))
+                return NULL;
+
+        input = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+        reply = g_data_input_stream_read_line (input, NULL, NULL, error);
+
+        if (!reply && error && !*error)
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+                                     "Connection closed without a reply");
+
+        return reply;
+}
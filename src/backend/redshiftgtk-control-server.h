@@ -0,0 +1,52 @@
+/* redshiftgtk-control-server.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "redshiftgtk-backend.h"
+
+G_BEGIN_DECLS
+
+#define REDSHIFTGTK_TYPE_CONTROL_SERVER redshiftgtk_control_server_get_type ()
+G_DECLARE_FINAL_TYPE (RedshiftGtkControlServer, redshiftgtk_control_server,
+                      REDSHIFTGTK, CONTROL_SERVER, GObject)
+
+RedshiftGtkControlServer*
+redshiftgtk_control_server_new      (RedshiftGtkBackend       *backend);
+
+gboolean
+redshiftgtk_control_server_start    (RedshiftGtkControlServer *self,
+                                     const gchar              *path,
+                                     GError                  **error);
+void
+redshiftgtk_control_server_stop     (RedshiftGtkControlServer *self);
+
+gchar*
+redshiftgtk_control_server_handle   (RedshiftGtkControlServer *self,
+                                     const gchar              *command);
+
+gchar*
+redshiftgtk_control_socket_path     (void);
+
+gchar*
+redshiftgtk_control_send            (const gchar              *path,
+                                     const gchar              *command,
+                                     GError                  **error);
+
+G_END_DECLS
@@ -0,0 +1,815 @@
+/* redshiftgtk-dbus-client.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "redshiftgtk-dbus-client.h"
+#include "redshiftgtk-dbus-generated.h"
+#include "redshiftgtk-dbus-service.h"
+#include "redshiftgtk-snapshot.h"
+#include "redshiftgtk-stall-monitor.h"
+
+struct _RedshiftGtkDBusClient
+{
+        GObject parent_instance;
+
+        RedshiftGtkDBusBackend *proxy;
+
+        /* Last known daemon state, with our own changes on top */
+        GHashTable *snapshot;
+
+        /* Changes not sent to the daemon yet */
+        GHashTable *pending;
+};
+
+static void
+redshiftgtk_backend_iface_init (RedshiftGtkBackendInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (RedshiftGtkDBusClient,
+                         redshiftgtk_dbus_client,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (REDSHIFTGTK_TYPE_BACKEND,
+                                                redshiftgtk_backend_iface_init))
+
+static void
+redshiftgtk_dbus_client_dispose (GObject *object)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (object);
+
+        if (self->proxy)
+                g_signal_handlers_disconnect_by_data (self->proxy, self);
+
+        g_clear_object (&self->proxy);
+        g_clear_pointer (&self->snapshot, g_hash_table_unref);
+        g_clear_pointer (&self->pending, g_hash_table_unref);
+
+        G_OBJECT_CLASS (redshiftgtk_dbus_client_parent_class)->dispose (object);
+}
+
+static void
+redshiftgtk_dbus_client_class_init (RedshiftGtkDBusClientClass *klass)
+{
+        GObjectClass *obj_class = G_OBJECT_CLASS (klass);
+
+        obj_class->dispose = redshiftgtk_dbus_client_dispose;
+}
+
+static void
+redshiftgtk_dbus_client_init (RedshiftGtkDBusClient *self)
+{
+        self->snapshot = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                (GDestroyNotify) g_variant_unref);
+        self->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                               (GDestroyNotify) g_variant_unref);
+}
+
+static void
+redshiftgtk_dbus_client_load_snapshot (RedshiftGtkDBusClient *self,
+                                       GVariant              *snapshot)
+{
+        GVariantIter iter;
+        GHashTableIter pending;
+        gchar *key;
+        GVariant *value;
+
+        g_hash_table_remove_all (self->snapshot);
+
+        g_variant_iter_init (&iter, snapshot);
+        while (g_variant_iter_next (&iter, "{sv}", &key, &value))
+                g_hash_table_insert (self->snapshot, key, value);
+
+        /* Unsent changes still win over what the daemon knows */
+        g_hash_table_iter_init (&pending, self->pending);
+        while (g_hash_table_iter_next (&pending, (gpointer *) &key, (gpointer *) &value))
+                g_hash_table_insert (self->snapshot, g_strdup (key), g_variant_ref (value));
+}
+
+static void
+proxy_changed_cb (RedshiftGtkDBusBackend *proxy,
+                  GVariant               *snapshot,
+                  gpointer                user_data)
+{
+        RedshiftGtkDBusClient *self = user_data;
+
+        redshiftgtk_dbus_client_load_snapshot (self, snapshot);
+        g_signal_emit_by_name (self, "changed");
+}
+
+static void
+proxy_autostart_failed_cb (RedshiftGtkDBusBackend *proxy,
+                           const gchar            *message,
+                           gpointer                user_data)
+{
+        g_signal_emit_by_name (user_data, "autostart-failed", message);
+}
+
+static GVariant*
+redshiftgtk_dbus_client_lookup (RedshiftGtkDBusClient *self,
+                                const gchar           *key,
+                                const GVariantType    *type)
+{
+        GVariant *value = g_hash_table_lookup (self->snapshot, key);
+
+        if (value && !g_variant_is_of_type (value, type))
+                return NULL;
+
+        return value;
+}
+
+static void
+redshiftgtk_dbus_client_store (RedshiftGtkDBusClient *self,
+                               const gchar           *key,
+                               GVariant              *value)
+{
+        g_variant_ref_sink (value);
+
+        g_hash_table_insert (self->snapshot, g_strdup (key), g_variant_ref (value));
+        g_hash_table_insert (self->pending, g_strdup (key), value);
+}
+
+static const gchar*
+temperature_key (TimePeriod period)
+{
+        return (period == TIME_PERIOD_DAY) ? SNAPSHOT_KEY_TEMP_DAY
+                                           : SNAPSHOT_KEY_TEMP_NIGHT;
+}
+
+static const gchar*
+brightness_key (TimePeriod period)
+{
+        return (period == TIME_PERIOD_DAY) ? SNAPSHOT_KEY_BRIGHTNESS_DAY
+                                           : SNAPSHOT_KEY_BRIGHTNESS_NIGHT;
+}
+
+static const gchar*
+gamma_key (TimePeriod period)
+{
+        return (period == TIME_PERIOD_DAY) ? SNAPSHOT_KEY_GAMMA_DAY
+                                           : SNAPSHOT_KEY_GAMMA_NIGHT;
+}
+
+static gdouble
+redshiftgtk_dbus_client_get_double (RedshiftGtkDBusClient *self,
+                                    const gchar           *key)
+{
+        GVariant *value = redshiftgtk_dbus_client_lookup (self, key, G_VARIANT_TYPE_DOUBLE);
+
+        return value ? g_variant_get_double (value) : 0;
+}
+
+static guint32
+redshiftgtk_dbus_client_get_uint32 (RedshiftGtkDBusClient *self,
+                                    const gchar           *key)
+{
+        GVariant *value = redshiftgtk_dbus_client_lookup (self, key, G_VARIANT_TYPE_UINT32);
+
+        return value ? g_variant_get_uint32 (value) : 0;
+}
+
+static gboolean
+redshiftgtk_dbus_client_get_boolean (RedshiftGtkDBusClient *self,
+                                     const gchar           *key)
+{
+        GVariant *value = redshiftgtk_dbus_client_lookup (self, key, G_VARIANT_TYPE_BOOLEAN);
+
+        return value ? g_variant_get_boolean (value) : FALSE;
+}
+
+static void
+redshiftgtk_dbus_client_take_error (GError  *remote_error,
+                                    GError **error)
+{
+        g_dbus_error_strip_remote_error (remote_error);
+        g_propagate_error (error, remote_error);
+}
+
+static void
+redshiftgtk_dbus_client_start (RedshiftGtkBackend *backend,
+                               GError            **error)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        GError *remote_error = NULL;
+
+        if (!redshiftgtk_dbus_backend_call_start_sync (self->proxy, NULL, &remote_error)) {
+                redshiftgtk_dbus_client_take_error (remote_error, error);
+                return;
+        }
+
+        g_hash_table_insert (self->snapshot, g_strdup (SNAPSHOT_KEY_RUNNING),
+                             g_variant_ref_sink (g_variant_new_boolean (TRUE)));
+}
+
+static void
+redshiftgtk_dbus_client_stop (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        g_autoptr (GError) error = NULL;
+
+        redshiftgtk_dbus_backend_call_stop_sync (self->proxy, NULL, &error);
+
+        if (error) {
+                g_warning ("redshiftgtk_dbus_client_stop\n\
+        redshiftgtk_dbus_backend_call_stop_sync: %s\n", error->message);
+                return;
+        }
+
+        g_hash_table_insert (self->snapshot, g_strdup (SNAPSHOT_KEY_RUNNING),
+                             g_variant_ref_sink (g_variant_new_boolean (FALSE)));
+}
+
+static gboolean
+redshiftgtk_dbus_client_is_running (RedshiftGtkBackend *backend)
+{
+        return redshiftgtk_dbus_client_get_boolean (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                    SNAPSHOT_KEY_RUNNING);
+}
+
+static gdouble
+redshiftgtk_dbus_client_get_temperature (RedshiftGtkBackend *backend,
+                                         TimePeriod          period)
+{
+        return redshiftgtk_dbus_client_get_double (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                   temperature_key (period));
+}
+
+static void
+redshiftgtk_dbus_client_set_temperature (RedshiftGtkBackend *backend,
+                                         TimePeriod          period,
+                                         gdouble             temperature)
+{
+        redshiftgtk_dbus_client_store (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                       temperature_key (period),
+                                       g_variant_new_double (temperature));
+}
+
+static LocationProvider
+redshiftgtk_dbus_client_get_location_provider (RedshiftGtkBackend *backend)
+{
+        return redshiftgtk_dbus_client_get_uint32 (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                   SNAPSHOT_KEY_LOCATION_PROVIDER);
+}
+
+static void
+redshiftgtk_dbus_client_set_location_provider (RedshiftGtkBackend *backend,
+                                               LocationProvider    provider)
+{
+        redshiftgtk_dbus_client_store (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                       SNAPSHOT_KEY_LOCATION_PROVIDER,
+                                       g_variant_new_uint32 (provider));
+}
+
+static gdouble
+redshiftgtk_dbus_client_get_latitude (RedshiftGtkBackend *backend)
+{
+        return redshiftgtk_dbus_client_get_double (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                   SNAPSHOT_KEY_LATITUDE);
+}
+
+static void
+redshiftgtk_dbus_client_set_latitude (RedshiftGtkBackend *backend,
+                                      gdouble             latitude)
+{
+        redshiftgtk_dbus_client_store (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                       SNAPSHOT_KEY_LATITUDE,
+                                       g_variant_new_double (latitude));
+}
+
+static gdouble
+redshiftgtk_dbus_client_get_longtitude (RedshiftGtkBackend *backend)
+{
+        return redshiftgtk_dbus_client_get_double (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                   SNAPSHOT_KEY_LONGTITUDE);
+}
+
+static void
+redshiftgtk_dbus_client_set_longtitude (RedshiftGtkBackend *backend,
+                                        gdouble             longtitude)
+{
+        redshiftgtk_dbus_client_store (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                       SNAPSHOT_KEY_LONGTITUDE,
+                                       g_variant_new_double (longtitude));
+}
+
+static gdouble
+redshiftgtk_dbus_client_get_brightness (RedshiftGtkBackend *backend,
+                                        TimePeriod          period)
+{
+        return redshiftgtk_dbus_client_get_double (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                   brightness_key (period));
+}
+
+static void
+redshiftgtk_dbus_client_set_brightness (RedshiftGtkBackend *backend,
+                                        TimePeriod          period,
+                                        gdouble             brightness)
+{
+        redshiftgtk_dbus_client_store (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                       brightness_key (period),
+                                       g_variant_new_double (brightness));
+}
+
+static GArray*
+redshiftgtk_dbus_client_get_gamma (RedshiftGtkBackend *backend,
+                                   TimePeriod          period)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        GArray *gamma;
+        GVariant *value;
+        gdouble red, green, blue;
+
+        value = redshiftgtk_dbus_client_lookup (self, gamma_key (period),
+                                                G_VARIANT_TYPE ("(ddd)"));
+        if (!value)
+                return NULL;
+
+        g_variant_get (value, "(ddd)", &red, &green, &blue);
+
+        gamma = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), 3);
+        g_array_append_val (gamma, red);
+        g_array_append_val (gamma, green);
+        g_array_append_val (gamma, blue);
+
+        return gamma;
+}
+
+static void
+redshiftgtk_dbus_client_set_gamma (RedshiftGtkBackend *backend,
+                                   TimePeriod          period,
+                                   gdouble             red,
+                                   gdouble             green,
+                                   gdouble             blue)
+{
+        redshiftgtk_dbus_client_store (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                       gamma_key (period),
+                                       g_variant_new ("(ddd)", red, green, blue));
+}
+
+static AdjustmentMethod
+redshiftgtk_dbus_client_get_adjustment_method (RedshiftGtkBackend *backend)
+{
+        return redshiftgtk_dbus_client_get_uint32 (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                   SNAPSHOT_KEY_ADJUSTMENT_METHOD);
+}
+
+static void
+redshiftgtk_dbus_client_set_adjustment_method (RedshiftGtkBackend *backend,
+                                               AdjustmentMethod    method)
+{
+        redshiftgtk_dbus_client_store (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                       SNAPSHOT_KEY_ADJUSTMENT_METHOD,
+                                       g_variant_new_uint32 (method));
+}
+
+static gboolean
+redshiftgtk_dbus_client_get_smooth_transition (RedshiftGtkBackend *backend)
+{
+        return redshiftgtk_dbus_client_get_boolean (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                    SNAPSHOT_KEY_SMOOTH_TRANSITION);
+}
+
+static void
+redshiftgtk_dbus_client_set_smooth_transition (RedshiftGtkBackend *backend,
+                                               gboolean            transition)
+{
+        redshiftgtk_dbus_client_store (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                       SNAPSHOT_KEY_SMOOTH_TRANSITION,
+                                       g_variant_new_boolean (transition));
+}
+
+static gboolean
+redshiftgtk_dbus_client_get_autostart (RedshiftGtkBackend *backend)
+{
+        return redshiftgtk_dbus_client_get_boolean (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                    SNAPSHOT_KEY_AUTOSTART);
+}
+
+static void
+redshiftgtk_dbus_client_set_autostart (RedshiftGtkBackend *backend,
+                                       gboolean            autostart,
+                                       GError            **error)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        GError *remote_error = NULL;
+
+        if (!redshiftgtk_dbus_backend_call_set_autostart_sync (self->proxy, autostart,
+                                                               NULL, &remote_error)) {
+                redshiftgtk_dbus_client_take_error (remote_error, error);
+                return;
+        }
+
+        g_hash_table_insert (self->snapshot, g_strdup (SNAPSHOT_KEY_AUTOSTART),
+                             g_variant_ref_sink (g_variant_new_boolean (autostart)));
+}
+
+/* Send everything set since the last flush in one call */
+static gboolean
+redshiftgtk_dbus_client_flush (RedshiftGtkDBusClient *self,
+                               GError               **error)
+{
+        GVariantBuilder builder;
+        GHashTableIter iter;
+        gpointer key, value;
+        GError *remote_error = NULL;
+
+        if (g_hash_table_size (self->pending) == 0)
+                return TRUE;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+        g_hash_table_iter_init (&iter, self->pending);
+        while (g_hash_table_iter_next (&iter, &key, &value))
+                g_variant_builder_add (&builder, "{sv}", key, value);
+
+        if (!redshiftgtk_dbus_backend_call_update_sync (self->proxy,
+                                                        g_variant_builder_end (&builder),
+                                                        NULL, &remote_error)) {
+                redshiftgtk_dbus_client_take_error (remote_error, error);
+                return FALSE;
+        }
+
+        g_hash_table_remove_all (self->pending);
+
+        return TRUE;
+}
+
+static void
+redshiftgtk_dbus_client_apply_changes (RedshiftGtkBackend *backend,
+                                       GError            **error)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        GError *remote_error = NULL;
+
+        if (!redshiftgtk_dbus_client_flush (self, error))
+                return;
+
+        if (!redshiftgtk_dbus_backend_call_apply_changes_sync (self->proxy, NULL, &remote_error))
+                redshiftgtk_dbus_client_take_error (remote_error, error);
+}
+
+static void
+redshiftgtk_dbus_client_preview_temperature (RedshiftGtkBackend *backend,
+                                             TimePeriod          period,
+                                             gdouble             temperature)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+
+        /* Fire and forget, the daemon coalesces previews itself */
+        redshiftgtk_dbus_backend_call_preview_temperature (self->proxy, period, temperature,
+                                                           NULL, NULL, NULL);
+}
+
+static void
+redshiftgtk_dbus_client_end_preview (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+
+        redshiftgtk_dbus_backend_call_end_preview (self->proxy, NULL, NULL, NULL);
+}
+
+static gchar**
+redshiftgtk_dbus_client_list_profiles (RedshiftGtkBackend *backend)
+{
+        GVariant *value = redshiftgtk_dbus_client_lookup (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                          SNAPSHOT_KEY_PROFILES,
+                                                          G_VARIANT_TYPE_STRING_ARRAY);
+
+        return value ? g_variant_dup_strv (value, NULL) : g_new0 (gchar*, 1);
+}
+
+static const gchar*
+redshiftgtk_dbus_client_get_profile (RedshiftGtkBackend *backend)
+{
+        GVariant *value = redshiftgtk_dbus_client_lookup (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                          SNAPSHOT_KEY_PROFILE,
+                                                          G_VARIANT_TYPE_STRING);
+        const gchar *name = value ? g_variant_get_string (value, NULL) : NULL;
+
+        return (name && *name) ? name : NULL;
+}
+
+/* Don't wait for Changed, callers expect to see the new values */
+static void
+redshiftgtk_dbus_client_refresh (RedshiftGtkDBusClient *self,
+                                 GError               **error)
+{
+        g_autoptr (GVariant) snapshot = NULL;
+        GError *remote_error = NULL;
+
+        if (!redshiftgtk_dbus_backend_call_get_snapshot_sync (self->proxy, &snapshot,
+                                                              NULL, &remote_error)) {
+                redshiftgtk_dbus_client_take_error (remote_error, error);
+                return;
+        }
+
+        redshiftgtk_dbus_client_load_snapshot (self, snapshot);
+        g_signal_emit_by_name (self, "changed");
+}
+
+static void
+redshiftgtk_dbus_client_switch_profile (RedshiftGtkBackend *backend,
+                                        const gchar        *name,
+                                        GError            **error)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        GError *remote_error = NULL;
+
+        /* Unsent changes belong to the profile that was active
+         * when they were made
+         */
+        if (!redshiftgtk_dbus_client_flush (self, error))
+                return;
+
+        if (!redshiftgtk_dbus_backend_call_switch_profile_sync (self->proxy, name ? name : "",
+                                                                NULL, &remote_error)) {
+                redshiftgtk_dbus_client_take_error (remote_error, error);
+                return;
+        }
+
+        redshiftgtk_dbus_client_refresh (self, error);
+}
+
+static void
+redshiftgtk_dbus_client_set_override (RedshiftGtkBackend *backend,
+                                      const gchar        *key,
+                                      const gchar        *value,
+                                      GError            **error)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        GError *remote_error = NULL;
+
+        if (!redshiftgtk_dbus_backend_call_set_override_sync (self->proxy, key,
+                                                              value ? value : "",
+                                                              NULL, &remote_error)) {
+                redshiftgtk_dbus_client_take_error (remote_error, error);
+                return;
+        }
+
+        redshiftgtk_dbus_client_refresh (self, error);
+}
+
+static ConfigLayer
+redshiftgtk_dbus_client_get_source (RedshiftGtkBackend *backend,
+                                    const gchar        *key)
+{
+        GVariant *sources = redshiftgtk_dbus_client_lookup (REDSHIFTGTK_DBUS_CLIENT (backend),
+                                                            SNAPSHOT_KEY_SOURCES,
+                                                            G_VARIANT_TYPE ("a{su}"));
+        guint32 layer = CONFIG_LAYER_DEFAULT;
+
+        if (sources)
+                g_variant_lookup (sources, key, "u", &layer);
+
+        return layer;
+}
+
+static GPtrArray*
+redshiftgtk_dbus_client_list_foreign (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        GPtrArray *foreign = g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_process_free);
+        g_autoptr (GVariant) instances = NULL;
+        g_autoptr (GError) error = NULL;
+        const gchar *name;
+        const gchar *cmdline;
+        GVariantIter iter;
+        guint32 pid;
+
+        if (!redshiftgtk_dbus_backend_call_list_foreign_sync (self->proxy, &instances,
+                                                              NULL, &error)) {
+                g_warning ("redshiftgtk_dbus_client_list_foreign\n\
+        redshiftgtk_dbus_backend_call_list_foreign_sync: %s\n", error->message);
+                return foreign;
+        }
+
+        g_variant_iter_init (&iter, instances);
+        while (g_variant_iter_next (&iter, "(u&s&s)", &pid, &name, &cmdline))
+                g_ptr_array_add (foreign, redshiftgtk_process_new ((GPid) pid, name, cmdline));
+
+        return foreign;
+}
+
+static void
+redshiftgtk_dbus_client_adopt (RedshiftGtkBackend *backend,
+                               GPid                pid,
+                               GError            **error)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        GError *remote_error = NULL;
+
+        if (!redshiftgtk_dbus_backend_call_adopt_sync (self->proxy, (guint32) pid,
+                                                       NULL, &remote_error))
+                redshiftgtk_dbus_client_take_error (remote_error, error);
+}
+
+static void
+redshiftgtk_dbus_client_leave (RedshiftGtkBackend *backend,
+                               GPid                pid)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        g_autoptr (GError) error = NULL;
+
+        if (!redshiftgtk_dbus_backend_call_leave_sync (self->proxy, (guint32) pid,
+                                                       NULL, &error))
+                g_warning ("redshiftgtk_dbus_client_leave\n\
+        redshiftgtk_dbus_backend_call_leave_sync: %s\n", error->message);
+}
+
+static GPtrArray*
+redshiftgtk_dbus_client_list_outputs (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        GPtrArray *outputs = g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_output_free);
+        g_autoptr (GVariant) lit = NULL;
+        g_autoptr (GError) error = NULL;
+        const gchar *name;
+        GVariantIter iter;
+        guint32 crtc;
+        guint32 ramp_size;
+
+        if (!redshiftgtk_dbus_backend_call_list_outputs_sync (self->proxy, &lit,
+                                                              NULL, &error)) {
+                g_warning ("redshiftgtk_dbus_client_list_outputs\n\
+        redshiftgtk_dbus_backend_call_list_outputs_sync: %s\n", error->message);
+                return outputs;
+        }
+
+        g_variant_iter_init (&iter, lit);
+        while (g_variant_iter_next (&iter, "(&suu)", &name, &crtc, &ramp_size))
+                g_ptr_array_add (outputs, redshiftgtk_output_new (name, crtc, ramp_size));
+
+        return outputs;
+}
+
+static gchar*
+redshiftgtk_dbus_client_get_output_setting (RedshiftGtkBackend *backend,
+                                            const gchar        *output,
+                                            const gchar        *key)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        g_autoptr (GError) error = NULL;
+        gchar *value = NULL;
+
+        if (!redshiftgtk_dbus_backend_call_get_output_setting_sync (self->proxy, output, key,
+                                                                    &value, NULL, &error)) {
+                g_warning ("redshiftgtk_dbus_client_get_output_setting\n\
+        redshiftgtk_dbus_backend_call_get_output_setting_sync: %s\n", error->message);
+                return NULL;
+        }
+
+        /* The empty string is how the bus says "follows the profile" */
+        if (!*value)
+                g_clear_pointer (&value, g_free);
+
+        return value;
+}
+
+static void
+redshiftgtk_dbus_client_set_output_setting (RedshiftGtkBackend *backend,
+                                            const gchar        *output,
+                                            const gchar        *key,
+                                            const gchar        *value,
+                                            GError            **error)
+{
+        RedshiftGtkDBusClient *self = REDSHIFTGTK_DBUS_CLIENT (backend);
+        GError *remote_error = NULL;
+
+        if (!redshiftgtk_dbus_backend_call_set_output_setting_sync (self->proxy, output, key,
+                                                                    value ? value : "",
+                                                                    NULL, &remote_error))
+                redshiftgtk_dbus_client_take_error (remote_error, error);
+}
+
+/* Connect our methods to the interface */
+static void
+redshiftgtk_backend_iface_init (RedshiftGtkBackendInterface *iface)
+{
+        iface->start = redshiftgtk_dbus_client_start;
+        iface->stop = redshiftgtk_dbus_client_stop;
+        iface->is_running = redshiftgtk_dbus_client_is_running;
+        iface->get_temperature = redshiftgtk_dbus_client_get_temperature;
+        iface->set_temperature = redshiftgtk_dbus_client_set_temperature;
+        iface->get_location_provider = redshiftgtk_dbus_client_get_location_provider;
+        iface->set_location_provider = redshiftgtk_dbus_client_set_location_provider;
+        iface->get_latitude = redshiftgtk_dbus_client_get_latitude;
+        iface->set_latitude = redshiftgtk_dbus_client_set_latitude;
+        iface->get_longtitude = redshiftgtk_dbus_client_get_longtitude;
+        iface->set_longtitude = redshiftgtk_dbus_client_set_longtitude;
+        iface->get_brightness = redshiftgtk_dbus_client_get_brightness;
+        iface->set_brightness = redshiftgtk_dbus_client_set_brightness;
+        iface->get_gamma = redshiftgtk_dbus_client_get_gamma;
+        iface->set_gamma = redshiftgtk_dbus_client_set_gamma;
+        iface->get_adjustment_method = redshiftgtk_dbus_client_get_adjustment_method;
+        iface->set_adjustment_method = redshiftgtk_dbus_client_set_adjustment_method;
+        iface->get_smooth_transition = redshiftgtk_dbus_client_get_smooth_transition;
+        iface->set_smooth_transition = redshiftgtk_dbus_client_set_smooth_transition;
+        iface->get_autostart = redshiftgtk_dbus_client_get_autostart;
+        iface->set_autostart = redshiftgtk_dbus_client_set_autostart;
+        iface->apply_changes = redshiftgtk_dbus_client_apply_changes;
+        iface->preview_temperature = redshiftgtk_dbus_client_preview_temperature;
+        iface->end_preview = redshiftgtk_dbus_client_end_preview;
+        iface->list_profiles = redshiftgtk_dbus_client_list_profiles;
+        iface->get_profile = redshiftgtk_dbus_client_get_profile;
+        iface->switch_profile = redshiftgtk_dbus_client_switch_profile;
+        iface->set_override = redshiftgtk_dbus_client_set_override;
+        iface->get_source = redshiftgtk_dbus_client_get_source;
+        iface->list_foreign = redshiftgtk_dbus_client_list_foreign;
+        iface->adopt = redshiftgtk_dbus_client_adopt;
+        iface->leave = redshiftgtk_dbus_client_leave;
+        iface->list_outputs = redshiftgtk_dbus_client_list_outputs;
+        iface->get_output_setting = redshiftgtk_dbus_client_get_output_setting;
+        iface->set_output_setting = redshiftgtk_dbus_client_set_output_setting;
+}
+
+/* Where GLib would find the session bus without autolaunching one,
+ * which can block for a long time where there is none
+ */
+static gboolean
+redshiftgtk_dbus_client_has_session_bus (void)
+{
+        const gchar *runtime_dir = g_getenv ("XDG_RUNTIME_DIR");
+        g_autofree gchar *socket_path = NULL;
+
+        if (g_getenv ("DBUS_SESSION_BUS_ADDRESS"))
+                return TRUE;
+
+        /* GLib looks for $XDG_RUNTIME_DIR/bus next */
+        if (!runtime_dir)
+                return FALSE;
+
+        socket_path = g_build_filename (runtime_dir, "bus", NULL);
+
+        return g_file_test (socket_path, G_FILE_TEST_EXISTS) &&
+               !g_file_test (socket_path, G_FILE_TEST_IS_REGULAR | G_FILE_TEST_IS_DIR);
+}
+
+/**
+ * redshiftgtk_dbus_client_new
+ *
+ * Connect to a running redshiftgtk-daemon on @connection, or on the
+ * session bus if @connection is NULL. Neither the daemon nor a bus
+ * is ever started on demand; if either is missing NULL is returned
+ * without an error and the caller is expected to fall back to a
+ * local backend.
+ */
+RedshiftGtkBackend*
+redshiftgtk_dbus_client_new (GDBusConnection *connection,
+                             GError         **error)
+{
+        g_autoptr (RedshiftGtkDBusClient) self = NULL;
+        g_autoptr (GVariant) snapshot = NULL;
+        g_autofree gchar *owner = NULL;
+        GError *remote_error = NULL;
+        const GDBusProxyFlags flags = G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START |
+                                      G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES;
+
+        g_assert (error == NULL || *error == NULL);
+
+        if (!connection && !redshiftgtk_dbus_client_has_session_bus ())
+                return NULL;
+
+        self = g_object_new (REDSHIFTGTK_TYPE_DBUS_CLIENT, NULL);
+
+        if (connection)
+                self->proxy = redshiftgtk_dbus_backend_proxy_new_sync (connection, flags,
+                                                                       REDSHIFTGTK_DBUS_NAME,
+                                                                       REDSHIFTGTK_DBUS_OBJECT_PATH,
+                                                                       NULL, error);
+        else
+                self->proxy = redshiftgtk_dbus_backend_proxy_new_for_bus_sync (G_BUS_TYPE_SESSION,
+                                                                               flags,
+                                                                               REDSHIFTGTK_DBUS_NAME,
+                                                                               REDSHIFTGTK_DBUS_OBJECT_PATH,
+                                                                               NULL, error);
+        if (!self->proxy)
+                return NULL;
+
+        owner = g_dbus_proxy_get_name_owner (G_DBUS_PROXY (self->proxy));
+        if (!owner)
+                return NULL;
+
+        if (!redshiftgtk_dbus_backend_call_get_snapshot_sync (self->proxy, &snapshot,
+                                                              NULL, &remote_error)) {
+                redshiftgtk_dbus_client_take_error (remote_error, error);
+                return NULL;
+        }
+
+        redshiftgtk_dbus_client_load_snapshot (self, snapshot);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (self->proxy, "changed",
+                                    proxy_changed_cb, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->proxy, "autostart-failed",
+                                    proxy_autostart_failed_cb, self);
+
+        return REDSHIFTGTK_BACKEND (g_steal_pointer (&self));
+}
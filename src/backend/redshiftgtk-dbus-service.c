@@ -0,0 +1,505 @@
+/* redshiftgtk-dbus-service.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "redshiftgtk-dbus-service.h"
+#include "redshiftgtk-dbus-generated.h"
+#include "redshiftgtk-snapshot.h"
+#include "redshiftgtk-stall-monitor.h"
+
+struct _RedshiftGtkDBusService
+{
+        GObject parent_instance;
+
+        RedshiftGtkBackend *backend;
+        RedshiftGtkDBusBackend *skeleton;
+
+        /* Whoever previews, the preview ends when they leave the bus */
+        gchar *preview_owner;
+        guint preview_watch;
+};
+
+G_DEFINE_TYPE (RedshiftGtkDBusService, redshiftgtk_dbus_service, G_TYPE_OBJECT)
+
+static void
+redshiftgtk_dbus_service_unwatch_preview (RedshiftGtkDBusService *self)
+{
+        if (self->preview_watch) {
+                g_bus_unwatch_name (self->preview_watch);
+                self->preview_watch = 0;
+        }
+        g_clear_pointer (&self->preview_owner, g_free);
+}
+
+static void
+redshiftgtk_dbus_service_dispose (GObject *object)
+{
+        RedshiftGtkDBusService *self = REDSHIFTGTK_DBUS_SERVICE (object);
+
+        if (self->backend)
+                g_signal_handlers_disconnect_by_data (self->backend, self);
+
+        redshiftgtk_dbus_service_unwatch_preview (self);
+
+        if (self->skeleton)
+                redshiftgtk_dbus_service_unexport (self);
+
+        g_clear_object (&self->skeleton);
+        g_clear_object (&self->backend);
+
+        G_OBJECT_CLASS (redshiftgtk_dbus_service_parent_class)->dispose (object);
+}
+
+static void
+redshiftgtk_dbus_service_class_init (RedshiftGtkDBusServiceClass *klass)
+{
+        GObjectClass *obj_class = G_OBJECT_CLASS (klass);
+
+        obj_class->dispose = redshiftgtk_dbus_service_dispose;
+}
+
+static void
+redshiftgtk_dbus_service_init (RedshiftGtkDBusService *self)
+{
+        self->skeleton = redshiftgtk_dbus_backend_skeleton_new ();
+}
+
+static void
+backend_changed_cb (RedshiftGtkBackend *backend,
+                    gpointer            user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+
+        redshiftgtk_dbus_backend_emit_changed (self->skeleton,
+                                                redshiftgtk_snapshot_new (backend));
+}
+
+static void
+backend_autostart_failed_cb (RedshiftGtkBackend *backend,
+                             const gchar        *message,
+                             gpointer            user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+
+        redshiftgtk_dbus_backend_emit_autostart_failed (self->skeleton, message);
+}
+
+static gboolean
+handle_get_snapshot (RedshiftGtkDBusBackend *skeleton,
+                     GDBusMethodInvocation  *invocation,
+                     gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+
+        redshiftgtk_dbus_backend_complete_get_snapshot (skeleton, invocation,
+                redshiftgtk_snapshot_new (self->backend));
+
+        return TRUE;
+}
+
+static gboolean
+handle_update (RedshiftGtkDBusBackend *skeleton,
+               GDBusMethodInvocation  *invocation,
+               GVariant               *values,
+               gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+
+        redshiftgtk_snapshot_apply (values, self->backend);
+        redshiftgtk_dbus_backend_complete_update (skeleton, invocation);
+
+        return TRUE;
+}
+
+static gboolean
+handle_apply_changes (RedshiftGtkDBusBackend *skeleton,
+                      GDBusMethodInvocation  *invocation,
+                      gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+        GError *error = NULL;
+
+        redshiftgtk_backend_apply_changes (self->backend, &error);
+
+        if (error)
+                g_dbus_method_invocation_take_error (invocation, error);
+        else
+                redshiftgtk_dbus_backend_complete_apply_changes (skeleton, invocation);
+
+        return TRUE;
+}
+
+static gboolean
+handle_start (RedshiftGtkDBusBackend *skeleton,
+              GDBusMethodInvocation  *invocation,
+              gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+        GError *error = NULL;
+
+        redshiftgtk_backend_start (self->backend, &error);
+
+        if (error)
+                g_dbus_method_invocation_take_error (invocation, error);
+        else
+                redshiftgtk_dbus_backend_complete_start (skeleton, invocation);
+
+        return TRUE;
+}
+
+static gboolean
+handle_stop (RedshiftGtkDBusBackend *skeleton,
+             GDBusMethodInvocation  *invocation,
+             gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+
+        redshiftgtk_backend_stop (self->backend);
+        redshiftgtk_dbus_backend_complete_stop (skeleton, invocation);
+
+        return TRUE;
+}
+
+static gboolean
+handle_set_autostart (RedshiftGtkDBusBackend *skeleton,
+                      GDBusMethodInvocation  *invocation,
+                      gboolean                autostart,
+                      gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+        GError *error = NULL;
+
+        redshiftgtk_backend_set_autostart (self->backend, autostart, &error);
+
+        if (error)
+                g_dbus_method_invocation_take_error (invocation, error);
+        else
+                redshiftgtk_dbus_backend_complete_set_autostart (skeleton, invocation);
+
+        return TRUE;
+}
+
+/* A window that crashed or was killed mid-preview would leave
+ * redshift stopped for good
+ */
+static void
+preview_owner_vanished_cb (GDBusConnection *connection,
+                           const gchar     *name,
+                           gpointer         user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+
+        redshiftgtk_dbus_service_unwatch_preview (self);
+        redshiftgtk_backend_end_preview (self->backend);
+}
+
+static void
+redshiftgtk_dbus_service_watch_preview (RedshiftGtkDBusService *self,
+                                        GDBusMethodInvocation  *invocation)
+{
+        const gchar *sender = g_dbus_method_invocation_get_sender (invocation);
+
+        /* Peer-to-peer connections have no names to watch */
+        if (!sender || g_strcmp0 (sender, self->preview_owner) == 0)
+                return;
+
+        redshiftgtk_dbus_service_unwatch_preview (self);
+        self->preview_owner = g_strdup (sender);
+        self->preview_watch = g_bus_watch_name_on_connection (g_dbus_method_invocation_get_connection (invocation),
+                                                              sender,
+                                                              G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                              NULL,
+                                                              preview_owner_vanished_cb,
+                                                              self, NULL);
+}
+
+static gboolean
+handle_preview_temperature (RedshiftGtkDBusBackend *skeleton,
+                            GDBusMethodInvocation  *invocation,
+                            guint                   period,
+                            gdouble                 temperature,
+                            gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+
+        redshiftgtk_dbus_service_watch_preview (self, invocation);
+        redshiftgtk_backend_preview_temperature (self->backend, period, temperature);
+        redshiftgtk_dbus_backend_complete_preview_temperature (skeleton, invocation);
+
+        return TRUE;
+}
+
+static gboolean
+handle_end_preview (RedshiftGtkDBusBackend *skeleton,
+                    GDBusMethodInvocation  *invocation,
+                    gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+
+        redshiftgtk_dbus_service_unwatch_preview (self);
+        redshiftgtk_backend_end_preview (self->backend);
+        redshiftgtk_dbus_backend_complete_end_preview (skeleton, invocation);
+
+        return TRUE;
+}
+
+static gboolean
+handle_switch_profile (RedshiftGtkDBusBackend *skeleton,
+                       GDBusMethodInvocation  *invocation,
+                       const gchar            *name,
+                       gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+        GError *error = NULL;
+
+        redshiftgtk_backend_switch_profile (self->backend, name, &error);
+
+        if (error)
+                g_dbus_method_invocation_take_error (invocation, error);
+        else
+                redshiftgtk_dbus_backend_complete_switch_profile (skeleton, invocation);
+
+        return TRUE;
+}
+
+static gboolean
+handle_set_override (RedshiftGtkDBusBackend *skeleton,
+                     GDBusMethodInvocation  *invocation,
+                     const gchar            *key,
+                     const gchar            *value,
+                     gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+        GError *error = NULL;
+
+        redshiftgtk_backend_set_override (self->backend, key,
+                                          *value ? value : NULL, &error);
+
+        if (error)
+                g_dbus_method_invocation_take_error (invocation, error);
+        else
+                redshiftgtk_dbus_backend_complete_set_override (skeleton, invocation);
+
+        return TRUE;
+}
+
+static gboolean
+handle_list_foreign (RedshiftGtkDBusBackend *skeleton,
+                     GDBusMethodInvocation  *invocation,
+                     gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+        g_autoptr (GPtrArray) foreign = redshiftgtk_backend_list_foreign (self->backend);
+        GVariantBuilder builder;
+        guint i;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(uss)"));
+        for (i = 0; i < foreign->len; i++) {
+                RedshiftGtkProcess *process = g_ptr_array_index (foreign, i);
+
+                g_variant_builder_add (&builder, "(uss)",
+                                       (guint32) process->pid, process->name, process->cmdline);
+        }
+
+        redshiftgtk_dbus_backend_complete_list_foreign (skeleton, invocation,
+                                                        g_variant_builder_end (&builder));
+
+        return TRUE;
+}
+
+static gboolean
+handle_adopt (RedshiftGtkDBusBackend *skeleton,
+              GDBusMethodInvocation  *invocation,
+              guint                   pid,
+              gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+        GError *error = NULL;
+
+        redshiftgtk_backend_adopt (self->backend, (GPid) pid, &error);
+
+        if (error)
+                g_dbus_method_invocation_take_error (invocation, error);
+        else
+                redshiftgtk_dbus_backend_complete_adopt (skeleton, invocation);
+
+        return TRUE;
+}
+
+static gboolean
+handle_leave (RedshiftGtkDBusBackend *skeleton,
+              GDBusMethodInvocation  *invocation,
+              guint                   pid,
+              gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+
+        redshiftgtk_backend_leave (self->backend, (GPid) pid);
+        redshiftgtk_dbus_backend_complete_leave (skeleton, invocation);
+
+        return TRUE;
+}
+
+static gboolean
+handle_list_outputs (RedshiftGtkDBusBackend *skeleton,
+                     GDBusMethodInvocation  *invocation,
+                     gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+        g_autoptr (GPtrArray) outputs = redshiftgtk_backend_list_outputs (self->backend);
+        GVariantBuilder builder;
+        guint i;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(suu)"));
+        for (i = 0; i < outputs->len; i++) {
+                RedshiftGtkOutput *output = g_ptr_array_index (outputs, i);
+
+                g_variant_builder_add (&builder, "(suu)",
+                                       output->name, output->crtc, output->ramp_size);
+        }
+
+        redshiftgtk_dbus_backend_complete_list_outputs (skeleton, invocation,
+                                                        g_variant_builder_end (&builder));
+
+        return TRUE;
+}
+
+static gboolean
+handle_get_output_setting (RedshiftGtkDBusBackend *skeleton,
+                           GDBusMethodInvocation  *invocation,
+                           const gchar            *output,
+                           const gchar            *key,
+                           gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+        g_autofree gchar *value = redshiftgtk_backend_get_output_setting (self->backend,
+                                                                         output, key);
+
+        redshiftgtk_dbus_backend_complete_get_output_setting (skeleton, invocation,
+                                                              value ? value : "");
+
+        return TRUE;
+}
+
+static gboolean
+handle_set_output_setting (RedshiftGtkDBusBackend *skeleton,
+                           GDBusMethodInvocation  *invocation,
+                           const gchar            *output,
+                           const gchar            *key,
+                           const gchar            *value,
+                           gpointer                user_data)
+{
+        RedshiftGtkDBusService *self = user_data;
+        GError *error = NULL;
+
+        redshiftgtk_backend_set_output_setting (self->backend, output, key,
+                                                *value ? value : NULL, &error);
+
+        if (error)
+                g_dbus_method_invocation_take_error (invocation, error);
+        else
+                redshiftgtk_dbus_backend_complete_set_output_setting (skeleton, invocation);
+
+        return TRUE;
+}
+
+/**
+ * redshiftgtk_dbus_service_new
+ *
+ * Wrap a backend so it can be exported on the bus
+ */
+RedshiftGtkDBusService*
+redshiftgtk_dbus_service_new (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkDBusService *self;
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (backend));
+
+        self = g_object_new (REDSHIFTGTK_TYPE_DBUS_SERVICE, NULL);
+        self->backend = g_object_ref (backend);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (self->backend, "changed",
+                                    backend_changed_cb, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->backend, "autostart-failed",
+                                    backend_autostart_failed_cb, self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-get-snapshot",
+                                    handle_get_snapshot, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-update",
+                                    handle_update, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-apply-changes",
+                                    handle_apply_changes, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-start",
+                                    handle_start, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-stop",
+                                    handle_stop, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-set-autostart",
+                                    handle_set_autostart, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-preview-temperature",
+                                    handle_preview_temperature, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-end-preview",
+                                    handle_end_preview, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-switch-profile",
+                                    handle_switch_profile, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-set-override",
+                                    handle_set_override, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-list-foreign",
+                                    handle_list_foreign, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-adopt",
+                                    handle_adopt, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-leave",
+                                    handle_leave, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-list-outputs",
+                                    handle_list_outputs, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-get-output-setting",
+                                    handle_get_output_setting, self);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->skeleton, "handle-set-output-setting",
+                                    handle_set_output_setting, self);
+
+        return self;
+}
+
+/**
+ * redshiftgtk_dbus_service_export
+ *
+ * Export the backend at REDSHIFTGTK_DBUS_OBJECT_PATH. Method calls
+ * are dispatched in the thread-default main context of the caller.
+ */
+gboolean
+redshiftgtk_dbus_service_export (RedshiftGtkDBusService *self,
+                                 GDBusConnection        *connection,
+                                 GError                **error)
+{
+        g_assert (REDSHIFTGTK_IS_DBUS_SERVICE (self));
+        g_assert (error == NULL || *error == NULL);
+
+        return g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (self->skeleton),
+                                                 connection,
+                                                 REDSHIFTGTK_DBUS_OBJECT_PATH,
+                                                 error);
+}
+
+void
+redshiftgtk_dbus_service_unexport (RedshiftGtkDBusService *self)
+{
+        GDBusInterfaceSkeleton *skeleton;
+
+        g_assert (REDSHIFTGTK_IS_DBUS_SERVICE (self));
+
+        skeleton = G_DBUS_INTERFACE_SKELETON (self->skeleton);
+        if (g_dbus_interface_skeleton_get_connection (skeleton))
+                g_dbus_interface_skeleton_unexport (skeleton);
+}
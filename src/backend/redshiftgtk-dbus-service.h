@@ -0,0 +1,43 @@
+/* redshiftgtk-dbus-service.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "redshiftgtk-backend.h"
+
+G_BEGIN_DECLS
+
+#define REDSHIFTGTK_DBUS_NAME        "com.github.cybre.RedshiftGtk.Daemon"
+#define REDSHIFTGTK_DBUS_OBJECT_PATH "/com/github/cybre/RedshiftGtk/Backend"
+
+#define REDSHIFTGTK_TYPE_DBUS_SERVICE redshiftgtk_dbus_service_get_type ()
+G_DECLARE_FINAL_TYPE (RedshiftGtkDBusService, redshiftgtk_dbus_service,
+                      REDSHIFTGTK, DBUS_SERVICE, GObject)
+
+RedshiftGtkDBusService*
+redshiftgtk_dbus_service_new      (RedshiftGtkBackend     *backend);
+
+gboolean
+redshiftgtk_dbus_service_export   (RedshiftGtkDBusService *self,
+                                   GDBusConnection        *connection,
+                                   GError                **error);
+void
+redshiftgtk_dbus_service_unexport (RedshiftGtkDBusService *self);
+
+G_END_DECLS
@@ -0,0 +1,1346 @@
+/* redshiftgtk-gsettings-backend.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <gio/gio.h>
+#include <glib/gi18n.h>
+
+#include "redshiftgtk-config-document.h"
+#include "redshiftgtk-gsettings-backend.h"
+#include "redshiftgtk-metrics.h"
+#include "redshiftgtk-outputs.h"
+#include "redshiftgtk-redshift-wrapper.h"
+#include "redshiftgtk-settings-layers.h"
+#include "redshiftgtk-settings-schema.h"
+#include "redshiftgtk-stall-monitor.h"
+
+#define SETTINGS_SCHEMA_ID REDSHIFTGTK_GSETTINGS_SCHEMA_ID ".Settings"
+#define SETTINGS_PATH "/com/github/cybre/RedshiftGtk/"
+
+/* Stored as "auto" where redshift picks the choice by itself */
+#define AUTO_CHOICE "auto"
+
+#define OUTPUTS_TYPE ((const GVariantType *) "a{sa{ss}}")
+
+typedef struct {
+        RedshiftGtkGSettingsBackend *backend;
+        /* Interned, NULL for the default settings */
+        const gchar *name;
+        /* Delayed, nothing reaches dconf before apply */
+        GSettings *settings;
+        /* The merged view, kept up to date by change notifications */
+        RedshiftGtkSettingsLayers *layers;
+        /* Created here, not in the profile list before apply */
+        gboolean unlisted;
+} Profile;
+
+struct _RedshiftGtkGSettingsBackend
+{
+        GObject parent_instance;
+
+        GSettingsSchema *schema;
+        GSettings *settings;
+        Profile *defaults;
+        GHashTable *profiles;   /* name quark -> Profile */
+        Profile *active;
+        /* Settings of single outputs waiting for apply, NULL if
+         * there are none
+         */
+        GVariant *outputs;
+
+        /* redshift can't read GSettings. The runner manages a
+         * redshift.conf of its own, written from the settings the
+         * first time a child needs it and whenever it went stale.
+         */
+        RedshiftGtkBackend *runner;
+        gboolean runner_stale;
+        gboolean running;
+};
+
+static void
+redshiftgtk_backend_iface_init (RedshiftGtkBackendInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (RedshiftGtkGSettingsBackend,
+                         redshiftgtk_gsettings_backend,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (REDSHIFTGTK_TYPE_BACKEND,
+                                                redshiftgtk_backend_iface_init))
+
+static GVariant*
+redshiftgtk_gsettings_backend_to_variant (Setting            setting,
+                                          const SettingValue value)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        const gchar *choice;
+
+        switch (info->type) {
+        case SETTING_TYPE_GAMMA:
+                return g_variant_new ("(ddd)", value[0], value[1], value[2]);
+        case SETTING_TYPE_CHOICE:
+                choice = info->choices[(guint) value[0]];
+                return g_variant_new_string (choice ? choice : AUTO_CHOICE);
+        case SETTING_TYPE_FLAG:
+                return g_variant_new_boolean (value[0] != 0);
+        default:
+                return g_variant_new_double (value[0]);
+        }
+}
+
+static gboolean
+redshiftgtk_gsettings_backend_from_variant (Setting       setting,
+                                            GVariant     *variant,
+                                            SettingValue  value)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        const gchar *string;
+        guint i;
+
+        switch (info->type) {
+        case SETTING_TYPE_GAMMA:
+                g_variant_get (variant, "(ddd)", &value[0], &value[1], &value[2]);
+                break;
+        case SETTING_TYPE_CHOICE:
+                string = g_variant_get_string (variant, NULL);
+                for (i = info->minimum; i <= info->maximum; i++) {
+                        if (g_strcmp0 (info->choices[i] ? info->choices[i] : AUTO_CHOICE, string) == 0)
+                                break;
+                }
+                if (i > info->maximum)
+                        return FALSE;
+                value[0] = value[1] = value[2] = i;
+                break;
+        case SETTING_TYPE_FLAG:
+                value[0] = value[1] = value[2] = g_variant_get_boolean (variant);
+                break;
+        default:
+                value[0] = value[1] = value[2] = g_variant_get_double (variant);
+                break;
+        }
+
+        redshiftgtk_settings_schema_validate (setting, value);
+
+        return TRUE;
+}
+
+/* Pick up what GSettings has for @setting. Returns TRUE if the
+ * merged value changed.
+ */
+static gboolean
+redshiftgtk_gsettings_backend_profile_read (Profile *profile,
+                                            Setting  setting)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        g_autoptr (GSettingsSchemaKey) key = NULL;
+        g_autoptr (GVariant) fallback = NULL;
+        g_autoptr (GVariant) system = NULL;
+        g_autoptr (GVariant) user = NULL;
+        SettingValue value;
+        gboolean changed = FALSE;
+
+        key = g_settings_schema_get_key (profile->backend->schema, info->key);
+        fallback = g_settings_schema_key_get_default_value (key);
+
+        /* Defaults an administrator put in the system databases */
+        system = g_settings_get_default_value (profile->settings, info->key);
+        if (system && !g_variant_equal (system, fallback) &&
+            redshiftgtk_gsettings_backend_from_variant (setting, system, value))
+                changed |= redshiftgtk_settings_layers_set (profile->layers, CONFIG_LAYER_SYSTEM,
+                                                            setting, value);
+        else
+                changed |= redshiftgtk_settings_layers_unset (profile->layers, CONFIG_LAYER_SYSTEM,
+                                                              setting);
+
+        /* Includes what is waiting for apply */
+        user = g_settings_get_user_value (profile->settings, info->key);
+        if (user && redshiftgtk_gsettings_backend_from_variant (setting, user, value))
+                changed |= redshiftgtk_settings_layers_set (profile->layers, CONFIG_LAYER_USER,
+                                                            setting, value);
+        else
+                changed |= redshiftgtk_settings_layers_unset (profile->layers, CONFIG_LAYER_USER,
+                                                              setting);
+
+        return changed;
+}
+
+static void
+redshiftgtk_gsettings_backend_profile_changed_cb (GSettings   *settings,
+                                                  const gchar *key,
+                                                  Profile     *profile)
+{
+        RedshiftGtkGSettingsBackend *self = profile->backend;
+        Setting setting;
+
+        if (!redshiftgtk_settings_schema_find (key, &setting))
+                return;
+
+        /* Our own writes are in the layers already, this only
+         * goes through for changes made somewhere else
+         */
+        if (!redshiftgtk_gsettings_backend_profile_read (profile, setting) ||
+            profile != self->active)
+                return;
+
+        self->runner_stale = TRUE;
+        g_signal_emit_by_name (self, "changed");
+}
+
+static Profile*
+redshiftgtk_gsettings_backend_profile_new (RedshiftGtkGSettingsBackend *self,
+                                           const gchar                 *name)
+{
+        Profile *profile = g_new0 (Profile, 1);
+        g_autofree gchar *path = NULL;
+        Setting setting;
+
+        if (name)
+                path = g_strconcat (SETTINGS_PATH "profiles/", name, "/", NULL);
+        else
+                path = g_strdup (SETTINGS_PATH "settings/");
+
+        profile->backend = self;
+        profile->name = name ? g_intern_string (name) : NULL;
+        profile->settings = g_settings_new_full (self->schema, NULL, path);
+        profile->layers = redshiftgtk_settings_layers_new ();
+        g_settings_delay (profile->settings);
+
+        /* Notifications only come for keys read after connecting */
+        REDSHIFTGTK_SIGNAL_CONNECT (profile->settings, "changed",
+                                    redshiftgtk_gsettings_backend_profile_changed_cb,
+                                    profile);
+
+        for (setting = 0; setting < N_SETTINGS; setting++)
+                redshiftgtk_gsettings_backend_profile_read (profile, setting);
+
+        return profile;
+}
+
+static void
+redshiftgtk_gsettings_backend_profile_free (Profile *profile)
+{
+        g_signal_handlers_disconnect_by_data (profile->settings, profile);
+        g_object_unref (profile->settings);
+        redshiftgtk_settings_layers_free (profile->layers);
+        g_free (profile);
+}
+
+static Profile*
+redshiftgtk_gsettings_backend_profile_lookup (RedshiftGtkGSettingsBackend *self,
+                                              const gchar                 *name)
+{
+        GQuark quark = g_quark_try_string (name);
+
+        if (!quark)
+                return NULL;
+
+        return g_hash_table_lookup (self->profiles, GUINT_TO_POINTER (quark));
+}
+
+static void
+redshiftgtk_gsettings_backend_profile_insert (RedshiftGtkGSettingsBackend *self,
+                                              Profile                     *profile)
+{
+        g_hash_table_insert (self->profiles,
+                             GUINT_TO_POINTER (g_quark_from_static_string (profile->name)),
+                             profile);
+}
+
+static gboolean
+redshiftgtk_gsettings_backend_profile_name_is_valid (const gchar *name)
+{
+        const gchar *c;
+
+        /* Has to work as one element of a dconf path */
+        for (c = name; *c; c++) {
+                if (*c == '/' || g_ascii_iscntrl (*c))
+                        return FALSE;
+        }
+
+        return *name != '\0' && g_utf8_validate (name, -1, NULL);
+}
+
+/* Follow the profile list. Profiles created here stay around until
+ * they had a chance to be applied. Returns TRUE if anything changed.
+ */
+static gboolean
+redshiftgtk_gsettings_backend_load_profiles (RedshiftGtkGSettingsBackend *self)
+{
+        g_auto (GStrv) names = NULL;
+        GHashTableIter iter;
+        Profile *profile;
+        gboolean changed = FALSE;
+        guint i;
+
+        names = g_settings_get_strv (self->settings, "profiles");
+
+        g_hash_table_iter_init (&iter, self->profiles);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &profile)) {
+                if (profile->unlisted ||
+                    g_strv_contains ((const gchar * const *) names, profile->name))
+                        continue;
+
+                if (self->active == profile) {
+                        self->active = self->defaults;
+                        self->runner_stale = TRUE;
+                }
+
+                g_hash_table_iter_remove (&iter);
+                changed = TRUE;
+        }
+
+        for (i = 0; names[i]; i++) {
+                if (!redshiftgtk_gsettings_backend_profile_name_is_valid (names[i]))
+                        continue;
+
+                profile = redshiftgtk_gsettings_backend_profile_lookup (self, names[i]);
+                if (profile) {
+                        profile->unlisted = FALSE;
+                        continue;
+                }
+
+                profile = redshiftgtk_gsettings_backend_profile_new (self, names[i]);
+                redshiftgtk_gsettings_backend_profile_insert (self, profile);
+                changed = TRUE;
+        }
+
+        return changed;
+}
+
+static void
+redshiftgtk_gsettings_backend_profiles_changed_cb (GSettings                   *settings,
+                                                   const gchar                 *key,
+                                                   RedshiftGtkGSettingsBackend *self)
+{
+        if (redshiftgtk_gsettings_backend_load_profiles (self))
+                g_signal_emit_by_name (self, "changed");
+}
+
+static void
+redshiftgtk_gsettings_backend_outputs_changed_cb (GSettings                   *settings,
+                                                  const gchar                 *key,
+                                                  RedshiftGtkGSettingsBackend *self)
+{
+        self->runner_stale = TRUE;
+        g_signal_emit_by_name (self, "changed");
+}
+
+static void
+redshiftgtk_gsettings_backend_dispose (GObject *object)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (object);
+
+        if (self->settings)
+                g_signal_handlers_disconnect_by_data (self->settings, self);
+
+        if (self->runner)
+                g_signal_handlers_disconnect_by_data (self->runner, self);
+
+        g_clear_object (&self->runner);
+        g_clear_pointer (&self->outputs, g_variant_unref);
+        g_clear_pointer (&self->profiles, g_hash_table_unref);
+        g_clear_pointer (&self->defaults, redshiftgtk_gsettings_backend_profile_free);
+        self->active = NULL;
+        g_clear_object (&self->settings);
+        g_clear_pointer (&self->schema, g_settings_schema_unref);
+
+        G_OBJECT_CLASS (redshiftgtk_gsettings_backend_parent_class)->dispose (object);
+}
+
+static void
+redshiftgtk_gsettings_backend_class_init (RedshiftGtkGSettingsBackendClass *klass)
+{
+        GObjectClass *obj_class = G_OBJECT_CLASS (klass);
+
+        obj_class->dispose = redshiftgtk_gsettings_backend_dispose;
+}
+
+static void
+redshiftgtk_gsettings_backend_init (RedshiftGtkGSettingsBackend *self)
+{
+        GSettingsSchemaSource *source = g_settings_schema_source_get_default ();
+
+        /* Callers check redshiftgtk_gsettings_backend_is_available() */
+        self->schema = g_settings_schema_source_lookup (source, SETTINGS_SCHEMA_ID, TRUE);
+        g_assert (self->schema != NULL);
+
+        self->settings = g_settings_new (REDSHIFTGTK_GSETTINGS_SCHEMA_ID);
+        self->profiles = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                                (GDestroyNotify) redshiftgtk_gsettings_backend_profile_free);
+        self->defaults = redshiftgtk_gsettings_backend_profile_new (self, NULL);
+        self->active = self->defaults;
+        self->runner_stale = TRUE;
+
+        REDSHIFTGTK_SIGNAL_CONNECT (self->settings, "changed::profiles",
+                                    redshiftgtk_gsettings_backend_profiles_changed_cb,
+                                    self);
+        redshiftgtk_gsettings_backend_load_profiles (self);
+
+        /* Notifications only come for keys read after connecting */
+        REDSHIFTGTK_SIGNAL_CONNECT (self->settings, "changed::outputs",
+                                    redshiftgtk_gsettings_backend_outputs_changed_cb,
+                                    self);
+        g_variant_unref (g_settings_get_value (self->settings, "outputs"));
+}
+
+/**
+ * redshiftgtk_gsettings_backend_is_available
+ *
+ * Whether the compiled schema is installed where GSettings looks
+ */
+gboolean
+redshiftgtk_gsettings_backend_is_available (void)
+{
+        GSettingsSchemaSource *source = g_settings_schema_source_get_default ();
+        g_autoptr (GSettingsSchema) schema = NULL;
+
+        if (!source)
+                return FALSE;
+
+        schema = g_settings_schema_source_lookup (source, SETTINGS_SCHEMA_ID, TRUE);
+
+        return schema != NULL;
+}
+
+RedshiftGtkBackend*
+redshiftgtk_gsettings_backend_new ()
+{
+        return g_object_new (REDSHIFTGTK_TYPE_GSETTINGS_BACKEND, NULL);
+}
+
+/* Merged value of @setting in the active profile */
+static const gdouble*
+redshiftgtk_gsettings_backend_value (RedshiftGtkGSettingsBackend *self,
+                                     Setting                      setting)
+{
+        return redshiftgtk_settings_layers_get (self->active->layers, setting);
+}
+
+/* Settings of single outputs, including the ones waiting for apply */
+static GVariant*
+redshiftgtk_gsettings_backend_get_outputs (RedshiftGtkGSettingsBackend *self)
+{
+        if (self->outputs)
+                return g_variant_ref (self->outputs);
+
+        return g_settings_get_value (self->settings, "outputs");
+}
+
+static gchar*
+redshiftgtk_gsettings_backend_get_runner_path (void)
+{
+        /* Outlives the session, a redshift started at login reads it */
+        return g_build_filename (g_get_user_data_dir (), "redshiftgtk", "redshift.conf", NULL);
+}
+
+/* The runner writes the launcher, failures are ours to report */
+static void
+redshiftgtk_gsettings_backend_autostart_failed_cb (RedshiftGtkBackend *runner,
+                                                   const gchar        *message,
+                                                   gpointer            user_data)
+{
+        g_signal_emit_by_name (user_data, "autostart-failed", message);
+}
+
+/* What apply stored for @setting in the active profile, with the
+ * system defaults under it. Neither edits waiting for apply nor
+ * runtime overrides.
+ */
+static void
+redshiftgtk_gsettings_backend_applied_value (RedshiftGtkGSettingsBackend *self,
+                                             GSettings                   *applied,
+                                             Setting                      setting,
+                                             SettingValue                 value)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        g_autoptr (GVariant) variant = g_settings_get_value (applied, info->key);
+
+        if (!redshiftgtk_gsettings_backend_from_variant (setting, variant, value))
+                value[0] = value[1] = value[2] = info->fallback;
+}
+
+/* The runner, reading whatever an earlier start left in its file.
+ * That may be stale or missing, fine for anything but starting
+ * redshift: only start and autostart write the file.
+ */
+static RedshiftGtkBackend*
+redshiftgtk_gsettings_backend_get_runner (RedshiftGtkGSettingsBackend *self)
+{
+        g_autofree gchar *path = NULL;
+
+        if (self->runner)
+                return self->runner;
+
+        path = redshiftgtk_gsettings_backend_get_runner_path ();
+        self->runner = redshiftgtk_redshift_wrapper_new_for_path (path);
+        REDSHIFTGTK_SIGNAL_CONNECT (self->runner, "autostart-failed",
+                                    redshiftgtk_gsettings_backend_autostart_failed_cb,
+                                    self);
+        self->runner_stale = TRUE;
+
+        return self->runner;
+}
+
+/* Hand what isn't applied to the runner as overrides of its own,
+ * it passes them to redshift through its runtime config
+ */
+static gboolean
+redshiftgtk_gsettings_backend_sync_overrides (RedshiftGtkGSettingsBackend *self,
+                                              GSettings                   *applied,
+                                              GError                     **error)
+{
+        g_autoptr (GVariant) stored = NULL;
+        gchar buffer[SETTING_FORMAT_SIZE];
+        GVariantIter iter;
+        GVariantIter *values;
+        const gchar *output;
+        const gchar *key;
+        const gchar *value;
+        Setting setting;
+
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+                const gdouble *merged = redshiftgtk_gsettings_backend_value (self, setting);
+                SettingValue on_disk;
+
+                redshiftgtk_gsettings_backend_applied_value (self, applied, setting, on_disk);
+                redshiftgtk_backend_set_override (self->runner, info->key,
+                                                  memcmp (merged, on_disk, sizeof (SettingValue)) != 0 ?
+                                                  redshiftgtk_settings_schema_format (setting, merged, buffer) :
+                                                  NULL,
+                                                  error);
+                if (error && *error)
+                        return FALSE;
+        }
+
+        if (!self->outputs)
+                return TRUE;
+
+        /* Dropped from the pending outputs, then set from them */
+        stored = g_settings_get_value (self->settings, "outputs");
+        g_variant_iter_init (&iter, stored);
+        while (g_variant_iter_loop (&iter, "{&sa{ss}}", &output, &values)) {
+                while (g_variant_iter_loop (values, "{&s&s}", &key, &value))
+                        redshiftgtk_backend_set_output_setting (self->runner, output, key, NULL, NULL);
+        }
+
+        g_variant_iter_init (&iter, self->outputs);
+        while (g_variant_iter_loop (&iter, "{&sa{ss}}", &output, &values)) {
+                while (g_variant_iter_loop (values, "{&s&s}", &key, &value)) {
+                        redshiftgtk_backend_set_output_setting (self->runner, output, key, value, error);
+                        if (error && *error)
+                                return FALSE;
+                }
+        }
+
+        return TRUE;
+}
+
+/* Write what apply stored in the active profile where the runner
+ * reads it, if it changed since the last time. The file outlives
+ * the session, so what isn't applied stays out of it.
+ */
+static gboolean
+redshiftgtk_gsettings_backend_sync_runner (RedshiftGtkGSettingsBackend *self,
+                                           GError                     **error)
+{
+        g_autoptr (RedshiftGtkConfigDocument) document = NULL;
+        g_autoptr (GSettings) applied = NULL;
+        g_autoptr (GVariant) outputs = NULL;
+        g_autofree gchar *profile_path = NULL;
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *directory = NULL;
+        RedshiftGtkBackend *runner;
+        GError *local_error = NULL;
+        gchar buffer[SETTING_FORMAT_SIZE];
+        GVariantIter iter;
+        GVariantIter *values;
+        const gchar *output;
+        const gchar *key;
+        const gchar *value;
+        const gchar *data;
+        gsize length;
+        Setting setting;
+
+        if (self->runner && !self->runner_stale)
+                return TRUE;
+
+        /* Not delayed, reads what dconf has */
+        g_object_get (self->active->settings, "path", &profile_path, NULL);
+        applied = g_settings_new_full (self->schema, NULL, profile_path);
+
+        document = redshiftgtk_config_document_new ("", 0);
+
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+                SettingValue on_disk;
+
+                redshiftgtk_gsettings_backend_applied_value (self, applied, setting, on_disk);
+                redshiftgtk_config_document_set (document, info->group, info->key,
+                                                 redshiftgtk_settings_schema_format (setting,
+                                                                                     on_disk,
+                                                                                     buffer));
+        }
+
+        /* The runner starts one redshift per output from these */
+        outputs = g_settings_get_value (self->settings, "outputs");
+        g_variant_iter_init (&iter, outputs);
+        while (g_variant_iter_loop (&iter, "{&sa{ss}}", &output, &values)) {
+                g_autofree gchar *group = g_strconcat (OUTPUT_GROUP_PREFIX, output, NULL);
+
+                while (g_variant_iter_loop (values, "{&s&s}", &key, &value))
+                        redshiftgtk_config_document_set (document, group, key, value);
+        }
+
+        path = redshiftgtk_gsettings_backend_get_runner_path ();
+        directory = g_path_get_dirname (path);
+        g_mkdir_with_parents (directory, 0700);
+
+        data = redshiftgtk_config_document_get_data (document, &length);
+        if (!g_file_set_contents (path, data, length, error))
+                return FALSE;
+        redshiftgtk_metrics_count_write (length);
+
+        runner = redshiftgtk_gsettings_backend_get_runner (self);
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (runner),
+                                                  &local_error);
+        if (local_error) {
+                g_propagate_error (error, local_error);
+                return FALSE;
+        }
+
+        if (!redshiftgtk_gsettings_backend_sync_overrides (self, applied, error))
+                return FALSE;
+
+        self->runner_stale = FALSE;
+
+        return TRUE;
+}
+
+static void
+redshiftgtk_gsettings_backend_start (RedshiftGtkBackend *backend,
+                                     GError            **error)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        if (!redshiftgtk_gsettings_backend_sync_runner (self, error))
+                return;
+
+        redshiftgtk_backend_start (self->runner, error);
+        self->running = TRUE;
+}
+
+static void
+redshiftgtk_gsettings_backend_stop (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        RedshiftGtkBackend *runner = redshiftgtk_gsettings_backend_get_runner (self);
+
+        if (runner)
+                redshiftgtk_backend_stop (runner);
+        self->running = FALSE;
+}
+
+static gboolean
+redshiftgtk_gsettings_backend_is_running (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        return self->runner && redshiftgtk_backend_is_running (self->runner);
+}
+
+/* Validate and cache, the write waits in GSettings for apply */
+static void
+redshiftgtk_gsettings_backend_store (RedshiftGtkGSettingsBackend *self,
+                                     Setting                      setting,
+                                     gdouble                      red,
+                                     gdouble                      green,
+                                     gdouble                      blue)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        RedshiftGtkSettingsLayers *layers = self->active->layers;
+        SettingValue value = { red, green, blue };
+
+        redshiftgtk_settings_schema_validate (setting, value);
+
+        if (memcmp (redshiftgtk_settings_layers_get (layers, setting), value,
+                    sizeof (SettingValue)) == 0)
+                return;
+
+        /* Something set on purpose replaces a temporary override */
+        redshiftgtk_settings_layers_set (layers, CONFIG_LAYER_USER, setting, value);
+        redshiftgtk_settings_layers_unset (layers, CONFIG_LAYER_RUNTIME, setting);
+        self->runner_stale = TRUE;
+
+        g_settings_set_value (self->active->settings, info->key,
+                              redshiftgtk_gsettings_backend_to_variant (setting, value));
+}
+
+static gdouble
+redshiftgtk_gsettings_backend_get_temperature (RedshiftGtkBackend *backend,
+                                               TimePeriod          period)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        return redshiftgtk_gsettings_backend_value (self, SETTING_TEMP_DAY + period)[0];
+}
+
+static void
+redshiftgtk_gsettings_backend_set_temperature (RedshiftGtkBackend *backend,
+                                               TimePeriod          period,
+                                               gdouble             temperature)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        redshiftgtk_gsettings_backend_store (self, SETTING_TEMP_DAY + period,
+                                             temperature, temperature, temperature);
+}
+
+static LocationProvider
+redshiftgtk_gsettings_backend_get_location_provider (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        return (LocationProvider) redshiftgtk_gsettings_backend_value (self, SETTING_LOCATION_PROVIDER)[0];
+}
+
+static void
+redshiftgtk_gsettings_backend_set_location_provider (RedshiftGtkBackend *backend,
+                                                     LocationProvider    provider)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        redshiftgtk_gsettings_backend_store (self, SETTING_LOCATION_PROVIDER,
+                                             provider, provider, provider);
+}
+
+static gdouble
+redshiftgtk_gsettings_backend_get_latitude (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        return redshiftgtk_gsettings_backend_value (self, SETTING_LATITUDE)[0];
+}
+
+static void
+redshiftgtk_gsettings_backend_set_latitude (RedshiftGtkBackend *backend,
+                                            gdouble             latitude)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        redshiftgtk_gsettings_backend_store (self, SETTING_LATITUDE,
+                                             latitude, latitude, latitude);
+}
+
+static gdouble
+redshiftgtk_gsettings_backend_get_longtitude (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        return redshiftgtk_gsettings_backend_value (self, SETTING_LONGTITUDE)[0];
+}
+
+static void
+redshiftgtk_gsettings_backend_set_longtitude (RedshiftGtkBackend *backend,
+                                              gdouble             longtitude)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        redshiftgtk_gsettings_backend_store (self, SETTING_LONGTITUDE,
+                                             longtitude, longtitude, longtitude);
+}
+
+static gdouble
+redshiftgtk_gsettings_backend_get_brightness (RedshiftGtkBackend *backend,
+                                              TimePeriod          period)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        return redshiftgtk_gsettings_backend_value (self, SETTING_BRIGHTNESS_DAY + period)[0];
+}
+
+static void
+redshiftgtk_gsettings_backend_set_brightness (RedshiftGtkBackend *backend,
+                                              TimePeriod          period,
+                                              gdouble             brightness)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        redshiftgtk_gsettings_backend_store (self, SETTING_BRIGHTNESS_DAY + period,
+                                             brightness, brightness, brightness);
+}
+
+static GArray*
+redshiftgtk_gsettings_backend_get_gamma (RedshiftGtkBackend *backend,
+                                         TimePeriod          period)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        GArray *gamma = NULL;
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        gamma = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), SETTING_COMPONENTS);
+        g_array_append_vals (gamma,
+                             redshiftgtk_gsettings_backend_value (self, SETTING_GAMMA_DAY + period),
+                             SETTING_COMPONENTS);
+
+        return gamma;
+}
+
+static void
+redshiftgtk_gsettings_backend_set_gamma (RedshiftGtkBackend *backend,
+                                         TimePeriod          period,
+                                         gdouble             red,
+                                         gdouble             green,
+                                         gdouble             blue)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        redshiftgtk_gsettings_backend_store (self, SETTING_GAMMA_DAY + period,
+                                             red, green, blue);
+}
+
+static AdjustmentMethod
+redshiftgtk_gsettings_backend_get_adjustment_method (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        return (AdjustmentMethod) redshiftgtk_gsettings_backend_value (self, SETTING_ADJUSTMENT_METHOD)[0];
+}
+
+static void
+redshiftgtk_gsettings_backend_set_adjustment_method (RedshiftGtkBackend *backend,
+                                                     AdjustmentMethod    method)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        redshiftgtk_gsettings_backend_store (self, SETTING_ADJUSTMENT_METHOD,
+                                             method, method, method);
+}
+
+static gboolean
+redshiftgtk_gsettings_backend_get_smooth_transition (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        return redshiftgtk_gsettings_backend_value (self, SETTING_FADE)[0] != 0;
+}
+
+static void
+redshiftgtk_gsettings_backend_set_smooth_transition (RedshiftGtkBackend *backend,
+                                                     gboolean            transition)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        gdouble value = transition ? 1 : 0;
+
+        redshiftgtk_gsettings_backend_store (self, SETTING_FADE, value, value, value);
+}
+
+static gboolean
+redshiftgtk_gsettings_backend_get_autostart (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        RedshiftGtkBackend *runner = redshiftgtk_gsettings_backend_get_runner (self);
+
+        return runner ? redshiftgtk_backend_get_autostart (runner) : FALSE;
+}
+
+static void
+redshiftgtk_gsettings_backend_set_autostart (RedshiftGtkBackend *backend,
+                                             gboolean            autostart,
+                                             GError            **error)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        /* The launcher starts redshift on the runner's file */
+        if (!redshiftgtk_gsettings_backend_sync_runner (self, error))
+                return;
+
+        redshiftgtk_backend_set_autostart (self->runner, autostart, error);
+}
+
+static gint
+redshiftgtk_gsettings_backend_compare_names (gconstpointer a,
+                                             gconstpointer b)
+{
+        return g_strcmp0 (*(const gchar **) a, *(const gchar **) b);
+}
+
+/* Names of every profile, sorted. Free the array, not the names. */
+static GPtrArray*
+redshiftgtk_gsettings_backend_get_names (RedshiftGtkGSettingsBackend *self)
+{
+        GPtrArray *names;
+        GHashTableIter iter;
+        Profile *profile;
+
+        names = g_ptr_array_sized_new (g_hash_table_size (self->profiles) + 1);
+
+        g_hash_table_iter_init (&iter, self->profiles);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &profile))
+                g_ptr_array_add (names, (gpointer) profile->name);
+
+        g_ptr_array_sort (names, redshiftgtk_gsettings_backend_compare_names);
+        g_ptr_array_add (names, NULL);
+
+        return names;
+}
+
+static void
+redshiftgtk_gsettings_backend_apply_changes (RedshiftGtkBackend *backend,
+                                             GError            **error)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        GHashTableIter iter;
+        Profile *profile;
+        gboolean applied = FALSE;
+        gboolean listed = TRUE;
+
+        if (g_settings_get_has_unapplied (self->defaults->settings)) {
+                g_settings_apply (self->defaults->settings);
+                applied = TRUE;
+        }
+
+        if (self->outputs) {
+                g_settings_set_value (self->settings, "outputs", self->outputs);
+                g_clear_pointer (&self->outputs, g_variant_unref);
+                applied = TRUE;
+        }
+
+        g_hash_table_iter_init (&iter, self->profiles);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &profile)) {
+                if (g_settings_get_has_unapplied (profile->settings)) {
+                        g_settings_apply (profile->settings);
+                        applied = TRUE;
+                }
+
+                if (profile->unlisted)
+                        listed = FALSE;
+        }
+
+        /* New profiles show up for everyone else only now */
+        if (!listed) {
+                g_autoptr (GPtrArray) names = redshiftgtk_gsettings_backend_get_names (self);
+
+                g_hash_table_iter_init (&iter, self->profiles);
+                while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &profile))
+                        profile->unlisted = FALSE;
+
+                g_settings_set_strv (self->settings, "profiles",
+                                     (const gchar * const *) names->pdata);
+                applied = TRUE;
+        }
+
+        if (!applied)
+                return;
+
+        /* What was only handed to the runner goes into its file now */
+        self->runner_stale = TRUE;
+
+        /* A redshift started at login reads the runner's file too */
+        if (redshiftgtk_backend_get_autostart (redshiftgtk_gsettings_backend_get_runner (self)) &&
+            !redshiftgtk_gsettings_backend_sync_runner (self, error))
+                return;
+
+        g_signal_emit_by_name (self, "changed");
+}
+
+static void
+redshiftgtk_gsettings_backend_preview_temperature (RedshiftGtkBackend *backend,
+                                                   TimePeriod          period,
+                                                   gdouble             temperature)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        RedshiftGtkBackend *runner = redshiftgtk_gsettings_backend_get_runner (self);
+
+        /* Called for every step of a drag, never writes anything */
+        if (runner)
+                redshiftgtk_backend_preview_temperature (runner, period, temperature);
+}
+
+static void
+redshiftgtk_gsettings_backend_end_preview (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+
+        if (self->runner)
+                redshiftgtk_backend_end_preview (self->runner);
+}
+
+static gchar**
+redshiftgtk_gsettings_backend_list_profiles (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        g_autoptr (GPtrArray) names = redshiftgtk_gsettings_backend_get_names (self);
+
+        return g_strdupv ((gchar **) names->pdata);
+}
+
+static const gchar*
+redshiftgtk_gsettings_backend_get_profile (RedshiftGtkBackend *backend)
+{
+        return REDSHIFTGTK_GSETTINGS_BACKEND (backend)->active->name;
+}
+
+static void
+redshiftgtk_gsettings_backend_switch_profile (RedshiftGtkBackend *backend,
+                                              const gchar        *name,
+                                              GError            **error)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        Profile *profile = self->defaults;
+        Setting setting;
+
+        if (name && *name) {
+                if (!redshiftgtk_gsettings_backend_profile_name_is_valid (name)) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                                     _("Invalid profile name \"%s\""), name);
+                        return;
+                }
+
+                profile = redshiftgtk_gsettings_backend_profile_lookup (self, name);
+
+                /* New profiles start out as a copy of what is active now,
+                 * written on the next apply. Overrides are dropped first,
+                 * they are meant to go away and would be saved for good.
+                 */
+                if (!profile) {
+                        for (setting = 0; setting < N_SETTINGS; setting++)
+                                redshiftgtk_settings_layers_unset (self->active->layers,
+                                                                   CONFIG_LAYER_RUNTIME, setting);
+
+                        profile = redshiftgtk_gsettings_backend_profile_new (self, name);
+                        for (setting = 0; setting < N_SETTINGS; setting++) {
+                                const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+
+                                g_settings_set_value (profile->settings, info->key,
+                                                      redshiftgtk_gsettings_backend_to_variant (setting,
+                                                                                                redshiftgtk_gsettings_backend_value (self, setting)));
+                                redshiftgtk_gsettings_backend_profile_read (profile, setting);
+                        }
+                        profile->unlisted = TRUE;
+                        redshiftgtk_gsettings_backend_profile_insert (self, profile);
+                }
+        }
+
+        if (profile == self->active)
+                return;
+
+        self->active = profile;
+        self->runner_stale = TRUE;
+
+        /* The ramps follow right away if redshift is running */
+        if (self->running)
+                redshiftgtk_gsettings_backend_start (backend, error);
+
+        g_signal_emit_by_name (self, "changed");
+}
+
+static void
+redshiftgtk_gsettings_backend_set_override (RedshiftGtkBackend *backend,
+                                            const gchar        *key,
+                                            const gchar        *value,
+                                            GError            **error)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        RedshiftGtkSettingsLayers *layers = self->active->layers;
+        SettingValue parsed;
+        Setting setting;
+        gboolean changed;
+
+        if (!redshiftgtk_settings_schema_find (key, &setting)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                             _("Unknown setting “%s”"), key);
+                return;
+        }
+
+        if (value) {
+                if (!redshiftgtk_settings_schema_parse_value (setting, value, parsed)) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                                     _("“%s” is not a valid value for %s"), value, key);
+                        return;
+                }
+
+                changed = redshiftgtk_settings_layers_set (layers, CONFIG_LAYER_RUNTIME,
+                                                           setting, parsed);
+        } else {
+                changed = redshiftgtk_settings_layers_unset (layers, CONFIG_LAYER_RUNTIME,
+                                                             setting);
+        }
+
+        /* Only in memory, overrides never reach GSettings */
+        if (changed) {
+                self->runner_stale = TRUE;
+                g_signal_emit_by_name (self, "changed");
+        }
+}
+
+static ConfigLayer
+redshiftgtk_gsettings_backend_get_source (RedshiftGtkBackend *backend,
+                                          const gchar        *key)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        Setting setting;
+
+        if (!redshiftgtk_settings_schema_find (key, &setting))
+                return CONFIG_LAYER_DEFAULT;
+
+        return redshiftgtk_settings_layers_get_source (self->active->layers, setting);
+}
+
+/* Whatever runs redshift for us knows what else does */
+static GPtrArray*
+redshiftgtk_gsettings_backend_list_foreign (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        RedshiftGtkBackend *runner = redshiftgtk_gsettings_backend_get_runner (self);
+
+        if (!runner)
+                return g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_process_free);
+
+        return redshiftgtk_backend_list_foreign (runner);
+}
+
+static void
+redshiftgtk_gsettings_backend_adopt (RedshiftGtkBackend *backend,
+                                     GPid                pid,
+                                     GError            **error)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        RedshiftGtkBackend *runner = redshiftgtk_gsettings_backend_get_runner (self);
+        GError *local_error = NULL;
+
+        if (!runner) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                             _("No redshift instance with process ID %d"), pid);
+                return;
+        }
+
+        redshiftgtk_backend_adopt (runner, pid, &local_error);
+        if (local_error) {
+                g_propagate_error (error, local_error);
+                return;
+        }
+
+        self->running = TRUE;
+}
+
+static void
+redshiftgtk_gsettings_backend_leave (RedshiftGtkBackend *backend,
+                                     GPid                pid)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        RedshiftGtkBackend *runner = redshiftgtk_gsettings_backend_get_runner (self);
+
+        if (runner)
+                redshiftgtk_backend_leave (runner, pid);
+}
+
+/* What the runner finds */
+static GPtrArray*
+redshiftgtk_gsettings_backend_list_outputs (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        RedshiftGtkBackend *runner = redshiftgtk_gsettings_backend_get_runner (self);
+
+        if (!runner)
+                return g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_output_free);
+
+        return redshiftgtk_backend_list_outputs (runner);
+}
+
+static gchar*
+redshiftgtk_gsettings_backend_get_output_setting (RedshiftGtkBackend *backend,
+                                                  const gchar        *output,
+                                                  const gchar        *key)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        g_autoptr (GVariant) outputs = redshiftgtk_gsettings_backend_get_outputs (self);
+        g_autoptr (GVariant) values = NULL;
+        gchar *value = NULL;
+
+        values = g_variant_lookup_value (outputs, output, G_VARIANT_TYPE ("a{ss}"));
+        if (values)
+                g_variant_lookup (values, key, "s", &value);
+
+        return value;
+}
+
+static gboolean
+redshiftgtk_gsettings_backend_output_name_is_valid (const gchar *name)
+{
+        const gchar *c;
+
+        /* Has to survive as part of a group header in the runner's file */
+        for (c = name; *c; c++) {
+                if (*c == '[' || *c == ']' || g_ascii_iscntrl (*c))
+                        return FALSE;
+        }
+
+        return *name != '\0' && g_utf8_validate (name, -1, NULL);
+}
+
+/* @outputs with @key of @output set to @value, or dropped if @value
+ * is NULL. Outputs left without settings go away.
+ */
+static GVariant*
+redshiftgtk_gsettings_backend_replace_output_setting (GVariant    *outputs,
+                                                      const gchar *output,
+                                                      const gchar *key,
+                                                      const gchar *value)
+{
+        GVariantBuilder builder;
+        GVariantBuilder settings;
+        GVariantIter iter;
+        GVariantIter value_iter;
+        GVariant *values;
+        const gchar *name;
+        const gchar *other_key;
+        const gchar *other_value;
+        gboolean empty = value == NULL;
+
+        g_variant_builder_init (&builder, OUTPUTS_TYPE);
+        g_variant_builder_init (&settings, G_VARIANT_TYPE ("a{ss}"));
+
+        g_variant_iter_init (&iter, outputs);
+        while (g_variant_iter_loop (&iter, "{&s@a{ss}}", &name, &values)) {
+                if (g_strcmp0 (name, output) != 0) {
+                        g_variant_builder_add (&builder, "{s@a{ss}}", name, values);
+                        continue;
+                }
+
+                g_variant_iter_init (&value_iter, values);
+                while (g_variant_iter_loop (&value_iter, "{&s&s}", &other_key, &other_value)) {
+                        if (g_strcmp0 (other_key, key) == 0)
+                                continue;
+
+                        g_variant_builder_add (&settings, "{ss}", other_key, other_value);
+                        empty = FALSE;
+                }
+        }
+
+        if (value)
+                g_variant_builder_add (&settings, "{ss}", key, value);
+
+        if (empty)
+                g_variant_builder_clear (&settings);
+        else
+                g_variant_builder_add (&builder, "{sa{ss}}", output, &settings);
+
+        return g_variant_builder_end (&builder);
+}
+
+static void
+redshiftgtk_gsettings_backend_set_output_setting (RedshiftGtkBackend *backend,
+                                                  const gchar        *output,
+                                                  const gchar        *key,
+                                                  const gchar        *value,
+                                                  GError            **error)
+{
+        RedshiftGtkGSettingsBackend *self = REDSHIFTGTK_GSETTINGS_BACKEND (backend);
+        g_autoptr (GVariant) outputs = NULL;
+        g_autoptr (GVariant) replaced = NULL;
+        gchar buffer[SETTING_FORMAT_SIZE];
+        SettingValue parsed;
+        Setting setting;
+
+        if (!redshiftgtk_gsettings_backend_output_name_is_valid (output)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                             _("Invalid output name \"%s\""), output);
+                return;
+        }
+
+        if (!redshiftgtk_settings_schema_find (key, &setting)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                             _("Unknown setting “%s”"), key);
+                return;
+        }
+
+        if (!redshiftgtk_settings_schema_is_per_output (setting)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                             _("%s is the same for every output"), key);
+                return;
+        }
+
+        if (value) {
+                if (!redshiftgtk_settings_schema_parse_value (setting, value, parsed)) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                                     _("“%s” is not a valid value for %s"), value, key);
+                        return;
+                }
+
+                /* Stored the way the runner's file would have it */
+                value = redshiftgtk_settings_schema_format (setting, parsed, buffer);
+        }
+
+        outputs = redshiftgtk_gsettings_backend_get_outputs (self);
+        replaced = g_variant_ref_sink (redshiftgtk_gsettings_backend_replace_output_setting (outputs,
+                                                                                              output,
+                                                                                              key,
+                                                                                              value));
+        if (g_variant_equal (outputs, replaced))
+                return;
+
+        g_clear_pointer (&self->outputs, g_variant_unref);
+        self->outputs = g_steal_pointer (&replaced);
+        self->runner_stale = TRUE;
+
+        g_signal_emit_by_name (self, "changed");
+}
+
+/* Connect our methods to the interface */
+static void
+redshiftgtk_backend_iface_init (RedshiftGtkBackendInterface *iface)
+{
+        iface->start = redshiftgtk_gsettings_backend_start;
+        iface->stop = redshiftgtk_gsettings_backend_stop;
+        iface->is_running = redshiftgtk_gsettings_backend_is_running;
+        iface->get_temperature = redshiftgtk_gsettings_backend_get_temperature;
+        iface->set_temperature = redshiftgtk_gsettings_backend_set_temperature;
+        iface->get_location_provider = redshiftgtk_gsettings_backend_get_location_provider;
+        iface->set_location_provider = redshiftgtk_gsettings_backend_set_location_provider;
+        iface->get_latitude = redshiftgtk_gsettings_backend_get_latitude;
+        iface->set_latitude = redshiftgtk_gsettings_backend_set_latitude;
+        iface->get_longtitude = redshiftgtk_gsettings_backend_get_longtitude;
+        iface->set_longtitude = redshiftgtk_gsettings_backend_set_longtitude;
+        iface->get_brightness = redshiftgtk_gsettings_backend_get_brightness;
+        iface->set_brightness = redshiftgtk_gsettings_backend_set_brightness;
+        iface->get_gamma = redshiftgtk_gsettings_backend_get_gamma;
+        iface->set_gamma = redshiftgtk_gsettings_backend_set_gamma;
+        iface->get_adjustment_method = redshiftgtk_gsettings_backend_get_adjustment_method;
+        iface->set_adjustment_method = redshiftgtk_gsettings_backend_set_adjustment_method;
+        iface->get_smooth_transition = redshiftgtk_gsettings_backend_get_smooth_transition;
+        iface->set_smooth_transition = redshiftgtk_gsettings_backend_set_smooth_transition;
+        iface->get_autostart = redshiftgtk_gsettings_backend_get_autostart;
+        iface->set_autostart = redshiftgtk_gsettings_backend_set_autostart;
+        iface->apply_changes = redshiftgtk_gsettings_backend_apply_changes;
+        iface->preview_temperature = redshiftgtk_gsettings_backend_preview_temperature;
+        iface->end_preview = redshiftgtk_gsettings_backend_end_preview;
+        iface->list_profiles = redshiftgtk_gsettings_backend_list_profiles;
+        iface->get_profile = redshiftgtk_gsettings_backend_get_profile;
+        iface->switch_profile = redshiftgtk_gsettings_backend_switch_profile;
+        iface->set_override = redshiftgtk_gsettings_backend_set_override;
+        iface->get_source = redshiftgtk_gsettings_backend_get_source;
+        iface->list_foreign = redshiftgtk_gsettings_backend_list_foreign;
+        iface->adopt = redshiftgtk_gsettings_backend_adopt;
+        iface->leave = redshiftgtk_gsettings_backend_leave;
+        iface->list_outputs = redshiftgtk_gsettings_backend_list_outputs;
+        iface->get_output_setting = redshiftgtk_gsettings_backend_get_output_setting;
+        iface->set_output_setting = redshiftgtk_gsettings_backend_set_output_setting;
+}
@@ -0,0 +1,400 @@
+/* redshiftgtk-metrics.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "redshiftgtk-metrics.h"
+
+/* Enough for any histogram below, the last one is +Inf */
+#define MAX_BUCKETS 16
+
+typedef struct {
+        const gchar *name;
+        const gchar *unit;
+        const gchar *help;
+} CounterInfo;
+
+typedef struct {
+        const gchar *name;
+        const gchar *unit;
+        const gchar *help;
+        const gdouble *bounds;
+        guint n_bounds;
+} HistogramInfo;
+
+typedef struct {
+        /* Per bucket, made cumulative when written */
+        guint64 buckets[MAX_BUCKETS];
+        guint64 count;
+        gdouble sum;
+} Histogram;
+
+/* Family names, OpenMetrics adds _total to counter samples */
+static const CounterInfo counter_info[N_METRIC_COUNTERS] = {
+        [METRIC_APPLIES] = {
+                "redshiftgtk_applies", NULL,
+                "Settings applied" },
+        [METRIC_SPAWNS] = {
+                "redshiftgtk_spawns", NULL,
+                "redshift processes started" },
+        [METRIC_KILLS] = {
+                "redshiftgtk_kills", NULL,
+                "Times running redshift instances were stopped" },
+        [METRIC_CONFIG_WRITES] = {
+                "redshiftgtk_config_writes", NULL,
+                "Config files written" },
+        [METRIC_CONFIG_WRITTEN_BYTES] = {
+                "redshiftgtk_config_written_bytes", "bytes",
+                "Bytes of config written" },
+        [METRIC_REDRAWS] = {
+                "redshiftgtk_redraws", NULL,
+                "Slider redraws" },
+        [METRIC_RAMPS_SENT] = {
+                "redshiftgtk_ramps_sent", NULL,
+                "Gamma ramps uploaded to an output" },
+        [METRIC_RAMPS_SKIPPED] = {
+                "redshiftgtk_ramps_skipped", NULL,
+                "Gamma ramps not uploaded because the output had them already" },
+};
+
+/* From a settled apply to one waiting on a slow disk or daemon */
+static const gdouble apply_bounds[] = {
+        0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5
+};
+
+static const HistogramInfo histogram_info[N_METRIC_HISTOGRAMS] = {
+        [METRIC_APPLY_DURATION] = {
+                "redshiftgtk_apply_duration_seconds", "seconds",
+                "Time taken to apply settings",
+                apply_bounds, G_N_ELEMENTS (apply_bounds) },
+};
+
+G_STATIC_ASSERT (G_N_ELEMENTS (apply_bounds) < MAX_BUCKETS);
+
+/* Counted from any thread, the rest belongs to the main thread */
+static GMutex metrics_lock;
+static guint64 counters[N_METRIC_COUNTERS];
+static Histogram histograms[N_METRIC_HISTOGRAMS];
+static gboolean dirty;
+
+static gchar *metrics_path;
+static gchar *metrics_program;
+static guint flush_id;
+
+static void
+redshiftgtk_metrics_exit (void)
+{
+        redshiftgtk_metrics_stop ();
+}
+
+static gboolean
+redshiftgtk_metrics_flush_cb (gpointer user_data)
+{
+        g_autoptr (GError) error = NULL;
+
+        if (!redshiftgtk_metrics_flush (&error))
+                g_warning ("redshiftgtk_metrics_flush_cb\n\
+        redshiftgtk_metrics_flush: %s\n", error->message);
+
+        return G_SOURCE_CONTINUE;
+}
+
+/**
+ * redshiftgtk_metrics_start
+ *
+ * Write the metrics to @path every @interval seconds in which
+ * something changed, and once more on exit. A directory gets a
+ * file named after @program, which also labels every sample so
+ * the GUI, daemon and CLI can share one collector directory.
+ */
+gboolean
+redshiftgtk_metrics_start (const gchar *path,
+                           const gchar *program,
+                           guint        interval)
+{
+        static gboolean exit_hooked = FALSE;
+
+        g_return_val_if_fail (path != NULL && *path != '\0', FALSE);
+
+        redshiftgtk_metrics_stop ();
+
+        metrics_program = g_strdup (program);
+        if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
+                g_autofree gchar *basename = g_strconcat (program ? program : "redshiftgtk",
+                                                          ".prom", NULL);
+                metrics_path = g_build_filename (path, basename, NULL);
+        } else {
+                metrics_path = g_strdup (path);
+        }
+
+        if (interval > 0) {
+                flush_id = g_timeout_add_seconds (interval, redshiftgtk_metrics_flush_cb, NULL);
+                g_source_set_name_by_id (flush_id, "[redshiftgtk] metrics flush");
+        }
+
+        /* Short-lived callers like the CLI never reach a timeout */
+        if (!exit_hooked) {
+                atexit (redshiftgtk_metrics_exit);
+                exit_hooked = TRUE;
+        }
+
+        /* Have a file to scrape right away, even if all zeroes */
+        g_mutex_lock (&metrics_lock);
+        dirty = TRUE;
+        g_mutex_unlock (&metrics_lock);
+
+        return TRUE;
+}
+
+/**
+ * redshiftgtk_metrics_start_from_env
+ *
+ * Start writing if REDSHIFTGTK_METRICS_FILE names a file or directory,
+ * every REDSHIFTGTK_METRICS_INTERVAL seconds or 30 if unset
+ */
+gboolean
+redshiftgtk_metrics_start_from_env (const gchar *program)
+{
+        const gchar *path = g_getenv (REDSHIFTGTK_METRICS_ENV);
+        const gchar *value = g_getenv (REDSHIFTGTK_METRICS_INTERVAL_ENV);
+        guint64 interval = REDSHIFTGTK_METRICS_DEFAULT_INTERVAL;
+
+        if (!path || !*path)
+                return FALSE;
+
+        if (value && *value) {
+                gchar *end = NULL;
+
+                interval = g_ascii_strtoull (value, &end, 10);
+                if (*end != '\0' || interval > G_MAXUINT) {
+                        g_warning ("redshiftgtk_metrics_start_from_env\n\
+        g_ascii_strtoull: %s is not an interval\n", value);
+                        interval = REDSHIFTGTK_METRICS_DEFAULT_INTERVAL;
+                }
+        }
+
+        return redshiftgtk_metrics_start (path, program, (guint) interval);
+}
+
+/**
+ * redshiftgtk_metrics_stop
+ *
+ * Write what is still unwritten and stop writing
+ */
+void
+redshiftgtk_metrics_stop (void)
+{
+        g_autoptr (GError) error = NULL;
+
+        if (!metrics_path)
+                return;
+
+        if (!redshiftgtk_metrics_flush (&error))
+                g_warning ("redshiftgtk_metrics_stop\n\
+        redshiftgtk_metrics_flush: %s\n", error->message);
+
+        if (flush_id) {
+                g_source_remove (flush_id);
+                flush_id = 0;
+        }
+        g_clear_pointer (&metrics_path, g_free);
+        g_clear_pointer (&metrics_program, g_free);
+}
+
+void
+redshiftgtk_metrics_count (MetricCounter counter,
+                           guint64       amount)
+{
+        g_return_if_fail (counter < N_METRIC_COUNTERS);
+
+        g_mutex_lock (&metrics_lock);
+        counters[counter] += amount;
+        dirty = TRUE;
+        g_mutex_unlock (&metrics_lock);
+}
+
+void
+redshiftgtk_metrics_observe (MetricHistogram histogram,
+                             gdouble         value)
+{
+        const HistogramInfo *info;
+        Histogram *h;
+        guint i;
+
+        g_return_if_fail (histogram < N_METRIC_HISTOGRAMS);
+
+        info = &histogram_info[histogram];
+
+        /* Upper bounds are inclusive */
+        for (i = 0; i < info->n_bounds; i++) {
+                if (value <= info->bounds[i])
+                        break;
+        }
+
+        g_mutex_lock (&metrics_lock);
+        h = &histograms[histogram];
+        h->buckets[i]++;
+        h->count++;
+        h->sum += value;
+        dirty = TRUE;
+        g_mutex_unlock (&metrics_lock);
+}
+
+guint64
+redshiftgtk_metrics_get (MetricCounter counter)
+{
+        guint64 value;
+
+        g_return_val_if_fail (counter < N_METRIC_COUNTERS, 0);
+
+        g_mutex_lock (&metrics_lock);
+        value = counters[counter];
+        g_mutex_unlock (&metrics_lock);
+
+        return value;
+}
+
+/* Back to zero, for tests */
+void
+redshiftgtk_metrics_reset (void)
+{
+        g_mutex_lock (&metrics_lock);
+        memset (counters, 0, sizeof (counters));
+        memset (histograms, 0, sizeof (histograms));
+        dirty = TRUE;
+        g_mutex_unlock (&metrics_lock);
+}
+
+static void
+redshiftgtk_metrics_format_header (GString     *output,
+                                   const gchar *name,
+                                   const gchar *type,
+                                   const gchar *unit,
+                                   const gchar *help)
+{
+        g_string_append_printf (output, "# TYPE %s %s\n", name, type);
+        if (unit)
+                g_string_append_printf (output, "# UNIT %s %s\n", name, unit);
+        g_string_append_printf (output, "# HELP %s %s\n", name, help);
+}
+
+/**
+ * redshiftgtk_metrics_format
+ *
+ * Everything counted so far in the OpenMetrics text format
+ */
+gchar*
+redshiftgtk_metrics_format (void)
+{
+        guint64 counter_values[N_METRIC_COUNTERS];
+        Histogram histogram_values[N_METRIC_HISTOGRAMS];
+        g_autofree gchar *labels = NULL;
+        g_autofree gchar *bucket_labels = NULL;
+        gchar number[G_ASCII_DTOSTR_BUF_SIZE];
+        GString *output = g_string_new (NULL);
+        guint i, j;
+
+        /* One consistent snapshot, formatted without the lock */
+        g_mutex_lock (&metrics_lock);
+        memcpy (counter_values, counters, sizeof (counters));
+        memcpy (histogram_values, histograms, sizeof (histograms));
+        g_mutex_unlock (&metrics_lock);
+
+        if (metrics_program) {
+                labels = g_strdup_printf ("{program=\"%s\"}", metrics_program);
+                bucket_labels = g_strdup_printf ("{program=\"%s\",", metrics_program);
+        } else {
+                labels = g_strdup ("");
+                bucket_labels = g_strdup ("{");
+        }
+
+        for (i = 0; i < N_METRIC_COUNTERS; i++) {
+                const CounterInfo *info = &counter_info[i];
+
+                redshiftgtk_metrics_format_header (output, info->name, "counter",
+                                                   info->unit, info->help);
+                g_string_append_printf (output, "%s_total%s %" G_GUINT64_FORMAT "\n",
+                                        info->name, labels, counter_values[i]);
+        }
+
+        for (i = 0; i < N_METRIC_HISTOGRAMS; i++) {
+                const HistogramInfo *info = &histogram_info[i];
+                const Histogram *h = &histogram_values[i];
+                guint64 cumulative = 0;
+
+                redshiftgtk_metrics_format_header (output, info->name, "histogram",
+                                                   info->unit, info->help);
+
+                for (j = 0; j <= info->n_bounds; j++) {
+                        cumulative += h->buckets[j];
+
+                        if (j < info->n_bounds)
+                                g_ascii_formatd (number, sizeof (number), "%g", info->bounds[j]);
+                        else
+                                g_strlcpy (number, "+Inf", sizeof (number));
+
+                        g_string_append_printf (output, "%s_bucket%sle=\"%s\"} %" G_GUINT64_FORMAT "\n",
+                                                info->name, bucket_labels, number, cumulative);
+                }
+
+                g_string_append_printf (output, "%s_count%s %" G_GUINT64_FORMAT "\n",
+                                        info->name, labels, h->count);
+                g_string_append_printf (output, "%s_sum%s %s\n",
+                                        info->name, labels,
+                                        g_ascii_dtostr (number, sizeof (number), h->sum));
+        }
+
+        g_string_append (output, "# EOF\n");
+
+        return g_string_free (output, FALSE);
+}
+
+/**
+ * redshiftgtk_metrics_flush
+ *
+ * Write the file now if anything changed since the last write.
+ * It is replaced by a rename, a collector never reads half of it.
+ */
+gboolean
+redshiftgtk_metrics_flush (GError **error)
+{
+        g_autofree gchar *data = NULL;
+        gboolean was_dirty;
+
+        if (!metrics_path)
+                return TRUE;
+
+        g_mutex_lock (&metrics_lock);
+        was_dirty = dirty;
+        dirty = FALSE;
+        g_mutex_unlock (&metrics_lock);
+
+        if (!was_dirty)
+                return TRUE;
+
+        data = redshiftgtk_metrics_format ();
+        if (!g_file_set_contents (metrics_path, data, -1, error)) {
+                /* Try again next time */
+                g_mutex_lock (&metrics_lock);
+                dirty = TRUE;
+                g_mutex_unlock (&metrics_lock);
+                return FALSE;
+        }
+
+        return TRUE;
+}
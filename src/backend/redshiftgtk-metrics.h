@@ -0,0 +1,85 @@
+/* redshiftgtk-metrics.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Counters and histograms for the whole process, written out now and
+ * then as an OpenMetrics text file for node_exporter's textfile
+ * collector or anything else that reads one. Counting always happens,
+ * it is a locked add; only REDSHIFTGTK_METRICS_FILE makes them land
+ * anywhere.
+ */
+#define REDSHIFTGTK_METRICS_ENV "REDSHIFTGTK_METRICS_FILE"
+/* Seconds between writes, nothing is written while nothing changed */
+#define REDSHIFTGTK_METRICS_INTERVAL_ENV "REDSHIFTGTK_METRICS_INTERVAL"
+#define REDSHIFTGTK_METRICS_DEFAULT_INTERVAL 30
+
+typedef enum {
+        METRIC_APPLIES,
+        METRIC_SPAWNS,
+        METRIC_KILLS,
+        METRIC_CONFIG_WRITES,
+        METRIC_CONFIG_WRITTEN_BYTES,
+        METRIC_REDRAWS,
+        METRIC_RAMPS_SENT,
+        METRIC_RAMPS_SKIPPED,
+        N_METRIC_COUNTERS
+} MetricCounter;
+
+typedef enum {
+        METRIC_APPLY_DURATION,
+        N_METRIC_HISTOGRAMS
+} MetricHistogram;
+
+gboolean
+redshiftgtk_metrics_start          (const gchar     *path,
+                                    const gchar     *program,
+                                    guint            interval);
+gboolean
+redshiftgtk_metrics_start_from_env (const gchar     *program);
+void
+redshiftgtk_metrics_stop           (void);
+
+void
+redshiftgtk_metrics_count          (MetricCounter    counter,
+                                    guint64          amount);
+void
+redshiftgtk_metrics_observe        (MetricHistogram  histogram,
+                                    gdouble          value);
+guint64
+redshiftgtk_metrics_get            (MetricCounter    counter);
+void
+redshiftgtk_metrics_reset          (void);
+
+gchar*
+redshiftgtk_metrics_format         (void);
+gboolean
+redshiftgtk_metrics_flush          (GError         **error);
+
+/* One file written by us, @length bytes of it */
+static inline void
+redshiftgtk_metrics_count_write (gsize length)
+{
+        redshiftgtk_metrics_count (METRIC_CONFIG_WRITES, 1);
+        redshiftgtk_metrics_count (METRIC_CONFIG_WRITTEN_BYTES, length);
+}
+
+G_END_DECLS
@@ -0,0 +1,58 @@
+/* redshiftgtk-outputs.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "redshiftgtk-outputs.h"
+
+RedshiftGtkOutput*
+redshiftgtk_output_new (const gchar *name,
+                        guint        crtc,
+                        guint        ramp_size)
+{
+        RedshiftGtkOutput *output = g_new0 (RedshiftGtkOutput, 1);
+
+        output->name = g_strdup (name);
+        output->crtc = crtc;
+        output->ramp_size = ramp_size;
+
+        return output;
+}
+
+RedshiftGtkOutput*
+redshiftgtk_output_copy (const RedshiftGtkOutput *output)
+{
+        return redshiftgtk_output_new (output->name, output->crtc, output->ramp_size);
+}
+
+void
+redshiftgtk_output_free (RedshiftGtkOutput *output)
+{
+        g_free (output->name);
+        g_free (output);
+}
+
+gboolean
+redshiftgtk_ramp_key_equal (const RedshiftGtkRampKey *a,
+                            const RedshiftGtkRampKey *b)
+{
+        /* Field by field, padding is anybody's guess */
+        return a->temperature == b->temperature &&
+               a->brightness == b->brightness &&
+               a->gamma[0] == b->gamma[0] &&
+               a->gamma[1] == b->gamma[1] &&
+               a->gamma[2] == b->gamma[2] &&
+               a->size == b->size;
+}
@@ -0,0 +1,66 @@
+/* redshiftgtk-outputs.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include "enums.h"
+
+G_BEGIN_DECLS
+
+/* Settings of single outputs live in [output:NAME] groups */
+#define OUTPUT_GROUP_PREFIX "output:"
+
+/* A CRTC that lights up at least one output. @crtc is its index in
+ * the screen resources, the number redshift's randr:crtc= takes.
+ */
+typedef struct {
+        /* Of the first output on the CRTC */
+        gchar *name;
+        guint crtc;
+        /* Entries per channel of its gamma ramps */
+        guint ramp_size;
+} RedshiftGtkOutput;
+
+RedshiftGtkOutput*
+redshiftgtk_output_new  (const gchar             *name,
+                         guint                    crtc,
+                         guint                    ramp_size);
+RedshiftGtkOutput*
+redshiftgtk_output_copy (const RedshiftGtkOutput *output);
+void
+redshiftgtk_output_free (RedshiftGtkOutput       *output);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RedshiftGtkOutput, redshiftgtk_output_free)
+
+/* Everything that goes into the ramp of one output for one time
+ * period. Two outputs with equal keys get the same ramp, an output
+ * whose key didn't change keeps the one it has.
+ */
+typedef struct {
+        gdouble temperature;
+        gdouble brightness;
+        gdouble gamma[3];
+        guint size;
+} RedshiftGtkRampKey;
+
+gboolean
+redshiftgtk_ramp_key_equal (const RedshiftGtkRampKey *a,
+                            const RedshiftGtkRampKey *b);
+
+G_END_DECLS
@@ -0,0 +1,325 @@
+/* redshiftgtk-process-scan.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <signal.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "redshiftgtk-process-scan.h"
+
+struct _RedshiftGtkProcessScan
+{
+        gchar *proc_dir;
+        /* RedshiftGtkProcess, NULL until the next scan */
+        GPtrArray *processes;
+        guint scans;
+};
+
+typedef struct {
+        gchar *proc_dir;
+        GPid pid;
+} Termination;
+
+static const gchar * const process_names[] = { "redshift", "redshift-gtk" };
+
+/* Set the ramps once, or not at all, and exit */
+static const gchar * const one_shot_arguments[] = { "-o", "-x", "-p", "-h", "-V" };
+
+RedshiftGtkProcess*
+redshiftgtk_process_new (GPid         pid,
+                         const gchar *name,
+                         const gchar *cmdline)
+{
+        RedshiftGtkProcess *process = g_new0 (RedshiftGtkProcess, 1);
+
+        process->pid = pid;
+        process->name = g_strdup (name);
+        process->cmdline = g_strdup (cmdline);
+
+        return process;
+}
+
+RedshiftGtkProcess*
+redshiftgtk_process_copy (const RedshiftGtkProcess *process)
+{
+        return redshiftgtk_process_new (process->pid, process->name, process->cmdline);
+}
+
+void
+redshiftgtk_process_free (RedshiftGtkProcess *process)
+{
+        g_free (process->name);
+        g_free (process->cmdline);
+        g_free (process);
+}
+
+/* Name of @pid if it is a redshift of ours to look at, NULL otherwise */
+static gchar*
+redshiftgtk_process_scan_read_name (const gchar *proc_dir,
+                                    GPid         pid)
+{
+        g_autofree gchar *directory = NULL;
+        g_autofree gchar *path = NULL;
+        gchar *name = NULL;
+        GStatBuf buffer;
+        guint i;
+
+        directory = g_strdup_printf ("%s/%d", proc_dir, pid);
+        if (g_stat (directory, &buffer) != 0 || buffer.st_uid != getuid ())
+                return NULL;
+
+        path = g_build_filename (directory, "comm", NULL);
+        if (!g_file_get_contents (path, &name, NULL, NULL))
+                return NULL;
+        g_strchomp (name);
+
+        for (i = 0; i < G_N_ELEMENTS (process_names); i++) {
+                if (g_strcmp0 (name, process_names[i]) == 0)
+                        return name;
+        }
+
+        g_free (name);
+        return NULL;
+}
+
+static gboolean
+redshiftgtk_process_scan_is_one_shot (const gchar *argument)
+{
+        guint i;
+
+        /* -O takes its temperature attached or separately */
+        if (g_str_has_prefix (argument, "-O"))
+                return TRUE;
+
+        for (i = 0; i < G_N_ELEMENTS (one_shot_arguments); i++) {
+                if (g_strcmp0 (argument, one_shot_arguments[i]) == 0)
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+/* The instance running as @pid, NULL if there is none or it is
+ * a one-shot call that is about to exit anyway
+ */
+static RedshiftGtkProcess*
+redshiftgtk_process_scan_read (RedshiftGtkProcessScan *self,
+                               GPid                    pid)
+{
+        g_autofree gchar *name = NULL;
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *contents = NULL;
+        g_autoptr (GString) cmdline = NULL;
+        const gchar *argument;
+        gsize length;
+
+        name = redshiftgtk_process_scan_read_name (self->proc_dir, pid);
+        if (!name)
+                return NULL;
+
+        /* Arguments end in a NUL each, a zombie has none */
+        path = g_strdup_printf ("%s/%d/cmdline", self->proc_dir, pid);
+        if (!g_file_get_contents (path, &contents, &length, NULL) || length == 0)
+                return NULL;
+
+        cmdline = g_string_new (NULL);
+        for (argument = contents; argument < contents + length;
+             argument += strlen (argument) + 1) {
+                if (redshiftgtk_process_scan_is_one_shot (argument))
+                        return NULL;
+
+                if (cmdline->len > 0)
+                        g_string_append_c (cmdline, ' ');
+                g_string_append (cmdline, argument);
+        }
+
+        return redshiftgtk_process_new (pid, name, cmdline->str);
+}
+
+static GPtrArray*
+redshiftgtk_process_scan_run (RedshiftGtkProcessScan *self)
+{
+        GPtrArray *processes = g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_process_free);
+        g_autoptr (GDir) dir = NULL;
+        const gchar *entry;
+
+        dir = g_dir_open (self->proc_dir, 0, NULL);
+        if (!dir)
+                return processes;
+
+        while ((entry = g_dir_read_name (dir))) {
+                RedshiftGtkProcess *process;
+                gchar *end = NULL;
+                guint64 pid;
+
+                pid = g_ascii_strtoull (entry, &end, 10);
+                if (*end != '\0' || pid == 0 || pid > G_MAXINT || (GPid) pid == getpid ())
+                        continue;
+
+                process = redshiftgtk_process_scan_read (self, (GPid) pid);
+                if (process)
+                        g_ptr_array_add (processes, process);
+        }
+
+        self->scans++;
+
+        return processes;
+}
+
+/**
+ * redshiftgtk_process_scan_new
+ *
+ * A scan of @proc_dir, /proc if NULL. Nothing is read before the
+ * first redshiftgtk_process_scan_get().
+ */
+RedshiftGtkProcessScan*
+redshiftgtk_process_scan_new (const gchar *proc_dir)
+{
+        RedshiftGtkProcessScan *self = g_new0 (RedshiftGtkProcessScan, 1);
+
+        self->proc_dir = g_strdup (proc_dir ? proc_dir : "/proc");
+
+        return self;
+}
+
+void
+redshiftgtk_process_scan_free (RedshiftGtkProcessScan *self)
+{
+        g_clear_pointer (&self->processes, g_ptr_array_unref);
+        g_free (self->proc_dir);
+        g_free (self);
+}
+
+/**
+ * redshiftgtk_process_scan_get
+ *
+ * Every redshift instance of the current user but ourselves, as
+ * RedshiftGtkProcess. Owned by @self and valid until the next
+ * invalidation.
+ */
+GPtrArray*
+redshiftgtk_process_scan_get (RedshiftGtkProcessScan *self)
+{
+        if (!self->processes)
+                self->processes = redshiftgtk_process_scan_run (self);
+
+        return self->processes;
+}
+
+/* Scan again next time, something was spawned or exited */
+void
+redshiftgtk_process_scan_invalidate (RedshiftGtkProcessScan *self)
+{
+        g_clear_pointer (&self->processes, g_ptr_array_unref);
+}
+
+/* Times /proc was actually read */
+guint
+redshiftgtk_process_scan_get_scans (RedshiftGtkProcessScan *self)
+{
+        return self->scans;
+}
+
+/**
+ * redshiftgtk_process_scan_is_redshift
+ *
+ * Whether @pid still is a redshift of ours, read fresh so a pid that
+ * was reused since the last scan never gets a signal meant for it
+ */
+gboolean
+redshiftgtk_process_scan_is_redshift (RedshiftGtkProcessScan *self,
+                                      GPid                    pid)
+{
+        g_autofree gchar *name = redshiftgtk_process_scan_read_name (self->proc_dir, pid);
+
+        return name != NULL;
+}
+
+static void
+redshiftgtk_process_scan_termination_free (Termination *termination)
+{
+        g_free (termination->proc_dir);
+        g_free (termination);
+}
+
+static gboolean
+redshiftgtk_process_scan_kill_cb (gpointer user_data)
+{
+        Termination *termination = user_data;
+        g_autofree gchar *name = NULL;
+
+        name = redshiftgtk_process_scan_read_name (termination->proc_dir, termination->pid);
+        if (name)
+                kill (termination->pid, SIGKILL);
+
+        return G_SOURCE_REMOVE;
+}
+
+/**
+ * redshiftgtk_process_scan_terminate
+ *
+ * Ask the redshift running as @pid to quit, which restores its ramps,
+ * and kill it if it is still around @grace seconds later. Returns
+ * FALSE if @pid is no redshift of ours (anymore).
+ */
+gboolean
+redshiftgtk_process_scan_terminate (RedshiftGtkProcessScan *self,
+                                    GPid                    pid,
+                                    guint                   grace)
+{
+        Termination *termination;
+
+        if (!redshiftgtk_process_scan_is_redshift (self, pid))
+                return FALSE;
+
+        /* A stopped process only sees SIGTERM once it runs again */
+        kill (pid, SIGTERM);
+        kill (pid, SIGCONT);
+
+        termination = g_new0 (Termination, 1);
+        termination->proc_dir = g_strdup (self->proc_dir);
+        termination->pid = pid;
+        g_timeout_add_seconds_full (G_PRIORITY_DEFAULT, grace,
+                                    redshiftgtk_process_scan_kill_cb,
+                                    termination,
+                                    (GDestroyNotify) redshiftgtk_process_scan_termination_free);
+
+        redshiftgtk_process_scan_invalidate (self);
+
+        return TRUE;
+}
+
+/**
+ * redshiftgtk_process_scan_kill
+ *
+ * Kill the redshift running as @pid right away. Unlike terminating
+ * it, this leaves its ramps on screen for whoever takes over.
+ */
+gboolean
+redshiftgtk_process_scan_kill (RedshiftGtkProcessScan *self,
+                               GPid                    pid)
+{
+        if (!redshiftgtk_process_scan_is_redshift (self, pid))
+                return FALSE;
+
+        kill (pid, SIGKILL);
+        redshiftgtk_process_scan_invalidate (self);
+
+        return TRUE;
+}
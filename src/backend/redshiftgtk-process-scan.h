@@ -0,0 +1,76 @@
+/* redshiftgtk-process-scan.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Seconds a terminated instance gets to restore its ramps */
+#define PROCESS_SCAN_GRACE_PERIOD 5
+
+/* A long-running redshift or redshift-gtk of the current user */
+typedef struct {
+        GPid pid;
+        gchar *name;
+        /* Arguments separated by spaces, for showing */
+        gchar *cmdline;
+} RedshiftGtkProcess;
+
+RedshiftGtkProcess*
+redshiftgtk_process_new  (GPid                      pid,
+                          const gchar              *name,
+                          const gchar              *cmdline);
+RedshiftGtkProcess*
+redshiftgtk_process_copy (const RedshiftGtkProcess *process);
+void
+redshiftgtk_process_free (RedshiftGtkProcess       *process);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RedshiftGtkProcess, redshiftgtk_process_free)
+
+/* Running redshift instances found in /proc, scanned once and kept
+ * until invalidated. Whoever spawns or reaps one invalidates it.
+ */
+typedef struct _RedshiftGtkProcessScan RedshiftGtkProcessScan;
+
+RedshiftGtkProcessScan*
+redshiftgtk_process_scan_new          (const gchar            *proc_dir);
+void
+redshiftgtk_process_scan_free         (RedshiftGtkProcessScan *self);
+
+GPtrArray*
+redshiftgtk_process_scan_get          (RedshiftGtkProcessScan *self);
+void
+redshiftgtk_process_scan_invalidate   (RedshiftGtkProcessScan *self);
+guint
+redshiftgtk_process_scan_get_scans    (RedshiftGtkProcessScan *self);
+
+gboolean
+redshiftgtk_process_scan_is_redshift  (RedshiftGtkProcessScan *self,
+                                       GPid                    pid);
+gboolean
+redshiftgtk_process_scan_terminate    (RedshiftGtkProcessScan *self,
+                                       GPid                    pid,
+                                       guint                   grace);
+gboolean
+redshiftgtk_process_scan_kill         (RedshiftGtkProcessScan *self,
+                                       GPid                    pid);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RedshiftGtkProcessScan, redshiftgtk_process_scan_free)
+
+G_END_DECLS
@@ -0,0 +1,209 @@
+/* redshiftgtk-ramp-sink.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include "redshiftgtk-metrics.h"
+#include "redshiftgtk-ramp-sink.h"
+
+/* FNV-1a, cheap next to a round trip to the X server */
+#define HASH_OFFSET_BASIS G_GUINT64_CONSTANT (14695981039346656037)
+#define HASH_PRIME        G_GUINT64_CONSTANT (1099511628211)
+
+struct _RedshiftGtkRampSink
+{
+        /* Output name -> hash of its last ramp */
+        GHashTable *committed;
+        guint64 sent;
+        guint64 skipped;
+};
+
+RedshiftGtkRamp*
+redshiftgtk_ramp_new (guint size)
+{
+        RedshiftGtkRamp *ramp = g_new0 (RedshiftGtkRamp, 1);
+
+        /* One block, channel after channel */
+        ramp->size = size;
+        ramp->red = g_new0 (guint16, 3 * (gsize) size);
+        ramp->green = ramp->red + size;
+        ramp->blue = ramp->green + size;
+
+        return ramp;
+}
+
+void
+redshiftgtk_ramp_free (RedshiftGtkRamp *ramp)
+{
+        g_free (ramp->red);
+        g_free (ramp);
+}
+
+/* Color of a black body at @temperature, 0 to 255 per channel.
+ * Tanner Helland's fit, not redshift's table: close enough to tell
+ * temperatures apart, not to show them.
+ */
+static void
+redshiftgtk_ramp_black_body (gdouble temperature,
+                             gdouble color[3])
+{
+        gdouble t = temperature / 100;
+        guint i;
+
+        if (t <= 66) {
+                color[0] = 255;
+                color[1] = 99.4708025861 * log (t) - 161.1195681661;
+                color[2] = t <= 19 ? 0 : 138.5177312231 * log (t - 10) - 305.0447927307;
+        } else {
+                color[0] = 329.698727446 * pow (t - 60, -0.1332047592);
+                color[1] = 288.1221695283 * pow (t - 60, -0.0755148492);
+                color[2] = 255;
+        }
+
+        for (i = 0; i < 3; i++)
+                color[i] = CLAMP (color[i], 0, 255);
+}
+
+/** redshiftgtk_ramp_fill
+ *
+ * Fill @ramp for @temperature, @brightness and @gamma, relative to
+ * a neutral white at 6500K. Brightness and gamma are applied the
+ * way redshift does, so at 6500K the ramp is the one redshift sets.
+ * Warmer ones only approximate it, good for telling whether two
+ * settings give the same ramp.
+ */
+void
+redshiftgtk_ramp_fill (RedshiftGtkRamp *ramp,
+                       gdouble          temperature,
+                       gdouble          brightness,
+                       const gdouble    gamma[3])
+{
+        guint16 *channels[] = { ramp->red, ramp->green, ramp->blue };
+        gdouble neutral[3];
+        gdouble white[3];
+        guint c;
+        guint i;
+
+        redshiftgtk_ramp_black_body (RAMP_NEUTRAL_TEMPERATURE, neutral);
+        redshiftgtk_ramp_black_body (temperature, white);
+
+        for (c = 0; c < 3; c++) {
+                gdouble scale = MIN (white[c] / neutral[c], 1.0) * brightness;
+
+                for (i = 0; i < ramp->size; i++) {
+                        gdouble value = pow ((gdouble) i / ramp->size * scale, 1.0 / gamma[c]);
+
+                        channels[c][i] = (guint16) CLAMP (value * (G_MAXUINT16 + 1.0),
+                                                          0, G_MAXUINT16);
+                }
+        }
+}
+
+/** redshiftgtk_ramp_hash
+ *
+ * Hash of the size and every entry of @ramp
+ */
+guint64
+redshiftgtk_ramp_hash (const RedshiftGtkRamp *ramp)
+{
+        const guint8 *bytes = (const guint8 *) ramp->red;
+        gsize length = 3 * (gsize) ramp->size * sizeof (guint16);
+        guint64 hash = HASH_OFFSET_BASIS;
+        gsize i;
+
+        hash = (hash ^ ramp->size) * HASH_PRIME;
+        for (i = 0; i < length; i++)
+                hash = (hash ^ bytes[i]) * HASH_PRIME;
+
+        return hash;
+}
+
+RedshiftGtkRampSink*
+redshiftgtk_ramp_sink_new (void)
+{
+        RedshiftGtkRampSink *self = g_new0 (RedshiftGtkRampSink, 1);
+
+        self->committed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+        return self;
+}
+
+void
+redshiftgtk_ramp_sink_free (RedshiftGtkRampSink *self)
+{
+        g_hash_table_unref (self->committed);
+        g_free (self);
+}
+
+/** redshiftgtk_ramp_sink_offer
+ *
+ * Whether @ramp has to be uploaded to @output, that is whether it
+ * differs from the last one offered for it. A TRUE is taken as the
+ * upload having happened; if it failed, forget @output.
+ */
+gboolean
+redshiftgtk_ramp_sink_offer (RedshiftGtkRampSink   *self,
+                             const gchar           *output,
+                             const RedshiftGtkRamp *ramp)
+{
+        guint64 hash = redshiftgtk_ramp_hash (ramp);
+        guint64 *committed = g_hash_table_lookup (self->committed, output);
+
+        if (committed && *committed == hash) {
+                self->skipped++;
+                redshiftgtk_metrics_count (METRIC_RAMPS_SKIPPED, 1);
+                return FALSE;
+        }
+
+        if (!committed) {
+                committed = g_new (guint64, 1);
+                g_hash_table_insert (self->committed, g_strdup (output), committed);
+        }
+        *committed = hash;
+
+        self->sent++;
+        redshiftgtk_metrics_count (METRIC_RAMPS_SENT, 1);
+
+        return TRUE;
+}
+
+/** redshiftgtk_ramp_sink_forget
+ *
+ * The ramps of @output, or of every output if NULL, were set by
+ * someone else. The next offer for it is always sent.
+ */
+void
+redshiftgtk_ramp_sink_forget (RedshiftGtkRampSink *self,
+                              const gchar         *output)
+{
+        if (output)
+                g_hash_table_remove (self->committed, output);
+        else
+                g_hash_table_remove_all (self->committed);
+}
+
+guint64
+redshiftgtk_ramp_sink_get_sent (RedshiftGtkRampSink *self)
+{
+        return self->sent;
+}
+
+guint64
+redshiftgtk_ramp_sink_get_skipped (RedshiftGtkRampSink *self)
+{
+        return self->skipped;
+}
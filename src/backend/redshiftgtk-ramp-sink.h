@@ -0,0 +1,77 @@
+/* redshiftgtk-ramp-sink.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The temperature ramps are neutral at */
+#define RAMP_NEUTRAL_TEMPERATURE 6500
+
+/* One gamma ramp per channel, @size entries each, the way
+ * RandR takes them
+ */
+typedef struct {
+        guint size;
+        guint16 *red;
+        guint16 *green;
+        guint16 *blue;
+} RedshiftGtkRamp;
+
+RedshiftGtkRamp*
+redshiftgtk_ramp_new  (guint                  size);
+void
+redshiftgtk_ramp_free (RedshiftGtkRamp       *ramp);
+void
+redshiftgtk_ramp_fill (RedshiftGtkRamp       *ramp,
+                       gdouble                temperature,
+                       gdouble                brightness,
+                       const gdouble          gamma[3]);
+guint64
+redshiftgtk_ramp_hash (const RedshiftGtkRamp *ramp);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RedshiftGtkRamp, redshiftgtk_ramp_free)
+
+/* Remembers what was last uploaded to each output, by hash, so a
+ * ramp that is already on screen isn't sent again. Whoever lets
+ * something else set the ramps forgets the outputs it touches.
+ */
+typedef struct _RedshiftGtkRampSink RedshiftGtkRampSink;
+
+RedshiftGtkRampSink*
+redshiftgtk_ramp_sink_new         (void);
+void
+redshiftgtk_ramp_sink_free        (RedshiftGtkRampSink   *self);
+
+gboolean
+redshiftgtk_ramp_sink_offer       (RedshiftGtkRampSink   *self,
+                                   const gchar           *output,
+                                   const RedshiftGtkRamp *ramp);
+void
+redshiftgtk_ramp_sink_forget      (RedshiftGtkRampSink   *self,
+                                   const gchar           *output);
+
+guint64
+redshiftgtk_ramp_sink_get_sent    (RedshiftGtkRampSink   *self);
+guint64
+redshiftgtk_ramp_sink_get_skipped (RedshiftGtkRampSink   *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RedshiftGtkRampSink, redshiftgtk_ramp_sink_free)
+
+G_END_DECLS
@@ -0,0 +1,502 @@
+/* redshiftgtk-randr-gamma.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "redshiftgtk-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include <glib/gi18n.h>
+
+#ifdef HAVE_XCB_RANDR
+#include <xcb/randr.h>
+#endif
+
+#include "redshiftgtk-randr-gamma.h"
+
+#ifdef HAVE_XCB_RANDR
+
+/* Anything that can move, add or remove a CRTC */
+#define WATCHED_EVENTS (XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE | \
+                        XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE | \
+                        XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE)
+
+struct _RedshiftGtkRandrGamma
+{
+        xcb_connection_t *connection;
+        xcb_window_t root;
+        guint8 first_event;
+        GSource *watch;
+
+        /* RedshiftGtkOutput and the RandR ids of their CRTCs, in
+         * the same order. NULL until the next query.
+         */
+        GPtrArray *outputs;
+        GArray *crtcs;
+        guint queries;
+
+        RedshiftGtkRampSink *sink;
+};
+
+static xcb_screen_t*
+redshiftgtk_randr_gamma_get_screen (xcb_connection_t *connection,
+                                    gint              number)
+{
+        xcb_screen_iterator_t iter = xcb_setup_roots_iterator (xcb_get_setup (connection));
+
+        for (; iter.rem; number--, xcb_screen_next (&iter)) {
+                if (number == 0)
+                        return iter.data;
+        }
+
+        return NULL;
+}
+
+/* The CRTCs changed, so may have their ramps */
+static void
+redshiftgtk_randr_gamma_invalidate (RedshiftGtkRandrGamma *self)
+{
+        g_clear_pointer (&self->outputs, g_ptr_array_unref);
+        g_clear_pointer (&self->crtcs, g_array_unref);
+        redshiftgtk_ramp_sink_forget (self->sink, NULL);
+}
+
+/* Events queued while waiting for replies count too, so this runs
+ * before every use of the cache and not only from the watch
+ */
+static void
+redshiftgtk_randr_gamma_dispatch (RedshiftGtkRandrGamma *self)
+{
+        xcb_generic_event_t *event;
+
+        while ((event = xcb_poll_for_event (self->connection))) {
+                guint8 type = event->response_type & ~0x80;
+
+                if (type == self->first_event + XCB_RANDR_SCREEN_CHANGE_NOTIFY ||
+                    type == self->first_event + XCB_RANDR_NOTIFY)
+                        redshiftgtk_randr_gamma_invalidate (self);
+
+                free (event);
+        }
+}
+
+static gboolean
+redshiftgtk_randr_gamma_watch_cb (gint         fd,
+                                  GIOCondition condition,
+                                  gpointer     user_data)
+{
+        RedshiftGtkRandrGamma *self = user_data;
+
+        redshiftgtk_randr_gamma_dispatch (self);
+
+        /* The X server went away, nothing will change anymore */
+        if (xcb_connection_has_error (self->connection))
+                return G_SOURCE_REMOVE;
+
+        return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+redshiftgtk_randr_gamma_query (RedshiftGtkRandrGamma *self,
+                               GError               **error)
+{
+        g_autoptr (GPtrArray) outputs = NULL;
+        g_autoptr (GArray) crtcs = NULL;
+        g_autofree xcb_randr_get_crtc_info_cookie_t *info_cookies = NULL;
+        g_autofree xcb_randr_get_crtc_gamma_size_cookie_t *size_cookies = NULL;
+        xcb_randr_get_screen_resources_current_reply_t *resources;
+        xcb_randr_crtc_t *ids;
+        gint n_crtcs;
+        gint i;
+
+        resources = xcb_randr_get_screen_resources_current_reply (self->connection,
+                xcb_randr_get_screen_resources_current (self->connection, self->root), NULL);
+        if (!resources) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             _("Could not get the screen resources"));
+                return FALSE;
+        }
+
+        ids = xcb_randr_get_screen_resources_current_crtcs (resources);
+        n_crtcs = xcb_randr_get_screen_resources_current_crtcs_length (resources);
+
+        /* Ask about every CRTC before waiting for the first answer,
+         * one round trip instead of two per CRTC
+         */
+        info_cookies = g_new (xcb_randr_get_crtc_info_cookie_t, n_crtcs);
+        size_cookies = g_new (xcb_randr_get_crtc_gamma_size_cookie_t, n_crtcs);
+        for (i = 0; i < n_crtcs; i++) {
+                info_cookies[i] = xcb_randr_get_crtc_info (self->connection, ids[i],
+                                                           resources->config_timestamp);
+                size_cookies[i] = xcb_randr_get_crtc_gamma_size (self->connection, ids[i]);
+        }
+
+        outputs = g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_output_free);
+        crtcs = g_array_new (FALSE, FALSE, sizeof (xcb_randr_crtc_t));
+
+        for (i = 0; i < n_crtcs; i++) {
+                xcb_randr_get_crtc_info_reply_t *info;
+                xcb_randr_get_crtc_gamma_size_reply_t *size;
+                xcb_randr_get_output_info_reply_t *output = NULL;
+
+                info = xcb_randr_get_crtc_info_reply (self->connection, info_cookies[i], NULL);
+                size = xcb_randr_get_crtc_gamma_size_reply (self->connection, size_cookies[i], NULL);
+
+                /* Switched off, nothing to adjust */
+                if (info && size && size->size > 0 && info->mode != XCB_NONE && info->num_outputs > 0)
+                        output = xcb_randr_get_output_info_reply (self->connection,
+                                xcb_randr_get_output_info (self->connection,
+                                                           xcb_randr_get_crtc_info_outputs (info)[0],
+                                                           resources->config_timestamp),
+                                NULL);
+
+                if (output) {
+                        g_autofree gchar *name = NULL;
+
+                        name = g_strndup ((const gchar *) xcb_randr_get_output_info_name (output),
+                                          xcb_randr_get_output_info_name_length (output));
+                        g_ptr_array_add (outputs, redshiftgtk_output_new (name, i, size->size));
+                        g_array_append_val (crtcs, ids[i]);
+                }
+
+                free (output);
+                free (size);
+                free (info);
+        }
+
+        free (resources);
+
+        self->outputs = g_steal_pointer (&outputs);
+        self->crtcs = g_steal_pointer (&crtcs);
+        self->queries++;
+
+        return TRUE;
+}
+
+/* Index of @output in the cache, -1 if it isn't lit */
+static gint
+redshiftgtk_randr_gamma_find (RedshiftGtkRandrGamma *self,
+                              const gchar           *output)
+{
+        guint i;
+
+        for (i = 0; i < self->outputs->len; i++) {
+                if (g_strcmp0 (((RedshiftGtkOutput *) g_ptr_array_index (self->outputs, i))->name,
+                               output) == 0)
+                        return i;
+        }
+
+        return -1;
+}
+
+/**
+ * redshiftgtk_randr_gamma_new
+ *
+ * Connect to @display, or to $DISPLAY if NULL, and watch it for
+ * changes from the thread-default main context. NULL with @error
+ * set if there is no X server or it lacks RandR 1.2.
+ */
+RedshiftGtkRandrGamma*
+redshiftgtk_randr_gamma_new (const gchar *display,
+                             GError     **error)
+{
+        g_autoptr (RedshiftGtkRandrGamma) self = g_new0 (RedshiftGtkRandrGamma, 1);
+        const xcb_query_extension_reply_t *extension;
+        xcb_randr_query_version_reply_t *version = NULL;
+        xcb_screen_t *screen;
+        gint number = 0;
+
+        self->sink = redshiftgtk_ramp_sink_new ();
+        self->connection = xcb_connect (display, &number);
+
+        screen = xcb_connection_has_error (self->connection)
+                 ? NULL : redshiftgtk_randr_gamma_get_screen (self->connection, number);
+        if (!screen) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+                             _("Could not connect to the X server"));
+                return NULL;
+        }
+        self->root = screen->root;
+
+        /* CRTCs and their ramps came with 1.2 */
+        extension = xcb_get_extension_data (self->connection, &xcb_randr_id);
+        if (extension && extension->present)
+                version = xcb_randr_query_version_reply (self->connection,
+                        xcb_randr_query_version (self->connection, 1, 3), NULL);
+
+        if (!version || (version->major_version == 1 && version->minor_version < 2)) {
+                free (version);
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                             _("The X server does not support RandR 1.2"));
+                return NULL;
+        }
+        free (version);
+        self->first_event = extension->first_event;
+
+        xcb_randr_select_input (self->connection, self->root, WATCHED_EVENTS);
+        xcb_flush (self->connection);
+
+        self->watch = g_unix_fd_source_new (xcb_get_file_descriptor (self->connection),
+                                            G_IO_IN | G_IO_HUP | G_IO_ERR);
+        g_source_set_callback (self->watch, (GSourceFunc) redshiftgtk_randr_gamma_watch_cb,
+                               self, NULL);
+        g_source_attach (self->watch, g_main_context_get_thread_default ());
+
+        return g_steal_pointer (&self);
+}
+
+void
+redshiftgtk_randr_gamma_free (RedshiftGtkRandrGamma *self)
+{
+        if (self->watch) {
+                g_source_destroy (self->watch);
+                g_source_unref (self->watch);
+        }
+
+        g_clear_pointer (&self->outputs, g_ptr_array_unref);
+        g_clear_pointer (&self->crtcs, g_array_unref);
+        g_clear_pointer (&self->sink, redshiftgtk_ramp_sink_free);
+        xcb_disconnect (self->connection);
+        g_free (self);
+}
+
+/** redshiftgtk_randr_gamma_get_outputs
+ *
+ * The lit CRTCs as RedshiftGtkOutput, in CRTC order. Owned by
+ * @self and replaced, not changed, when the screen changes, so a
+ * reference stays valid.
+ */
+GPtrArray*
+redshiftgtk_randr_gamma_get_outputs (RedshiftGtkRandrGamma  *self,
+                                     GError                **error)
+{
+        redshiftgtk_randr_gamma_dispatch (self);
+
+        if (!self->outputs && !redshiftgtk_randr_gamma_query (self, error))
+                return NULL;
+
+        return self->outputs;
+}
+
+/* Times the CRTCs were asked for */
+guint
+redshiftgtk_randr_gamma_get_queries (RedshiftGtkRandrGamma *self)
+{
+        return self->queries;
+}
+
+/** redshiftgtk_randr_gamma_reset
+ *
+ * Set neutral ramps, the ones redshift -x leaves, on @output or on
+ * every lit output if NULL. Outputs that have them already are
+ * skipped, the others are sent in one go and checked for errors
+ * together.
+ */
+gboolean
+redshiftgtk_randr_gamma_reset (RedshiftGtkRandrGamma  *self,
+                               const gchar            *output,
+                               GError                **error)
+{
+        static const gdouble neutral[3] = { 1.0, 1.0, 1.0 };
+        g_autoptr (GArray) cookies = NULL;
+        GPtrArray *outputs;
+        gboolean found = FALSE;
+        gboolean failed = FALSE;
+        guint i;
+
+        outputs = redshiftgtk_randr_gamma_get_outputs (self, error);
+        if (!outputs)
+                return FALSE;
+
+        cookies = g_array_new (FALSE, FALSE, sizeof (xcb_void_cookie_t));
+
+        for (i = 0; i < outputs->len; i++) {
+                RedshiftGtkOutput *lit = g_ptr_array_index (outputs, i);
+                g_autoptr (RedshiftGtkRamp) ramp = NULL;
+                xcb_void_cookie_t cookie;
+
+                if (output && g_strcmp0 (lit->name, output) != 0)
+                        continue;
+                found = TRUE;
+
+                ramp = redshiftgtk_ramp_new (lit->ramp_size);
+                redshiftgtk_ramp_fill (ramp, RAMP_NEUTRAL_TEMPERATURE, 1.0, neutral);
+                if (!redshiftgtk_ramp_sink_offer (self->sink, lit->name, ramp))
+                        continue;
+
+                cookie = xcb_randr_set_crtc_gamma_checked (self->connection,
+                                                           g_array_index (self->crtcs,
+                                                                          xcb_randr_crtc_t, i),
+                                                           ramp->size,
+                                                           ramp->red, ramp->green, ramp->blue);
+                g_array_append_val (cookies, cookie);
+        }
+
+        if (!found) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                             _("No output %s is lit"), output);
+                return FALSE;
+        }
+
+        for (i = 0; i < cookies->len; i++) {
+                xcb_generic_error_t *x_error;
+
+                x_error = xcb_request_check (self->connection,
+                                             g_array_index (cookies, xcb_void_cookie_t, i));
+                if (x_error)
+                        failed = TRUE;
+                free (x_error);
+        }
+
+        /* Which of them made it is anybody's guess */
+        if (failed) {
+                redshiftgtk_ramp_sink_forget (self->sink, NULL);
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             _("Could not set the gamma ramps"));
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+/** redshiftgtk_randr_gamma_get_ramp
+ *
+ * The ramps @output has now, whoever set them
+ */
+RedshiftGtkRamp*
+redshiftgtk_randr_gamma_get_ramp (RedshiftGtkRandrGamma  *self,
+                                  const gchar            *output,
+                                  GError                **error)
+{
+        xcb_randr_get_crtc_gamma_reply_t *reply;
+        RedshiftGtkRamp *ramp;
+        gint index;
+
+        if (!redshiftgtk_randr_gamma_get_outputs (self, error))
+                return NULL;
+
+        index = redshiftgtk_randr_gamma_find (self, output);
+        if (index < 0) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                             _("No output %s is lit"), output);
+                return NULL;
+        }
+
+        reply = xcb_randr_get_crtc_gamma_reply (self->connection,
+                xcb_randr_get_crtc_gamma (self->connection,
+                                          g_array_index (self->crtcs, xcb_randr_crtc_t, index)),
+                NULL);
+        if (!reply) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             _("Could not get the gamma ramps"));
+                return NULL;
+        }
+
+        ramp = redshiftgtk_ramp_new (reply->size);
+        memcpy (ramp->red, xcb_randr_get_crtc_gamma_red (reply), ramp->size * sizeof (guint16));
+        memcpy (ramp->green, xcb_randr_get_crtc_gamma_green (reply), ramp->size * sizeof (guint16));
+        memcpy (ramp->blue, xcb_randr_get_crtc_gamma_blue (reply), ramp->size * sizeof (guint16));
+        free (reply);
+
+        return ramp;
+}
+
+/** redshiftgtk_randr_gamma_forget
+ *
+ * Someone else, a long-running redshift, set the ramps. The next
+ * ramps are sent whatever they are.
+ */
+void
+redshiftgtk_randr_gamma_forget (RedshiftGtkRandrGamma *self)
+{
+        redshiftgtk_ramp_sink_forget (self->sink, NULL);
+}
+
+/* What was sent and skipped */
+RedshiftGtkRampSink*
+redshiftgtk_randr_gamma_get_sink (RedshiftGtkRandrGamma *self)
+{
+        return self->sink;
+}
+
+#else
+
+/* Nothing but construction is reachable without RandR */
+struct _RedshiftGtkRandrGamma
+{
+        RedshiftGtkRampSink *sink;
+};
+
+RedshiftGtkRandrGamma*
+redshiftgtk_randr_gamma_new (const gchar *display,
+                             GError     **error)
+{
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     _("Built without RandR support"));
+
+        return NULL;
+}
+
+void
+redshiftgtk_randr_gamma_free (RedshiftGtkRandrGamma *self)
+{
+        g_free (self);
+}
+
+GPtrArray*
+redshiftgtk_randr_gamma_get_outputs (RedshiftGtkRandrGamma  *self,
+                                     GError                **error)
+{
+        g_return_val_if_reached (NULL);
+}
+
+guint
+redshiftgtk_randr_gamma_get_queries (RedshiftGtkRandrGamma *self)
+{
+        g_return_val_if_reached (0);
+}
+
+gboolean
+redshiftgtk_randr_gamma_reset (RedshiftGtkRandrGamma  *self,
+                               const gchar            *output,
+                               GError                **error)
+{
+        g_return_val_if_reached (FALSE);
+}
+
+RedshiftGtkRamp*
+redshiftgtk_randr_gamma_get_ramp (RedshiftGtkRandrGamma  *self,
+                                  const gchar            *output,
+                                  GError                **error)
+{
+        g_return_val_if_reached (NULL);
+}
+
+void
+redshiftgtk_randr_gamma_forget (RedshiftGtkRandrGamma *self)
+{
+        g_return_if_reached ();
+}
+
+RedshiftGtkRampSink*
+redshiftgtk_randr_gamma_get_sink (RedshiftGtkRandrGamma *self)
+{
+        g_return_val_if_reached (NULL);
+}
+
+#endif
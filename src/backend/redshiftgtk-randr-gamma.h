@@ -0,0 +1,62 @@
+/* redshiftgtk-randr-gamma.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include "redshiftgtk-outputs.h"
+#include "redshiftgtk-ramp-sink.h"
+
+G_BEGIN_DECLS
+
+/* Neutral gamma ramps set through RandR in-process, over a
+ * connection of our own. Anything else is left to redshift, whose
+ * white points we don't have. The lit CRTCs and their gamma sizes
+ * are asked for once and kept until the X server reports a screen,
+ * CRTC or output change.
+ */
+typedef struct _RedshiftGtkRandrGamma RedshiftGtkRandrGamma;
+
+RedshiftGtkRandrGamma*
+redshiftgtk_randr_gamma_new         (const gchar            *display,
+                                     GError                **error);
+void
+redshiftgtk_randr_gamma_free        (RedshiftGtkRandrGamma  *self);
+
+GPtrArray*
+redshiftgtk_randr_gamma_get_outputs (RedshiftGtkRandrGamma  *self,
+                                     GError                **error);
+guint
+redshiftgtk_randr_gamma_get_queries (RedshiftGtkRandrGamma  *self);
+
+gboolean
+redshiftgtk_randr_gamma_reset       (RedshiftGtkRandrGamma  *self,
+                                     const gchar            *output,
+                                     GError                **error);
+RedshiftGtkRamp*
+redshiftgtk_randr_gamma_get_ramp    (RedshiftGtkRandrGamma  *self,
+                                     const gchar            *output,
+                                     GError                **error);
+void
+redshiftgtk_randr_gamma_forget      (RedshiftGtkRandrGamma  *self);
+RedshiftGtkRampSink*
+redshiftgtk_randr_gamma_get_sink    (RedshiftGtkRandrGamma  *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RedshiftGtkRandrGamma, redshiftgtk_randr_gamma_free)
+
+G_END_DECLS
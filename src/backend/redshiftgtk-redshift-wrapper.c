@@ -16,29 +16,64 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <gio/gio.h>
 #include <pwd.h>
-#include <errno.h>
+#include <signal.h>
 #include <glib/gi18n.h>
 
+#include "redshiftgtk-config-document.h"
+#include "redshiftgtk-metrics.h"
+#include "redshiftgtk-outputs.h"
+#include "redshiftgtk-process-scan.h"
+#include "redshiftgtk-ramp-sink.h"
+#include "redshiftgtk-randr-gamma.h"
 #include "redshiftgtk-redshift-wrapper.h"
+#include "redshiftgtk-settings-cache.h"
+#include "redshiftgtk-settings-layers.h"
+#include "redshiftgtk-settings-schema.h"
+#include "redshiftgtk-spawn.h"
+#include "redshiftgtk-stall-monitor.h"
+#include "redshiftgtk-trace.h"
 
-#define DEFAULT_SETTINGS_GROUP "redshift"
-#define MANUAL_SETTINGS_GROUP "manual"
+/* Named profiles live in [profile:NAME] groups of redshift.conf */
+#define PROFILE_GROUP_PREFIX "profile:"
 
-#define MIN_TEMPERATURE 1000
-#define MAX_TEMPERATURE 12000
+#define ALL_SETTINGS ((1u << N_SETTINGS) - 1)
 
-#define MIN_BRIGHTNESS 0.1
-#define MAX_BRIGHTNESS 1.0
+/* Entries per channel previews are compared at when the outputs
+ * and their ramp sizes can't be asked for
+ */
+#define PREVIEW_RAMP_SIZE 1024
 
-#define MIN_GAMMA 0.1
-#define MAX_GAMMA 1.0
+enum {
+        PROP_CONFIG_PATH = 1,
+        N_PROPS
+};
 
-#define DEFAULT_DAY_TEMPERATURE 6500
-#define DEFAULT_NIGHT_TEMPERATURE 4500
-#define DEFAULT_BRIGHTNESS 1.0
-#define DEFAULT_SMOOTH_TRANSITION FALSE
+static GParamSpec *obj_properties[N_PROPS] = { NULL, };
+
+typedef struct {
+        /* NULL for the default settings, whose keys live in
+         * the groups redshift itself reads
+         */
+        gchar *group;
+        /* Interned, NULL for the default settings */
+        const gchar *name;
+        RedshiftGtkSettingsLayers *layers;
+        /* User layer values apply still has to write */
+        guint32 dirty;
+        /* Last load that found the profile in a file */
+        guint generation;
+} Profile;
+
+/* A redshift of ours that only adjusts one CRTC */
+typedef struct {
+        GSubprocess *process;
+        guint crtc;
+        /* What its ramps are made from, by TimePeriod */
+        RedshiftGtkRampKey ramps[TIME_PERIOD_NIGHT + 1];
+} OutputInstance;
 
 struct _RedshiftGtkRedshiftWrapper
 {
@@ -46,12 +81,80 @@ struct _RedshiftGtkRedshiftWrapper
 
         RedshiftState redshift_state;
         GSubprocess *process;
-        GKeyFile *config;
+        /* Instances we didn't start but were asked to take over */
+        GArray *adopted;        /* GPid */
+        /* Foreign ones the user chose to leave, we don't run next to them */
+        GArray *left_alone;     /* GPid */
+        RedshiftGtkProcessScan *scan;
+        /* Cancels watching the processes on dispose */
+        GCancellable *process_cancellable;
+        /* Read on demand, see _get_document() */
+        RedshiftGtkConfigDocument *document;
         gchar *config_path;
+        /* Created if missing. Not a path handed to _new_for_path(),
+         * its owner writes that one.
+         */
+        gboolean own_config;
+        /* Files the settings were loaded from, NULL once they
+         * no longer match what is in memory
+         */
+        GVariant *stamps;
+
+        /* Typed settings. The accessors only ever look at the active
+         * profile, switching is a matter of moving the pointer.
+         */
+        Profile defaults;
+        GHashTable *profiles;   /* name quark -> Profile */
+        Profile *active;
+        guint generation;
+
+        /* Settings of single outputs, by output name. They hold
+         * the per-output settings only and apply to every profile.
+         */
+        GHashTable *outputs;    /* name quark -> Profile */
+        /* RedshiftGtkOutput, from the RandR connection below
+         * unless set from outside
+         */
+        GPtrArray *connected;
+        gboolean connected_fixed;
+        /* Our own line to the X server for outputs, previews and
+         * resets, NULL if there is none
+         */
+        RedshiftGtkRandrGamma *randr;
+        gboolean randr_tried;
+        /* Once any output has settings of its own, every output
+         * gets a redshift of its own and self->process is unused
+         */
+        GHashTable *instances;  /* output name -> OutputInstance */
+        /* Settings the instances share, as they were started */
+        SettingValue shared[N_SETTINGS];
+
+        /* Live preview */
+        gboolean previewing;
+        GSubprocess *preview_process;
+        gint64 preview_spawned;
+        TimePeriod preview_period;
+        gdouble preview_temperature;
+        gboolean preview_pending;
+        /* What the previews put on screen, forgotten whenever
+         * a long-running redshift gets the ramps back
+         */
+        RedshiftGtkRampSink *preview_ramps;
+
+        /* Autostart launcher, cached and watched */
+        gboolean autostart;
+        gboolean autostart_writing;
+        GFile *autostart_file;
+        GKeyFile *autostart_desktop;
+        GFileMonitor *autostart_monitor;
+        GCancellable *autostart_cancellable;
 };
 
 static void
 redshiftgtk_backend_iface_init (RedshiftGtkBackendInterface *iface);
+static void
+redshiftgtk_redshift_wrapper_autostart_init (RedshiftGtkRedshiftWrapper *self,
+                                             const gchar                *user_config_path);
 
 G_DEFINE_TYPE_WITH_CODE (RedshiftGtkRedshiftWrapper,
                          redshiftgtk_redshift_wrapper,
@@ -59,21 +162,459 @@ G_DEFINE_TYPE_WITH_CODE (RedshiftGtkRedshiftWrapper,
                          G_IMPLEMENT_INTERFACE (REDSHIFTGTK_TYPE_BACKEND,
                                                 redshiftgtk_backend_iface_init))
 
+static void
+redshiftgtk_redshift_wrapper_instance_free (OutputInstance *instance)
+{
+        g_object_unref (instance->process);
+        g_free (instance);
+}
+
+/* Send @signal to every redshift we started */
+static void
+redshiftgtk_redshift_wrapper_signal (RedshiftGtkRedshiftWrapper *self,
+                                     gint                        signal)
+{
+        GHashTableIter iter;
+        OutputInstance *instance;
+
+        if (self->process)
+                g_subprocess_send_signal (self->process, signal);
+
+        g_hash_table_iter_init (&iter, self->instances);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &instance))
+                g_subprocess_send_signal (instance->process, signal);
+}
+
+/* A long-running redshift or a reset got the ramps back */
+static void
+redshiftgtk_redshift_wrapper_forget_ramps (RedshiftGtkRedshiftWrapper *self)
+{
+        redshiftgtk_ramp_sink_forget (self->preview_ramps, NULL);
+        if (self->randr)
+                redshiftgtk_randr_gamma_forget (self->randr);
+}
+
 static void
 redshiftgtk_redshift_wrapper_dispose (GObject *object)
 {
         RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (object);
 
+        /* Never leave a paused redshift behind */
+        if (self->previewing && self->instances)
+                redshiftgtk_redshift_wrapper_signal (self, SIGCONT);
+        self->previewing = FALSE;
+
+        /* Pending autostart callbacks bail out on cancellation */
+        g_cancellable_cancel (self->autostart_cancellable);
+        g_clear_object (&self->autostart_cancellable);
+        if (self->autostart_monitor)
+                g_signal_handlers_disconnect_by_data (self->autostart_monitor, self);
+        g_clear_object (&self->autostart_monitor);
+        g_clear_object (&self->autostart_file);
+        g_clear_pointer (&self->autostart_desktop, g_key_file_unref);
+
+        g_cancellable_cancel (self->process_cancellable);
+        g_clear_object (&self->process_cancellable);
+        g_clear_object (&self->preview_process);
+        g_clear_pointer (&self->preview_ramps, redshiftgtk_ramp_sink_free);
         g_clear_object (&self->process);
-        g_free (self->config_path);
+        g_clear_pointer (&self->instances, g_hash_table_unref);
+        g_clear_pointer (&self->connected, g_ptr_array_unref);
+        g_clear_pointer (&self->randr, redshiftgtk_randr_gamma_free);
+        g_clear_pointer (&self->adopted, g_array_unref);
+        g_clear_pointer (&self->left_alone, g_array_unref);
+        g_clear_pointer (&self->scan, redshiftgtk_process_scan_free);
+        g_clear_pointer (&self->config_path, g_free);
+        g_clear_pointer (&self->document, redshiftgtk_config_document_free);
+        g_clear_pointer (&self->stamps, g_variant_unref);
+        g_clear_pointer (&self->profiles, g_hash_table_unref);
+        g_clear_pointer (&self->outputs, g_hash_table_unref);
+        g_clear_pointer (&self->defaults.layers, redshiftgtk_settings_layers_free);
+        self->active = &self->defaults;
+
+        G_OBJECT_CLASS (redshiftgtk_redshift_wrapper_parent_class)->dispose (object);
+}
+
+static void
+redshiftgtk_redshift_wrapper_set_property (GObject      *object,
+                                           guint         id,
+                                           const GValue *value,
+                                           GParamSpec   *spec)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (object);
+
+        switch (id) {
+        case PROP_CONFIG_PATH:
+                g_free (self->config_path);
+                self->config_path = g_value_dup_string (value);
+                break;
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, id, spec);
+                break;
+        }
+}
+
+static void
+redshiftgtk_redshift_wrapper_get_property (GObject    *object,
+                                           guint       id,
+                                           GValue     *value,
+                                           GParamSpec *spec)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (object);
+
+        switch (id) {
+        case PROP_CONFIG_PATH:
+                g_value_set_string (value, self->config_path);
+                break;
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, id, spec);
+                break;
+        }
 }
 
+static void
+redshiftgtk_redshift_wrapper_constructed (GObject *object);
+
 static void
 redshiftgtk_redshift_wrapper_class_init (RedshiftGtkRedshiftWrapperClass *klass)
 {
         GObjectClass *obj_class = G_OBJECT_CLASS (klass);
 
+        obj_class->constructed = redshiftgtk_redshift_wrapper_constructed;
         obj_class->dispose = redshiftgtk_redshift_wrapper_dispose;
+        obj_class->set_property = redshiftgtk_redshift_wrapper_set_property;
+        obj_class->get_property = redshiftgtk_redshift_wrapper_get_property;
+
+        /**
+         * RedshiftGtkRedshiftWrapper:config-path:
+         *
+         * The redshift.conf to manage, the user's own if NULL
+         */
+        obj_properties[PROP_CONFIG_PATH] =
+            g_param_spec_string ("config-path",
+                                 "Config path",
+                                 "The redshift.conf to manage",
+                                 NULL,
+                                 G_PARAM_READWRITE |
+                                 G_PARAM_CONSTRUCT_ONLY |
+                                 G_PARAM_STATIC_STRINGS);
+
+        g_object_class_install_properties (obj_class, N_PROPS, obj_properties);
+}
+
+static void
+redshiftgtk_redshift_wrapper_profile_free (Profile *profile)
+{
+        redshiftgtk_settings_layers_free (profile->layers);
+        g_free (profile->group);
+        g_free (profile);
+}
+
+static Profile*
+redshiftgtk_redshift_wrapper_profile_new (const gchar *prefix,
+                                          const gchar *name)
+{
+        Profile *profile = g_new0 (Profile, 1);
+
+        profile->name = g_intern_string (name);
+        profile->group = g_strconcat (prefix, name, NULL);
+        profile->layers = redshiftgtk_settings_layers_new ();
+
+        return profile;
+}
+
+static Profile*
+redshiftgtk_redshift_wrapper_profile_lookup (GHashTable  *index,
+                                             const gchar *name)
+{
+        GQuark quark = g_quark_try_string (name);
+
+        /* Names nobody ever interned can't be in the index */
+        if (!quark)
+                return NULL;
+
+        return g_hash_table_lookup (index, GUINT_TO_POINTER (quark));
+}
+
+static void
+redshiftgtk_redshift_wrapper_profile_insert (GHashTable *index,
+                                             Profile    *profile)
+{
+        g_hash_table_insert (index,
+                             GUINT_TO_POINTER (g_quark_from_static_string (profile->name)),
+                             profile);
+}
+
+static gboolean
+redshiftgtk_redshift_wrapper_profile_is_stale (gpointer key,
+                                               gpointer value,
+                                               gpointer user_data)
+{
+        RedshiftGtkRedshiftWrapper *self = user_data;
+        Profile *profile = value;
+
+        return profile->generation != self->generation;
+}
+
+/* The profile or output of the group @group, added to its
+ * index if it is new. NULL if @group is neither.
+ */
+static Profile*
+redshiftgtk_redshift_wrapper_profile_ensure (RedshiftGtkRedshiftWrapper *self,
+                                             const gchar                *group)
+{
+        GHashTable *index;
+        const gchar *prefix;
+        Profile *profile;
+
+        if (g_str_has_prefix (group, PROFILE_GROUP_PREFIX)) {
+                index = self->profiles;
+                prefix = PROFILE_GROUP_PREFIX;
+        } else if (g_str_has_prefix (group, OUTPUT_GROUP_PREFIX)) {
+                index = self->outputs;
+                prefix = OUTPUT_GROUP_PREFIX;
+        } else {
+                return NULL;
+        }
+
+        if (group[strlen (prefix)] == '\0')
+                return NULL;
+
+        profile = redshiftgtk_redshift_wrapper_profile_lookup (index, group + strlen (prefix));
+        if (!profile) {
+                profile = redshiftgtk_redshift_wrapper_profile_new (prefix, group + strlen (prefix));
+                redshiftgtk_redshift_wrapper_profile_insert (index, profile);
+        }
+
+        return profile;
+}
+
+/* Drop the profiles and outputs the last load didn't come across */
+static void
+redshiftgtk_redshift_wrapper_remove_stale_profiles (RedshiftGtkRedshiftWrapper *self)
+{
+        /* Keep the same profile active if it is still around */
+        if (self->active != &self->defaults &&
+            self->active->generation != self->generation)
+                self->active = &self->defaults;
+
+        g_hash_table_foreach_remove (self->profiles,
+                                     redshiftgtk_redshift_wrapper_profile_is_stale,
+                                     self);
+        g_hash_table_foreach_remove (self->outputs,
+                                     redshiftgtk_redshift_wrapper_profile_is_stale,
+                                     self);
+}
+
+/* Bring every profile and output that has a group in @system or @user
+ * up to date. Profiles that are already around keep their runtime
+ * overrides, and only the settings whose value really changed are
+ * merged again.
+ */
+static void
+redshiftgtk_redshift_wrapper_load_profiles (RedshiftGtkRedshiftWrapper *self,
+                                            GKeyFile                   *system,
+                                            GKeyFile                   *user)
+{
+        GKeyFile *sources[] = { system, user };
+        guint i, j;
+
+        self->generation++;
+
+        for (i = 0; i < G_N_ELEMENTS (sources); i++) {
+                g_auto (GStrv) groups = NULL;
+
+                if (!sources[i])
+                        continue;
+
+                groups = g_key_file_get_groups (sources[i], NULL);
+                for (j = 0; groups[j]; j++) {
+                        Profile *profile;
+
+                        profile = redshiftgtk_redshift_wrapper_profile_ensure (self, groups[j]);
+                        if (!profile || profile->generation == self->generation)
+                                continue;
+
+                        /* All keys of a profile share its one group */
+                        redshiftgtk_settings_layers_load (profile->layers, CONFIG_LAYER_SYSTEM,
+                                                          system, profile->group);
+                        redshiftgtk_settings_layers_load (profile->layers, CONFIG_LAYER_USER,
+                                                          user, profile->group);
+                        profile->dirty = 0;
+                        profile->generation = self->generation;
+                }
+        }
+
+        redshiftgtk_redshift_wrapper_remove_stale_profiles (self);
+}
+
+/* Same as loading the files the cache was made from, without a
+ * single line of text to parse
+ */
+static void
+redshiftgtk_redshift_wrapper_load_cached_profiles (RedshiftGtkRedshiftWrapper *self,
+                                                   GVariant                   *profiles)
+{
+        GVariantIter iter;
+        const gchar *group;
+        GVariant *layers;
+
+        self->generation++;
+
+        g_variant_iter_init (&iter, profiles);
+        while (g_variant_iter_loop (&iter, "(&s@a(yyddd))", &group, &layers)) {
+                Profile *profile;
+
+                if (*group == '\0')
+                        profile = &self->defaults;
+                else
+                        profile = redshiftgtk_redshift_wrapper_profile_ensure (self, group);
+
+                if (!profile)
+                        continue;
+
+                redshiftgtk_settings_layers_deserialize (profile->layers, layers);
+                profile->dirty = 0;
+                profile->generation = self->generation;
+        }
+
+        redshiftgtk_redshift_wrapper_remove_stale_profiles (self);
+}
+
+static void
+redshiftgtk_redshift_wrapper_serialize_index (GHashTable      *index,
+                                              GVariantBuilder *builder)
+{
+        GHashTableIter iter;
+        Profile *profile;
+
+        g_hash_table_iter_init (&iter, index);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &profile))
+                g_variant_builder_add (builder, "(s@a(yyddd))", profile->group,
+                                       redshiftgtk_settings_layers_serialize (profile->layers));
+}
+
+/* Every profile and output in cacheable form, by group */
+static GVariant*
+redshiftgtk_redshift_wrapper_serialize_profiles (RedshiftGtkRedshiftWrapper *self)
+{
+        GVariantBuilder builder;
+
+        g_variant_builder_init (&builder, SETTINGS_CACHE_PROFILES_TYPE);
+        g_variant_builder_add (&builder, "(s@a(yyddd))", "",
+                               redshiftgtk_settings_layers_serialize (self->defaults.layers));
+
+        redshiftgtk_redshift_wrapper_serialize_index (self->profiles, &builder);
+        redshiftgtk_redshift_wrapper_serialize_index (self->outputs, &builder);
+
+        return g_variant_builder_end (&builder);
+}
+
+/* Candidate system configs in $XDG_CONFIG_DIRS order */
+static gchar**
+redshiftgtk_redshift_wrapper_get_system_config_paths (void)
+{
+        const gchar * const *directories = g_get_system_config_dirs ();
+        gchar **paths = g_new0 (gchar *, g_strv_length ((gchar **) directories) + 1);
+        guint i;
+
+        for (i = 0; directories[i]; i++)
+                paths[i] = g_build_filename (directories[i], "redshift.conf", NULL);
+
+        return paths;
+}
+
+/* The administrator's baseline, from the first directory in
+ * $XDG_CONFIG_DIRS that has one. NULL if there is none.
+ */
+static GKeyFile*
+redshiftgtk_redshift_wrapper_load_system_config (void)
+{
+        g_auto (GStrv) paths = redshiftgtk_redshift_wrapper_get_system_config_paths ();
+        guint i;
+
+        for (i = 0; paths[i]; i++) {
+                g_autoptr (GKeyFile) config = g_key_file_new ();
+                g_autoptr (GError) error = NULL;
+
+                if (g_key_file_load_from_file (config, paths[i], G_KEY_FILE_NONE, &error))
+                        return g_steal_pointer (&config);
+
+                if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+                        g_debug ("redshiftgtk_redshift_wrapper_load_system_config\n\
+        g_key_file_load_from_file: %s: %s\n", paths[i], error->message);
+                }
+        }
+
+        return NULL;
+}
+
+/* Stamps of every file the settings are read from */
+static GVariant*
+redshiftgtk_redshift_wrapper_stamp_sources (RedshiftGtkRedshiftWrapper *self)
+{
+        g_autoptr (GPtrArray) sources = g_ptr_array_new_with_free_func (g_free);
+        g_auto (GStrv) system = redshiftgtk_redshift_wrapper_get_system_config_paths ();
+        guint i;
+
+        for (i = 0; system[i]; i++)
+                g_ptr_array_add (sources, g_steal_pointer (&system[i]));
+        g_ptr_array_add (sources, g_strdup (self->config_path));
+        g_ptr_array_add (sources, NULL);
+
+        return g_variant_ref_sink (redshiftgtk_settings_cache_stamp ((const gchar * const *) sources->pdata));
+}
+
+/* Remember the settings as they are now, read from the files
+ * in @stamps. The cache is only a shortcut, failing to write
+ * it costs the next startup a parse and nothing else.
+ */
+static void
+redshiftgtk_redshift_wrapper_save_cache (RedshiftGtkRedshiftWrapper *self,
+                                         GVariant                   *stamps)
+{
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *path = NULL;
+
+        path = redshiftgtk_settings_cache_get_path (self->config_path);
+
+        if (!redshiftgtk_settings_cache_save (path, stamps,
+                                              redshiftgtk_redshift_wrapper_serialize_profiles (self),
+                                              &error)) {
+                g_debug ("redshiftgtk_redshift_wrapper_save_cache\n\
+        redshiftgtk_settings_cache_save: %s\n", error->message);
+        }
+}
+
+/* The bytes of the user file. Startup from the cache doesn't read
+ * them at all, they are only needed once something gets written.
+ */
+static RedshiftGtkConfigDocument*
+redshiftgtk_redshift_wrapper_get_document (RedshiftGtkRedshiftWrapper *self)
+{
+        g_autoptr (GVariant) stamps = NULL;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *data = NULL;
+        gsize length = 0;
+
+        if (self->document)
+                return self->document;
+
+        /* If the file moved on since the settings were loaded, what
+         * gets written next is no longer what the cache holds
+         */
+        stamps = redshiftgtk_redshift_wrapper_stamp_sources (self);
+        if (self->stamps && !g_variant_equal (stamps, self->stamps))
+                g_clear_pointer (&self->stamps, g_variant_unref);
+
+        if (!g_file_get_contents (self->config_path, &data, &length, &error)) {
+                g_warning ("redshiftgtk_redshift_wrapper_get_document\n\
+        g_file_get_contents: %s\n", error->message);
+        }
+
+        self->document = redshiftgtk_config_document_new (data ? data : "", length);
+
+        return self->document;
 }
 
 void
@@ -82,11 +623,36 @@ redshiftgtk_redshift_wrapper_load_config (RedshiftGtkRedshiftWrapper *self,
 {
         g_assert (error == NULL || *error == NULL);
         g_autoptr (GFile) file = NULL;
+        g_autoptr (GFileOutputStream) created = NULL;
+        g_autoptr (GKeyFile) config = NULL;
+        g_autoptr (GKeyFile) system = NULL;
+        g_autoptr (GVariant) stamps = NULL;
+        g_autoptr (GVariant) cached = NULL;
+        g_autofree gchar *cache_path = NULL;
+        g_autofree gchar *data = NULL;
+        gsize length = 0;
+        REDSHIFTGTK_TRACE_SPAN ("load_config");
+
+        /* Nothing to parse if none of the files changed since last time */
+        stamps = redshiftgtk_redshift_wrapper_stamp_sources (self);
+        cache_path = redshiftgtk_settings_cache_get_path (self->config_path);
+        cached = redshiftgtk_settings_cache_load (cache_path, stamps);
+
+        g_clear_pointer (&self->document, redshiftgtk_config_document_free);
+        g_clear_pointer (&self->stamps, g_variant_unref);
+
+        if (cached) {
+                redshiftgtk_redshift_wrapper_load_cached_profiles (self, cached);
+                self->stamps = g_steal_pointer (&stamps);
+                return;
+        }
 
-        self->config = g_key_file_new ();
+        config = g_key_file_new ();
+        system = redshiftgtk_redshift_wrapper_load_system_config ();
 
         file = g_file_new_for_path (self->config_path);
-        g_file_create (file, G_FILE_CREATE_NONE, NULL, error);
+        if (self->own_config)
+                created = g_file_create (file, G_FILE_CREATE_NONE, NULL, error);
 
         /* Clear error if file exists */
         if (*error) {
@@ -95,37 +661,101 @@ redshiftgtk_redshift_wrapper_load_config (RedshiftGtkRedshiftWrapper *self,
                 } else {
                         g_warning ("redshiftgtk_redshift_wrapper_load_config\n\
         g_file_create: %s\n", (*error)->message);
-                        return;
+                        goto cache;
+                }
+        }
+
+        /* The empty file is what gets read now, not the missing one */
+        if (created) {
+                g_clear_pointer (&stamps, g_variant_unref);
+                stamps = redshiftgtk_redshift_wrapper_stamp_sources (self);
+        }
+
+        if (!g_file_get_contents (self->config_path, &data, &length, error)) {
+                /* Not written yet, the defaults are all there is */
+                if (!self->own_config &&
+                    g_error_matches (*error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+                        g_clear_error (error);
+                        goto cache;
                 }
+
+                g_warning ("redshiftgtk_redshift_wrapper_load_config\n\
+        g_file_get_contents: %s\n", (*error)->message);
+                goto cache;
         }
 
-        g_key_file_load_from_file (self->config,
-                                   self->config_path,
-                                   G_KEY_FILE_NONE, error);
+        g_key_file_load_from_data (config, data, length, G_KEY_FILE_NONE, error);
 
         if (*error) {
                 g_warning ("redshiftgtk_redshift_wrapper_load_config\n\
-        g_key_file_load_from_file: %s\n", (*error)->message);
+        g_key_file_load_from_data: %s\n", (*error)->message);
         }
+
+cache:
+        /* Keep the original bytes around, apply only patches them */
+        self->document = redshiftgtk_config_document_new (data ? data : "", length);
+
+        /* Parse everything once, the accessors only read the merged
+         * view. Runtime overrides survive a reload.
+         */
+        redshiftgtk_settings_layers_load (self->defaults.layers, CONFIG_LAYER_SYSTEM,
+                                          system, NULL);
+        redshiftgtk_settings_layers_load (self->defaults.layers, CONFIG_LAYER_USER,
+                                          config, NULL);
+        self->defaults.dirty = 0;
+
+        redshiftgtk_redshift_wrapper_load_profiles (self, system, config);
+
+        /* Don't let a file that couldn't be read stick around as defaults */
+        if (*error)
+                return;
+
+        redshiftgtk_redshift_wrapper_save_cache (self, stamps);
+        self->stamps = g_steal_pointer (&stamps);
 }
 
 static void
 redshiftgtk_redshift_wrapper_init (RedshiftGtkRedshiftWrapper *self)
 {
+        self->redshift_state = REDSHIFT_STATE_UNDEFINED;
+        self->process = NULL;
+        self->adopted = g_array_new (FALSE, FALSE, sizeof (GPid));
+        self->left_alone = g_array_new (FALSE, FALSE, sizeof (GPid));
+        self->scan = redshiftgtk_process_scan_new (NULL);
+        self->process_cancellable = g_cancellable_new ();
+        self->profiles = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                                (GDestroyNotify) redshiftgtk_redshift_wrapper_profile_free);
+        self->outputs = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                               (GDestroyNotify) redshiftgtk_redshift_wrapper_profile_free);
+        self->instances = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                 (GDestroyNotify) redshiftgtk_redshift_wrapper_instance_free);
+        self->preview_ramps = redshiftgtk_ramp_sink_new ();
+        self->defaults.layers = redshiftgtk_settings_layers_new ();
+        self->active = &self->defaults;
+}
+
+static void
+redshiftgtk_redshift_wrapper_constructed (GObject *object)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (object);
         g_autoptr (GError) error = NULL;
         const gchar* user_config_path = NULL;
 
-        self->redshift_state = REDSHIFT_STATE_UNDEFINED;
-        self->process = NULL;
+        G_OBJECT_CLASS (redshiftgtk_redshift_wrapper_parent_class)->constructed (object);
 
         user_config_path = g_get_user_config_dir ();
 
         g_assert (user_config_path != NULL);
 
-        self->config_path = g_build_filename (user_config_path, "redshift.conf", NULL);
+        if (!self->config_path) {
+                self->config_path = g_build_filename (user_config_path, "redshift.conf", NULL);
+                self->own_config = TRUE;
+        }
         redshiftgtk_redshift_wrapper_load_config (self, &error);
 
         g_assert_null (error);
+
+        redshiftgtk_redshift_wrapper_autostart_init (self, user_config_path);
 }
 
 RedshiftGtkBackend*
@@ -134,669 +764,2069 @@ redshiftgtk_redshift_wrapper_new ()
         return g_object_new (REDSHIFTGTK_TYPE_REDSHIFT_WRAPPER, NULL);
 }
 
+/**
+ * redshiftgtk_redshift_wrapper_new_for_path
+ *
+ * A wrapper around @path instead of the user's redshift.conf.
+ * The redshift it starts reads @path too. @path isn't created,
+ * until its owner writes it there are only the defaults.
+ */
+RedshiftGtkBackend*
+redshiftgtk_redshift_wrapper_new_for_path (const gchar *path)
+{
+        return g_object_new (REDSHIFTGTK_TYPE_REDSHIFT_WRAPPER,
+                             "config-path", path,
+                             NULL);
+}
+
+static void redshiftgtk_redshift_wrapper_reset (RedshiftGtkRedshiftWrapper *self);
+
+static gboolean
+redshiftgtk_redshift_wrapper_force_exit_cb (gpointer user_data)
+{
+        g_subprocess_force_exit (G_SUBPROCESS (user_data));
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Let @process restore the ramps on its way out, and kill it
+ * if it takes too long
+ */
 static void
-redshiftgtk_redshift_wrapper_stop (RedshiftGtkBackend *backend)
+redshiftgtk_redshift_wrapper_terminate (GSubprocess *process)
+{
+        /* A paused process only sees SIGTERM once it runs again */
+        g_subprocess_send_signal (process, SIGTERM);
+        g_subprocess_send_signal (process, SIGCONT);
+
+        g_timeout_add_seconds_full (G_PRIORITY_DEFAULT, PROCESS_SCAN_GRACE_PERIOD,
+                                    redshiftgtk_redshift_wrapper_force_exit_cb,
+                                    g_object_ref (process), g_object_unref);
+}
+
+static gboolean redshiftgtk_redshift_wrapper_adopt_ours (RedshiftGtkRedshiftWrapper *self);
+
+/* Before the first start or stop, take over what our launcher or an
+ * earlier RedshiftGtk left running. Later on everything of ours was
+ * spawned by us, and one we just asked to quit may still be around.
+ */
+static void
+redshiftgtk_redshift_wrapper_discover (RedshiftGtkRedshiftWrapper *self)
+{
+        if (self->redshift_state != REDSHIFT_STATE_UNDEFINED)
+                return;
+
+        redshiftgtk_process_scan_invalidate (self->scan);
+        self->redshift_state = redshiftgtk_redshift_wrapper_adopt_ours (self) ?
+                               REDSHIFT_STATE_RUNNING : REDSHIFT_STATE_STOPPED;
+}
+
+static gboolean
+redshiftgtk_redshift_wrapper_is_running (RedshiftGtkBackend *backend)
 {
         RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
 
-        /* Kill using all methods just to be sure */
-        g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, NULL,
-                          "redshift", "-x", NULL);
-        g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, NULL,
-                          "redshift", "-x", "-m", "randr", NULL);
-        g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, NULL,
-                          "redshift", "-x", "-m", "vidmode", NULL);
-        g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, NULL,
-                          "killall", "-e", "-s", "KILL", "redshift", NULL);
-        g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, NULL,
-                          "killall", "-e", "-s", "KILL", "redshift-gtk", NULL);
-        if (self->process)
-                g_subprocess_force_exit (self->process);
+        redshiftgtk_redshift_wrapper_discover (self);
 
-        self->redshift_state = REDSHIFT_STATE_STOPPED;
+        return self->redshift_state == REDSHIFT_STATE_RUNNING;
 }
 
 static void
-redshiftgtk_redshift_wrapper_start (RedshiftGtkBackend *backend,
-                                    GError            **error)
+redshiftgtk_redshift_wrapper_stop (RedshiftGtkBackend *backend)
 {
         RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        GHashTableIter iter;
+        OutputInstance *instance;
+        guint terminated = 0;
+        guint i;
+
+        /* What a previous session left running goes too */
+        redshiftgtk_redshift_wrapper_discover (self);
+
+        /* Only what we started or adopted, anything else is
+         * none of our business
+         */
+        if (self->process) {
+                redshiftgtk_redshift_wrapper_terminate (self->process);
+                g_clear_object (&self->process);
+                terminated++;
+        }
 
-        if (self->redshift_state != REDSHIFT_STATE_STOPPED)
-                redshiftgtk_redshift_wrapper_stop (backend);
+        g_hash_table_iter_init (&iter, self->instances);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &instance)) {
+                redshiftgtk_redshift_wrapper_terminate (instance->process);
+                terminated++;
+        }
+        g_hash_table_remove_all (self->instances);
+
+        for (i = 0; i < self->adopted->len; i++) {
+                if (redshiftgtk_process_scan_terminate (self->scan,
+                                                        g_array_index (self->adopted, GPid, i),
+                                                        PROCESS_SCAN_GRACE_PERIOD))
+                        terminated++;
+        }
+        g_array_set_size (self->adopted, 0);
 
-        self->process = g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, error,
-                                          "redshift",
-                                          NULL);
+        /* Nobody left to restore the ramps, clear a preview or
+         * whatever an earlier session left behind
+         */
+        if (terminated == 0)
+                redshiftgtk_redshift_wrapper_reset (self);
 
-        self->redshift_state = REDSHIFT_STATE_RUNNING;
+        redshiftgtk_process_scan_invalidate (self->scan);
+        redshiftgtk_metrics_count (METRIC_KILLS, terminated);
+
+        /* Whatever was being previewed is gone along with it */
+        self->previewing = FALSE;
+        self->preview_pending = FALSE;
+        redshiftgtk_redshift_wrapper_forget_ramps (self);
+
+        self->redshift_state = REDSHIFT_STATE_STOPPED;
 }
 
-static gdouble
-redshiftgtk_redshift_wrapper_get_temperature (RedshiftGtkBackend *backend,
-                                              TimePeriod          period)
+/* Merged value of @setting in the active profile */
+static const gdouble*
+redshiftgtk_redshift_wrapper_value (RedshiftGtkRedshiftWrapper *self,
+                                    Setting                     setting)
 {
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
-        const gchar* key;
+        return redshiftgtk_settings_layers_get (self->active->layers, setting);
+}
 
-        switch (period) {
-        case TIME_PERIOD_DAY:
-                key = "temp-day";
-                break;
-        case TIME_PERIOD_NIGHT:
-                key = "temp-night";
-                break;
-        default:
-                return 0;
+/* What @output gets for @setting: its own value where it has one,
+ * the active profile's otherwise. @output may be NULL.
+ */
+static const gdouble*
+redshiftgtk_redshift_wrapper_output_value (RedshiftGtkRedshiftWrapper *self,
+                                           Profile                    *output,
+                                           Setting                     setting)
+{
+        if (output && redshiftgtk_settings_schema_is_per_output (setting) &&
+            redshiftgtk_settings_layers_get_source (output->layers, setting) != CONFIG_LAYER_DEFAULT)
+                return redshiftgtk_settings_layers_get (output->layers, setting);
+
+        return redshiftgtk_redshift_wrapper_value (self, setting);
+}
+
+/* redshift only reads the user file, anything it would miss
+ * has to be handed over in a config of its own
+ */
+static gboolean
+redshiftgtk_redshift_wrapper_needs_runtime_config (RedshiftGtkRedshiftWrapper *self)
+{
+        Setting setting;
+
+        if (self->active != &self->defaults)
+                return TRUE;
+
+        /* Set but not written yet, the user file doesn't have it */
+        if (self->active->dirty)
+                return TRUE;
+
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                switch (redshiftgtk_settings_layers_get_source (self->active->layers, setting)) {
+                case CONFIG_LAYER_SYSTEM:
+                case CONFIG_LAYER_RUNTIME:
+                        return TRUE;
+                default:
+                        break;
+                }
         }
 
-        g_autoptr (GError) error = NULL;
-        gdouble temperature = g_key_file_get_double (self->config,
-                                                     DEFAULT_SETTINGS_GROUP,
-                                                     key, &error);
+        return FALSE;
+}
 
-        if (error) {
-                g_debug ("redshiftgtk_redshift_wrapper_get_temperature\n\
-        g_key_file_get_double: %s\n",
-                         error->message);
-                goto default_temp;
+/**
+ * Write the merged view of the active profile out as a redshift.conf
+ * for the running instance. Keys we don't manage are taken over from
+ * the user file. With @output, the file is for an instance that only
+ * adjusts that output and has its settings. Returns the path, or NULL
+ * with @error set.
+ */
+static gchar*
+redshiftgtk_redshift_wrapper_write_runtime_config (RedshiftGtkRedshiftWrapper *self,
+                                                   const RedshiftGtkOutput    *output,
+                                                   GError                    **error)
+{
+        g_autoptr (RedshiftGtkConfigDocument) document = NULL;
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *name = NULL;
+        gchar buffer[SETTING_FORMAT_SIZE];
+        const SettingInfo *method;
+        Profile *settings = NULL;
+        const gchar *data;
+        gsize length;
+        Setting setting;
+
+        if (output)
+                settings = redshiftgtk_redshift_wrapper_profile_lookup (self->outputs, output->name);
+
+        data = redshiftgtk_config_document_get_data (redshiftgtk_redshift_wrapper_get_document (self),
+                                                     &length);
+        document = redshiftgtk_config_document_new (data, length);
+
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+
+                redshiftgtk_config_document_set (document, info->group, info->key,
+                                                 redshiftgtk_settings_schema_format (setting,
+                                                                                     redshiftgtk_redshift_wrapper_output_value (self, settings, setting),
+                                                                                     buffer));
+        }
+
+        /* Only randr can be told to leave the other CRTCs alone */
+        if (output) {
+                g_snprintf (buffer, sizeof (buffer), "%u", output->crtc);
+                method = redshiftgtk_settings_schema_lookup (SETTING_ADJUSTMENT_METHOD);
+                redshiftgtk_config_document_set (document, method->group, method->key, "randr");
+                redshiftgtk_config_document_set (document, "randr", "crtc", buffer);
         }
 
-        if (temperature < MIN_TEMPERATURE || temperature > MAX_TEMPERATURE)
-                goto default_temp;
+        name = output ? g_strdup_printf ("redshiftgtk-runtime-crtc%u.conf", output->crtc)
+                      : g_strdup ("redshiftgtk-runtime.conf");
+        path = g_build_filename (g_get_user_runtime_dir (), name, NULL);
+        data = redshiftgtk_config_document_get_data (document, &length);
+
+        if (!g_file_set_contents (path, data, length, error))
+                return NULL;
+        redshiftgtk_metrics_count_write (length);
+
+        return g_steal_pointer (&path);
+}
+
+static void
+redshiftgtk_redshift_wrapper_trace_exit_cb (GObject      *source_object,
+                                            GAsyncResult *result,
+                                            gpointer      user_data)
+{
+        g_autofree gint64 *spawned = user_data;
+
+        g_subprocess_wait_finish (G_SUBPROCESS (source_object), result, NULL);
+        redshiftgtk_trace_mark (*spawned, "redshift lifetime", NULL);
+}
+
+static GPid
+redshiftgtk_redshift_wrapper_get_pid (GSubprocess *process)
+{
+        const gchar *identifier = process ? g_subprocess_get_identifier (process) : NULL;
+
+        return identifier ? (GPid) g_ascii_strtoll (identifier, NULL, 10) : 0;
+}
+
+static void
+redshiftgtk_redshift_wrapper_exit_cb (GObject      *source_object,
+                                      GAsyncResult *result,
+                                      gpointer      user_data)
+{
+        g_autoptr (GError) error = NULL;
+
+        g_subprocess_wait_finish (G_SUBPROCESS (source_object), result, &error);
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                return;
+
+        /* The last scan still has it */
+        redshiftgtk_process_scan_invalidate (REDSHIFTGTK_REDSHIFT_WRAPPER (user_data)->scan);
+}
+
+/* A long-running redshift on @config_path. With @handoff it takes
+ * over from ramps already on screen, fading in from neutral would
+ * be the very flash this avoids.
+ */
+static GSubprocess*
+redshiftgtk_redshift_wrapper_spawn (RedshiftGtkRedshiftWrapper *self,
+                                    const gchar                *config_path,
+                                    gboolean                    handoff,
+                                    GError                    **error)
+{
+        g_autoptr (GPtrArray) argv = NULL;
+        GSubprocess *process;
+        gint64 spawned;
+
+        /* Always name the file, it isn't necessarily the one
+         * redshift would pick by itself
+         */
+        argv = g_ptr_array_new ();
+        g_ptr_array_add (argv, "redshift");
+        if (handoff)
+                g_ptr_array_add (argv, "-r");
+        g_ptr_array_add (argv, "-c");
+        g_ptr_array_add (argv, (gpointer) config_path);
+        g_ptr_array_add (argv, NULL);
+
+        spawned = redshiftgtk_trace_begin ();
+        /* Its complaints go to the session log, nobody reads
+         * what it prints otherwise
+         */
+        process = redshiftgtk_spawnv ((const gchar * const *) argv->pdata,
+                                      G_SUBPROCESS_FLAGS_STDOUT_SILENCE,
+                                      error);
+        redshiftgtk_trace_end (spawned, "spawn redshift");
+        redshiftgtk_metrics_count (METRIC_SPAWNS, 1);
+
+        if (!process)
+                return NULL;
+
+        redshiftgtk_process_scan_invalidate (self->scan);
+        g_subprocess_wait_async (process, self->process_cancellable,
+                                 redshiftgtk_redshift_wrapper_exit_cb, self);
+
+        /* Watched once more for the trace */
+        if (spawned) {
+                gint64 *start = g_new (gint64, 1);
+
+                *start = spawned;
+                g_subprocess_wait_async (process, NULL,
+                                         redshiftgtk_redshift_wrapper_trace_exit_cb,
+                                         start);
+        }
+
+        return process;
+}
+
+/* GSubprocess forgets the pid once the process has been reaped */
+static gboolean
+redshiftgtk_redshift_wrapper_is_alive (GSubprocess *process)
+{
+        return process && g_subprocess_get_identifier (process) != NULL;
+}
+
+/* Whether a redshift still has its ramps on screen, a new one then
+ * hands off from them. One that died or was never there left the
+ * screen neutral, a cold start fades in as usual.
+ */
+static gboolean
+redshiftgtk_redshift_wrapper_is_handoff (RedshiftGtkRedshiftWrapper *self,
+                                         GSubprocess                *previous,
+                                         gboolean                    instances)
+{
+        GHashTableIter iter;
+        OutputInstance *instance;
+        guint i;
+
+        if (redshiftgtk_redshift_wrapper_is_alive (previous))
+                return TRUE;
+
+        for (i = 0; i < self->adopted->len; i++) {
+                if (redshiftgtk_process_scan_is_redshift (self->scan,
+                                                          g_array_index (self->adopted, GPid, i)))
+                        return TRUE;
+        }
+
+        if (!instances)
+                return FALSE;
+
+        g_hash_table_iter_init (&iter, self->instances);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &instance)) {
+                if (redshiftgtk_redshift_wrapper_is_alive (instance->process))
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+/* Killed, asked to quit it would restore neutral ramps */
+static void
+redshiftgtk_redshift_wrapper_kill (GSubprocess *process)
+{
+        g_subprocess_force_exit (process);
+        redshiftgtk_metrics_count (METRIC_KILLS, 1);
+}
+
+/* The new instances are up, what ran before them can go */
+static void
+redshiftgtk_redshift_wrapper_finish_start (RedshiftGtkRedshiftWrapper *self,
+                                           GSubprocess                *previous)
+{
+        guint i;
+
+        if (previous)
+                redshiftgtk_redshift_wrapper_kill (previous);
+
+        for (i = 0; i < self->adopted->len; i++) {
+                if (redshiftgtk_process_scan_kill (self->scan, g_array_index (self->adopted, GPid, i)))
+                        redshiftgtk_metrics_count (METRIC_KILLS, 1);
+        }
+        g_array_set_size (self->adopted, 0);
+        redshiftgtk_process_scan_invalidate (self->scan);
+
+        /* The new instances replace any preview too, the ones
+         * that were kept were paused for it
+         */
+        if (self->previewing)
+                redshiftgtk_redshift_wrapper_signal (self, SIGCONT);
+        self->previewing = FALSE;
+        self->preview_pending = FALSE;
+        redshiftgtk_redshift_wrapper_forget_ramps (self);
+
+        self->redshift_state = REDSHIFT_STATE_RUNNING;
+}
+
+/* One redshift for every output */
+static void
+redshiftgtk_redshift_wrapper_start_all (RedshiftGtkRedshiftWrapper *self,
+                                        GError                    **error)
+{
+        g_autoptr (GSubprocess) previous = NULL;
+        g_autofree gchar *runtime_path = NULL;
+        GHashTableIter iter;
+        OutputInstance *instance;
+        gboolean handoff;
+
+        if (redshiftgtk_redshift_wrapper_needs_runtime_config (self)) {
+                runtime_path = redshiftgtk_redshift_wrapper_write_runtime_config (self, NULL, error);
+                if (!runtime_path)
+                        return;
+        }
+
+        /* Never reset the screen on the way: what runs now is
+         * replaced once the new instance is up
+         */
+        previous = g_steal_pointer (&self->process);
+        handoff = redshiftgtk_redshift_wrapper_is_handoff (self, previous, TRUE);
+
+        self->process = redshiftgtk_redshift_wrapper_spawn (self,
+                                                            runtime_path ? runtime_path : self->config_path,
+                                                            handoff, error);
+
+        /* Better the old settings than none at all */
+        if (!self->process) {
+                self->process = g_steal_pointer (&previous);
+                return;
+        }
+
+        /* No output has settings of its own anymore */
+        g_hash_table_iter_init (&iter, self->instances);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &instance))
+                redshiftgtk_redshift_wrapper_kill (instance->process);
+        g_hash_table_remove_all (self->instances);
+
+        redshiftgtk_redshift_wrapper_finish_start (self, previous);
+}
+
+/* What the ramps of @output are made from in @period */
+static void
+redshiftgtk_redshift_wrapper_ramp_key (RedshiftGtkRedshiftWrapper *self,
+                                       const RedshiftGtkOutput    *output,
+                                       TimePeriod                  period,
+                                       RedshiftGtkRampKey         *key)
+{
+        Profile *settings = redshiftgtk_redshift_wrapper_profile_lookup (self->outputs, output->name);
+
+        key->temperature = redshiftgtk_redshift_wrapper_output_value (self, settings,
+                                                                      SETTING_TEMP_DAY + period)[0];
+        key->brightness = redshiftgtk_redshift_wrapper_output_value (self, settings,
+                                                                     SETTING_BRIGHTNESS_DAY + period)[0];
+        memcpy (key->gamma,
+                redshiftgtk_redshift_wrapper_output_value (self, settings, SETTING_GAMMA_DAY + period),
+                sizeof (key->gamma));
+        key->size = output->ramp_size;
+}
+
+static gboolean
+redshiftgtk_redshift_wrapper_is_connected (GPtrArray   *outputs,
+                                           const gchar *name)
+{
+        guint i;
+
+        for (i = 0; i < outputs->len; i++) {
+                if (g_strcmp0 (((RedshiftGtkOutput *) g_ptr_array_index (outputs, i))->name, name) == 0)
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+/* Spawned for a start that failed halfway, what ran before stays */
+static void
+redshiftgtk_redshift_wrapper_abort_start (GHashTable *started)
+{
+        GHashTableIter iter;
+        OutputInstance *instance;
+
+        g_hash_table_iter_init (&iter, started);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &instance))
+                redshiftgtk_redshift_wrapper_kill (instance->process);
+}
+
+/* A redshift for each of @outputs. Instances whose ramps would come
+ * out the same as before keep running untouched, changing one output
+ * doesn't flicker the others. Nothing is replaced unless all of the
+ * new ones are up.
+ */
+static void
+redshiftgtk_redshift_wrapper_start_outputs (RedshiftGtkRedshiftWrapper *self,
+                                            GPtrArray                  *outputs,
+                                            GError                    **error)
+{
+        g_autoptr (GSubprocess) previous = NULL;
+        g_autoptr (GHashTable) started = NULL;
+        GHashTableIter iter;
+        gchar *name;
+        OutputInstance *instance;
+        gboolean restart = FALSE;
+        gboolean handoff;
+        Setting setting;
+        guint i;
+
+        /* Location, method and fading are the same for all of them */
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                if (redshiftgtk_settings_schema_is_per_output (setting))
+                        continue;
+
+                if (memcmp (self->shared[setting], redshiftgtk_redshift_wrapper_value (self, setting),
+                            sizeof (SettingValue)) != 0)
+                        restart = TRUE;
+        }
+
+        /* Outputs that went away take their instance along */
+        g_hash_table_iter_init (&iter, self->instances);
+        while (g_hash_table_iter_next (&iter, (gpointer *) &name, (gpointer *) &instance)) {
+                if (!redshiftgtk_redshift_wrapper_is_connected (outputs, name)) {
+                        redshiftgtk_redshift_wrapper_kill (instance->process);
+                        g_hash_table_iter_remove (&iter);
+                }
+        }
+
+        handoff = redshiftgtk_redshift_wrapper_is_handoff (self, self->process, FALSE);
+        started = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify) redshiftgtk_redshift_wrapper_instance_free);
+
+        for (i = 0; i < outputs->len; i++) {
+                RedshiftGtkOutput *output = g_ptr_array_index (outputs, i);
+                g_autofree gchar *runtime_path = NULL;
+                RedshiftGtkRampKey ramps[TIME_PERIOD_NIGHT + 1];
+                GSubprocess *process;
+                TimePeriod period;
+                gboolean same = !restart;
+                gboolean replacing;
+
+                instance = g_hash_table_lookup (self->instances, output->name);
+
+                for (period = TIME_PERIOD_DAY; period <= TIME_PERIOD_NIGHT; period++) {
+                        redshiftgtk_redshift_wrapper_ramp_key (self, output, period, &ramps[period]);
+                        if (!instance || !redshiftgtk_ramp_key_equal (&instance->ramps[period],
+                                                                     &ramps[period]))
+                                same = FALSE;
+                }
+
+                if (same && instance->crtc == output->crtc)
+                        continue;
+
+                replacing = instance && redshiftgtk_redshift_wrapper_is_alive (instance->process);
+
+                runtime_path = redshiftgtk_redshift_wrapper_write_runtime_config (self, output, error);
+                process = runtime_path ? redshiftgtk_redshift_wrapper_spawn (self, runtime_path,
+                                                                             handoff || replacing,
+                                                                             error)
+                                       : NULL;
+                if (!process) {
+                        redshiftgtk_redshift_wrapper_abort_start (started);
+                        return;
+                }
+
+                instance = g_new0 (OutputInstance, 1);
+                instance->process = process;
+                instance->crtc = output->crtc;
+                memcpy (instance->ramps, ramps, sizeof (ramps));
+                g_hash_table_insert (started, g_strdup (output->name), instance);
+        }
+
+        /* All of them are up, each replaces what ran for its output */
+        g_hash_table_iter_init (&iter, started);
+        while (g_hash_table_iter_next (&iter, (gpointer *) &name, (gpointer *) &instance)) {
+                OutputInstance *replaced = g_hash_table_lookup (self->instances, name);
+
+                if (replaced)
+                        redshiftgtk_redshift_wrapper_kill (replaced->process);
+
+                g_hash_table_iter_steal (&iter);
+                g_hash_table_replace (self->instances, name, instance);
+        }
+
+        for (setting = 0; setting < N_SETTINGS; setting++)
+                memcpy (self->shared[setting], redshiftgtk_redshift_wrapper_value (self, setting),
+                        sizeof (SettingValue));
+
+        /* Every output has its own now */
+        previous = g_steal_pointer (&self->process);
+        redshiftgtk_redshift_wrapper_finish_start (self, previous);
+}
+
+/* Whether any of @outputs has a setting of its own */
+static gboolean
+redshiftgtk_redshift_wrapper_has_output_settings (RedshiftGtkRedshiftWrapper *self,
+                                                  GPtrArray                  *outputs)
+{
+        Setting setting;
+        guint i;
+
+        for (i = 0; i < outputs->len; i++) {
+                RedshiftGtkOutput *output = g_ptr_array_index (outputs, i);
+                Profile *settings = redshiftgtk_redshift_wrapper_profile_lookup (self->outputs,
+                                                                                 output->name);
+
+                if (!settings)
+                        continue;
+
+                for (setting = 0; setting < N_SETTINGS; setting++) {
+                        if (redshiftgtk_settings_schema_is_per_output (setting) &&
+                            redshiftgtk_settings_layers_get_source (settings->layers, setting) != CONFIG_LAYER_DEFAULT)
+                                return TRUE;
+                }
+        }
+
+        return FALSE;
+}
+
+/* Connected on first use. Outputs set from outside aren't on
+ * any X server we could talk to.
+ */
+static RedshiftGtkRandrGamma*
+redshiftgtk_redshift_wrapper_get_randr (RedshiftGtkRedshiftWrapper *self)
+{
+        g_autoptr (GError) error = NULL;
+
+        if (self->connected_fixed)
+                return NULL;
+
+        if (!self->randr && !self->randr_tried) {
+                self->randr_tried = TRUE;
+                self->randr = redshiftgtk_randr_gamma_new (NULL, &error);
+                if (!self->randr)
+                        g_debug ("redshiftgtk_redshift_wrapper_get_randr\n\
+        redshiftgtk_randr_gamma_new: %s\n", error->message);
+        }
+
+        return self->randr;
+}
+
+/* The outputs there are now, empty if they can't be told apart.
+ * Only asked for again after the X server reported a change.
+ */
+static GPtrArray*
+redshiftgtk_redshift_wrapper_get_connected (RedshiftGtkRedshiftWrapper *self)
+{
+        g_autoptr (GError) error = NULL;
+        RedshiftGtkRandrGamma *randr;
+        GPtrArray *outputs = NULL;
+
+        if (self->connected_fixed)
+                return self->connected;
+
+        randr = redshiftgtk_redshift_wrapper_get_randr (self);
+        if (randr) {
+                outputs = redshiftgtk_randr_gamma_get_outputs (randr, &error);
+                if (!outputs)
+                        g_debug ("redshiftgtk_redshift_wrapper_get_connected\n\
+        redshiftgtk_randr_gamma_get_outputs: %s\n", error->message);
+        }
+
+        g_clear_pointer (&self->connected, g_ptr_array_unref);
+        self->connected = outputs ? g_ptr_array_ref (outputs)
+                                  : g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_output_free);
+
+        return self->connected;
+}
+
+/* Two redshifts would fight over the ramps, one that was left
+ * alone keeps them until it is adopted or quits
+ */
+static gboolean
+redshiftgtk_redshift_wrapper_check_left_alone (RedshiftGtkRedshiftWrapper *self,
+                                               GError                    **error)
+{
+        guint i = 0;
+
+        while (i < self->left_alone->len) {
+                GPid pid = g_array_index (self->left_alone, GPid, i);
+
+                if (!redshiftgtk_process_scan_is_redshift (self->scan, pid)) {
+                        g_array_remove_index_fast (self->left_alone, i);
+                        continue;
+                }
+
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                             _("Another redshift (process %d) is running, adopt it or quit it first"),
+                             (gint) pid);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+static void
+redshiftgtk_redshift_wrapper_start (RedshiftGtkBackend *backend,
+                                    GError            **error)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        GPtrArray *outputs;
+
+        /* Replaced rather than run next to */
+        redshiftgtk_redshift_wrapper_discover (self);
+
+        if (!redshiftgtk_redshift_wrapper_check_left_alone (self, error))
+                return;
+
+        outputs = redshiftgtk_redshift_wrapper_get_connected (self);
+        if (redshiftgtk_redshift_wrapper_has_output_settings (self, outputs))
+                redshiftgtk_redshift_wrapper_start_outputs (self, outputs, error);
+        else
+                redshiftgtk_redshift_wrapper_start_all (self, error);
+}
+
+/* Validate and cache, remembering what apply has to write */
+static void
+redshiftgtk_redshift_wrapper_store (RedshiftGtkRedshiftWrapper *self,
+                                    Setting                     setting,
+                                    gdouble                     red,
+                                    gdouble                     green,
+                                    gdouble                     blue)
+{
+        RedshiftGtkSettingsLayers *layers = self->active->layers;
+        SettingValue value = { red, green, blue };
+
+        redshiftgtk_settings_schema_validate (setting, value);
+
+        if (memcmp (redshiftgtk_settings_layers_get (layers, setting), value,
+                    sizeof (SettingValue)) == 0)
+                return;
+
+        /* Something set on purpose replaces a temporary override */
+        redshiftgtk_settings_layers_set (layers, CONFIG_LAYER_USER, setting, value);
+        redshiftgtk_settings_layers_unset (layers, CONFIG_LAYER_RUNTIME, setting);
+        self->active->dirty |= 1u << setting;
+}
+
+static gdouble
+redshiftgtk_redshift_wrapper_get_temperature (RedshiftGtkBackend *backend,
+                                              TimePeriod          period)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        return redshiftgtk_redshift_wrapper_value (self, SETTING_TEMP_DAY + period)[0];
+}
+
+static void
+redshiftgtk_redshift_wrapper_set_temperature (RedshiftGtkBackend *backend,
+                                              TimePeriod          period,
+                                              gdouble             temperature)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        redshiftgtk_redshift_wrapper_store (self, SETTING_TEMP_DAY + period,
+                                            temperature, temperature, temperature);
+}
+
+static LocationProvider
+redshiftgtk_redshift_wrapper_get_location_provider (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+
+        return (LocationProvider) redshiftgtk_redshift_wrapper_value (self, SETTING_LOCATION_PROVIDER)[0];
+}
+
+static void
+redshiftgtk_redshift_wrapper_set_location_provider (RedshiftGtkBackend *backend,
+                                                    LocationProvider    provider)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+
+        redshiftgtk_redshift_wrapper_store (self, SETTING_LOCATION_PROVIDER,
+                                            provider, provider, provider);
+}
+
+static gdouble
+redshiftgtk_redshift_wrapper_get_latitude (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+
+        return redshiftgtk_redshift_wrapper_value (self, SETTING_LATITUDE)[0];
+}
+
+static void
+redshiftgtk_redshift_wrapper_set_latitude (RedshiftGtkBackend *backend,
+                                           gdouble             latitude)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+
+        redshiftgtk_redshift_wrapper_store (self, SETTING_LATITUDE,
+                                            latitude, latitude, latitude);
+}
+
+static gdouble
+redshiftgtk_redshift_wrapper_get_longtitude (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+
+        return redshiftgtk_redshift_wrapper_value (self, SETTING_LONGTITUDE)[0];
+}
+
+static void
+redshiftgtk_redshift_wrapper_set_longtitude (RedshiftGtkBackend *backend,
+                                             gdouble             longtitude)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+
+        redshiftgtk_redshift_wrapper_store (self, SETTING_LONGTITUDE,
+                                            longtitude, longtitude, longtitude);
+}
+
+static gdouble
+redshiftgtk_redshift_wrapper_get_brightness (RedshiftGtkBackend *backend,
+                                             TimePeriod          period)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        return redshiftgtk_redshift_wrapper_value (self, SETTING_BRIGHTNESS_DAY + period)[0];
+}
+
+static void
+redshiftgtk_redshift_wrapper_set_brightness (RedshiftGtkBackend *backend,
+                                             TimePeriod          period,
+                                             gdouble             brightness)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        redshiftgtk_redshift_wrapper_store (self, SETTING_BRIGHTNESS_DAY + period,
+                                            brightness, brightness, brightness);
+}
+
+static GArray*
+redshiftgtk_redshift_wrapper_get_gamma (RedshiftGtkBackend *backend,
+                                        TimePeriod          period)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        GArray *gamma = NULL;
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        gamma = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), SETTING_COMPONENTS);
+        g_array_append_vals (gamma,
+                             redshiftgtk_redshift_wrapper_value (self, SETTING_GAMMA_DAY + period),
+                             SETTING_COMPONENTS);
+
+        return gamma;
+}
+
+static void
+redshiftgtk_redshift_wrapper_set_gamma (RedshiftGtkBackend *backend,
+                                        TimePeriod          period,
+                                        gdouble             red,
+                                        gdouble             green,
+                                        gdouble             blue)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        g_assert (period <= TIME_PERIOD_NIGHT);
+
+        redshiftgtk_redshift_wrapper_store (self, SETTING_GAMMA_DAY + period,
+                                            red, green, blue);
+}
+
+static AdjustmentMethod
+redshiftgtk_redshift_wrapper_get_adjustment_method (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+
+        return (AdjustmentMethod) redshiftgtk_redshift_wrapper_value (self, SETTING_ADJUSTMENT_METHOD)[0];
+}
+
+static void
+redshiftgtk_redshift_wrapper_set_adjustment_method (RedshiftGtkBackend *backend,
+                                                    AdjustmentMethod    method)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+
+        redshiftgtk_redshift_wrapper_store (self, SETTING_ADJUSTMENT_METHOD,
+                                            method, method, method);
+}
+
+static gboolean
+redshiftgtk_redshift_wrapper_get_smooth_transition (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+
+        return (gboolean) redshiftgtk_redshift_wrapper_value (self, SETTING_FADE)[0];
+}
+
+static void
+redshiftgtk_redshift_wrapper_set_smooth_transition (RedshiftGtkBackend *backend,
+                                                    gboolean            transition)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+
+        redshiftgtk_redshift_wrapper_store (self, SETTING_FADE,
+                                            transition, transition, transition);
+}
+
+static gboolean
+redshiftgtk_redshift_wrapper_autostart_parse (GKeyFile *desktop)
+{
+        g_autoptr (GError) error = NULL;
+        gboolean value;
+
+        value = g_key_file_get_boolean (desktop,
+                                        "Desktop Entry",
+                                        "Hidden",
+                                        &error);
+
+        if (!error) {
+                /* Return true if Hidden is false */
+                return !value;
+        }
+        g_clear_error (&error);
+
+        value = g_key_file_get_boolean (desktop,
+                                        "Desktop Entry",
+                                        "X-GNOME-Autostart-enabled",
+                                        &error);
+
+        if (!error)
+                return value;
+
+        /* We couldn't get either of the keys. Default to FALSE */
+        return FALSE;
+}
+
+/* Replace the cached launcher with @data, or forget it when @data is NULL.
+ * Emits "changed" if that flipped the autostart state.
+ */
+static void
+redshiftgtk_redshift_wrapper_autostart_update (RedshiftGtkRedshiftWrapper *self,
+                                               const gchar                *data,
+                                               gsize                       length)
+{
+        g_autoptr (GError) error = NULL;
+        gboolean autostart = FALSE;
+
+        g_clear_pointer (&self->autostart_desktop, g_key_file_unref);
+
+        if (data) {
+                self->autostart_desktop = g_key_file_new ();
+                g_key_file_load_from_data (self->autostart_desktop,
+                                           data, length,
+                                           G_KEY_FILE_KEEP_COMMENTS, &error);
+
+                if (error) {
+                        g_debug ("redshiftgtk_redshift_wrapper_autostart_update\n\
+        g_key_file_load_from_data: %s\n", error->message);
+                        g_clear_pointer (&self->autostart_desktop, g_key_file_unref);
+                } else {
+                        autostart = redshiftgtk_redshift_wrapper_autostart_parse (self->autostart_desktop);
+                }
+        }
+
+        if (autostart != self->autostart) {
+                self->autostart = autostart;
+                g_signal_emit_by_name (self, "changed");
+        }
+}
+
+static void
+redshiftgtk_redshift_wrapper_autostart_load_cb (GObject      *source_object,
+                                                GAsyncResult *result,
+                                                gpointer      user_data)
+{
+        RedshiftGtkRedshiftWrapper *self = NULL;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *data = NULL;
+        gsize length = 0;
+
+        g_file_load_contents_finish (G_FILE (source_object), result,
+                                     &data, &length, NULL, &error);
+
+        /* Superseded, or the wrapper is gone */
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                return;
+
+        self = REDSHIFTGTK_REDSHIFT_WRAPPER (user_data);
+
+        if (error && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+                g_debug ("redshiftgtk_redshift_wrapper_autostart_load\n\
+        g_file_load_contents_finish: %s\n", error->message);
+        }
+
+        redshiftgtk_redshift_wrapper_autostart_update (self, data, length);
+}
+
+static void
+redshiftgtk_redshift_wrapper_autostart_refresh (RedshiftGtkRedshiftWrapper *self)
+{
+        g_cancellable_cancel (self->autostart_cancellable);
+        g_clear_object (&self->autostart_cancellable);
+        self->autostart_cancellable = g_cancellable_new ();
+
+        g_file_load_contents_async (self->autostart_file,
+                                    self->autostart_cancellable,
+                                    redshiftgtk_redshift_wrapper_autostart_load_cb,
+                                    self);
+}
+
+static void
+redshiftgtk_redshift_wrapper_autostart_monitor_cb (GFileMonitor      *monitor,
+                                                   GFile             *file,
+                                                   GFile             *other_file,
+                                                   GFileMonitorEvent  event_type,
+                                                   gpointer           user_data)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (user_data);
+
+        if (!g_file_equal (file, self->autostart_file) &&
+            !(other_file && g_file_equal (other_file, self->autostart_file)))
+                return;
+
+        /* Wait for the writer to finish */
+        if (event_type == G_FILE_MONITOR_EVENT_CHANGED ||
+            event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+                return;
+
+        /* Our own write is authoritative until it lands */
+        if (self->autostart_writing)
+                return;
+
+        redshiftgtk_redshift_wrapper_autostart_refresh (self);
+}
+
+static void
+redshiftgtk_redshift_wrapper_autostart_init (RedshiftGtkRedshiftWrapper *self,
+                                             const gchar                *user_config_path)
+{
+        g_autoptr (GFile) directory = NULL;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *launcher = NULL;
+        g_autofree gchar *data = NULL;
+        gsize length = 0;
+
+        launcher = g_build_filename (user_config_path,
+                                     "autostart",
+                                     "redshiftgtk.desktop",
+                                     NULL);
+        self->autostart_file = g_file_new_for_path (launcher);
+
+        /* Read once here, the monitor keeps the cache fresh afterwards */
+        if (g_file_load_contents (self->autostart_file, NULL, &data, &length, NULL, NULL))
+                redshiftgtk_redshift_wrapper_autostart_update (self, data, length);
+
+        /* Works even before ~/.config/autostart exists */
+        directory = g_file_get_parent (self->autostart_file);
+        self->autostart_monitor = g_file_monitor_directory (directory,
+                                                            G_FILE_MONITOR_WATCH_MOVES,
+                                                            NULL, &error);
+
+        if (error) {
+                g_debug ("redshiftgtk_redshift_wrapper_autostart_init\n\
+        g_file_monitor_directory: %s\n", error->message);
+                return;
+        }
+
+        REDSHIFTGTK_SIGNAL_CONNECT (self->autostart_monitor, "changed",
+                                    redshiftgtk_redshift_wrapper_autostart_monitor_cb,
+                                    self);
+}
+
+static gboolean
+redshiftgtk_redshift_wrapper_get_autostart (RedshiftGtkBackend *backend)
+{
+        return REDSHIFTGTK_REDSHIFT_WRAPPER (backend)->autostart;
+}
+
+static void
+redshiftgtk_redshift_wrapper_autostart_write (RedshiftGtkRedshiftWrapper *self);
+
+static void
+redshiftgtk_redshift_wrapper_autostart_write_done (RedshiftGtkRedshiftWrapper *self,
+                                                   const gchar                *call,
+                                                   GError                     *error)
+{
+        self->autostart_writing = FALSE;
+
+        if (error) {
+                g_warning ("redshiftgtk_redshift_wrapper_set_autostart\n\
+        %s: %s\n", call, error->message);
+
+                /* Fall back to whatever is really on disk */
+                redshiftgtk_redshift_wrapper_autostart_refresh (self);
+                g_signal_emit_by_name (self, "autostart-failed", error->message);
+        }
+}
+
+static void
+redshiftgtk_redshift_wrapper_autostart_mkdir_cb (GObject      *source_object,
+                                                 GAsyncResult *result,
+                                                 gpointer      user_data)
+{
+        RedshiftGtkRedshiftWrapper *self = NULL;
+        g_autoptr (GError) error = NULL;
+
+        g_file_make_directory_finish (G_FILE (source_object), result, &error);
+
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                return;
+
+        self = REDSHIFTGTK_REDSHIFT_WRAPPER (user_data);
+
+        if (error && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_EXISTS)) {
+                redshiftgtk_redshift_wrapper_autostart_write_done (self,
+                                                                   "g_file_make_directory_finish",
+                                                                   error);
+                return;
+        }
+
+        redshiftgtk_redshift_wrapper_autostart_write (self);
+}
+
+static void
+redshiftgtk_redshift_wrapper_autostart_write_cb (GObject      *source_object,
+                                                 GAsyncResult *result,
+                                                 gpointer      user_data)
+{
+        RedshiftGtkRedshiftWrapper *self = NULL;
+        g_autoptr (GFile) directory = NULL;
+        g_autoptr (GError) error = NULL;
+
+        g_file_replace_contents_finish (G_FILE (source_object), result, NULL, &error);
+
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                return;
+
+        self = REDSHIFTGTK_REDSHIFT_WRAPPER (user_data);
+
+        /* First launcher ever, make sure ~/.config/autostart exists */
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+                directory = g_file_get_parent (self->autostart_file);
+                g_file_make_directory_async (directory,
+                                             G_PRIORITY_DEFAULT,
+                                             self->autostart_cancellable,
+                                             redshiftgtk_redshift_wrapper_autostart_mkdir_cb,
+                                             self);
+                return;
+        }
+
+        redshiftgtk_redshift_wrapper_autostart_write_done (self,
+                                                           "g_file_replace_contents_finish",
+                                                           error);
+}
+
+static void
+redshiftgtk_redshift_wrapper_autostart_write (RedshiftGtkRedshiftWrapper *self)
+{
+        g_autoptr (GBytes) bytes = NULL;
+        gchar *data = NULL;
+        gsize length = 0;
+
+        data = g_key_file_to_data (self->autostart_desktop, &length, NULL);
+        bytes = g_bytes_new_take (data, length);
+
+        /* Written to a temporary file and renamed over the launcher,
+         * so readers never see a half-written entry
+         */
+        g_file_replace_contents_bytes_async (self->autostart_file,
+                                             bytes,
+                                             NULL, FALSE,
+                                             G_FILE_CREATE_NONE,
+                                             self->autostart_cancellable,
+                                             redshiftgtk_redshift_wrapper_autostart_write_cb,
+                                             self);
+        redshiftgtk_metrics_count_write (length);
+}
+
+/* Plain redshift for the user's own file, which it finds by itself */
+static gchar*
+redshiftgtk_redshift_wrapper_autostart_exec (RedshiftGtkRedshiftWrapper *self)
+{
+        g_autofree gchar *user_config_path = NULL;
+        g_autofree gchar *quoted = NULL;
+
+        user_config_path = g_build_filename (g_get_user_config_dir (), "redshift.conf", NULL);
+        if (g_strcmp0 (self->config_path, user_config_path) == 0)
+                return g_strdup ("redshift");
+
+        quoted = g_shell_quote (self->config_path);
+
+        return g_strconcat ("redshift -c ", quoted, NULL);
+}
+
+static void
+redshiftgtk_redshift_wrapper_set_autostart (RedshiftGtkBackend *backend,
+                                            gboolean            autostart,
+                                            GError            **error)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+
+        if (!self->autostart_file)
+                return;
+
+        if (autostart == self->autostart && !self->autostart_writing)
+                return;
+
+        /* Supersede any read or write still in flight */
+        g_cancellable_cancel (self->autostart_cancellable);
+        g_clear_object (&self->autostart_cancellable);
+        self->autostart_cancellable = g_cancellable_new ();
+
+        if (!self->autostart_desktop) {
+                g_autofree gchar *exec = redshiftgtk_redshift_wrapper_autostart_exec (self);
+
+                self->autostart_desktop = g_key_file_new ();
+                g_key_file_set_string (self->autostart_desktop,
+                                       "Desktop Entry", "Name", "RedshiftGtkAutostart");
+                g_key_file_set_string (self->autostart_desktop,
+                                       "Desktop Entry", "Exec", exec);
+                g_key_file_set_string (self->autostart_desktop,
+                                       "Desktop Entry", "Type", "Application");
+        }
+
+        g_key_file_set_boolean (self->autostart_desktop,
+                                "Desktop Entry",
+                                "Hidden",
+                                !autostart);
+        g_key_file_set_boolean (self->autostart_desktop,
+                                "Desktop Entry",
+                                "X-GNOME-Autostart-enabled",
+                                autostart);
+
+        /* Queries see the new state right away */
+        self->autostart = autostart;
+        self->autostart_writing = TRUE;
+
+        redshiftgtk_redshift_wrapper_autostart_write (self);
+}
+
+/* Patch only the values of @profile that changed, the rest
+ * of the file keeps its bytes
+ */
+static void
+redshiftgtk_redshift_wrapper_apply_profile (RedshiftGtkRedshiftWrapper *self,
+                                            Profile                    *profile)
+{
+        gchar buffer[SETTING_FORMAT_SIZE];
+        Setting setting;
+
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+                const gdouble *value;
+
+                if (!(profile->dirty & (1u << setting)))
+                        continue;
+
+                /* Only what the user set goes to the user file, system
+                 * values and overrides stay where they are
+                 */
+                value = redshiftgtk_settings_layers_get_layer (profile->layers,
+                                                               CONFIG_LAYER_USER, setting);
+
+                redshiftgtk_config_document_set (redshiftgtk_redshift_wrapper_get_document (self),
+                                                 profile->group ? profile->group : info->group,
+                                                 info->key,
+                                                 value ? redshiftgtk_settings_schema_format (setting,
+                                                                                             value,
+                                                                                             buffer)
+                                                       : NULL);
+        }
+
+        profile->dirty = 0;
+}
+
+static void
+redshiftgtk_redshift_wrapper_apply_changes (RedshiftGtkBackend *backend,
+                                            GError            **error)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        RedshiftGtkConfigDocument *document;
+        GHashTableIter iter;
+        Profile *profile;
+        const gchar *data;
+        gsize length;
+
+        redshiftgtk_redshift_wrapper_apply_profile (self, &self->defaults);
+
+        g_hash_table_iter_init (&iter, self->profiles);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &profile))
+                redshiftgtk_redshift_wrapper_apply_profile (self, profile);
+
+        g_hash_table_iter_init (&iter, self->outputs);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &profile))
+                redshiftgtk_redshift_wrapper_apply_profile (self, profile);
+
+        document = redshiftgtk_redshift_wrapper_get_document (self);
+        if (!redshiftgtk_config_document_is_modified (document))
+                return;
+
+        /* One write to a temporary file, renamed over the old one */
+        data = redshiftgtk_config_document_get_data (document, &length);
+        if (!g_file_set_contents (self->config_path, data, length, error))
+                return;
+        redshiftgtk_metrics_count_write (length);
+
+        redshiftgtk_config_document_mark_saved (document);
+
+        /* What was just written is what is in memory, unless the file
+         * had changed behind our back before it was read
+         */
+        if (self->stamps) {
+                g_clear_pointer (&self->stamps, g_variant_unref);
+                self->stamps = redshiftgtk_redshift_wrapper_stamp_sources (self);
+                redshiftgtk_redshift_wrapper_save_cache (self, self->stamps);
+        }
+
+        g_signal_emit_by_name (self, "changed");
+}
+
+static const gchar*
+redshiftgtk_redshift_wrapper_method_name (AdjustmentMethod method)
+{
+        switch (method) {
+        case ADJUSTMENT_METHOD_RANDR:
+                return "randr";
+        case ADJUSTMENT_METHOD_VIDMODE:
+                return "vidmode";
+        default:
+                return NULL;
+        }
+}
+
+/* Neutral ramps on every output ourselves. FALSE where RandR can't
+ * be used, the caller falls back to a one-shot redshift.
+ */
+static gboolean
+redshiftgtk_redshift_wrapper_set_neutral (RedshiftGtkRedshiftWrapper *self)
+{
+        RedshiftGtkRandrGamma *randr = redshiftgtk_redshift_wrapper_get_randr (self);
+        g_autoptr (GError) error = NULL;
+
+        if (!randr || redshiftgtk_redshift_wrapper_get_adjustment_method (REDSHIFTGTK_BACKEND (self)) ==
+                      ADJUSTMENT_METHOD_VIDMODE)
+                return FALSE;
+
+        if (!redshiftgtk_randr_gamma_reset (randr, NULL, &error)) {
+                g_debug ("redshiftgtk_redshift_wrapper_set_neutral\n\
+        redshiftgtk_randr_gamma_reset: %s\n", error->message);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+/* Neutral ramps, for the method in use */
+static void
+redshiftgtk_redshift_wrapper_reset (RedshiftGtkRedshiftWrapper *self)
+{
+        const gchar *method;
+        g_autoptr (GSubprocess) reset = NULL;
 
-        return temperature;
+        if (redshiftgtk_redshift_wrapper_set_neutral (self))
+                return;
 
-default_temp:
-        if (period == TIME_PERIOD_DAY)
-                return DEFAULT_DAY_TEMPERATURE;
-        /* NIGHT */
-        return DEFAULT_NIGHT_TEMPERATURE;
+        method = redshiftgtk_redshift_wrapper_method_name (
+                redshiftgtk_redshift_wrapper_get_adjustment_method (REDSHIFTGTK_BACKEND (self)));
+        reset = redshiftgtk_spawn (G_SUBPROCESS_FLAGS_STDOUT_SILENCE |
+                                   G_SUBPROCESS_FLAGS_STDERR_SILENCE, NULL,
+                                   "redshift", "-x",
+                                   method ? "-m" : NULL, method,
+                                   NULL);
+        redshiftgtk_metrics_count (METRIC_SPAWNS, 1);
 }
 
 static void
-redshiftgtk_redshift_wrapper_set_temperature (RedshiftGtkBackend *backend,
-                                              TimePeriod          period,
-                                              gdouble             temperature)
+redshiftgtk_redshift_wrapper_preview_restore (RedshiftGtkRedshiftWrapper *self)
 {
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
-        const gchar* key;
+        redshiftgtk_redshift_wrapper_forget_ramps (self);
 
-        switch (period) {
-        case TIME_PERIOD_DAY:
-                key = "temp-day";
-                break;
-        case TIME_PERIOD_NIGHT:
-                key = "temp-night";
-                break;
-        default:
+        /* Let the regular instances take over again. They set
+         * their own ramps on their next update.
+         */
+        if (self->process || g_hash_table_size (self->instances) > 0) {
+                redshiftgtk_redshift_wrapper_signal (self, SIGCONT);
                 return;
         }
 
-        g_key_file_set_double (self->config, DEFAULT_SETTINGS_GROUP,
-                               key, temperature);
+        /* Nothing else is running, clear the preview */
+        redshiftgtk_redshift_wrapper_reset (self);
 }
 
-static LocationProvider
-redshiftgtk_redshift_wrapper_get_location_provider (RedshiftGtkBackend *backend)
+static void redshiftgtk_redshift_wrapper_preview_flush (RedshiftGtkRedshiftWrapper *self);
+
+/* Whether a preview with these arguments would change the ramps of
+ * any output. They are read back the way redshift reads them, what
+ * rounds to the same ramp is the same preview.
+ */
+static gboolean
+redshiftgtk_redshift_wrapper_preview_changes (RedshiftGtkRedshiftWrapper *self,
+                                              const gchar                *temperature,
+                                              const gchar                *brightness,
+                                              const gchar                *red,
+                                              const gchar                *green,
+                                              const gchar                *blue)
 {
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
+        GPtrArray *outputs = redshiftgtk_redshift_wrapper_get_connected (self);
+        gdouble gamma[3];
+        gboolean changed = FALSE;
+        guint i;
 
-        g_autoptr (GError) error = NULL;
-        g_autofree const gchar *provider;
+        gamma[0] = g_ascii_strtod (red, NULL);
+        gamma[1] = g_ascii_strtod (green, NULL);
+        gamma[2] = g_ascii_strtod (blue, NULL);
 
-        provider = g_key_file_get_string (self->config,
-                                          DEFAULT_SETTINGS_GROUP,
-                                          "location-provider", &error);
+        /* Without outputs to ask, one nominal screen stands for all */
+        if (outputs->len == 0) {
+                g_autoptr (RedshiftGtkRamp) ramp = redshiftgtk_ramp_new (PREVIEW_RAMP_SIZE);
 
-        if (error) {
-                g_debug ("redshiftgtk_redshift_wrapper_get_location_provider\n\
-        g_key_file_get_string: %s\n",
-                         error->message);
-                return LOCATION_PROVIDER_AUTO;
+                redshiftgtk_ramp_fill (ramp, g_ascii_strtod (temperature, NULL),
+                                       g_ascii_strtod (brightness, NULL), gamma);
+
+                return redshiftgtk_ramp_sink_offer (self->preview_ramps, "", ramp);
         }
 
-        if (g_strcmp0 (provider, "manual") == 0)
-                return LOCATION_PROVIDER_MANUAL;
+        /* Offered to every output, each remembers what it was sent */
+        for (i = 0; i < outputs->len; i++) {
+                RedshiftGtkOutput *output = g_ptr_array_index (outputs, i);
+                g_autoptr (RedshiftGtkRamp) ramp = redshiftgtk_ramp_new (output->ramp_size);
+
+                redshiftgtk_ramp_fill (ramp, g_ascii_strtod (temperature, NULL),
+                                       g_ascii_strtod (brightness, NULL), gamma);
+                if (redshiftgtk_ramp_sink_offer (self->preview_ramps, output->name, ramp))
+                        changed = TRUE;
+        }
 
-        return LOCATION_PROVIDER_AUTO;
+        return changed;
 }
 
 static void
-redshiftgtk_redshift_wrapper_set_location_provider (RedshiftGtkBackend *backend,
-                                                    LocationProvider    provider)
+redshiftgtk_redshift_wrapper_preview_wait_cb (GObject      *source_object,
+                                              GAsyncResult *result,
+                                              gpointer      user_data)
 {
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
-        gchar *provider_string = NULL;
+        g_autoptr (RedshiftGtkRedshiftWrapper) self = user_data;
+        g_autoptr (GError) error = NULL;
 
-        switch (provider) {
-        case LOCATION_PROVIDER_MANUAL:
-                provider_string = "manual";
-                break;
-        default:
-                provider_string = "geoclue2";
-        }
+        g_subprocess_wait_finish (G_SUBPROCESS (source_object), result, &error);
+        if (error)
+                g_debug ("redshiftgtk_redshift_wrapper_preview_wait_cb\n\
+        g_subprocess_wait_finish: %s\n", error->message);
+        redshiftgtk_trace_end (self->preview_spawned, "preview lifetime");
 
-        g_key_file_set_string (self->config, DEFAULT_SETTINGS_GROUP,
-                               "location-provider", provider_string);
+        g_clear_object (&self->preview_process);
+
+        if (self->previewing)
+                redshiftgtk_redshift_wrapper_preview_flush (self);
+        else
+                redshiftgtk_redshift_wrapper_preview_restore (self);
 }
 
-static gdouble
-redshiftgtk_redshift_wrapper_get_latitude (RedshiftGtkBackend *backend)
+/**
+ * Show the latest pending value with a one-shot redshift, so it
+ * looks the way Apply will. Only one of those runs at a time,
+ * values that arrive meanwhile replace each other and the newest
+ * one is sent once it exits.
+ */
+static void
+redshiftgtk_redshift_wrapper_preview_flush (RedshiftGtkRedshiftWrapper *self)
 {
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
-
+        RedshiftGtkBackend *backend = REDSHIFTGTK_BACKEND (self);
+        g_autoptr (GPtrArray) argv = NULL;
+        g_autoptr (GArray) gamma = NULL;
         g_autoptr (GError) error = NULL;
-        gdouble latitude = g_key_file_get_double (self->config,
-                                                  MANUAL_SETTINGS_GROUP,
-                                                  "lat", &error);
+        gchar temperature[G_ASCII_DTOSTR_BUF_SIZE];
+        gchar brightness[G_ASCII_DTOSTR_BUF_SIZE];
+        gchar red[G_ASCII_DTOSTR_BUF_SIZE];
+        gchar green[G_ASCII_DTOSTR_BUF_SIZE];
+        gchar blue[G_ASCII_DTOSTR_BUF_SIZE];
+        g_autofree gchar *gamma_string = NULL;
+        const gchar *method;
+
+        if (!self->preview_pending || self->preview_process)
+                return;
+
+        self->preview_pending = FALSE;
+
+        g_ascii_formatd (temperature, sizeof (temperature), "%.0f",
+                         self->preview_temperature);
+        g_ascii_formatd (brightness, sizeof (brightness), "%.2f",
+                         redshiftgtk_redshift_wrapper_get_brightness (backend,
+                                                                      self->preview_period));
+
+        gamma = redshiftgtk_redshift_wrapper_get_gamma (backend, self->preview_period);
+        g_ascii_formatd (red, sizeof (red), "%.2f",
+                         gamma ? g_array_index (gamma, gdouble, 0) : 1.0);
+        g_ascii_formatd (green, sizeof (green), "%.2f",
+                         gamma ? g_array_index (gamma, gdouble, 1) : 1.0);
+        g_ascii_formatd (blue, sizeof (blue), "%.2f",
+                         gamma ? g_array_index (gamma, gdouble, 2) : 1.0);
+        gamma_string = g_strjoin (":", red, green, blue, NULL);
+
+        /* Already on screen, a slider that moved less than a Kelvin */
+        if (!redshiftgtk_redshift_wrapper_preview_changes (self, temperature, brightness,
+                                                           red, green, blue))
+                return;
+
+        /* -P resets the current ramps so previews don't stack up */
+        argv = g_ptr_array_new ();
+        g_ptr_array_add (argv, "redshift");
+        g_ptr_array_add (argv, "-P");
+        g_ptr_array_add (argv, "-O");
+        g_ptr_array_add (argv, temperature);
+        g_ptr_array_add (argv, "-b");
+        g_ptr_array_add (argv, brightness);
+        g_ptr_array_add (argv, "-g");
+        g_ptr_array_add (argv, gamma_string);
+
+        method = redshiftgtk_redshift_wrapper_method_name (
+                redshiftgtk_redshift_wrapper_get_adjustment_method (backend));
+        if (method) {
+                g_ptr_array_add (argv, "-m");
+                g_ptr_array_add (argv, (gpointer) method);
+        }
+        g_ptr_array_add (argv, NULL);
+
+        self->preview_spawned = redshiftgtk_trace_begin ();
+        self->preview_process = redshiftgtk_spawnv ((const gchar * const *) argv->pdata,
+                                                    G_SUBPROCESS_FLAGS_STDOUT_SILENCE |
+                                                    G_SUBPROCESS_FLAGS_STDERR_SILENCE,
+                                                    &error);
+        redshiftgtk_trace_end (self->preview_spawned, "spawn preview");
+        redshiftgtk_metrics_count (METRIC_SPAWNS, 1);
 
         if (error) {
-                g_debug ("redshiftgtk_redshift_wrapper_get_latitude\n\
-        g_key_file_get_double: %s\n",
-                         error->message);
-                return 0;
+                g_warning ("redshiftgtk_redshift_wrapper_preview_flush\n\
+        redshiftgtk_spawnv: %s\n", error->message);
+                redshiftgtk_ramp_sink_forget (self->preview_ramps, NULL);
+                return;
         }
 
-        return latitude;
+        g_subprocess_wait_async (self->preview_process, NULL,
+                                 redshiftgtk_redshift_wrapper_preview_wait_cb,
+                                 g_object_ref (self));
 }
 
 static void
-redshiftgtk_redshift_wrapper_set_latitude (RedshiftGtkBackend *backend,
-                                           gdouble             latitude)
+redshiftgtk_redshift_wrapper_preview_temperature (RedshiftGtkBackend *backend,
+                                                  TimePeriod          period,
+                                                  gdouble             temperature)
 {
         RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
 
-        g_key_file_set_string (self->config, MANUAL_SETTINGS_GROUP,
-                               "lat", g_strdup_printf ("%.2f", latitude));
+        if (!self->previewing) {
+                /* Keep the running instances from fighting over the ramps */
+                redshiftgtk_redshift_wrapper_signal (self, SIGSTOP);
+                self->previewing = TRUE;
+        }
+
+        /* Only the latest value is worth showing */
+        self->preview_period = period;
+        self->preview_temperature = CLAMP (temperature,
+                                           redshiftgtk_settings_schema_lookup (SETTING_TEMP_DAY)->minimum,
+                                           redshiftgtk_settings_schema_lookup (SETTING_TEMP_DAY)->maximum);
+        self->preview_pending = TRUE;
+
+        redshiftgtk_redshift_wrapper_preview_flush (self);
 }
 
-static gdouble
-redshiftgtk_redshift_wrapper_get_longtitude (RedshiftGtkBackend *backend)
+static void
+redshiftgtk_redshift_wrapper_end_preview (RedshiftGtkBackend *backend)
 {
         RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
 
-        g_autoptr (GError) error = NULL;
-        gdouble longtitude = g_key_file_get_double (self->config,
-                                                    MANUAL_SETTINGS_GROUP,
-                                                    "lon", &error);
+        if (!self->previewing)
+                return;
 
-        if (error) {
-                g_debug ("redshiftgtk_redshift_wrapper_get_longtitude\n\
-        g_key_file_get_double: %s\n",
-                         error->message);
-                return 0;
-        }
+        self->previewing = FALSE;
+        self->preview_pending = FALSE;
 
-        return longtitude;
+        /* Restore once the in-flight preview is done, otherwise
+         * it would land on top of the restored ramps
+         */
+        if (!self->preview_process)
+                redshiftgtk_redshift_wrapper_preview_restore (self);
 }
 
-static void
-redshiftgtk_redshift_wrapper_set_longtitude (RedshiftGtkBackend *backend,
-                                             gdouble             longtitude)
+static gint
+redshiftgtk_redshift_wrapper_compare_names (gconstpointer a,
+                                            gconstpointer b)
 {
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
-
-        g_key_file_set_string (self->config, MANUAL_SETTINGS_GROUP,
-                               "lon", g_strdup_printf ("%.2f", longtitude));
+        return g_strcmp0 (*(const gchar **) a, *(const gchar **) b);
 }
 
-static gdouble
-redshiftgtk_redshift_wrapper_get_brightness (RedshiftGtkBackend *backend,
-                                             TimePeriod          period)
+static gchar**
+redshiftgtk_redshift_wrapper_list_profiles (RedshiftGtkBackend *backend)
 {
         RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
-        const gchar* key;
+        GPtrArray *names;
+        GHashTableIter iter;
+        Profile *profile;
 
-        switch (period) {
-        case TIME_PERIOD_DAY:
-                key = "brightness-day";
-                break;
-        case TIME_PERIOD_NIGHT:
-                key = "brightness-night";
-                break;
-        default:
-                return DEFAULT_BRIGHTNESS;
-        }
+        names = g_ptr_array_sized_new (g_hash_table_size (self->profiles) + 1);
 
-        g_autoptr (GError) error = NULL;
-        gdouble brightness = g_key_file_get_double (self->config,
-                                                    DEFAULT_SETTINGS_GROUP,
-                                                    key, &error);
+        g_hash_table_iter_init (&iter, self->profiles);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &profile))
+                g_ptr_array_add (names, g_strdup (profile->name));
 
-        if (error) {
-                g_debug ("redshiftgtk_redshift_wrapper_get_brightness\n\
-        g_key_file_get_double: %s\n",
-                         error->message);
-                return DEFAULT_BRIGHTNESS;
-        }
+        g_ptr_array_sort (names, redshiftgtk_redshift_wrapper_compare_names);
+        g_ptr_array_add (names, NULL);
 
-        if (brightness < MIN_BRIGHTNESS || brightness > MAX_BRIGHTNESS)
-                return DEFAULT_BRIGHTNESS;
+        return (gchar **) g_ptr_array_free (names, FALSE);
+}
 
-        return brightness;
+static const gchar*
+redshiftgtk_redshift_wrapper_get_profile (RedshiftGtkBackend *backend)
+{
+        return REDSHIFTGTK_REDSHIFT_WRAPPER (backend)->active->name;
 }
 
-static void
-redshiftgtk_redshift_wrapper_set_brightness (RedshiftGtkBackend *backend,
-                                             TimePeriod          period,
-                                             gdouble             brightness)
+static gboolean
+redshiftgtk_redshift_wrapper_profile_name_is_valid (const gchar *name)
 {
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
-        const gchar* key;
+        const gchar *c;
 
-        switch (period) {
-        case TIME_PERIOD_DAY:
-                key = "brightness-day";
-                break;
-        case TIME_PERIOD_NIGHT:
-                key = "brightness-night";
-                break;
-        default:
-                return;
+        /* Has to survive as part of a key file group header */
+        for (c = name; *c; c++) {
+                if (*c == '[' || *c == ']' || g_ascii_iscntrl (*c))
+                        return FALSE;
         }
 
-        g_key_file_set_string (self->config, DEFAULT_SETTINGS_GROUP,
-                               key, g_strdup_printf ("%.1f", brightness));
+        return g_utf8_validate (name, -1, NULL);
 }
 
-static GArray*
-redshiftgtk_redshift_wrapper_get_gamma (RedshiftGtkBackend *backend,
-                                        TimePeriod          period)
+static void
+redshiftgtk_redshift_wrapper_switch_profile (RedshiftGtkBackend *backend,
+                                             const gchar        *name,
+                                             GError            **error)
 {
         RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
+        Profile *profile = &self->defaults;
+        Setting setting;
 
-        GArray *gamma = NULL;
-        const gchar *gamma_string, *key;
-        gdouble gamma_double, red, green, blue;
-        g_autoptr (GError) error = NULL;
-        g_auto (GStrv) gamma_parts = NULL;
+        if (name && *name) {
+                if (!redshiftgtk_redshift_wrapper_profile_name_is_valid (name)) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                                     _("Invalid profile name \"%s\""), name);
+                        return;
+                }
 
-        switch (period) {
-        case TIME_PERIOD_DAY:
-                key = "gamma-day";
-                break;
-        case TIME_PERIOD_NIGHT:
-                key = "gamma-night";
-                break;
-        default:
-                return NULL;
+                profile = redshiftgtk_redshift_wrapper_profile_lookup (self->profiles, name);
+
+                /* New profiles start out as a copy of what is active now,
+                 * every key of them still has to be written. Overrides are
+                 * dropped first, they are meant to go away.
+                 */
+                if (!profile) {
+                        for (setting = 0; setting < N_SETTINGS; setting++)
+                                redshiftgtk_settings_layers_unset (self->active->layers,
+                                                                   CONFIG_LAYER_RUNTIME, setting);
+
+                        profile = redshiftgtk_redshift_wrapper_profile_new (PROFILE_GROUP_PREFIX, name);
+                        for (setting = 0; setting < N_SETTINGS; setting++)
+                                redshiftgtk_settings_layers_set (profile->layers,
+                                                                 CONFIG_LAYER_USER, setting,
+                                                                 redshiftgtk_redshift_wrapper_value (self, setting));
+                        profile->dirty = ALL_SETTINGS;
+                        redshiftgtk_redshift_wrapper_profile_insert (self->profiles, profile);
+                }
         }
 
-        gamma = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), 3);
+        if (profile == self->active)
+                return;
 
-        /* Try to retrieve the gamma in number format (gamma = 1.0) */
-        gamma_double = g_key_file_get_double (self->config,
-                                              DEFAULT_SETTINGS_GROUP,
-                                              key, &error);
+        /* Nothing to parse, the values are all there already */
+        self->active = profile;
 
-        /* If it is indeed single double value, return now */
-        if (!error) {
-                if (gamma_double < MIN_GAMMA || gamma_double > MAX_GAMMA)
-                        return NULL;
+        /* The ramps follow right away if redshift is running */
+        if (redshiftgtk_redshift_wrapper_is_running (backend))
+                redshiftgtk_redshift_wrapper_start (backend, error);
 
-                g_array_append_val (gamma, gamma_double);
-                g_array_append_val (gamma, gamma_double);
-                g_array_append_val (gamma, gamma_double);
+        g_signal_emit_by_name (self, "changed");
+}
 
-                return gamma;
+static void
+redshiftgtk_redshift_wrapper_set_override (RedshiftGtkBackend *backend,
+                                           const gchar        *key,
+                                           const gchar        *value,
+                                           GError            **error)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        RedshiftGtkSettingsLayers *layers = self->active->layers;
+        SettingValue parsed;
+        Setting setting;
+        gboolean changed;
+
+        if (!redshiftgtk_settings_schema_find (key, &setting)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                             _("Unknown setting “%s”"), key);
+                return;
         }
-        /* Otherwise continue to R:G:B string format */
-
-        /* Reset error pointer */
-        g_clear_error (&error);
 
-        /* Get the gamma in R:G:B string format */
-        gamma_string = g_key_file_get_string (self->config,
-                                              DEFAULT_SETTINGS_GROUP,
-                                              key, &error);
+        if (value) {
+                if (!redshiftgtk_settings_schema_parse_value (setting, value, parsed)) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                                     _("“%s” is not a valid value for %s"), value, key);
+                        return;
+                }
 
-        if (error) {
-                g_debug ("redshiftgtk_redshift_wrapper_get_gamma\n\
-        g_key_file_get_string: %s\n", error->message);
-                return NULL;
+                changed = redshiftgtk_settings_layers_set (layers, CONFIG_LAYER_RUNTIME,
+                                                           setting, parsed);
+        } else {
+                changed = redshiftgtk_settings_layers_unset (layers, CONFIG_LAYER_RUNTIME,
+                                                             setting);
         }
 
-        g_return_val_if_fail (strstr (gamma_string, ":") != NULL, NULL);
+        /* Never dirty, overrides don't get saved */
+        if (changed)
+                g_signal_emit_by_name (self, "changed");
+}
 
-        /* Split our R:G:B string into parts */
-        gamma_parts = g_strsplit (gamma_string, ":", 3);
-        g_return_val_if_fail (gamma_parts != NULL, NULL);
+static ConfigLayer
+redshiftgtk_redshift_wrapper_get_source (RedshiftGtkBackend *backend,
+                                         const gchar        *key)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        Setting setting;
 
-        /* Make sure we have 3 values */
-        int parts = -1;
-        while (gamma_parts[++parts] != NULL);
-        g_return_val_if_fail (parts == 3, NULL);
+        if (!redshiftgtk_settings_schema_find (key, &setting))
+                return CONFIG_LAYER_DEFAULT;
 
-        /* Convert our strings to doubles */
-        sscanf (gamma_parts[0], "%lf", &red);
-        sscanf (gamma_parts[1], "%lf", &green);
-        sscanf (gamma_parts[2], "%lf", &blue);
+        return redshiftgtk_settings_layers_get_source (self->active->layers, setting);
+}
 
-        if (red < MIN_GAMMA || red > MAX_GAMMA)
-                red = 1.00;
-        if (green < MIN_GAMMA || green > MAX_GAMMA)
-                green = 1.00;
-        if (blue < MIN_GAMMA || blue > MAX_GAMMA)
-                blue = 1.00;
+static gint
+redshiftgtk_redshift_wrapper_find_pid (GArray *pids,
+                                       GPid    pid)
+{
+        guint i;
 
-        /* Add to array */
-        g_array_append_val (gamma, red);
-        g_array_append_val (gamma, green);
-        g_array_append_val (gamma, blue);
+        for (i = 0; i < pids->len; i++) {
+                if (g_array_index (pids, GPid, i) == pid)
+                        return i;
+        }
 
-        return gamma;
+        return -1;
 }
 
-static void
-redshiftgtk_redshift_wrapper_set_gamma (RedshiftGtkBackend *backend,
-                                        TimePeriod          period,
-                                        gdouble             red,
-                                        gdouble             green,
-                                        gdouble             blue)
+static gboolean
+redshiftgtk_redshift_wrapper_is_adopted (RedshiftGtkRedshiftWrapper *self,
+                                         GPid                        pid)
 {
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
-        const gchar *key;
+        return redshiftgtk_redshift_wrapper_find_pid (self->adopted, pid) >= 0;
+}
 
-        switch (period) {
-        case TIME_PERIOD_DAY:
-                key = "gamma-day";
-                break;
-        case TIME_PERIOD_NIGHT:
-                key = "gamma-night";
-                break;
-        default:
-                return;
-        }
+/* The arguments after redshift itself, NULL if @process isn't one.
+ * The session may give redshift's full path, or an interpreter in
+ * front of it.
+ */
+static gchar**
+redshiftgtk_redshift_wrapper_get_arguments (const RedshiftGtkProcess *process)
+{
+        g_auto (GStrv) arguments = NULL;
+        guint i;
+
+        if (g_strcmp0 (process->name, "redshift") != 0)
+                return NULL;
+
+        arguments = g_strsplit (process->cmdline, " ", -1);
+        for (i = 0; arguments[i]; i++) {
+                g_autofree gchar *basename = g_path_get_basename (arguments[i]);
 
-        /* R:G:B */
-        const gchar *gamma = g_strdup_printf ("%.1f:%.1f:%.1f", red, green, blue);
+                if (g_strcmp0 (basename, "redshift") == 0)
+                        return g_strdupv (arguments + i + 1);
+        }
 
-        g_key_file_set_string (self->config, DEFAULT_SETTINGS_GROUP,
-                               key, gamma);
+        return NULL;
 }
 
-static AdjustmentMethod
-redshiftgtk_redshift_wrapper_get_adjustment_method (RedshiftGtkBackend *backend)
+/* One of the files redshiftgtk_redshift_wrapper_spawn() is given */
+static gboolean
+redshiftgtk_redshift_wrapper_is_own_config (RedshiftGtkRedshiftWrapper *self,
+                                            const gchar                *path)
 {
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
+        g_autofree gchar *directory = NULL;
+        g_autofree gchar *name = NULL;
+        g_autofree gchar *expected = NULL;
+        guint crtc;
 
-        g_autoptr (GError) error = NULL;
-        gchar *method = g_key_file_get_string (self->config,
-                                               DEFAULT_SETTINGS_GROUP,
-                                               "adjustment-method", &error);
+        if (g_strcmp0 (path, self->config_path) == 0)
+                return TRUE;
 
-        if (error) {
-                g_debug ("redshiftgtk_redshift_wrapper_get_adjustment_method\n\
-        g_key_file_get_string: %s\n",
-                         error->message);
-                return ADJUSTMENT_METHOD_AUTO;
-        }
+        directory = g_path_get_dirname (path);
+        if (g_strcmp0 (directory, g_get_user_runtime_dir ()) != 0)
+                return FALSE;
+
+        name = g_path_get_basename (path);
+        if (g_strcmp0 (name, "redshiftgtk-runtime.conf") == 0)
+                return TRUE;
 
-        if (g_strcmp0 (method, "randr") == 0)
-                return ADJUSTMENT_METHOD_RANDR;
-        else if (g_strcmp0 (method, "vidmode") == 0)
-                return ADJUSTMENT_METHOD_VIDMODE;
+        if (sscanf (name, "redshiftgtk-runtime-crtc%u", &crtc) != 1)
+                return FALSE;
+        expected = g_strdup_printf ("redshiftgtk-runtime-crtc%u.conf", crtc);
 
-        /* Fallback to auto */
-        return ADJUSTMENT_METHOD_AUTO;
+        return g_strcmp0 (name, expected) == 0;
 }
 
-static void
-redshiftgtk_redshift_wrapper_set_adjustment_method (RedshiftGtkBackend *backend,
-                                                    AdjustmentMethod    method)
+/* Whether @process runs what our launcher runs, or what an earlier
+ * RedshiftGtk spawned: redshift [-r] -c with one of our files
+ */
+static gboolean
+redshiftgtk_redshift_wrapper_is_ours (RedshiftGtkRedshiftWrapper *self,
+                                      const RedshiftGtkProcess   *process)
 {
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
-        const gchar *method_string;
+        g_autofree gchar *exec = NULL;
+        g_autofree gchar *expected = NULL;
+        g_autofree gchar *rest = NULL;
+        g_auto (GStrv) exec_argv = NULL;
+        g_auto (GStrv) arguments = NULL;
+        guint i = 0;
+
+        arguments = redshiftgtk_redshift_wrapper_get_arguments (process);
+        if (!arguments)
+                return FALSE;
 
-        switch (method) {
-        case ADJUSTMENT_METHOD_RANDR:
-                method_string = "randr";
-                break;
-        case ADJUSTMENT_METHOD_VIDMODE:
-                method_string = "vidmode";
-                break;
-        default:
-                g_key_file_remove_key (self->config, DEFAULT_SETTINGS_GROUP,
-                                       "adjustment-method", NULL);
-                return;
-        }
+        if (g_strcmp0 (arguments[i], "-r") == 0)
+                i++;
+        if (g_strcmp0 (arguments[i], "-c") == 0 && arguments[i + 1] && !arguments[i + 2] &&
+            redshiftgtk_redshift_wrapper_is_own_config (self, arguments[i + 1]))
+                return TRUE;
 
-        g_key_file_set_string (self->config, DEFAULT_SETTINGS_GROUP,
-                               "adjustment-method", method_string);
+        exec = redshiftgtk_redshift_wrapper_autostart_exec (self);
+        if (!g_shell_parse_argv (exec, NULL, &exec_argv, NULL))
+                return FALSE;
+        expected = g_strjoinv (" ", exec_argv + 1);
+        rest = g_strjoinv (" ", arguments);
+
+        return g_strcmp0 (rest, expected) == 0;
 }
 
+/* Started or adopted by us */
 static gboolean
-redshiftgtk_redshift_wrapper_get_smooth_transition (RedshiftGtkBackend *backend)
+redshiftgtk_redshift_wrapper_is_own (RedshiftGtkRedshiftWrapper *self,
+                                     GPid                        pid)
 {
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
-        g_autoptr (GError) error = NULL;
+        GHashTableIter iter;
+        OutputInstance *instance;
 
-        gboolean transition = g_key_file_get_double (self->config,
-                                                    DEFAULT_SETTINGS_GROUP,
-                                                    "fade", &error);
+        if (pid == redshiftgtk_redshift_wrapper_get_pid (self->process))
+                return TRUE;
 
-        if (error) {
-                g_debug ("redshiftgtk_redshift_wrapper_get_smooth_transition\n\
-        g_key_file_get_double: %s\n",
-                         error->message);
-                return DEFAULT_SMOOTH_TRANSITION;
+        g_hash_table_iter_init (&iter, self->instances);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &instance)) {
+                if (pid == redshiftgtk_redshift_wrapper_get_pid (instance->process))
+                        return TRUE;
         }
 
-        return transition;
+        return redshiftgtk_redshift_wrapper_is_adopted (self, pid);
 }
 
-static void
-redshiftgtk_redshift_wrapper_set_smooth_transition (RedshiftGtkBackend *backend,
-                                                    gboolean            transition)
+static GPtrArray*
+redshiftgtk_redshift_wrapper_list_foreign (RedshiftGtkBackend *backend)
 {
         RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
+        GPtrArray *processes = redshiftgtk_process_scan_get (self->scan);
+        GPtrArray *foreign = g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_process_free);
+        guint i;
 
-        g_key_file_set_integer (self->config, DEFAULT_SETTINGS_GROUP,
-                                "fade", transition);
-}
+        for (i = 0; i < processes->len; i++) {
+                RedshiftGtkProcess *process = g_ptr_array_index (processes, i);
 
-static gboolean
-redshiftgtk_redshift_wrapper_get_autostart (RedshiftGtkBackend *self)
-{
-        g_autoptr (GFile) file = NULL;
-        g_autoptr (GError) error = NULL;
-        const gchar *user_config_path = NULL;
-        g_autofree gchar *launcher = NULL;
+                /* Ours, whether start or stop adopted it yet or not */
+                if (redshiftgtk_redshift_wrapper_is_own (self, process->pid) ||
+                    redshiftgtk_redshift_wrapper_is_ours (self, process))
+                        continue;
 
-        user_config_path = g_get_user_config_dir ();
-        if (!user_config_path)
-                return FALSE;
+                g_ptr_array_add (foreign, redshiftgtk_process_copy (process));
+        }
 
-        launcher = g_build_filename (user_config_path,
-                                     "autostart",
-                                     "redshiftgtk.desktop",
-                                     NULL);
+        return foreign;
+}
 
-        file = g_file_new_for_path (launcher);
+/**
+ * Take over what our launcher or an earlier RedshiftGtk started, so
+ * that stop ends it and start replaces it instead of running next to
+ * it. Returns whether it found any.
+ */
+static gboolean
+redshiftgtk_redshift_wrapper_adopt_ours (RedshiftGtkRedshiftWrapper *self)
+{
+        GPtrArray *processes = redshiftgtk_process_scan_get (self->scan);
+        gboolean found = FALSE;
+        guint i;
 
-        if (!g_file_query_exists (file, NULL))
-                return FALSE;
+        for (i = 0; i < processes->len; i++) {
+                RedshiftGtkProcess *process = g_ptr_array_index (processes, i);
 
-        GKeyFile *desktop = g_key_file_new ();
-        g_key_file_load_from_file (desktop,
-                                   launcher,
-                                   G_KEY_FILE_NONE, &error);
+                if (redshiftgtk_redshift_wrapper_is_own (self, process->pid))
+                        continue;
+                if (!redshiftgtk_redshift_wrapper_is_ours (self, process))
+                        continue;
 
-        if (error) {
-                g_debug ("redshiftgtk_redshift_wrapper_get_autostart\n\
-        g_key_file_load_from_file: %s\n", error->message);
-                return FALSE;
+                g_array_append_val (self->adopted, process->pid);
+                found = TRUE;
         }
 
-        g_autofree gchar *value = g_key_file_get_string (desktop,
-                                                         "Desktop Entry",
-                                                         "Hidden",
-                                                         &error);
+        if (found)
+                self->redshift_state = REDSHIFT_STATE_RUNNING;
 
-        if (!error) {
-                /* Return true if Hidden is false */
-                return (g_strcmp0 (value, "false") == 0);
-        } else {
-                g_debug ("redshiftgtk_redshift_wrapper_get_autostart\n\
-        g_key_file_get_string: %s\n", error->message);
-        }
+        return found;
+}
 
-        value = g_key_file_get_string (desktop,
-                                       "Desktop Entry",
-                                       "X-GNOME-Autostart-enabled",
-                                       &error);
+static gboolean
+redshiftgtk_redshift_wrapper_is_foreign (RedshiftGtkRedshiftWrapper *self,
+                                         GPid                        pid)
+{
+        g_autoptr (GPtrArray) foreign = NULL;
+        guint i;
 
-        if (!error) {
-                /* Return true if X-GNOME-Autostart-enabled is true */
-                return (g_strcmp0 (value, "false") == 0);
-        } else {
-                g_debug ("redshiftgtk_redshift_wrapper_get_autostart\n\
-        g_key_file_get_string: %s\n", error->message);
+        foreign = redshiftgtk_redshift_wrapper_list_foreign (REDSHIFTGTK_BACKEND (self));
+        for (i = 0; i < foreign->len; i++) {
+                if (((RedshiftGtkProcess *) g_ptr_array_index (foreign, i))->pid == pid)
+                        return TRUE;
         }
 
-        /* We couldn't get either of the keys. Default to FALSE */
         return FALSE;
 }
 
 static void
-redshiftgtk_redshift_wrapper_autostart_file_create_cb (GObject *source_object,
-                                                       GAsyncResult *result,
-                                                       gpointer user_data)
+redshiftgtk_redshift_wrapper_adopt (RedshiftGtkBackend *backend,
+                                    GPid                pid,
+                                    GError            **error)
 {
-        g_autoptr (GFile) file = NULL;
-        g_autoptr (GFileOutputStream) stream = NULL;
-        g_autoptr (GDataOutputStream) output = NULL;
-        g_autoptr (GError) error = NULL;
-        gboolean autostart = FALSE;
-        const gchar *autostart_value = NULL;
-        const gchar *hidden_value = NULL;
-
-        file = G_FILE (source_object);
-        autostart = GPOINTER_TO_INT (user_data);
-        stream = g_file_create_finish (file, result, &error);
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        gint index;
 
-        if (error) {
-                g_warning ("redshiftgtk_redshift_wrapper_set_autostart_file_create\n\
-        g_file_create_finish: %s\n", error->message);
+        if (redshiftgtk_redshift_wrapper_is_adopted (self, pid))
                 return;
+
+        /* It may have started since the last scan, or be one of
+         * ours that was never foreign in the first place
+         */
+        if (!redshiftgtk_redshift_wrapper_is_foreign (self, pid)) {
+                redshiftgtk_process_scan_invalidate (self->scan);
+                redshiftgtk_redshift_wrapper_adopt_ours (self);
+                if (!redshiftgtk_redshift_wrapper_is_foreign (self, pid)) {
+                        if (redshiftgtk_redshift_wrapper_is_adopted (self, pid))
+                                return;
+
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                                     _("No redshift instance with process ID %d"), pid);
+                        return;
+                }
         }
 
-        hidden_value = (autostart) ? "false" : "true";
-        autostart_value = (autostart) ? "true" : "false";
+        g_array_append_val (self->adopted, pid);
 
-        output = g_data_output_stream_new (G_OUTPUT_STREAM (stream));
-        g_data_output_stream_put_string (output, g_strdup_printf ("[Desktop Entry]\n\
-Name=RedshiftGtkAutostart\n\
-Exec=redshift\n\
-Type=Application\n\
-Hidden=%s\n\
-X-GNOME-Autostart-enabled=%s", hidden_value, autostart_value), NULL, &error);
+        index = redshiftgtk_redshift_wrapper_find_pid (self->left_alone, pid);
+        if (index >= 0)
+                g_array_remove_index_fast (self->left_alone, index);
 
-        if (error) {
-                g_warning ("redshiftgtk_redshift_wrapper_set_autostart_file_create\n\
-        g_data_output_stream_put_string: %s\n", error->message);
-                g_file_delete (file, NULL, NULL);
-        }
+        /* It runs for us now, stop and apply take care of it */
+        self->redshift_state = REDSHIFT_STATE_RUNNING;
 }
 
 static void
-redshiftgtk_redshift_wrapper_set_autostart (RedshiftGtkBackend *self,
-                                            gboolean            autostart,
-                                            GError            **error)
+redshiftgtk_redshift_wrapper_leave (RedshiftGtkBackend *backend,
+                                    GPid                pid)
 {
-        GFile *file = NULL;
-        const gchar *user_config_path = NULL;
-        g_autofree gchar *launcher = NULL;
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
 
-        user_config_path = g_get_user_config_dir ();
-        if (!user_config_path)
+        /* Ours can't be left, and one that was adopted stays adopted */
+        if (!redshiftgtk_redshift_wrapper_is_foreign (self, pid))
                 return;
 
-        launcher = g_build_filename (user_config_path,
-                                     "autostart",
-                                     "redshiftgtk.desktop",
-                                     NULL);
+        if (redshiftgtk_redshift_wrapper_find_pid (self->left_alone, pid) < 0)
+                g_array_append_val (self->left_alone, pid);
+}
+
+static GPtrArray*
+redshiftgtk_redshift_wrapper_list_outputs (RedshiftGtkBackend *backend)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        GPtrArray *connected = redshiftgtk_redshift_wrapper_get_connected (self);
+        GPtrArray *outputs;
+        guint i;
 
-        file = g_file_new_for_path (launcher);
+        outputs = g_ptr_array_new_full (connected->len, (GDestroyNotify) redshiftgtk_output_free);
+        for (i = 0; i < connected->len; i++)
+                g_ptr_array_add (outputs, redshiftgtk_output_copy (g_ptr_array_index (connected, i)));
 
-        if (g_file_query_exists (file, NULL)) {
-                GKeyFile *desktop = g_key_file_new ();
-                g_key_file_load_from_file (desktop,
-                                           launcher,
-                                           G_KEY_FILE_NONE, error);
+        return outputs;
+}
 
-                if (*error)
-                        return;
+static gchar*
+redshiftgtk_redshift_wrapper_get_output_setting (RedshiftGtkBackend *backend,
+                                                 const gchar        *output,
+                                                 const gchar        *key)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        gchar buffer[SETTING_FORMAT_SIZE];
+        Profile *settings;
+        Setting setting;
+
+        settings = redshiftgtk_redshift_wrapper_profile_lookup (self->outputs, output);
+        if (!settings || !redshiftgtk_settings_schema_find (key, &setting) ||
+            !redshiftgtk_settings_schema_is_per_output (setting) ||
+            redshiftgtk_settings_layers_get_source (settings->layers, setting) == CONFIG_LAYER_DEFAULT)
+                return NULL;
 
-                if (autostart) {
-                        g_key_file_set_string (desktop,
-                                                "Desktop Entry",
-                                                "Hidden",
-                                                "false");
-                        g_key_file_set_string (desktop,
-                                                "Desktop Entry",
-                                                "X-GNOME-Autostart-enabled",
-                                                "true");
-                } else {
-                        g_key_file_set_string (desktop,
-                                                "Desktop Entry",
-                                                "Hidden",
-                                                "true");
-                        g_key_file_set_string (desktop,
-                                                "Desktop Entry",
-                                                "X-GNOME-Autostart-enabled",
-                                                "false");
-                }
+        return g_strdup (redshiftgtk_settings_schema_format (setting,
+                                                             redshiftgtk_settings_layers_get (settings->layers,
+                                                                                              setting),
+                                                             buffer));
+}
 
-                g_key_file_save_to_file (desktop, launcher, error);
+static void
+redshiftgtk_redshift_wrapper_set_output_setting (RedshiftGtkBackend *backend,
+                                                 const gchar        *output,
+                                                 const gchar        *key,
+                                                 const gchar        *value,
+                                                 GError            **error)
+{
+        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
+        Profile *settings;
+        SettingValue parsed;
+        Setting setting;
+        gboolean changed;
+
+        if (*output == '\0' || !redshiftgtk_redshift_wrapper_profile_name_is_valid (output)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                             _("Invalid output name \"%s\""), output);
+                return;
+        }
 
-                /* It already exists, don't write into it again */
+        if (!redshiftgtk_settings_schema_find (key, &setting)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                             _("Unknown setting “%s”"), key);
                 return;
         }
 
-        /* Make sure ~/.config/autostart exists */
-        if (g_mkdir_with_parents (g_path_get_dirname (launcher), 0775) == -1) {
-                int errsv = errno;
-                g_set_error (error, G_IO_ERROR,
-                             g_io_error_from_errno (errsv),
-                             _("Could not create parent directories: %s"),
-                             g_strerror (errsv));
+        if (!redshiftgtk_settings_schema_is_per_output (setting)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                             _("%s is the same for every output"), key);
                 return;
         }
 
-        g_file_create_async (file,
-                             G_FILE_CREATE_NONE,
-                             G_PRIORITY_DEFAULT,
-                             NULL,
-                             redshiftgtk_redshift_wrapper_autostart_file_create_cb,
-                             GINT_TO_POINTER (autostart));
-}
+        if (value && !redshiftgtk_settings_schema_parse_value (setting, value, parsed)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                             _("“%s” is not a valid value for %s"), value, key);
+                return;
+        }
 
-static void
-redshiftgtk_redshift_wrapper_apply_changes (RedshiftGtkBackend *backend,
-                                            GError            **error)
-{
-        RedshiftGtkRedshiftWrapper *self = REDSHIFTGTK_REDSHIFT_WRAPPER (backend);
-        g_assert (self->config != NULL);
+        settings = redshiftgtk_redshift_wrapper_profile_lookup (self->outputs, output);
+        if (!settings) {
+                if (!value)
+                        return;
+
+                settings = redshiftgtk_redshift_wrapper_profile_new (OUTPUT_GROUP_PREFIX, output);
+                redshiftgtk_redshift_wrapper_profile_insert (self->outputs, settings);
+        }
+
+        if (value)
+                changed = redshiftgtk_settings_layers_set (settings->layers, CONFIG_LAYER_USER,
+                                                           setting, parsed);
+        else
+                changed = redshiftgtk_settings_layers_unset (settings->layers, CONFIG_LAYER_USER,
+                                                             setting);
 
-        g_key_file_save_to_file (self->config, self->config_path, error);
+        /* Written on apply like everything else */
+        settings->dirty |= 1u << setting;
+
+        if (changed)
+                g_signal_emit_by_name (self, "changed");
 }
 
 /* Connect our methods to the interface */
@@ -805,6 +2835,7 @@ redshiftgtk_backend_iface_init (RedshiftGtkBackendInterface *iface)
 {
         iface->start = redshiftgtk_redshift_wrapper_start;
         iface->stop = redshiftgtk_redshift_wrapper_stop;
+        iface->is_running = redshiftgtk_redshift_wrapper_is_running;
         iface->get_temperature = redshiftgtk_redshift_wrapper_get_temperature;
         iface->set_temperature = redshiftgtk_redshift_wrapper_set_temperature;
         iface->get_location_provider = redshiftgtk_redshift_wrapper_get_location_provider;
@@ -824,6 +2855,19 @@ redshiftgtk_backend_iface_init (RedshiftGtkBackendInterface *iface)
         iface->get_autostart = redshiftgtk_redshift_wrapper_get_autostart;
         iface->set_autostart = redshiftgtk_redshift_wrapper_set_autostart;
         iface->apply_changes = redshiftgtk_redshift_wrapper_apply_changes;
+        iface->preview_temperature = redshiftgtk_redshift_wrapper_preview_temperature;
+        iface->end_preview = redshiftgtk_redshift_wrapper_end_preview;
+        iface->list_profiles = redshiftgtk_redshift_wrapper_list_profiles;
+        iface->get_profile = redshiftgtk_redshift_wrapper_get_profile;
+        iface->switch_profile = redshiftgtk_redshift_wrapper_switch_profile;
+        iface->set_override = redshiftgtk_redshift_wrapper_set_override;
+        iface->get_source = redshiftgtk_redshift_wrapper_get_source;
+        iface->list_foreign = redshiftgtk_redshift_wrapper_list_foreign;
+        iface->adopt = redshiftgtk_redshift_wrapper_adopt;
+        iface->leave = redshiftgtk_redshift_wrapper_leave;
+        iface->list_outputs = redshiftgtk_redshift_wrapper_list_outputs;
+        iface->get_output_setting = redshiftgtk_redshift_wrapper_get_output_setting;
+        iface->set_output_setting = redshiftgtk_redshift_wrapper_set_output_setting;
 }
 
 gchar*
@@ -842,3 +2886,18 @@ redshiftgtk_redshift_wrapper_set_config_path (RedshiftGtkBackend *backend,
         self->config_path = path;
 }
 
+/**
+ * redshiftgtk_redshift_wrapper_set_outputs
+ *
+ * Take @outputs as the outputs there are instead of asking the
+ * X server. Previews and resets then go through redshift too, the
+ * X server doesn't know these outputs. NULL goes back to asking.
+ */
+void
+redshiftgtk_redshift_wrapper_set_outputs (RedshiftGtkRedshiftWrapper *self,
+                                          GPtrArray                  *outputs)
+{
+        g_clear_pointer (&self->connected, g_ptr_array_unref);
+        self->connected = outputs ? g_ptr_array_ref (outputs) : NULL;
+        self->connected_fixed = outputs != NULL;
+}
@@ -29,6 +29,8 @@ G_DECLARE_FINAL_TYPE (RedshiftGtkRedshiftWrapper, redshiftgtk_redshift_wrapper,
 
 RedshiftGtkBackend*
 redshiftgtk_redshift_wrapper_new ();
+RedshiftGtkBackend*
+redshiftgtk_redshift_wrapper_new_for_path (const gchar *path);
 
 void
 redshiftgtk_redshift_wrapper_load_config (RedshiftGtkRedshiftWrapper *self,
@@ -38,5 +40,8 @@ redshiftgtk_redshift_wrapper_get_config_path (RedshiftGtkBackend *backend);
 void
 redshiftgtk_redshift_wrapper_set_config_path (RedshiftGtkBackend *backend,
                                               gchar              *path);
+void
+redshiftgtk_redshift_wrapper_set_outputs     (RedshiftGtkRedshiftWrapper *self,
+                                              GPtrArray                  *outputs);
 
 G_END_DECLS
@@ -0,0 +1,159 @@
+/* redshiftgtk-settings-cache.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <glib/gstdio.h>
+
+#include "redshiftgtk-settings-cache.h"
+
+/* Bump whenever the schema or the layout below changes */
+#define SETTINGS_CACHE_VERSION 2
+
+/* (version, stamps, profiles) */
+#define SETTINGS_CACHE_TYPE ((const GVariantType *) "(ua(sttx)a(sa(yyddd)))")
+
+/**
+ * redshiftgtk_settings_cache_get_path
+ *
+ * Where the cache of @config_path lives. Every config file gets
+ * its own, so switching between them doesn't throw caches away.
+ */
+gchar*
+redshiftgtk_settings_cache_get_path (const gchar *config_path)
+{
+        g_autofree gchar *checksum = NULL;
+        g_autofree gchar *name = NULL;
+
+        checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, config_path, -1);
+        name = g_strconcat (checksum, ".settings", NULL);
+
+        return g_build_filename (g_get_user_cache_dir (), "redshiftgtk", name, NULL);
+}
+
+/**
+ * redshiftgtk_settings_cache_stamp
+ *
+ * Identify the current state of every file in @sources by its inode,
+ * size and modification time. Files that don't exist are stamped with
+ * zeroes. Returns a floating variant to hand to _load() and _save().
+ *
+ * Stamp before reading the files, a change that races with the read
+ * then shows up as a stale cache instead of a wrong one.
+ */
+GVariant*
+redshiftgtk_settings_cache_stamp (const gchar * const *sources)
+{
+        GVariantBuilder builder;
+        guint i;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sttx)"));
+
+        for (i = 0; sources[i]; i++) {
+                GStatBuf buf;
+
+                if (g_stat (sources[i], &buf) != 0) {
+                        g_variant_builder_add (&builder, "(sttx)", sources[i],
+                                               (guint64) 0, (guint64) 0, (gint64) 0);
+                        continue;
+                }
+
+                g_variant_builder_add (&builder, "(sttx)", sources[i],
+                                       (guint64) buf.st_ino,
+                                       (guint64) buf.st_size,
+                                       (gint64) buf.st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000) +
+                                       buf.st_mtim.tv_nsec);
+        }
+
+        return g_variant_builder_end (&builder);
+}
+
+/**
+ * redshiftgtk_settings_cache_load
+ *
+ * The profiles stored in the cache at @path, if it was written for
+ * exactly @stamps. Returns NULL if there is no such cache or it is stale.
+ *
+ * The file is mapped, not read. The returned variant points right into
+ * the mapping and keeps it alive.
+ */
+GVariant*
+redshiftgtk_settings_cache_load (const gchar *path,
+                                 GVariant    *stamps)
+{
+        g_autoptr (GMappedFile) mapped = NULL;
+        g_autoptr (GBytes) bytes = NULL;
+        g_autoptr (GVariant) cache = NULL;
+        g_autoptr (GVariant) cached_stamps = NULL;
+        g_autoptr (GVariant) current_stamps = g_variant_ref_sink (stamps);
+        g_autoptr (GError) error = NULL;
+        guint32 version;
+
+        mapped = g_mapped_file_new (path, FALSE, &error);
+        if (!mapped) {
+                if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+                        g_debug ("redshiftgtk_settings_cache_load\n\
+        g_mapped_file_new: %s\n", error->message);
+                return NULL;
+        }
+
+        /* Anything can be in there, don't trust it to be in normal
+         * form. Malformed data reads back as default values.
+         */
+        bytes = g_mapped_file_get_bytes (mapped);
+        cache = g_variant_ref_sink (g_variant_new_from_bytes (SETTINGS_CACHE_TYPE, bytes, FALSE));
+
+        g_variant_get_child (cache, 0, "u", &version);
+        cached_stamps = g_variant_get_child_value (cache, 1);
+
+        if (version != SETTINGS_CACHE_VERSION || !g_variant_equal (cached_stamps, current_stamps))
+                return NULL;
+
+        return g_variant_get_child_value (cache, 2);
+}
+
+/**
+ * redshiftgtk_settings_cache_save
+ *
+ * Store @profiles at @path as read from the files in @stamps. The file
+ * is replaced atomically, a reader sees either the old or the new cache.
+ */
+gboolean
+redshiftgtk_settings_cache_save (const gchar *path,
+                                 GVariant    *stamps,
+                                 GVariant    *profiles,
+                                 GError     **error)
+{
+        g_autoptr (GVariant) cache = NULL;
+        g_autofree gchar *directory = NULL;
+
+        g_return_val_if_fail (g_variant_is_of_type (profiles, SETTINGS_CACHE_PROFILES_TYPE), FALSE);
+
+        cache = g_variant_ref_sink (g_variant_new ("(u@a(sttx)@a(sa(yyddd)))",
+                                                   SETTINGS_CACHE_VERSION, stamps, profiles));
+
+        directory = g_path_get_dirname (path);
+        if (g_mkdir_with_parents (directory, 0700) != 0) {
+                gint saved_errno = errno;
+
+                g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                             "%s: %s", directory, g_strerror (saved_errno));
+                return FALSE;
+        }
+
+        return g_file_set_contents (path, g_variant_get_data (cache),
+                                    g_variant_get_size (cache), error);
+}
@@ -0,0 +1,49 @@
+/* redshiftgtk-settings-cache.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The typed settings of every profile in binary form, so that startup
+ * doesn't have to parse redshift.conf. A cache only counts as long as
+ * every file it was read from still has the same inode, size and mtime.
+ *
+ * Profiles and outputs are stored as an array of (group, layers) pairs,
+ * the default settings under the empty group. Layers are serialized with
+ * redshiftgtk_settings_layers_serialize().
+ */
+#define SETTINGS_CACHE_PROFILES_TYPE ((const GVariantType *) "a(sa(yyddd))")
+
+gchar*
+redshiftgtk_settings_cache_get_path (const gchar         *config_path);
+
+GVariant*
+redshiftgtk_settings_cache_stamp    (const gchar * const *sources);
+
+GVariant*
+redshiftgtk_settings_cache_load     (const gchar         *path,
+                                     GVariant            *stamps);
+gboolean
+redshiftgtk_settings_cache_save     (const gchar         *path,
+                                     GVariant            *stamps,
+                                     GVariant            *profiles,
+                                     GError             **error);
+
+G_END_DECLS
@@ -0,0 +1,347 @@
+/* redshiftgtk-settings-layers.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "redshiftgtk-settings-layers.h"
+
+struct _RedshiftGtkSettingsLayers
+{
+        SettingValue values[N_CONFIG_LAYERS][N_SETTINGS];
+        /* One bit per setting a layer has a value for */
+        guint32 present[N_CONFIG_LAYERS];
+
+        /* Topmost value of every setting, and the layer it came from */
+        SettingValue merged[N_SETTINGS];
+        ConfigLayer source[N_SETTINGS];
+};
+
+/* Pick the topmost value of @setting again. Returns TRUE if the merged
+ * view changed.
+ */
+static gboolean
+redshiftgtk_settings_layers_merge (RedshiftGtkSettingsLayers *self,
+                                   Setting                    setting)
+{
+        ConfigLayer layer = CONFIG_LAYER_RUNTIME;
+
+        /* The default layer always has a value, this ends there */
+        while (!(self->present[layer] & (1u << setting)))
+                layer--;
+
+        if (self->source[setting] == layer &&
+            memcmp (self->merged[setting], self->values[layer][setting],
+                    sizeof (SettingValue)) == 0)
+                return FALSE;
+
+        self->source[setting] = layer;
+        memcpy (self->merged[setting], self->values[layer][setting],
+                sizeof (SettingValue));
+
+        return TRUE;
+}
+
+/**
+ * redshiftgtk_settings_layers_new
+ *
+ * Layers holding nothing but the built-in defaults
+ */
+RedshiftGtkSettingsLayers*
+redshiftgtk_settings_layers_new (void)
+{
+        RedshiftGtkSettingsLayers *self = g_new0 (RedshiftGtkSettingsLayers, 1);
+        Setting setting;
+        guint i;
+
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+
+                for (i = 0; i < SETTING_COMPONENTS; i++)
+                        self->values[CONFIG_LAYER_DEFAULT][setting][i] = info->fallback;
+
+                self->present[CONFIG_LAYER_DEFAULT] |= 1u << setting;
+                memcpy (self->merged[setting], self->values[CONFIG_LAYER_DEFAULT][setting],
+                        sizeof (SettingValue));
+                self->source[setting] = CONFIG_LAYER_DEFAULT;
+        }
+
+        return self;
+}
+
+void
+redshiftgtk_settings_layers_free (RedshiftGtkSettingsLayers *self)
+{
+        g_free (self);
+}
+
+/**
+ * redshiftgtk_settings_layers_get
+ *
+ * The merged value of @setting. Valid until the next change.
+ */
+const gdouble*
+redshiftgtk_settings_layers_get (RedshiftGtkSettingsLayers *self,
+                                 Setting                    setting)
+{
+        g_assert (setting < N_SETTINGS);
+
+        return self->merged[setting];
+}
+
+/**
+ * redshiftgtk_settings_layers_get_source
+ *
+ * The layer the merged value of @setting comes from
+ */
+ConfigLayer
+redshiftgtk_settings_layers_get_source (RedshiftGtkSettingsLayers *self,
+                                        Setting                    setting)
+{
+        g_assert (setting < N_SETTINGS);
+
+        return self->source[setting];
+}
+
+/**
+ * redshiftgtk_settings_layers_get_layer
+ *
+ * The value @layer has for @setting, or NULL if it leaves it
+ * to the layers below
+ */
+const gdouble*
+redshiftgtk_settings_layers_get_layer (RedshiftGtkSettingsLayers *self,
+                                       ConfigLayer                layer,
+                                       Setting                    setting)
+{
+        g_assert (layer < N_CONFIG_LAYERS);
+        g_assert (setting < N_SETTINGS);
+
+        if (!(self->present[layer] & (1u << setting)))
+                return NULL;
+
+        return self->values[layer][setting];
+}
+
+/**
+ * redshiftgtk_settings_layers_set
+ *
+ * Give @setting a value in @layer. @value is expected to be valid.
+ * Returns TRUE if the merged value changed.
+ */
+gboolean
+redshiftgtk_settings_layers_set (RedshiftGtkSettingsLayers *self,
+                                 ConfigLayer                layer,
+                                 Setting                    setting,
+                                 const SettingValue         value)
+{
+        g_assert (layer < N_CONFIG_LAYERS);
+        g_assert (setting < N_SETTINGS);
+
+        if ((self->present[layer] & (1u << setting)) &&
+            memcmp (self->values[layer][setting], value, sizeof (SettingValue)) == 0)
+                return FALSE;
+
+        memcpy (self->values[layer][setting], value, sizeof (SettingValue));
+        self->present[layer] |= 1u << setting;
+
+        return redshiftgtk_settings_layers_merge (self, setting);
+}
+
+/**
+ * redshiftgtk_settings_layers_unset
+ *
+ * Let the layers below @layer decide @setting again. The built-in
+ * defaults can't be unset. Returns TRUE if the merged value changed.
+ */
+gboolean
+redshiftgtk_settings_layers_unset (RedshiftGtkSettingsLayers *self,
+                                   ConfigLayer                layer,
+                                   Setting                    setting)
+{
+        g_assert (layer < N_CONFIG_LAYERS);
+        g_assert (setting < N_SETTINGS);
+        g_return_val_if_fail (layer != CONFIG_LAYER_DEFAULT, FALSE);
+
+        if (!(self->present[layer] & (1u << setting)))
+                return FALSE;
+
+        self->present[layer] &= ~(1u << setting);
+
+        return redshiftgtk_settings_layers_merge (self, setting);
+}
+
+/**
+ * redshiftgtk_settings_layers_load
+ *
+ * Replace everything in @layer with the keys of @config. Keys are looked
+ * up in @group, or in the group redshift reads them from if @group is NULL.
+ * Keys that are missing or don't parse are left to the layers below, values
+ * out of range are clamped. A NULL @config empties the layer.
+ *
+ * Returns a mask with a bit set for every setting whose merged value
+ * changed.
+ */
+guint32
+redshiftgtk_settings_layers_load (RedshiftGtkSettingsLayers *self,
+                                  ConfigLayer                layer,
+                                  GKeyFile                  *config,
+                                  const gchar               *group)
+{
+        guint32 changed = 0;
+        Setting setting;
+
+        g_return_val_if_fail (layer != CONFIG_LAYER_DEFAULT, 0);
+
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+                g_autofree gchar *string = NULL;
+                SettingValue value;
+                gboolean merged;
+
+                if (config)
+                        string = g_key_file_get_value (config, group ? group : info->group,
+                                                       info->key, NULL);
+
+                if (string && redshiftgtk_settings_schema_parse_value (setting, string, value)) {
+                        merged = redshiftgtk_settings_layers_set (self, layer, setting, value);
+                } else {
+                        if (string)
+                                g_debug ("redshiftgtk_settings_layers_load\n\
+        %s: \"%s\" is invalid\n", info->key, string);
+                        merged = redshiftgtk_settings_layers_unset (self, layer, setting);
+                }
+
+                if (merged)
+                        changed |= 1u << setting;
+        }
+
+        return changed;
+}
+
+/* One element of the serialized form. Laid out exactly like a GVariant
+ * (yyddd), so a mapped array can be read in place.
+ */
+typedef struct {
+        guint8 layer;
+        guint8 setting;
+        gdouble value[SETTING_COMPONENTS];
+} SerializedValue;
+
+G_STATIC_ASSERT (G_STRUCT_OFFSET (SerializedValue, value) == 8);
+G_STATIC_ASSERT (sizeof (SerializedValue) == 8 + sizeof (SettingValue));
+
+/* Only the layers that come from files are worth keeping around */
+static gboolean
+redshiftgtk_settings_layers_is_file_layer (ConfigLayer layer)
+{
+        return layer == CONFIG_LAYER_SYSTEM || layer == CONFIG_LAYER_USER;
+}
+
+/**
+ * redshiftgtk_settings_layers_serialize
+ *
+ * The values of the system and user layers as a floating
+ * SETTINGS_LAYERS_VARIANT_TYPE variant
+ */
+GVariant*
+redshiftgtk_settings_layers_serialize (RedshiftGtkSettingsLayers *self)
+{
+        SerializedValue values[N_CONFIG_LAYERS * N_SETTINGS];
+        ConfigLayer layer;
+        Setting setting;
+        gsize n_values = 0;
+
+        for (layer = 0; layer < N_CONFIG_LAYERS; layer++) {
+                if (!redshiftgtk_settings_layers_is_file_layer (layer))
+                        continue;
+
+                for (setting = 0; setting < N_SETTINGS; setting++) {
+                        if (!(self->present[layer] & (1u << setting)))
+                                continue;
+
+                        values[n_values].layer = layer;
+                        values[n_values].setting = setting;
+                        memcpy (values[n_values].value, self->values[layer][setting],
+                                sizeof (SettingValue));
+                        n_values++;
+                }
+        }
+
+        return g_variant_new_fixed_array (G_VARIANT_TYPE ("(yyddd)"), values,
+                                          n_values, sizeof (SerializedValue));
+}
+
+/**
+ * redshiftgtk_settings_layers_deserialize
+ *
+ * Replace the system and user layers with @values, as returned by
+ * redshiftgtk_settings_layers_serialize(). Runtime overrides are left
+ * alone. Values that don't belong to a file layer or are out of range
+ * are dropped.
+ *
+ * Returns a mask with a bit set for every setting whose merged value
+ * changed.
+ */
+guint32
+redshiftgtk_settings_layers_deserialize (RedshiftGtkSettingsLayers *self,
+                                         GVariant                  *values)
+{
+        const SerializedValue *array;
+        SettingValue loaded[N_CONFIG_LAYERS][N_SETTINGS];
+        guint32 present[N_CONFIG_LAYERS] = { 0 };
+        guint32 changed = 0;
+        ConfigLayer layer;
+        Setting setting;
+        gsize n_values, i;
+
+        g_return_val_if_fail (g_variant_is_of_type (values, SETTINGS_LAYERS_VARIANT_TYPE), 0);
+
+        array = g_variant_get_fixed_array (values, &n_values, sizeof (SerializedValue));
+
+        for (i = 0; i < n_values; i++) {
+                layer = array[i].layer;
+                setting = array[i].setting;
+
+                if (!redshiftgtk_settings_layers_is_file_layer (layer) ||
+                    setting >= N_SETTINGS)
+                        continue;
+
+                memcpy (loaded[layer][setting], array[i].value, sizeof (SettingValue));
+                redshiftgtk_settings_schema_validate (setting, loaded[layer][setting]);
+                present[layer] |= 1u << setting;
+        }
+
+        for (layer = 0; layer < N_CONFIG_LAYERS; layer++) {
+                if (!redshiftgtk_settings_layers_is_file_layer (layer))
+                        continue;
+
+                for (setting = 0; setting < N_SETTINGS; setting++) {
+                        gboolean merged;
+
+                        if (present[layer] & (1u << setting))
+                                merged = redshiftgtk_settings_layers_set (self, layer, setting,
+                                                                          loaded[layer][setting]);
+                        else
+                                merged = redshiftgtk_settings_layers_unset (self, layer, setting);
+
+                        if (merged)
+                                changed |= 1u << setting;
+                }
+        }
+
+        return changed;
+}
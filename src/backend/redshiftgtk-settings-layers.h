@@ -0,0 +1,77 @@
+/* redshiftgtk-settings-layers.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include "enums.h"
+#include "redshiftgtk-settings-schema.h"
+
+G_BEGIN_DECLS
+
+#define N_CONFIG_LAYERS (CONFIG_LAYER_RUNTIME + 1)
+
+/* GVariant type of the serialized file layers */
+#define SETTINGS_LAYERS_VARIANT_TYPE ((const GVariantType *) "a(yyddd)")
+
+/* Typed settings stacked in layers, from the built-in defaults up to
+ * runtime overrides. The merged view is kept up to date one setting
+ * at a time, only for the settings a change actually touched.
+ */
+typedef struct _RedshiftGtkSettingsLayers RedshiftGtkSettingsLayers;
+
+RedshiftGtkSettingsLayers*
+redshiftgtk_settings_layers_new        (void);
+void
+redshiftgtk_settings_layers_free       (RedshiftGtkSettingsLayers *self);
+
+const gdouble*
+redshiftgtk_settings_layers_get        (RedshiftGtkSettingsLayers *self,
+                                        Setting                    setting);
+ConfigLayer
+redshiftgtk_settings_layers_get_source (RedshiftGtkSettingsLayers *self,
+                                        Setting                    setting);
+const gdouble*
+redshiftgtk_settings_layers_get_layer  (RedshiftGtkSettingsLayers *self,
+                                        ConfigLayer                layer,
+                                        Setting                    setting);
+
+gboolean
+redshiftgtk_settings_layers_set        (RedshiftGtkSettingsLayers *self,
+                                        ConfigLayer                layer,
+                                        Setting                    setting,
+                                        const SettingValue         value);
+gboolean
+redshiftgtk_settings_layers_unset      (RedshiftGtkSettingsLayers *self,
+                                        ConfigLayer                layer,
+                                        Setting                    setting);
+guint32
+redshiftgtk_settings_layers_load       (RedshiftGtkSettingsLayers *self,
+                                        ConfigLayer                layer,
+                                        GKeyFile                  *config,
+                                        const gchar               *group);
+
+GVariant*
+redshiftgtk_settings_layers_serialize   (RedshiftGtkSettingsLayers *self);
+guint32
+redshiftgtk_settings_layers_deserialize (RedshiftGtkSettingsLayers *self,
+                                         GVariant                  *values);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RedshiftGtkSettingsLayers, redshiftgtk_settings_layers_free)
+
+G_END_DECLS
@@ -0,0 +1,353 @@
+/* redshiftgtk-settings-model.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "redshiftgtk-settings-model.h"
+
+enum {
+        PROP_TEMP_DAY = 1,
+        PROP_TEMP_NIGHT,
+        PROP_LOCATION_PROVIDER,
+        PROP_LATITUDE,
+        PROP_LONGTITUDE,
+        PROP_BRIGHTNESS_DAY,
+        PROP_BRIGHTNESS_NIGHT,
+        PROP_GAMMA_DAY_RED,
+        PROP_GAMMA_DAY_GREEN,
+        PROP_GAMMA_DAY_BLUE,
+        PROP_GAMMA_NIGHT_RED,
+        PROP_GAMMA_NIGHT_GREEN,
+        PROP_GAMMA_NIGHT_BLUE,
+        PROP_ADJUSTMENT_METHOD,
+        PROP_SMOOTH_TRANSITION,
+        PROP_AUTOSTART,
+        N_PROPS
+};
+
+struct _RedshiftGtkSettingsModel
+{
+        GObject parent_instance;
+
+        /* Every setting is kept as a double, indexed by its property id.
+         * Integer and boolean properties are converted on the way in and
+         * out so that change detection is a single comparison.
+         */
+        gdouble values[N_PROPS];
+};
+
+static GParamSpec *obj_properties[N_PROPS] = {
+        NULL,
+};
+
+G_DEFINE_TYPE (RedshiftGtkSettingsModel, redshiftgtk_settings_model,
+               G_TYPE_OBJECT)
+
+/**
+ * Store a value and notify only if it actually changed
+ */
+static void
+redshiftgtk_settings_model_set_value (RedshiftGtkSettingsModel *self,
+                                      guint                     prop_id,
+                                      gdouble                   value)
+{
+        g_assert (prop_id > 0 && prop_id < N_PROPS);
+
+        if (self->values[prop_id] == value)
+                return;
+
+        self->values[prop_id] = value;
+        g_object_notify_by_pspec (G_OBJECT (self), obj_properties[prop_id]);
+}
+
+static void
+redshiftgtk_settings_model_set_property (GObject      *object,
+                                         guint         id,
+                                         const GValue *value,
+                                         GParamSpec   *spec)
+{
+        RedshiftGtkSettingsModel *self = REDSHIFTGTK_SETTINGS_MODEL (object);
+
+        if (id == 0 || id >= N_PROPS) {
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, id, spec);
+                return;
+        }
+
+        switch (G_PARAM_SPEC_VALUE_TYPE (spec)) {
+        case G_TYPE_DOUBLE:
+                redshiftgtk_settings_model_set_value (self, id,
+                                                      g_value_get_double (value));
+                break;
+        case G_TYPE_INT:
+                redshiftgtk_settings_model_set_value (self, id,
+                                                      g_value_get_int (value));
+                break;
+        case G_TYPE_BOOLEAN:
+                redshiftgtk_settings_model_set_value (self, id,
+                                                      g_value_get_boolean (value));
+                break;
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, id, spec);
+                break;
+        }
+}
+
+static void
+redshiftgtk_settings_model_get_property (GObject    *object,
+                                         guint       id,
+                                         GValue     *value,
+                                         GParamSpec *spec)
+{
+        RedshiftGtkSettingsModel *self = REDSHIFTGTK_SETTINGS_MODEL (object);
+
+        if (id == 0 || id >= N_PROPS) {
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, id, spec);
+                return;
+        }
+
+        switch (G_PARAM_SPEC_VALUE_TYPE (spec)) {
+        case G_TYPE_DOUBLE:
+                g_value_set_double (value, self->values[id]);
+                break;
+        case G_TYPE_INT:
+                g_value_set_int (value, (gint) self->values[id]);
+                break;
+        case G_TYPE_BOOLEAN:
+                g_value_set_boolean (value, self->values[id] != 0);
+                break;
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, id, spec);
+                break;
+        }
+}
+
+static GParamSpec*
+double_property (const gchar *name,
+                 gdouble      minimum,
+                 gdouble      maximum,
+                 gdouble      default_value)
+{
+        return g_param_spec_double (name, NULL, NULL,
+                                    minimum, maximum, default_value,
+                                    G_PARAM_READWRITE |
+                                    G_PARAM_EXPLICIT_NOTIFY |
+                                    G_PARAM_STATIC_STRINGS);
+}
+
+static void
+redshiftgtk_settings_model_class_init (RedshiftGtkSettingsModelClass *klass)
+{
+        GObjectClass *obj_class = G_OBJECT_CLASS (klass);
+
+        obj_class->get_property = redshiftgtk_settings_model_get_property;
+        obj_class->set_property = redshiftgtk_settings_model_set_property;
+
+        obj_properties[PROP_TEMP_DAY] =
+                double_property ("temp-day", 1000.0, 25000.0, 6500.0);
+        obj_properties[PROP_TEMP_NIGHT] =
+                double_property ("temp-night", 1000.0, 25000.0, 4500.0);
+        obj_properties[PROP_LOCATION_PROVIDER] =
+                g_param_spec_int ("location-provider", NULL, NULL,
+                                  LOCATION_PROVIDER_AUTO,
+                                  LOCATION_PROVIDER_MANUAL,
+                                  LOCATION_PROVIDER_AUTO,
+                                  G_PARAM_READWRITE |
+                                  G_PARAM_EXPLICIT_NOTIFY |
+                                  G_PARAM_STATIC_STRINGS);
+        obj_properties[PROP_LATITUDE] =
+                double_property ("latitude", -90.0, 90.0, 0.0);
+        obj_properties[PROP_LONGTITUDE] =
+                double_property ("longtitude", -180.0, 180.0, 0.0);
+        obj_properties[PROP_BRIGHTNESS_DAY] =
+                double_property ("brightness-day", 0.1, 1.0, 1.0);
+        obj_properties[PROP_BRIGHTNESS_NIGHT] =
+                double_property ("brightness-night", 0.1, 1.0, 1.0);
+        obj_properties[PROP_GAMMA_DAY_RED] =
+                double_property ("gamma-day-red", 0.1, 10.0, 1.0);
+        obj_properties[PROP_GAMMA_DAY_GREEN] =
+                double_property ("gamma-day-green", 0.1, 10.0, 1.0);
+        obj_properties[PROP_GAMMA_DAY_BLUE] =
+                double_property ("gamma-day-blue", 0.1, 10.0, 1.0);
+        obj_properties[PROP_GAMMA_NIGHT_RED] =
+                double_property ("gamma-night-red", 0.1, 10.0, 1.0);
+        obj_properties[PROP_GAMMA_NIGHT_GREEN] =
+                double_property ("gamma-night-green", 0.1, 10.0, 1.0);
+        obj_properties[PROP_GAMMA_NIGHT_BLUE] =
+                double_property ("gamma-night-blue", 0.1, 10.0, 1.0);
+        obj_properties[PROP_ADJUSTMENT_METHOD] =
+                g_param_spec_int ("adjustment-method", NULL, NULL,
+                                  ADJUSTMENT_METHOD_AUTO,
+                                  ADJUSTMENT_METHOD_VIDMODE,
+                                  ADJUSTMENT_METHOD_AUTO,
+                                  G_PARAM_READWRITE |
+                                  G_PARAM_EXPLICIT_NOTIFY |
+                                  G_PARAM_STATIC_STRINGS);
+        obj_properties[PROP_SMOOTH_TRANSITION] =
+                g_param_spec_boolean ("smooth-transition", NULL, NULL,
+                                      FALSE,
+                                      G_PARAM_READWRITE |
+                                      G_PARAM_EXPLICIT_NOTIFY |
+                                      G_PARAM_STATIC_STRINGS);
+        obj_properties[PROP_AUTOSTART] =
+                g_param_spec_boolean ("autostart", NULL, NULL,
+                                      FALSE,
+                                      G_PARAM_READWRITE |
+                                      G_PARAM_EXPLICIT_NOTIFY |
+                                      G_PARAM_STATIC_STRINGS);
+
+        g_object_class_install_properties (obj_class, N_PROPS, obj_properties);
+}
+
+static void
+redshiftgtk_settings_model_init (RedshiftGtkSettingsModel *self)
+{
+        guint i;
+
+        /* Start out with the property defaults */
+        for (i = 1; i < N_PROPS; i++) {
+                GValue value = G_VALUE_INIT;
+
+                g_value_init (&value, G_PARAM_SPEC_VALUE_TYPE (obj_properties[i]));
+                g_param_value_set_default (obj_properties[i], &value);
+
+                if (G_VALUE_HOLDS_DOUBLE (&value))
+                        self->values[i] = g_value_get_double (&value);
+                else if (G_VALUE_HOLDS_INT (&value))
+                        self->values[i] = g_value_get_int (&value);
+                else if (G_VALUE_HOLDS_BOOLEAN (&value))
+                        self->values[i] = g_value_get_boolean (&value);
+
+                g_value_unset (&value);
+        }
+}
+
+RedshiftGtkSettingsModel*
+redshiftgtk_settings_model_new ()
+{
+        return g_object_new (REDSHIFTGTK_TYPE_SETTINGS_MODEL, NULL);
+}
+
+/**
+ * redshiftgtk_settings_model_load
+ *
+ * Refresh every value from the backend. Notifications are held back
+ * until all values are in place, and only the ones that changed are
+ * emitted, so bound widgets see at most one update each.
+ */
+void
+redshiftgtk_settings_model_load (RedshiftGtkSettingsModel *self,
+                                 RedshiftGtkBackend       *backend)
+{
+        g_autoptr (GArray) gamma = NULL;
+
+        g_assert (REDSHIFTGTK_IS_SETTINGS_MODEL (self));
+        g_assert (REDSHIFTGTK_IS_BACKEND (backend));
+
+        g_object_freeze_notify (G_OBJECT (self));
+
+        redshiftgtk_settings_model_set_value (self, PROP_TEMP_DAY,
+                redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_DAY));
+        redshiftgtk_settings_model_set_value (self, PROP_TEMP_NIGHT,
+                redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_NIGHT));
+
+        redshiftgtk_settings_model_set_value (self, PROP_LOCATION_PROVIDER,
+                redshiftgtk_backend_get_location_provider (backend));
+        redshiftgtk_settings_model_set_value (self, PROP_LATITUDE,
+                redshiftgtk_backend_get_latitude (backend));
+        redshiftgtk_settings_model_set_value (self, PROP_LONGTITUDE,
+                redshiftgtk_backend_get_longtitude (backend));
+
+        redshiftgtk_settings_model_set_value (self, PROP_BRIGHTNESS_DAY,
+                redshiftgtk_backend_get_brightness (backend, TIME_PERIOD_DAY));
+        redshiftgtk_settings_model_set_value (self, PROP_BRIGHTNESS_NIGHT,
+                redshiftgtk_backend_get_brightness (backend, TIME_PERIOD_NIGHT));
+
+        gamma = redshiftgtk_backend_get_gamma (backend, TIME_PERIOD_DAY);
+        if (gamma) {
+                redshiftgtk_settings_model_set_value (self, PROP_GAMMA_DAY_RED,
+                        g_array_index (gamma, gdouble, 0));
+                redshiftgtk_settings_model_set_value (self, PROP_GAMMA_DAY_GREEN,
+                        g_array_index (gamma, gdouble, 1));
+                redshiftgtk_settings_model_set_value (self, PROP_GAMMA_DAY_BLUE,
+                        g_array_index (gamma, gdouble, 2));
+                g_clear_pointer (&gamma, g_array_unref);
+        }
+
+        gamma = redshiftgtk_backend_get_gamma (backend, TIME_PERIOD_NIGHT);
+        if (gamma) {
+                redshiftgtk_settings_model_set_value (self, PROP_GAMMA_NIGHT_RED,
+                        g_array_index (gamma, gdouble, 0));
+                redshiftgtk_settings_model_set_value (self, PROP_GAMMA_NIGHT_GREEN,
+                        g_array_index (gamma, gdouble, 1));
+                redshiftgtk_settings_model_set_value (self, PROP_GAMMA_NIGHT_BLUE,
+                        g_array_index (gamma, gdouble, 2));
+        }
+
+        redshiftgtk_settings_model_set_value (self, PROP_ADJUSTMENT_METHOD,
+                redshiftgtk_backend_get_adjustment_method (backend));
+        redshiftgtk_settings_model_set_value (self, PROP_SMOOTH_TRANSITION,
+                redshiftgtk_backend_get_smooth_transition (backend));
+        redshiftgtk_settings_model_set_value (self, PROP_AUTOSTART,
+                redshiftgtk_backend_get_autostart (backend));
+
+        g_object_thaw_notify (G_OBJECT (self));
+}
+
+/**
+ * redshiftgtk_settings_model_commit
+ *
+ * Push every value into the backend. Autostart is left to the caller
+ * since changing it can fail and needs its own error handling.
+ */
+void
+redshiftgtk_settings_model_commit (RedshiftGtkSettingsModel *self,
+                                   RedshiftGtkBackend       *backend)
+{
+        gdouble *values;
+
+        g_assert (REDSHIFTGTK_IS_SETTINGS_MODEL (self));
+        g_assert (REDSHIFTGTK_IS_BACKEND (backend));
+
+        values = self->values;
+
+        redshiftgtk_backend_set_temperature (backend, TIME_PERIOD_DAY,
+                                             values[PROP_TEMP_DAY]);
+        redshiftgtk_backend_set_temperature (backend, TIME_PERIOD_NIGHT,
+                                             values[PROP_TEMP_NIGHT]);
+
+        redshiftgtk_backend_set_location_provider (backend,
+                (LocationProvider) values[PROP_LOCATION_PROVIDER]);
+        redshiftgtk_backend_set_latitude (backend, values[PROP_LATITUDE]);
+        redshiftgtk_backend_set_longtitude (backend, values[PROP_LONGTITUDE]);
+
+        redshiftgtk_backend_set_brightness (backend, TIME_PERIOD_DAY,
+                                            values[PROP_BRIGHTNESS_DAY]);
+        redshiftgtk_backend_set_brightness (backend, TIME_PERIOD_NIGHT,
+                                            values[PROP_BRIGHTNESS_NIGHT]);
+
+        redshiftgtk_backend_set_gamma (backend, TIME_PERIOD_DAY,
+                                       values[PROP_GAMMA_DAY_RED],
+                                       values[PROP_GAMMA_DAY_GREEN],
+                                       values[PROP_GAMMA_DAY_BLUE]);
+        redshiftgtk_backend_set_gamma (backend, TIME_PERIOD_NIGHT,
+                                       values[PROP_GAMMA_NIGHT_RED],
+                                       values[PROP_GAMMA_NIGHT_GREEN],
+                                       values[PROP_GAMMA_NIGHT_BLUE]);
+
+        redshiftgtk_backend_set_adjustment_method (backend,
+                (AdjustmentMethod) values[PROP_ADJUSTMENT_METHOD]);
+        redshiftgtk_backend_set_smooth_transition (backend,
+                values[PROP_SMOOTH_TRANSITION] != 0);
+}
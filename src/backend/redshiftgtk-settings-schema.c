@@ -0,0 +1,437 @@
+/* redshiftgtk-settings-schema.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "enums.h"
+#include "redshiftgtk-settings-schema.h"
+
+#define DEFAULT_SETTINGS_GROUP "redshift"
+#define MANUAL_SETTINGS_GROUP "manual"
+
+static const gchar * const location_providers[] = {
+        [LOCATION_PROVIDER_AUTO] = "geoclue2",
+        [LOCATION_PROVIDER_MANUAL] = "manual",
+};
+
+static const gchar * const adjustment_methods[] = {
+        /* Let redshift pick one */
+        [ADJUSTMENT_METHOD_AUTO] = NULL,
+        [ADJUSTMENT_METHOD_RANDR] = "randr",
+        [ADJUSTMENT_METHOD_VIDMODE] = "vidmode",
+};
+
+/* One row per key. The wrapper cache, validation, file format and the
+ * schema tests are all driven from here.
+ *
+ * key, group, type,
+ * minimum, maximum, fallback,
+ * format, choices, runtime
+ */
+static const SettingInfo schema[N_SETTINGS] = {
+        [SETTING_TEMP_DAY] = {
+                "temp-day", DEFAULT_SETTINGS_GROUP, SETTING_TYPE_NUMBER,
+                1000, 25000, 6500,
+                "%.0f", NULL, TRUE
+        },
+        [SETTING_TEMP_NIGHT] = {
+                "temp-night", DEFAULT_SETTINGS_GROUP, SETTING_TYPE_NUMBER,
+                1000, 25000, 4500,
+                "%.0f", NULL, TRUE
+        },
+        [SETTING_BRIGHTNESS_DAY] = {
+                "brightness-day", DEFAULT_SETTINGS_GROUP, SETTING_TYPE_NUMBER,
+                0.1, 1.0, 1.0,
+                "%.2f", NULL, TRUE
+        },
+        [SETTING_BRIGHTNESS_NIGHT] = {
+                "brightness-night", DEFAULT_SETTINGS_GROUP, SETTING_TYPE_NUMBER,
+                0.1, 1.0, 1.0,
+                "%.2f", NULL, TRUE
+        },
+        [SETTING_GAMMA_DAY] = {
+                "gamma-day", DEFAULT_SETTINGS_GROUP, SETTING_TYPE_GAMMA,
+                0.1, 10.0, 1.0,
+                "%.2f", NULL, TRUE
+        },
+        [SETTING_GAMMA_NIGHT] = {
+                "gamma-night", DEFAULT_SETTINGS_GROUP, SETTING_TYPE_GAMMA,
+                0.1, 10.0, 1.0,
+                "%.2f", NULL, TRUE
+        },
+        [SETTING_LOCATION_PROVIDER] = {
+                "location-provider", DEFAULT_SETTINGS_GROUP, SETTING_TYPE_CHOICE,
+                LOCATION_PROVIDER_AUTO, LOCATION_PROVIDER_MANUAL, LOCATION_PROVIDER_AUTO,
+                NULL, location_providers, FALSE
+        },
+        [SETTING_LATITUDE] = {
+                "lat", MANUAL_SETTINGS_GROUP, SETTING_TYPE_NUMBER,
+                -90, 90, 0,
+                "%.2f", NULL, FALSE
+        },
+        [SETTING_LONGTITUDE] = {
+                "lon", MANUAL_SETTINGS_GROUP, SETTING_TYPE_NUMBER,
+                -180, 180, 0,
+                "%.2f", NULL, FALSE
+        },
+        [SETTING_ADJUSTMENT_METHOD] = {
+                "adjustment-method", DEFAULT_SETTINGS_GROUP, SETTING_TYPE_CHOICE,
+                ADJUSTMENT_METHOD_AUTO, ADJUSTMENT_METHOD_VIDMODE, ADJUSTMENT_METHOD_AUTO,
+                NULL, adjustment_methods, FALSE
+        },
+        [SETTING_FADE] = {
+                "fade", DEFAULT_SETTINGS_GROUP, SETTING_TYPE_FLAG,
+                0, 1, 0,
+                "%.0f", NULL, FALSE
+        },
+};
+
+/** redshiftgtk_settings_schema_lookup
+ *
+ * Return the descriptor of @setting
+ */
+const SettingInfo*
+redshiftgtk_settings_schema_lookup (Setting setting)
+{
+        g_assert (setting < N_SETTINGS);
+
+        return &schema[setting];
+}
+
+/** redshiftgtk_settings_schema_find
+ *
+ * Find the setting stored under @key. Returns FALSE if there is none.
+ */
+gboolean
+redshiftgtk_settings_schema_find (const gchar *key,
+                                  Setting     *setting)
+{
+        Setting i;
+
+        for (i = 0; i < N_SETTINGS; i++) {
+                if (g_strcmp0 (schema[i].key, key) == 0) {
+                        *setting = i;
+                        return TRUE;
+                }
+        }
+
+        return FALSE;
+}
+
+/** redshiftgtk_settings_schema_is_per_output
+ *
+ * Whether an [output:NAME] group can set @setting for one output.
+ * Only what goes into the ramps can differ between outputs.
+ */
+gboolean
+redshiftgtk_settings_schema_is_per_output (Setting setting)
+{
+        return setting <= SETTING_GAMMA_NIGHT;
+}
+
+static guint
+redshiftgtk_settings_schema_components (const SettingInfo *info)
+{
+        return (info->type == SETTING_TYPE_GAMMA) ? SETTING_COMPONENTS : 1;
+}
+
+static void
+redshiftgtk_settings_schema_reset (const SettingInfo *info,
+                                   SettingValue       value)
+{
+        guint i;
+
+        for (i = 0; i < SETTING_COMPONENTS; i++)
+                value[i] = info->fallback;
+}
+
+/** redshiftgtk_settings_schema_validate
+ *
+ * Clamp @value into the range of @setting. Choices that don't exist and
+ * values that aren't numbers at all fall back to the default.
+ */
+void
+redshiftgtk_settings_schema_validate (Setting      setting,
+                                      SettingValue value)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        guint i;
+
+        for (i = 0; i < redshiftgtk_settings_schema_components (info); i++) {
+                if (isnan (value[i])) {
+                        value[i] = info->fallback;
+                        continue;
+                }
+
+                switch (info->type) {
+                case SETTING_TYPE_CHOICE:
+                        if (value[i] != floor (value[i]) ||
+                            value[i] < info->minimum || value[i] > info->maximum)
+                                value[i] = info->fallback;
+                        break;
+                case SETTING_TYPE_FLAG:
+                        value[i] = (value[i] != 0);
+                        break;
+                default:
+                        value[i] = CLAMP (value[i], info->minimum, info->maximum);
+                }
+        }
+}
+
+/* Scan one number starting at @string. Only plain decimal notation is
+ * accepted, g_ascii_strtod() alone would also take "inf", "nan" and hex.
+ */
+static const gchar*
+redshiftgtk_settings_schema_scan_number (const gchar *string,
+                                         gdouble     *value)
+{
+        const gchar *p;
+        gchar *end = NULL;
+
+        if (!g_ascii_isdigit (*string) && *string != '-' &&
+            *string != '+' && *string != '.')
+                return NULL;
+
+        *value = g_ascii_strtod (string, &end);
+        if (end == string)
+                return NULL;
+
+        for (p = string; p < end; p++) {
+                if (!g_ascii_isdigit (*p) && !strchr (".+-eE", *p))
+                        return NULL;
+        }
+
+        return end;
+}
+
+static const gchar*
+redshiftgtk_settings_schema_skip_space (const gchar *string)
+{
+        while (g_ascii_isspace (*string))
+                string++;
+
+        return string;
+}
+
+/** redshiftgtk_settings_schema_parse_number
+ *
+ * Parse a plain number, surrounding whitespace allowed.
+ * Doesn't allocate.
+ */
+gboolean
+redshiftgtk_settings_schema_parse_number (const gchar *string,
+                                          gdouble     *value)
+{
+        string = redshiftgtk_settings_schema_skip_space (string);
+        string = redshiftgtk_settings_schema_scan_number (string, value);
+
+        return string && *redshiftgtk_settings_schema_skip_space (string) == '\0';
+}
+
+/** redshiftgtk_settings_schema_parse_gamma
+ *
+ * Parse R:G:B, or a single number used for all three channels.
+ * Doesn't allocate.
+ */
+gboolean
+redshiftgtk_settings_schema_parse_gamma (const gchar  *string,
+                                         SettingValue  value)
+{
+        guint i;
+
+        string = redshiftgtk_settings_schema_skip_space (string);
+
+        for (i = 0; i < SETTING_COMPONENTS; i++) {
+                if (i > 0 && *string++ != ':')
+                        return FALSE;
+
+                string = redshiftgtk_settings_schema_scan_number (string, &value[i]);
+                if (!string)
+                        return FALSE;
+
+                /* G alone */
+                if (i == 0 && *redshiftgtk_settings_schema_skip_space (string) == '\0') {
+                        value[1] = value[2] = value[0];
+                        return TRUE;
+                }
+        }
+
+        return *redshiftgtk_settings_schema_skip_space (string) == '\0';
+}
+
+/* Compare @name with @string, ignoring whitespace around @string */
+static gboolean
+redshiftgtk_settings_schema_match (const gchar *string,
+                                   const gchar *name)
+{
+        gsize length;
+
+        if (!name)
+                return FALSE;
+
+        string = redshiftgtk_settings_schema_skip_space (string);
+        length = strlen (name);
+
+        return strncmp (string, name, length) == 0 &&
+               *redshiftgtk_settings_schema_skip_space (string + length) == '\0';
+}
+
+static gboolean
+redshiftgtk_settings_schema_parse (const SettingInfo *info,
+                                   const gchar       *string,
+                                   SettingValue       value)
+{
+        guint i;
+
+        switch (info->type) {
+        case SETTING_TYPE_NUMBER:
+        case SETTING_TYPE_FLAG:
+                return redshiftgtk_settings_schema_parse_number (string, &value[0]);
+
+        case SETTING_TYPE_GAMMA:
+                return redshiftgtk_settings_schema_parse_gamma (string, value);
+
+        case SETTING_TYPE_CHOICE:
+                for (i = 0; i <= info->maximum; i++) {
+                        if (redshiftgtk_settings_schema_match (string, info->choices[i])) {
+                                value[0] = i;
+                                return TRUE;
+                        }
+                }
+                return FALSE;
+        }
+
+        return FALSE;
+}
+
+/** redshiftgtk_settings_schema_parse_value
+ *
+ * Parse the raw key file @string of @setting into @value. Returns FALSE and
+ * leaves the default in @value if it doesn't parse. Values out of range are
+ * clamped with a warning. Doesn't allocate.
+ */
+gboolean
+redshiftgtk_settings_schema_parse_value (Setting       setting,
+                                         const gchar  *string,
+                                         SettingValue  value)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        SettingValue parsed;
+
+        redshiftgtk_settings_schema_reset (info, value);
+
+        if (!redshiftgtk_settings_schema_parse (info, string, parsed))
+                return FALSE;
+
+        if (info->type != SETTING_TYPE_GAMMA)
+                parsed[1] = parsed[2] = parsed[0];
+
+        memcpy (value, parsed, sizeof (SettingValue));
+        redshiftgtk_settings_schema_validate (setting, value);
+
+        /* redshift itself takes these, so a hand-edited file keeps
+         * working, just not quite the way it says
+         */
+        if (memcmp (value, parsed, sizeof (SettingValue)) != 0) {
+                g_warning ("redshiftgtk_settings_schema_parse_value\n\
+        %s: \"%s\" is out of range (%g to %g), clamped\n",
+                           info->key, string, info->minimum, info->maximum);
+        }
+
+        return TRUE;
+}
+
+/** redshiftgtk_settings_schema_read
+ *
+ * Load @setting from @config into @value. Missing keys and values that
+ * can't be parsed give the default, values out of range are clamped.
+ */
+void
+redshiftgtk_settings_schema_read (Setting       setting,
+                                  GKeyFile     *config,
+                                  SettingValue  value)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        g_autofree gchar *string = NULL;
+
+        /* GKeyFile hands out copies, this is the only allocation */
+        string = g_key_file_get_value (config, info->group, info->key, NULL);
+        if (!string) {
+                redshiftgtk_settings_schema_reset (info, value);
+                return;
+        }
+
+        if (!redshiftgtk_settings_schema_parse_value (setting, string, value)) {
+                g_debug ("redshiftgtk_settings_schema_read\n\
+        %s: \"%s\" is invalid\n", info->key, string);
+        }
+}
+
+/** redshiftgtk_settings_schema_format
+ *
+ * Format @value the way redshift expects it. Returns @buffer, a choice
+ * name, or NULL if the key should be left out of the file.
+ */
+const gchar*
+redshiftgtk_settings_schema_format (Setting             setting,
+                                    const SettingValue  value,
+                                    gchar               buffer[SETTING_FORMAT_SIZE])
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        SettingValue checked;
+        gsize length = 0;
+        guint i;
+
+        memcpy (checked, value, sizeof (SettingValue));
+        redshiftgtk_settings_schema_validate (setting, checked);
+
+        if (info->type == SETTING_TYPE_CHOICE)
+                return info->choices[(guint) checked[0]];
+
+        for (i = 0; i < redshiftgtk_settings_schema_components (info); i++) {
+                if (i > 0)
+                        buffer[length++] = ':';
+
+                g_ascii_formatd (buffer + length, G_ASCII_DTOSTR_BUF_SIZE,
+                                 info->format, checked[i]);
+                length += strlen (buffer + length);
+        }
+
+        return buffer;
+}
+
+/** redshiftgtk_settings_schema_write
+ *
+ * Store @value into @config in the format redshift expects
+ */
+void
+redshiftgtk_settings_schema_write (Setting             setting,
+                                   GKeyFile           *config,
+                                   const SettingValue  value)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        gchar buffer[SETTING_FORMAT_SIZE];
+        const gchar *string;
+
+        string = redshiftgtk_settings_schema_format (setting, value, buffer);
+
+        if (string)
+                g_key_file_set_value (config, info->group, info->key, string);
+        else
+                g_key_file_remove_key (config, info->group, info->key, NULL);
+}
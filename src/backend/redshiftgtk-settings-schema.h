@@ -0,0 +1,109 @@
+/* redshiftgtk-settings-schema.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Every redshift.conf key we manage. Day/night pairs are adjacent and in
+ * TimePeriod order, so SETTING_X_DAY + period selects the right one.
+ */
+typedef enum {
+        SETTING_TEMP_DAY,
+        SETTING_TEMP_NIGHT,
+        SETTING_BRIGHTNESS_DAY,
+        SETTING_BRIGHTNESS_NIGHT,
+        SETTING_GAMMA_DAY,
+        SETTING_GAMMA_NIGHT,
+        SETTING_LOCATION_PROVIDER,
+        SETTING_LATITUDE,
+        SETTING_LONGTITUDE,
+        SETTING_ADJUSTMENT_METHOD,
+        SETTING_FADE,
+        N_SETTINGS
+} Setting;
+
+typedef enum {
+        SETTING_TYPE_NUMBER,    /* key=1.0 */
+        SETTING_TYPE_GAMMA,     /* key=R:G:B or key=1.0 */
+        SETTING_TYPE_CHOICE,    /* key=name, stored as the index of name */
+        SETTING_TYPE_FLAG       /* key=0 or key=1 */
+} SettingType;
+
+/* Every setting is cached as up to three doubles */
+#define SETTING_COMPONENTS 3
+
+typedef gdouble SettingValue[SETTING_COMPONENTS];
+
+/* Enough room for any formatted value */
+#define SETTING_FORMAT_SIZE (SETTING_COMPONENTS * (G_ASCII_DTOSTR_BUF_SIZE + 1))
+
+typedef struct {
+        const gchar *key;
+        const gchar *group;
+        SettingType type;
+        gdouble minimum;
+        gdouble maximum;
+        gdouble fallback;
+        /* g_ascii_formatd() format of one component */
+        const gchar *format;
+        /* Names of a SETTING_TYPE_CHOICE, indexed by value. A NULL name
+         * means the key is left out of the file for that value.
+         */
+        const gchar * const *choices;
+        /* Can be shown on a running display with a one-shot adjustment */
+        gboolean runtime;
+} SettingInfo;
+
+const SettingInfo*
+redshiftgtk_settings_schema_lookup   (Setting             setting);
+gboolean
+redshiftgtk_settings_schema_find     (const gchar        *key,
+                                      Setting            *setting);
+gboolean
+redshiftgtk_settings_schema_is_per_output (Setting        setting);
+
+void
+redshiftgtk_settings_schema_validate (Setting             setting,
+                                      SettingValue        value);
+gboolean
+redshiftgtk_settings_schema_parse_number (const gchar     *string,
+                                          gdouble         *value);
+gboolean
+redshiftgtk_settings_schema_parse_gamma  (const gchar     *string,
+                                          SettingValue     value);
+gboolean
+redshiftgtk_settings_schema_parse_value  (Setting          setting,
+                                          const gchar     *string,
+                                          SettingValue     value);
+
+void
+redshiftgtk_settings_schema_read     (Setting             setting,
+                                      GKeyFile           *config,
+                                      SettingValue        value);
+const gchar*
+redshiftgtk_settings_schema_format   (Setting             setting,
+                                      const SettingValue  value,
+                                      gchar               buffer[SETTING_FORMAT_SIZE]);
+void
+redshiftgtk_settings_schema_write    (Setting             setting,
+                                      GKeyFile           *config,
+                                      const SettingValue  value);
+
+G_END_DECLS
@@ -0,0 +1,154 @@
+/* redshiftgtk-snapshot.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "redshiftgtk-settings-schema.h"
+#include "redshiftgtk-snapshot.h"
+
+static void
+redshiftgtk_snapshot_add_gamma (GVariantBuilder    *builder,
+                                const gchar        *key,
+                                RedshiftGtkBackend *backend,
+                                TimePeriod          period)
+{
+        g_autoptr (GArray) gamma = redshiftgtk_backend_get_gamma (backend, period);
+
+        if (!gamma)
+                return;
+
+        g_variant_builder_add (builder, "{sv}", key,
+                               g_variant_new ("(ddd)",
+                                              g_array_index (gamma, gdouble, 0),
+                                              g_array_index (gamma, gdouble, 1),
+                                              g_array_index (gamma, gdouble, 2)));
+}
+
+/**
+ * redshiftgtk_snapshot_new
+ *
+ * Collect every setting of the backend into a floating a{sv}
+ */
+GVariant*
+redshiftgtk_snapshot_new (RedshiftGtkBackend *backend)
+{
+        GVariantBuilder builder;
+        GVariantBuilder sources;
+        g_auto (GStrv) profiles = NULL;
+        const gchar *profile;
+        Setting setting;
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (backend));
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_TEMP_DAY,
+                g_variant_new_double (redshiftgtk_backend_get_temperature (backend,
+                                                                           TIME_PERIOD_DAY)));
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_TEMP_NIGHT,
+                g_variant_new_double (redshiftgtk_backend_get_temperature (backend,
+                                                                           TIME_PERIOD_NIGHT)));
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_LOCATION_PROVIDER,
+                g_variant_new_uint32 (redshiftgtk_backend_get_location_provider (backend)));
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_LATITUDE,
+                g_variant_new_double (redshiftgtk_backend_get_latitude (backend)));
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_LONGTITUDE,
+                g_variant_new_double (redshiftgtk_backend_get_longtitude (backend)));
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_BRIGHTNESS_DAY,
+                g_variant_new_double (redshiftgtk_backend_get_brightness (backend,
+                                                                          TIME_PERIOD_DAY)));
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_BRIGHTNESS_NIGHT,
+                g_variant_new_double (redshiftgtk_backend_get_brightness (backend,
+                                                                          TIME_PERIOD_NIGHT)));
+        redshiftgtk_snapshot_add_gamma (&builder, SNAPSHOT_KEY_GAMMA_DAY,
+                                        backend, TIME_PERIOD_DAY);
+        redshiftgtk_snapshot_add_gamma (&builder, SNAPSHOT_KEY_GAMMA_NIGHT,
+                                        backend, TIME_PERIOD_NIGHT);
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_ADJUSTMENT_METHOD,
+                g_variant_new_uint32 (redshiftgtk_backend_get_adjustment_method (backend)));
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_SMOOTH_TRANSITION,
+                g_variant_new_boolean (redshiftgtk_backend_get_smooth_transition (backend)));
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_AUTOSTART,
+                g_variant_new_boolean (redshiftgtk_backend_get_autostart (backend)));
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_RUNNING,
+                g_variant_new_boolean (redshiftgtk_backend_is_running (backend)));
+
+        profile = redshiftgtk_backend_get_profile (backend);
+        profiles = redshiftgtk_backend_list_profiles (backend);
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_PROFILE,
+                g_variant_new_string (profile ? profile : ""));
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_PROFILES,
+                g_variant_new_strv ((const gchar * const *) profiles, -1));
+
+        g_variant_builder_init (&sources, G_VARIANT_TYPE ("a{su}"));
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                const gchar *key = redshiftgtk_settings_schema_lookup (setting)->key;
+
+                g_variant_builder_add (&sources, "{su}", key,
+                                       redshiftgtk_backend_get_source (backend, key));
+        }
+        g_variant_builder_add (&builder, "{sv}", SNAPSHOT_KEY_SOURCES,
+                               g_variant_builder_end (&sources));
+
+        return g_variant_builder_end (&builder);
+}
+
+/**
+ * redshiftgtk_snapshot_apply
+ *
+ * Push the values found in an a{sv} snapshot into the backend.
+ * Keys that are missing are left alone. Autostart and the profile
+ * are skipped since changing them can fail and needs its own
+ * error handling.
+ */
+void
+redshiftgtk_snapshot_apply (GVariant           *snapshot,
+                            RedshiftGtkBackend *backend)
+{
+        GVariantDict dict;
+        gdouble value, red, green, blue;
+        guint32 enum_value;
+        gboolean boolean_value;
+
+        g_assert (REDSHIFTGTK_IS_BACKEND (backend));
+        g_return_if_fail (g_variant_is_of_type (snapshot, G_VARIANT_TYPE_VARDICT));
+
+        g_variant_dict_init (&dict, snapshot);
+
+        if (g_variant_dict_lookup (&dict, SNAPSHOT_KEY_TEMP_DAY, "d", &value))
+                redshiftgtk_backend_set_temperature (backend, TIME_PERIOD_DAY, value);
+        if (g_variant_dict_lookup (&dict, SNAPSHOT_KEY_TEMP_NIGHT, "d", &value))
+                redshiftgtk_backend_set_temperature (backend, TIME_PERIOD_NIGHT, value);
+        if (g_variant_dict_lookup (&dict, SNAPSHOT_KEY_LOCATION_PROVIDER, "u", &enum_value))
+                redshiftgtk_backend_set_location_provider (backend, enum_value);
+        if (g_variant_dict_lookup (&dict, SNAPSHOT_KEY_LATITUDE, "d", &value))
+                redshiftgtk_backend_set_latitude (backend, value);
+        if (g_variant_dict_lookup (&dict, SNAPSHOT_KEY_LONGTITUDE, "d", &value))
+                redshiftgtk_backend_set_longtitude (backend, value);
+        if (g_variant_dict_lookup (&dict, SNAPSHOT_KEY_BRIGHTNESS_DAY, "d", &value))
+                redshiftgtk_backend_set_brightness (backend, TIME_PERIOD_DAY, value);
+        if (g_variant_dict_lookup (&dict, SNAPSHOT_KEY_BRIGHTNESS_NIGHT, "d", &value))
+                redshiftgtk_backend_set_brightness (backend, TIME_PERIOD_NIGHT, value);
+        if (g_variant_dict_lookup (&dict, SNAPSHOT_KEY_GAMMA_DAY, "(ddd)", &red, &green, &blue))
+                redshiftgtk_backend_set_gamma (backend, TIME_PERIOD_DAY, red, green, blue);
+        if (g_variant_dict_lookup (&dict, SNAPSHOT_KEY_GAMMA_NIGHT, "(ddd)", &red, &green, &blue))
+                redshiftgtk_backend_set_gamma (backend, TIME_PERIOD_NIGHT, red, green, blue);
+        if (g_variant_dict_lookup (&dict, SNAPSHOT_KEY_ADJUSTMENT_METHOD, "u", &enum_value))
+                redshiftgtk_backend_set_adjustment_method (backend, enum_value);
+        if (g_variant_dict_lookup (&dict, SNAPSHOT_KEY_SMOOTH_TRANSITION, "b", &boolean_value))
+                redshiftgtk_backend_set_smooth_transition (backend, boolean_value);
+
+        g_variant_dict_clear (&dict);
+}
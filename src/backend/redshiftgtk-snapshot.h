@@ -0,0 +1,50 @@
+/* redshiftgtk-snapshot.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+#include "redshiftgtk-backend.h"
+
+G_BEGIN_DECLS
+
+/* Keys of an a{sv} settings snapshot */
+#define SNAPSHOT_KEY_TEMP_DAY          "temp-day"          /* d */
+#define SNAPSHOT_KEY_TEMP_NIGHT        "temp-night"        /* d */
+#define SNAPSHOT_KEY_LOCATION_PROVIDER "location-provider" /* u */
+#define SNAPSHOT_KEY_LATITUDE          "latitude"          /* d */
+#define SNAPSHOT_KEY_LONGTITUDE        "longtitude"        /* d */
+#define SNAPSHOT_KEY_BRIGHTNESS_DAY    "brightness-day"    /* d */
+#define SNAPSHOT_KEY_BRIGHTNESS_NIGHT  "brightness-night"  /* d */
+#define SNAPSHOT_KEY_GAMMA_DAY         "gamma-day"         /* (ddd) */
+#define SNAPSHOT_KEY_GAMMA_NIGHT       "gamma-night"       /* (ddd) */
+#define SNAPSHOT_KEY_ADJUSTMENT_METHOD "adjustment-method" /* u */
+#define SNAPSHOT_KEY_SMOOTH_TRANSITION "smooth-transition" /* b */
+#define SNAPSHOT_KEY_AUTOSTART         "autostart"         /* b */
+#define SNAPSHOT_KEY_RUNNING           "running"           /* b, read only */
+#define SNAPSHOT_KEY_PROFILE           "profile"           /* s, "" for the defaults */
+#define SNAPSHOT_KEY_PROFILES          "profiles"          /* as */
+#define SNAPSHOT_KEY_SOURCES           "sources"           /* a{su}, redshift.conf key -> ConfigLayer */
+
+GVariant*
+redshiftgtk_snapshot_new   (RedshiftGtkBackend *backend);
+void
+redshiftgtk_snapshot_apply (GVariant           *snapshot,
+                            RedshiftGtkBackend *backend);
+
+G_END_DECLS
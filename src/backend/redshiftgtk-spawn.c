@@ -0,0 +1,142 @@
+/* redshiftgtk-spawn.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "redshiftgtk-spawn.h"
+
+/* All redshift needs from the session: finding itself, the display,
+ * its config, geoclue on the session bus, translated messages and
+ * the local time its dawn-time and dusk-time schedule runs on
+ */
+static const gchar * const kept_variables[] = {
+        "PATH",
+        "HOME",
+        "USER",
+        "LOGNAME",
+        "LANG",
+        "LANGUAGE",
+        "LC_ALL",
+        "LC_CTYPE",
+        "LC_MESSAGES",
+        "LC_NUMERIC",
+        "LC_TIME",
+        "TZ",
+        "DISPLAY",
+        "WAYLAND_DISPLAY",
+        "XAUTHORITY",
+        "XDG_RUNTIME_DIR",
+        "XDG_CONFIG_HOME",
+        "XDG_CONFIG_DIRS",
+        "XDG_SESSION_TYPE",
+        "DBUS_SESSION_BUS_ADDRESS",
+};
+
+static gchar**
+redshiftgtk_spawn_keep (gchar       **envp,
+                        const gchar  *variable)
+{
+        const gchar *value = g_getenv (variable);
+
+        if (!value || g_environ_getenv (envp, variable))
+                return envp;
+
+        return g_environ_setenv (envp, variable, value, FALSE);
+}
+
+/**
+ * redshiftgtk_spawn_get_environ
+ *
+ * The environment redshift gets: the few variables it reads, not
+ * whatever a GTK process happens to carry around
+ */
+gchar**
+redshiftgtk_spawn_get_environ (void)
+{
+        g_auto (GStrv) extra = NULL;
+        gchar **envp = g_new0 (gchar*, 1);
+        const gchar *keep;
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (kept_variables); i++)
+                envp = redshiftgtk_spawn_keep (envp, kept_variables[i]);
+
+        keep = g_getenv (REDSHIFTGTK_SPAWN_KEEP_ENV);
+        if (keep) {
+                extra = g_strsplit (keep, ":", -1);
+                for (i = 0; extra[i] != NULL; i++) {
+                        if (*extra[i])
+                                envp = redshiftgtk_spawn_keep (envp, extra[i]);
+                }
+        }
+
+        return envp;
+}
+
+/**
+ * redshiftgtk_spawnv
+ *
+ * Start @argv with the environment from redshiftgtk_spawn_get_environ()
+ * and stdin on /dev/null.
+ *
+ * Descriptors are inherited as far as GLib is concerned, and that is
+ * deliberate: asked to close them it has to fork and walk the table,
+ * which costs page table copies in proportion to our whole address
+ * space. Left alone it uses posix_spawn(), which does a vfork. Nothing
+ * leaks this way, everything we open goes through GIO and is O_CLOEXEC,
+ * as are the display and bus connections of GTK.
+ */
+GSubprocess*
+redshiftgtk_spawnv (const gchar * const *argv,
+                    GSubprocessFlags     flags,
+                    GError             **error)
+{
+        g_autoptr (GSubprocessLauncher) launcher = NULL;
+        g_auto (GStrv) envp = redshiftgtk_spawn_get_environ ();
+
+        g_return_val_if_fail (argv != NULL && argv[0] != NULL, NULL);
+
+        launcher = g_subprocess_launcher_new (flags | G_SUBPROCESS_FLAGS_INHERIT_FDS);
+        g_subprocess_launcher_set_environ (launcher, envp);
+
+        return g_subprocess_launcher_spawnv (launcher, argv, error);
+}
+
+/**
+ * redshiftgtk_spawn
+ *
+ * redshiftgtk_spawnv() with the arguments listed, ending in NULL
+ */
+GSubprocess*
+redshiftgtk_spawn (GSubprocessFlags   flags,
+                   GError           **error,
+                   const gchar       *argv0,
+                   ...)
+{
+        g_autoptr (GPtrArray) argv = g_ptr_array_new ();
+        const gchar *argument;
+        va_list ap;
+
+        g_ptr_array_add (argv, (gchar *) argv0);
+
+        va_start (ap, argv0);
+        while ((argument = va_arg (ap, const gchar *)))
+                g_ptr_array_add (argv, (gchar *) argument);
+        va_end (ap);
+
+        g_ptr_array_add (argv, NULL);
+
+        return redshiftgtk_spawnv ((const gchar * const *) argv->pdata, flags, error);
+}
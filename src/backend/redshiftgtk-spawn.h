@@ -0,0 +1,42 @@
+/* redshiftgtk-spawn.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Extra variables to hand to redshift, separated by colons, for
+ * wrappers around it that need more than the usual session ones
+ */
+#define REDSHIFTGTK_SPAWN_KEEP_ENV "REDSHIFTGTK_SPAWN_KEEP_ENV"
+
+gchar**
+redshiftgtk_spawn_get_environ (void);
+
+GSubprocess*
+redshiftgtk_spawnv            (const gchar * const *argv,
+                               GSubprocessFlags     flags,
+                               GError             **error);
+GSubprocess*
+redshiftgtk_spawn             (GSubprocessFlags     flags,
+                               GError             **error,
+                               const gchar         *argv0,
+                               ...) G_GNUC_NULL_TERMINATED;
+
+G_END_DECLS
@@ -0,0 +1,403 @@
+/* redshiftgtk-stall-monitor.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "redshiftgtk-stall-monitor.h"
+
+#define UNATTRIBUTED "(unattributed)"
+
+/* Deeper than any chain of handlers emitting signals we have */
+#define MAX_DEPTH 16
+
+typedef struct {
+        guint count;
+        gint64 total;
+        gint64 longest;
+} StallStats;
+
+struct _RedshiftGtkStallMonitor
+{
+        GObject parent_instance;
+
+        gint64 threshold;       /* microseconds */
+        guint heartbeat_id;
+        GThread *thread;
+
+        /* Shared with the watchdog thread */
+        GMutex mutex;
+        GCond cond;
+        gboolean quit;
+        gint64 beat;
+        const gchar *stalled_in;
+        gint64 stall_start;
+
+        /* Main thread only */
+        GHashTable *stats;      /* handler name -> StallStats */
+        guint stall_count;
+        gint64 longest;
+};
+
+G_DEFINE_TYPE (RedshiftGtkStallMonitor, redshiftgtk_stall_monitor, G_TYPE_OBJECT)
+
+static RedshiftGtkStallMonitor *default_monitor;
+
+/* What the main thread runs, innermost last. Names are static. */
+static const gchar *handlers[MAX_DEPTH];
+static guint depth;
+static const gchar *current;
+
+static void
+redshiftgtk_stall_monitor_dispose (GObject *object)
+{
+        RedshiftGtkStallMonitor *self = REDSHIFTGTK_STALL_MONITOR (object);
+
+        if (self->heartbeat_id) {
+                g_source_remove (self->heartbeat_id);
+                self->heartbeat_id = 0;
+        }
+
+        if (self->thread) {
+                g_mutex_lock (&self->mutex);
+                self->quit = TRUE;
+                g_cond_signal (&self->cond);
+                g_mutex_unlock (&self->mutex);
+
+                g_thread_join (self->thread);
+                self->thread = NULL;
+        }
+
+        G_OBJECT_CLASS (redshiftgtk_stall_monitor_parent_class)->dispose (object);
+}
+
+static void
+redshiftgtk_stall_monitor_finalize (GObject *object)
+{
+        RedshiftGtkStallMonitor *self = REDSHIFTGTK_STALL_MONITOR (object);
+
+        g_hash_table_unref (self->stats);
+        g_mutex_clear (&self->mutex);
+        g_cond_clear (&self->cond);
+
+        G_OBJECT_CLASS (redshiftgtk_stall_monitor_parent_class)->finalize (object);
+}
+
+static void
+redshiftgtk_stall_monitor_class_init (RedshiftGtkStallMonitorClass *klass)
+{
+        GObjectClass *obj_class = G_OBJECT_CLASS (klass);
+
+        obj_class->dispose = redshiftgtk_stall_monitor_dispose;
+        obj_class->finalize = redshiftgtk_stall_monitor_finalize;
+}
+
+static void
+redshiftgtk_stall_monitor_init (RedshiftGtkStallMonitor *self)
+{
+        g_mutex_init (&self->mutex);
+        g_cond_init (&self->cond);
+        self->stats = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+}
+
+static void
+redshiftgtk_stall_monitor_record (RedshiftGtkStallMonitor *self,
+                                  const gchar             *name,
+                                  gint64                   duration)
+{
+        StallStats *stats = g_hash_table_lookup (self->stats, name);
+        g_autofree gchar *duration_field = NULL;
+
+        if (!stats) {
+                stats = g_new0 (StallStats, 1);
+                g_hash_table_insert (self->stats, (gpointer) name, stats);
+        }
+
+        stats->count++;
+        stats->total += duration;
+        stats->longest = MAX (stats->longest, duration);
+
+        self->stall_count++;
+        self->longest = MAX (self->longest, duration);
+
+        duration_field = g_strdup_printf ("%" G_GINT64_FORMAT, duration);
+        g_log_structured ("redshiftgtk", G_LOG_LEVEL_MESSAGE,
+                          "REDSHIFTGTK_STALL_HANDLER", name,
+                          "REDSHIFTGTK_STALL_DURATION_US", duration_field,
+                          "MESSAGE", "Main loop stalled for %" G_GINT64_FORMAT " ms in %s",
+                          duration / 1000, name);
+}
+
+/* Runs on the main loop, a stall the watchdog saw is over once
+ * this gets to run again
+ */
+static gboolean
+redshiftgtk_stall_monitor_heartbeat_cb (gpointer data)
+{
+        RedshiftGtkStallMonitor *self = data;
+        gint64 now = g_get_monotonic_time ();
+        const gchar *name;
+        gint64 start;
+
+        g_mutex_lock (&self->mutex);
+        self->beat = now;
+        name = self->stalled_in;
+        start = self->stall_start;
+        self->stalled_in = NULL;
+        g_mutex_unlock (&self->mutex);
+
+        if (name)
+                redshiftgtk_stall_monitor_record (self, name, now - start);
+
+        return G_SOURCE_CONTINUE;
+}
+
+static gpointer
+redshiftgtk_stall_monitor_thread (gpointer data)
+{
+        RedshiftGtkStallMonitor *self = data;
+
+        g_mutex_lock (&self->mutex);
+        while (!self->quit) {
+                gint64 now = g_get_monotonic_time ();
+
+                /* Blame whatever runs the moment it goes over */
+                if (!self->stalled_in && now - self->beat > self->threshold) {
+                        const gchar *name = g_atomic_pointer_get (&current);
+
+                        self->stalled_in = name ? name : UNATTRIBUTED;
+                        self->stall_start = self->beat;
+                }
+
+                g_cond_wait_until (&self->cond, &self->mutex, now + self->threshold / 4);
+        }
+        g_mutex_unlock (&self->mutex);
+
+        return NULL;
+}
+
+/**
+ * redshiftgtk_stall_monitor_start_default
+ *
+ * Watch the default main context for stalls over @threshold
+ * milliseconds. Only the first call starts anything.
+ */
+RedshiftGtkStallMonitor*
+redshiftgtk_stall_monitor_start_default (guint threshold)
+{
+        RedshiftGtkStallMonitor *self;
+
+        g_assert (threshold > 0);
+
+        if (default_monitor)
+                return default_monitor;
+
+        self = g_object_new (REDSHIFTGTK_TYPE_STALL_MONITOR, NULL);
+        self->threshold = (gint64) threshold * 1000;
+        self->beat = g_get_monotonic_time ();
+
+        /* Ahead of everything else that is ready, so work waiting
+         * in line doesn't count as a stall
+         */
+        self->heartbeat_id = g_timeout_add_full (G_PRIORITY_HIGH, MAX (threshold / 4, 1),
+                                                 redshiftgtk_stall_monitor_heartbeat_cb,
+                                                 self, NULL);
+        self->thread = g_thread_new ("redshiftgtk-watchdog",
+                                     redshiftgtk_stall_monitor_thread, self);
+
+        default_monitor = self;
+
+        return self;
+}
+
+/**
+ * redshiftgtk_stall_monitor_start_from_env
+ *
+ * Start the default monitor if REDSHIFTGTK_STALL_THRESHOLD_MS asks
+ * for it, otherwise leave it off and return NULL
+ */
+RedshiftGtkStallMonitor*
+redshiftgtk_stall_monitor_start_from_env (void)
+{
+        const gchar *value = g_getenv (REDSHIFTGTK_STALL_MONITOR_ENV);
+        guint64 threshold;
+        gchar *end = NULL;
+
+        if (!value || !*value)
+                return NULL;
+
+        threshold = g_ascii_strtoull (value, &end, 10);
+        if (*end != '\0' || threshold == 0 || threshold > G_MAXUINT) {
+                g_warning ("redshiftgtk_stall_monitor_start_from_env\n\
+        g_ascii_strtoull: %s is not a threshold\n", value);
+                return NULL;
+        }
+
+        return redshiftgtk_stall_monitor_start_default ((guint) threshold);
+}
+
+RedshiftGtkStallMonitor*
+redshiftgtk_stall_monitor_get_default (void)
+{
+        return default_monitor;
+}
+
+guint
+redshiftgtk_stall_monitor_get_stall_count (RedshiftGtkStallMonitor *self)
+{
+        return self->stall_count;
+}
+
+/* Microseconds */
+gint64
+redshiftgtk_stall_monitor_get_longest_stall (RedshiftGtkStallMonitor *self)
+{
+        return self->longest;
+}
+
+/**
+ * redshiftgtk_stall_monitor_get_stats
+ *
+ * Stalls per handler so far, as STALL_MONITOR_STATS_TYPE
+ */
+GVariant*
+redshiftgtk_stall_monitor_get_stats (RedshiftGtkStallMonitor *self)
+{
+        GVariantBuilder builder;
+        GHashTableIter iter;
+        const gchar *name;
+        StallStats *stats;
+
+        g_variant_builder_init (&builder, STALL_MONITOR_STATS_TYPE);
+
+        g_hash_table_iter_init (&iter, self->stats);
+        while (g_hash_table_iter_next (&iter, (gpointer *) &name, (gpointer *) &stats))
+                g_variant_builder_add (&builder, "{s(uxx)}", name,
+                                       stats->count, stats->total, stats->longest);
+
+        return g_variant_builder_end (&builder);
+}
+
+/**
+ * redshiftgtk_stall_monitor_enter
+ *
+ * Mark the main thread as running @name, a static string, until the
+ * matching redshiftgtk_stall_monitor_leave()
+ */
+void
+redshiftgtk_stall_monitor_enter (const gchar *name)
+{
+        if (!default_monitor)
+                return;
+
+        if (depth < MAX_DEPTH)
+                handlers[depth] = name;
+        depth++;
+
+        g_atomic_pointer_set (&current, name);
+}
+
+void
+redshiftgtk_stall_monitor_leave (void)
+{
+        /* Started in the middle of a handler */
+        if (depth == 0)
+                return;
+
+        depth--;
+
+        g_atomic_pointer_set (&current, depth ? handlers[MIN (depth, MAX_DEPTH) - 1] : NULL);
+}
+
+static void
+redshiftgtk_stall_monitor_guard_enter (gpointer  data,
+                                       GClosure *closure)
+{
+        redshiftgtk_stall_monitor_enter (data);
+}
+
+static void
+redshiftgtk_stall_monitor_guard_leave (gpointer  data,
+                                       GClosure *closure)
+{
+        redshiftgtk_stall_monitor_leave ();
+}
+
+static gulong
+redshiftgtk_stall_monitor_connect_closure (gpointer       instance,
+                                           const gchar   *signal,
+                                           GClosure      *closure,
+                                           const gchar   *name,
+                                           GConnectFlags  flags)
+{
+        g_closure_add_marshal_guards (closure,
+                                      (gpointer) name, redshiftgtk_stall_monitor_guard_enter,
+                                      NULL, redshiftgtk_stall_monitor_guard_leave);
+
+        return g_signal_connect_closure (instance, signal, closure,
+                                         (flags & G_CONNECT_AFTER) != 0);
+}
+
+/**
+ * redshiftgtk_stall_monitor_connect
+ *
+ * g_signal_connect_data() that names the handler @name while it runs.
+ * A plain connection unless the monitor was started before.
+ */
+gulong
+redshiftgtk_stall_monitor_connect (gpointer       instance,
+                                   const gchar   *signal,
+                                   GCallback      callback,
+                                   gpointer       data,
+                                   const gchar   *name,
+                                   GConnectFlags  flags)
+{
+        GClosure *closure;
+
+        if (!default_monitor)
+                return g_signal_connect_data (instance, signal, callback, data, NULL, flags);
+
+        if (flags & G_CONNECT_SWAPPED)
+                closure = g_cclosure_new_swap (callback, data, NULL);
+        else
+                closure = g_cclosure_new (callback, data, NULL);
+
+        return redshiftgtk_stall_monitor_connect_closure (instance, signal, closure, name, flags);
+}
+
+/**
+ * redshiftgtk_stall_monitor_connect_object
+ *
+ * The same for g_signal_connect_object()
+ */
+gulong
+redshiftgtk_stall_monitor_connect_object (gpointer       instance,
+                                          const gchar   *signal,
+                                          GCallback      callback,
+                                          gpointer       gobject,
+                                          const gchar   *name,
+                                          GConnectFlags  flags)
+{
+        GClosure *closure;
+
+        if (!default_monitor)
+                return g_signal_connect_object (instance, signal, callback, gobject, flags);
+
+        if (flags & G_CONNECT_SWAPPED)
+                closure = g_cclosure_new_object_swap (callback, G_OBJECT (gobject));
+        else
+                closure = g_cclosure_new_object (callback, G_OBJECT (gobject));
+
+        return redshiftgtk_stall_monitor_connect_closure (instance, signal, closure, name, flags);
+}
@@ -0,0 +1,86 @@
+/* redshiftgtk-stall-monitor.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/* Opt-in watchdog for the default main context. A thread notices when
+ * the main loop stopped turning for longer than a threshold and blames
+ * the handler that was running, as far as it was connected through
+ * REDSHIFTGTK_SIGNAL_CONNECT() or marked with enter/leave.
+ */
+#define REDSHIFTGTK_TYPE_STALL_MONITOR redshiftgtk_stall_monitor_get_type ()
+G_DECLARE_FINAL_TYPE (RedshiftGtkStallMonitor, redshiftgtk_stall_monitor,
+                      REDSHIFTGTK, STALL_MONITOR, GObject)
+
+/* Milliseconds, REDSHIFTGTK_STALL_THRESHOLD_MS turns it on */
+#define REDSHIFTGTK_STALL_MONITOR_ENV "REDSHIFTGTK_STALL_THRESHOLD_MS"
+
+/* GVariant type of redshiftgtk_stall_monitor_get_stats(): handler name
+ * to number of stalls, total and longest duration in microseconds
+ */
+#define STALL_MONITOR_STATS_TYPE ((const GVariantType *) "a{s(uxx)}")
+
+RedshiftGtkStallMonitor*
+redshiftgtk_stall_monitor_start_default   (guint                    threshold);
+RedshiftGtkStallMonitor*
+redshiftgtk_stall_monitor_start_from_env  (void);
+RedshiftGtkStallMonitor*
+redshiftgtk_stall_monitor_get_default     (void);
+
+guint
+redshiftgtk_stall_monitor_get_stall_count   (RedshiftGtkStallMonitor *self);
+gint64
+redshiftgtk_stall_monitor_get_longest_stall (RedshiftGtkStallMonitor *self);
+GVariant*
+redshiftgtk_stall_monitor_get_stats         (RedshiftGtkStallMonitor *self);
+
+void
+redshiftgtk_stall_monitor_enter (const gchar *name);
+void
+redshiftgtk_stall_monitor_leave (void);
+
+gulong
+redshiftgtk_stall_monitor_connect        (gpointer       instance,
+                                          const gchar   *signal,
+                                          GCallback      callback,
+                                          gpointer       data,
+                                          const gchar   *name,
+                                          GConnectFlags  flags);
+gulong
+redshiftgtk_stall_monitor_connect_object (gpointer       instance,
+                                          const gchar   *signal,
+                                          GCallback      callback,
+                                          gpointer       gobject,
+                                          const gchar   *name,
+                                          GConnectFlags  flags);
+
+/* g_signal_connect() and friends, with the callback's name for blame */
+#define REDSHIFTGTK_SIGNAL_CONNECT(instance, signal, callback, data) \
+        redshiftgtk_stall_monitor_connect ((instance), (signal), G_CALLBACK (callback), \
+                                           (data), #callback, 0)
+#define REDSHIFTGTK_SIGNAL_CONNECT_SWAPPED(instance, signal, callback, data) \
+        redshiftgtk_stall_monitor_connect ((instance), (signal), G_CALLBACK (callback), \
+                                           (data), #callback, G_CONNECT_SWAPPED)
+#define REDSHIFTGTK_SIGNAL_CONNECT_OBJECT(instance, signal, callback, gobject, flags) \
+        redshiftgtk_stall_monitor_connect_object ((instance), (signal), G_CALLBACK (callback), \
+                                                  (gobject), #callback, (flags))
+
+G_END_DECLS
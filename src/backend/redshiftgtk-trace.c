@@ -0,0 +1,67 @@
+/* redshiftgtk-trace.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "redshiftgtk-config.h"
+
+#ifdef HAVE_SYSPROF
+#include <sysprof-capture.h>
+#endif
+
+#include "redshiftgtk-trace.h"
+
+gboolean redshiftgtk_trace_enabled = FALSE;
+
+/**
+ * redshiftgtk_trace_init
+ *
+ * Turn spans on if @enable or REDSHIFTGTK_PROFILE is set. Call it
+ * once, before anything worth timing.
+ */
+void
+redshiftgtk_trace_init (gboolean enable)
+{
+        const gchar *value = g_getenv (REDSHIFTGTK_TRACE_ENV);
+
+        if (value && *value && g_strcmp0 (value, "0") != 0)
+                enable = TRUE;
+
+        redshiftgtk_trace_enabled = enable;
+}
+
+/**
+ * redshiftgtk_trace_mark
+ *
+ * Record a span @name from @begin, a g_get_monotonic_time() stamp,
+ * until now
+ */
+void
+redshiftgtk_trace_mark (gint64       begin,
+                        const gchar *name,
+                        const gchar *message)
+{
+        gint64 duration = g_get_monotonic_time () - begin;
+
+#ifdef HAVE_SYSPROF
+        /* Same clock, sysprof counts in nanoseconds */
+        sysprof_collector_mark (begin * 1000, duration * 1000,
+                                "RedshiftGtk", name, message);
+#else
+        g_printerr ("redshiftgtk-trace: %-36s %8.3f ms%s%s\n",
+                    name, duration / 1000.0,
+                    message ? "  " : "", message ? message : "");
+#endif
+}
@@ -0,0 +1,73 @@
+/* redshiftgtk-trace.h
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Timing spans, sent to sysprof when built with sysprof-capture and
+ * printed otherwise. Off unless --profile or REDSHIFTGTK_PROFILE turns
+ * them on, and then a span costs one branch on entry and one on exit.
+ */
+#define REDSHIFTGTK_TRACE_ENV "REDSHIFTGTK_PROFILE"
+
+extern gboolean redshiftgtk_trace_enabled;
+
+typedef struct {
+        gint64 begin;
+        const gchar *name;
+} RedshiftGtkTraceSpan;
+
+void
+redshiftgtk_trace_init   (gboolean     enable);
+void
+redshiftgtk_trace_mark   (gint64       begin,
+                          const gchar *name,
+                          const gchar *message);
+
+/* Start of a span, 0 while tracing is off */
+static inline gint64
+redshiftgtk_trace_begin (void)
+{
+        return G_UNLIKELY (redshiftgtk_trace_enabled) ? g_get_monotonic_time () : 0;
+}
+
+/* End of a span that started at @begin */
+static inline void
+redshiftgtk_trace_end (gint64       begin,
+                       const gchar *name)
+{
+        if (G_UNLIKELY (begin))
+                redshiftgtk_trace_mark (begin, name, NULL);
+}
+
+static inline void
+redshiftgtk_trace_span_clear (RedshiftGtkTraceSpan *span)
+{
+        redshiftgtk_trace_end (span->begin, span->name);
+}
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (RedshiftGtkTraceSpan, redshiftgtk_trace_span_clear)
+
+/* A span from here to the end of the enclosing scope */
+#define REDSHIFTGTK_TRACE_SPAN(name) \
+        g_auto (RedshiftGtkTraceSpan) G_PASTE (trace_span_, __LINE__) = \
+                { redshiftgtk_trace_begin (), (name) }
+
+G_END_DECLS
@@ -0,0 +1,399 @@
+/* redshiftgtk-cli.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <locale.h>
+#include <glib/gi18n.h>
+
+#include "redshiftgtk-config.h"
+
+#include "backend/redshiftgtk-backend.h"
+#include "backend/redshiftgtk-control-server.h"
+#include "backend/redshiftgtk-dbus-client.h"
+#include "backend/redshiftgtk-metrics.h"
+#include "backend/redshiftgtk-settings-schema.h"
+#include "backend/redshiftgtk-trace.h"
+
+typedef gboolean (*SettingSetter) (RedshiftGtkBackend *backend,
+                                   const gchar        *value,
+                                   GError            **error);
+
+typedef struct {
+        const gchar  *key;
+        SettingSetter set;
+} SettingEntry;
+
+static gboolean
+parse_double (const gchar *value,
+              gdouble     *result,
+              GError     **error)
+{
+        if (!redshiftgtk_settings_schema_parse_number (value, result)) {
+                g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                             _("“%s” is not a number"), value);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+static gboolean
+set_temp_day (RedshiftGtkBackend *backend, const gchar *value, GError **error)
+{
+        gdouble temperature;
+
+        if (!parse_double (value, &temperature, error))
+                return FALSE;
+
+        redshiftgtk_backend_set_temperature (backend, TIME_PERIOD_DAY, temperature);
+        return TRUE;
+}
+
+static gboolean
+set_temp_night (RedshiftGtkBackend *backend, const gchar *value, GError **error)
+{
+        gdouble temperature;
+
+        if (!parse_double (value, &temperature, error))
+                return FALSE;
+
+        redshiftgtk_backend_set_temperature (backend, TIME_PERIOD_NIGHT, temperature);
+        return TRUE;
+}
+
+static gboolean
+set_brightness_day (RedshiftGtkBackend *backend, const gchar *value, GError **error)
+{
+        gdouble brightness;
+
+        if (!parse_double (value, &brightness, error))
+                return FALSE;
+
+        redshiftgtk_backend_set_brightness (backend, TIME_PERIOD_DAY, brightness);
+        return TRUE;
+}
+
+static gboolean
+set_brightness_night (RedshiftGtkBackend *backend, const gchar *value, GError **error)
+{
+        gdouble brightness;
+
+        if (!parse_double (value, &brightness, error))
+                return FALSE;
+
+        redshiftgtk_backend_set_brightness (backend, TIME_PERIOD_NIGHT, brightness);
+        return TRUE;
+}
+
+static gboolean
+set_gamma (RedshiftGtkBackend *backend,
+           TimePeriod          period,
+           const gchar        *value,
+           GError            **error)
+{
+        SettingValue rgb;
+
+        if (!redshiftgtk_settings_schema_parse_gamma (value, rgb)) {
+                g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                             _("“%s” is not a gamma value, use G or R:G:B"), value);
+                return FALSE;
+        }
+
+        redshiftgtk_backend_set_gamma (backend, period, rgb[0], rgb[1], rgb[2]);
+        return TRUE;
+}
+
+static gboolean
+set_gamma_day (RedshiftGtkBackend *backend, const gchar *value, GError **error)
+{
+        return set_gamma (backend, TIME_PERIOD_DAY, value, error);
+}
+
+static gboolean
+set_gamma_night (RedshiftGtkBackend *backend, const gchar *value, GError **error)
+{
+        return set_gamma (backend, TIME_PERIOD_NIGHT, value, error);
+}
+
+static gboolean
+set_location_provider (RedshiftGtkBackend *backend, const gchar *value, GError **error)
+{
+        if (g_strcmp0 (value, "manual") == 0) {
+                redshiftgtk_backend_set_location_provider (backend, LOCATION_PROVIDER_MANUAL);
+        } else if (g_strcmp0 (value, "auto") == 0 || g_strcmp0 (value, "geoclue2") == 0) {
+                redshiftgtk_backend_set_location_provider (backend, LOCATION_PROVIDER_AUTO);
+        } else {
+                g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                             _("Unknown location provider “%s”"), value);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+static gboolean
+set_latitude (RedshiftGtkBackend *backend, const gchar *value, GError **error)
+{
+        gdouble latitude;
+
+        if (!parse_double (value, &latitude, error))
+                return FALSE;
+
+        redshiftgtk_backend_set_latitude (backend, latitude);
+        return TRUE;
+}
+
+static gboolean
+set_longtitude (RedshiftGtkBackend *backend, const gchar *value, GError **error)
+{
+        gdouble longtitude;
+
+        if (!parse_double (value, &longtitude, error))
+                return FALSE;
+
+        redshiftgtk_backend_set_longtitude (backend, longtitude);
+        return TRUE;
+}
+
+static gboolean
+set_adjustment_method (RedshiftGtkBackend *backend, const gchar *value, GError **error)
+{
+        if (g_strcmp0 (value, "randr") == 0) {
+                redshiftgtk_backend_set_adjustment_method (backend, ADJUSTMENT_METHOD_RANDR);
+        } else if (g_strcmp0 (value, "vidmode") == 0) {
+                redshiftgtk_backend_set_adjustment_method (backend, ADJUSTMENT_METHOD_VIDMODE);
+        } else if (g_strcmp0 (value, "auto") == 0) {
+                redshiftgtk_backend_set_adjustment_method (backend, ADJUSTMENT_METHOD_AUTO);
+        } else {
+                g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                             _("Unknown adjustment method “%s”"), value);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+static gboolean
+set_fade (RedshiftGtkBackend *backend, const gchar *value, GError **error)
+{
+        if (g_strcmp0 (value, "1") == 0 || g_strcmp0 (value, "true") == 0) {
+                redshiftgtk_backend_set_smooth_transition (backend, TRUE);
+        } else if (g_strcmp0 (value, "0") == 0 || g_strcmp0 (value, "false") == 0) {
+                redshiftgtk_backend_set_smooth_transition (backend, FALSE);
+        } else {
+                g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                             _("“%s” is not a boolean"), value);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+/* Keys follow the names used in redshift.conf */
+static const SettingEntry settings[] = {
+        { "temp-day",          set_temp_day },
+        { "temp-night",        set_temp_night },
+        { "brightness-day",    set_brightness_day },
+        { "brightness-night",  set_brightness_night },
+        { "gamma-day",         set_gamma_day },
+        { "gamma-night",       set_gamma_night },
+        { "location-provider", set_location_provider },
+        { "lat",               set_latitude },
+        { "lon",               set_longtitude },
+        { "adjustment-method", set_adjustment_method },
+        { "fade",              set_fade },
+};
+
+static gboolean
+apply_setting (RedshiftGtkBackend *backend,
+               const gchar        *assignment,
+               GError            **error)
+{
+        g_auto (GStrv) parts = g_strsplit (assignment, "=", 2);
+        guint i;
+
+        if (g_strv_length (parts) != 2) {
+                g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                             _("Expected KEY=VALUE, got “%s”"), assignment);
+                return FALSE;
+        }
+
+        for (i = 0; i < G_N_ELEMENTS (settings); i++) {
+                if (g_strcmp0 (settings[i].key, parts[0]) == 0)
+                        return settings[i].set (backend, parts[1], error);
+        }
+
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_UNKNOWN_OPTION,
+                     _("Unknown setting “%s”"), parts[0]);
+        return FALSE;
+}
+
+/* KEY= makes the output follow the profile again */
+static gboolean
+apply_output_setting (RedshiftGtkBackend *backend,
+                      const gchar        *output,
+                      const gchar        *assignment,
+                      GError            **error)
+{
+        g_auto (GStrv) parts = g_strsplit (assignment, "=", 2);
+
+        if (g_strv_length (parts) != 2) {
+                g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                             _("Expected KEY=VALUE, got “%s”"), assignment);
+                return FALSE;
+        }
+
+        redshiftgtk_backend_set_output_setting (backend, output, parts[0],
+                                                *parts[1] ? parts[1] : NULL, error);
+        return error == NULL || *error == NULL;
+}
+
+static void
+list_outputs (RedshiftGtkBackend *backend)
+{
+        g_autoptr (GPtrArray) outputs = redshiftgtk_backend_list_outputs (backend);
+        guint i;
+
+        for (i = 0; i < outputs->len; i++) {
+                RedshiftGtkOutput *output = g_ptr_array_index (outputs, i);
+
+                g_print ("%s\tcrtc=%u\tramp-size=%u\n",
+                         output->name, output->crtc, output->ramp_size);
+        }
+}
+
+int
+main (int argc, char *argv[])
+{
+        g_autoptr (GOptionContext) context = NULL;
+        g_autoptr (RedshiftGtkBackend) backend = NULL;
+        g_autoptr (GError) error = NULL;
+        g_auto (GStrv) assignments = NULL;
+        g_autofree gchar *command = NULL;
+        g_autofree gchar *output = NULL;
+        gboolean outputs = FALSE;
+        gboolean apply = FALSE;
+        gboolean stop = FALSE;
+        gboolean profile = FALSE;
+        guint i;
+
+        const GOptionEntry entries[] = {
+                { "set", 's', 0, G_OPTION_ARG_STRING_ARRAY, &assignments,
+                  N_("Change a setting and save it"), N_("KEY=VALUE") },
+                { "output", 'o', 0, G_OPTION_ARG_STRING, &output,
+                  N_("Make --set change only this output, an empty VALUE makes it follow the profile"),
+                  N_("NAME") },
+                { "list-outputs", 0, 0, G_OPTION_ARG_NONE, &outputs,
+                  N_("List the lit outputs"), NULL },
+                { "apply", 'a', 0, G_OPTION_ARG_NONE, &apply,
+                  N_("(Re)start redshift with the saved settings"), NULL },
+                { "stop", 'x', 0, G_OPTION_ARG_NONE, &stop,
+                  N_("Stop redshift and reset the screen"), NULL },
+                { "send", 'c', 0, G_OPTION_ARG_STRING, &command,
+                  N_("Send a command to the control socket of a running instance"),
+                  N_("COMMAND") },
+                { "profile", 0, 0, G_OPTION_ARG_NONE, &profile,
+                  N_("Print how long loading and applying take"), NULL },
+                { NULL }
+        };
+
+        setlocale (LC_ALL, "");
+
+        /* Set up gettext translations */
+        bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+        bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+        textdomain (GETTEXT_PACKAGE);
+
+        context = g_option_context_new (NULL);
+        g_option_context_set_summary (context,
+                _("Change redshift settings without starting the user interface."));
+        g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+
+        if (!g_option_context_parse (context, &argc, &argv, &error)) {
+                g_printerr ("%s\n", error->message);
+                return EXIT_FAILURE;
+        }
+
+        redshiftgtk_trace_init (profile);
+        /* Written on exit, there is no main loop to flush from */
+        redshiftgtk_metrics_start_from_env ("redshiftgtk-cli");
+
+        /* Hotkeys only talk to the socket, nothing is loaded */
+        if (command) {
+                g_autofree gchar *path = redshiftgtk_control_socket_path ();
+                g_autofree gchar *reply = redshiftgtk_control_send (path, command, &error);
+
+                if (!reply) {
+                        g_printerr ("%s\n", error->message);
+                        return EXIT_FAILURE;
+                }
+
+                g_print ("%s\n", reply);
+                return g_str_has_prefix (reply, "OK") ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        if (!assignments && !apply && !stop && !outputs) {
+                g_autofree gchar *help = g_option_context_get_help (context, TRUE, NULL);
+                g_printerr ("%s", help);
+                return EXIT_FAILURE;
+        }
+
+        if (apply && stop) {
+                g_printerr ("%s\n", _("--apply and --stop can not be used together"));
+                return EXIT_FAILURE;
+        }
+
+        /* Go through the daemon if it runs so it stays in sync */
+        backend = redshiftgtk_dbus_client_new (NULL, NULL);
+        if (!backend)
+                backend = redshiftgtk_backend_new_local ();
+
+        if (outputs)
+                list_outputs (backend);
+
+        if (assignments) {
+                for (i = 0; assignments[i] != NULL; i++) {
+                        gboolean set = output ?
+                                apply_output_setting (backend, output, assignments[i], &error) :
+                                apply_setting (backend, assignments[i], &error);
+
+                        if (!set) {
+                                g_printerr ("%s\n", error->message);
+                                return EXIT_FAILURE;
+                        }
+                }
+
+                redshiftgtk_backend_apply_changes (backend, &error);
+                if (error) {
+                        g_printerr (_("Could not save settings: %s\n"), error->message);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (stop)
+                redshiftgtk_backend_stop (backend);
+
+        if (apply) {
+                redshiftgtk_backend_start (backend, &error);
+                if (error) {
+                        g_printerr (_("Could not start redshift: %s\n"), error->message);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        return EXIT_SUCCESS;
+}
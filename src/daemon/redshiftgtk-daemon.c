@@ -0,0 +1,134 @@
+/* redshiftgtk-daemon.c
+ *
+ * Copyright 2019 Stefan Ric
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <locale.h>
+#include <signal.h>
+#include <glib/gi18n.h>
+#include <glib-unix.h>
+
+#include "redshiftgtk-config.h"
+
+#include "backend/redshiftgtk-backend.h"
+#include "backend/redshiftgtk-control-server.h"
+#include "backend/redshiftgtk-dbus-service.h"
+#include "backend/redshiftgtk-metrics.h"
+#include "backend/redshiftgtk-stall-monitor.h"
+#include "backend/redshiftgtk-trace.h"
+
+typedef struct {
+        GMainLoop *loop;
+        RedshiftGtkDBusService *service;
+        RedshiftGtkControlServer *control;
+        gint exit_status;
+} Daemon;
+
+static void
+bus_acquired_cb (GDBusConnection *connection,
+                 const gchar     *name,
+                 gpointer         user_data)
+{
+        Daemon *daemon = user_data;
+        g_autoptr (GError) error = NULL;
+
+        if (!redshiftgtk_dbus_service_export (daemon->service, connection, &error)) {
+                g_warning ("bus_acquired_cb\n\
+        redshiftgtk_dbus_service_export: %s\n", error->message);
+                daemon->exit_status = EXIT_FAILURE;
+                g_main_loop_quit (daemon->loop);
+        }
+}
+
+static void
+name_lost_cb (GDBusConnection *connection,
+              const gchar     *name,
+              gpointer         user_data)
+{
+        Daemon *daemon = user_data;
+
+        /* Either there is no bus or another daemon already runs */
+        g_printerr (_("Could not own %s on the session bus\n"), name);
+        daemon->exit_status = EXIT_FAILURE;
+        g_main_loop_quit (daemon->loop);
+}
+
+static gboolean
+quit_cb (gpointer user_data)
+{
+        Daemon *daemon = user_data;
+
+        g_main_loop_quit (daemon->loop);
+
+        return G_SOURCE_REMOVE;
+}
+
+int
+main (int argc, char *argv[])
+{
+        g_autoptr (RedshiftGtkBackend) backend = NULL;
+        g_autoptr (GError) error = NULL;
+        Daemon daemon = { 0 };
+        guint owner_id;
+
+        setlocale (LC_ALL, "");
+
+        /* Set up gettext translations */
+        bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+        bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+        textdomain (GETTEXT_PACKAGE);
+
+        /* Before anything connects, so every handler gets a name */
+        redshiftgtk_stall_monitor_start_from_env ();
+        redshiftgtk_trace_init (FALSE);
+        redshiftgtk_metrics_start_from_env ("redshiftgtk-daemon");
+
+        /* Config is parsed once here and kept for the whole session */
+        backend = redshiftgtk_backend_new_local ();
+
+        daemon.loop = g_main_loop_new (NULL, FALSE);
+        daemon.service = redshiftgtk_dbus_service_new (backend);
+        daemon.exit_status = EXIT_SUCCESS;
+
+        /* Hotkey socket, not fatal if something else already serves it */
+        daemon.control = redshiftgtk_control_server_new (backend);
+        if (!redshiftgtk_control_server_start (daemon.control, NULL, &error))
+                g_message ("Control socket not available: %s", error->message);
+
+        owner_id = g_bus_own_name (G_BUS_TYPE_SESSION,
+                                   REDSHIFTGTK_DBUS_NAME,
+                                   G_BUS_NAME_OWNER_FLAGS_NONE,
+                                   bus_acquired_cb,
+                                   NULL,
+                                   name_lost_cb,
+                                   &daemon,
+                                   NULL);
+
+        g_unix_signal_add (SIGINT, quit_cb, &daemon);
+        g_unix_signal_add (SIGTERM, quit_cb, &daemon);
+
+        g_main_loop_run (daemon.loop);
+
+        g_bus_unown_name (owner_id);
+        redshiftgtk_dbus_service_unexport (daemon.service);
+        redshiftgtk_control_server_stop (daemon.control);
+        g_clear_object (&daemon.service);
+        g_clear_object (&daemon.control);
+        g_main_loop_unref (daemon.loop);
+        redshiftgtk_metrics_stop ();
+
+        return daemon.exit_status;
+}
@@ -38,3 +38,11 @@ typedef enum {
         TIME_PERIOD_DAY = 0,
         TIME_PERIOD_NIGHT = 1
 } TimePeriod;
+
+/* Where a setting came from, lowest priority first */
+typedef enum {
+        CONFIG_LAYER_DEFAULT = 0,
+        CONFIG_LAYER_SYSTEM = 1,
+        CONFIG_LAYER_USER = 2,
+        CONFIG_LAYER_RUNTIME = 3
+} ConfigLayer;
@@ -20,6 +20,8 @@
 #include <math.h>
 
 #include "redshiftgtk-radial-slider.h"
+#include "backend/redshiftgtk-metrics.h"
+#include "backend/redshiftgtk-trace.h"
 
 enum {
         PROP_ADJUSTMENT = 1,
@@ -296,6 +298,9 @@ redshiftgtk_radial_slider_draw (GtkWidget *widget, cairo_t *cr)
         RedshiftGtkRadialSlider *self = NULL;
         gdouble knob_radius, track_width, radius, real_radius, knob_x, knob_y;
         GdkRGBA fg, track, knob = { 0 };
+        REDSHIFTGTK_TRACE_SPAN ("slider draw");
+
+        redshiftgtk_metrics_count (METRIC_REDRAWS, 1);
 
         self = REDSHIFTGTK_RADIAL_SLIDER (widget);
         knob_radius = self->priv->knob_radius;
@@ -632,6 +637,7 @@ redshiftgtk_radial_slider_init (RedshiftGtkRadialSlider *self)
         self->priv->map_slope = 0;
 
         gtk_widget_set_events (GTK_WIDGET (self), GDK_BUTTON_PRESS_MASK
+                | GDK_BUTTON_RELEASE_MASK
                 | GDK_BUTTON1_MOTION_MASK
                 | GDK_SCROLL_MASK);
 }
@@ -21,8 +21,14 @@
 #include "redshiftgtk-window.h"
 #include "redshiftgtk-radial-slider.h"
 
+#include "backend/redshiftgtk-apply-pipeline.h"
 #include "backend/redshiftgtk-backend.h"
-#include "backend/redshiftgtk-redshift-wrapper.h"
+#include "backend/redshiftgtk-control-server.h"
+#include "backend/redshiftgtk-dbus-client.h"
+#include "backend/redshiftgtk-gsettings-backend.h"
+#include "backend/redshiftgtk-settings-model.h"
+#include "backend/redshiftgtk-stall-monitor.h"
+#include "backend/redshiftgtk-trace.h"
 
 typedef RedshiftGtkRadialSlider RadialSlider;
 
@@ -50,6 +56,8 @@ struct _RedshiftGtkWindow
         GtkComboBoxText *method_combobox;
         GtkSwitch       *transition_switch;
         GtkSwitch       *autostart_switch;
+        GtkSwitch       *auto_apply_switch;
+        GtkComboBoxText *profile_combobox;
         GtkButton       *stop_button;
         GtkButton       *apply_button;
         GtkButton       *cancel_button;
@@ -60,28 +68,145 @@ struct _RedshiftGtkWindow
 
         /* Backend */
         RedshiftGtkBackend *backend;
+        RedshiftGtkControlServer *control;
+
+        /* Authoritative copy of the values shown in the controls */
+        RedshiftGtkSettingsModel *settings;
+
+        /* Live preview while dragging a slider */
+        RadialSlider    *preview_slider;
+        guint            preview_tick_id;
+        gboolean         preview_pending;
+        gboolean         previewing;
+
+        /* Set while the profile list is rebuilt */
+        gboolean         populating_profiles;
+
+        /* Apply in flight, if any */
+        RedshiftGtkApplyPipeline *apply;
+
+        /* Auto-apply, NULL without the GSettings schema */
+        GSettings       *preferences;
+
+        /* Set while the model is loaded from the backend */
+        gboolean         loading_settings;
+
+        /* Instances we did not start, asked about one at a time */
+        GPtrArray       *foreign;
 };
 
 G_DEFINE_TYPE (RedshiftGtkWindow, redshiftgtk_window,
                GTK_TYPE_APPLICATION_WINDOW)
 
+enum {
+        PROP_BACKEND = 1,
+        N_PROPS
+};
+
+static GParamSpec *obj_properties[N_PROPS] = { NULL, };
+
+static void apply_finished_cb (GObject      *source_object,
+                               GAsyncResult *result,
+                               gpointer      user_data);
+
 static void
 redshiftgtk_window_dispose (GObject *obj)
 {
         RedshiftGtkWindow *self = REDSHIFTGTK_WINDOW (obj);
 
+        /* Closed right after a change, it still gets applied */
+        if (self->apply)
+                redshiftgtk_apply_pipeline_run_scheduled (self->apply);
+
+        /* Or right after Apply */
+        if (self->apply)
+                redshiftgtk_apply_pipeline_flush (self->apply);
+
+        if (self->backend && self->previewing) {
+                redshiftgtk_backend_end_preview (self->backend);
+                self->previewing = FALSE;
+        }
+
+        if (self->control)
+                redshiftgtk_control_server_stop (self->control);
+
+        g_clear_pointer (&self->apply, redshiftgtk_apply_pipeline_free);
+        g_clear_pointer (&self->foreign, g_ptr_array_unref);
+        g_clear_object (&self->control);
+        g_clear_object (&self->preferences);
+        g_clear_object (&self->settings);
         g_clear_object (&self->backend);
 
         G_OBJECT_CLASS(redshiftgtk_window_parent_class)->dispose(obj);
 }
 
+static void
+redshiftgtk_window_set_property (GObject      *object,
+                                 guint         id,
+                                 const GValue *value,
+                                 GParamSpec   *spec)
+{
+        RedshiftGtkWindow *self = REDSHIFTGTK_WINDOW (object);
+
+        switch (id) {
+        case PROP_BACKEND:
+                g_clear_object (&self->backend);
+                self->backend = g_value_dup_object (value);
+                break;
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, id, spec);
+                break;
+        }
+}
+
+static void
+redshiftgtk_window_get_property (GObject    *object,
+                                 guint       id,
+                                 GValue     *value,
+                                 GParamSpec *spec)
+{
+        RedshiftGtkWindow *self = REDSHIFTGTK_WINDOW (object);
+
+        switch (id) {
+        case PROP_BACKEND:
+                g_value_set_object (value, self->backend);
+                break;
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, id, spec);
+                break;
+        }
+}
+
+static void
+redshiftgtk_window_constructed (GObject *object);
+
 static void
 redshiftgtk_window_class_init (RedshiftGtkWindowClass *klass)
 {
         GObjectClass   *object_class = G_OBJECT_CLASS (klass);
         GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+        object_class->constructed = redshiftgtk_window_constructed;
         object_class->dispose = redshiftgtk_window_dispose;
+        object_class->set_property = redshiftgtk_window_set_property;
+        object_class->get_property = redshiftgtk_window_get_property;
+
+        /**
+         * RedshiftGtkWindow:backend:
+         *
+         * Where the settings come from. The daemon if it runs, a local
+         * backend otherwise when left NULL.
+         */
+        obj_properties[PROP_BACKEND] =
+            g_param_spec_object ("backend",
+                                 "Backend",
+                                 "Where the settings come from",
+                                 REDSHIFTGTK_TYPE_BACKEND,
+                                 G_PARAM_READWRITE |
+                                 G_PARAM_CONSTRUCT_ONLY |
+                                 G_PARAM_STATIC_STRINGS);
+
+        g_object_class_install_properties (object_class, N_PROPS, obj_properties);
 
         gtk_widget_class_set_template_from_resource (widget_class,
                 "/com/github/cybre/RedshiftGtk/ui/redshiftgtk-window.ui");
@@ -119,6 +244,10 @@ redshiftgtk_window_class_init (RedshiftGtkWindowClass *klass)
                                               transition_switch);
         gtk_widget_class_bind_template_child (widget_class, RedshiftGtkWindow,
                                               autostart_switch);
+        gtk_widget_class_bind_template_child (widget_class, RedshiftGtkWindow,
+                                              auto_apply_switch);
+        gtk_widget_class_bind_template_child (widget_class, RedshiftGtkWindow,
+                                              profile_combobox);
         gtk_widget_class_bind_template_child (widget_class, RedshiftGtkWindow,
                                               stop_button);
         gtk_widget_class_bind_template_child (widget_class, RedshiftGtkWindow,
@@ -128,84 +257,272 @@ redshiftgtk_window_class_init (RedshiftGtkWindowClass *klass)
 }
 
 static void
-redshiftgtk_window_populate_controls (RedshiftGtkWindow *self)
+redshiftgtk_window_populate_profiles (RedshiftGtkWindow *self)
 {
-        /* Location provider */
-        LocationProvider location_provider;
-        location_provider = redshiftgtk_backend_get_location_provider (self->backend);
-        switch (location_provider) {
-        case LOCATION_PROVIDER_MANUAL:
-                gtk_stack_set_visible_child_name (self->location_stack, "manual");
+        g_auto (GStrv) profiles = NULL;
+        const gchar *active;
+        guint i;
+
+        self->populating_profiles = TRUE;
+
+        gtk_combo_box_text_remove_all (self->profile_combobox);
+        gtk_combo_box_text_append (self->profile_combobox, "", _("Default"));
+
+        profiles = redshiftgtk_backend_list_profiles (self->backend);
+        for (i = 0; profiles[i]; i++)
+                gtk_combo_box_text_append (self->profile_combobox,
+                                           profiles[i], profiles[i]);
+
+        active = redshiftgtk_backend_get_profile (self->backend);
+        gtk_combo_box_set_active_id (GTK_COMBO_BOX (self->profile_combobox),
+                                     active ? active : "");
+
+        self->populating_profiles = FALSE;
+}
+
+/* Tell where a value came from if it isn't the user's own */
+static void
+redshiftgtk_window_show_source (RedshiftGtkWindow *self,
+                                gpointer           widget,
+                                const gchar       *key)
+{
+        const gchar *tooltip = NULL;
+
+        switch (redshiftgtk_backend_get_source (self->backend, key)) {
+        case CONFIG_LAYER_SYSTEM:
+                tooltip = _("Set by the system configuration");
+                break;
+        case CONFIG_LAYER_RUNTIME:
+                tooltip = _("Temporarily overridden, not saved");
                 break;
         default:
-                gtk_stack_set_visible_child_name (self->location_stack, "automatic");
+                break;
         }
 
-        /* Latitude and longtitude */
-        gtk_spin_button_set_value (self->latitude_spinner,
-                                   redshiftgtk_backend_get_latitude (self->backend));
-        gtk_spin_button_set_value (self->longtitude_spinner,
-                                   redshiftgtk_backend_get_longtitude (self->backend));
-
-        /* Day brightness */
-        gtk_spin_button_set_value (self->day_brightness_spinner,
-                redshiftgtk_backend_get_brightness (self->backend,
-                                                    TIME_PERIOD_DAY));
-
-        /* Day gamma */
-        g_autoptr (GArray) gamma = redshiftgtk_backend_get_gamma (self->backend,
-                                                                  TIME_PERIOD_DAY);
-        if (gamma) {
-                gtk_spin_button_set_value (self->day_gamma_r_spinner,
-                                           g_array_index (gamma, gdouble, 0));
-                gtk_spin_button_set_value (self->day_gamma_g_spinner,
-                                           g_array_index (gamma, gdouble, 1));
-                gtk_spin_button_set_value (self->day_gamma_b_spinner,
-                                           g_array_index (gamma, gdouble, 2));
-        }
+        gtk_widget_set_tooltip_text (GTK_WIDGET (widget), tooltip);
+}
+
+static void
+redshiftgtk_window_populate_sources (RedshiftGtkWindow *self)
+{
+        redshiftgtk_window_show_source (self, self->day_temp_slider, "temp-day");
+        redshiftgtk_window_show_source (self, self->night_temp_slider, "temp-night");
+        redshiftgtk_window_show_source (self, self->location_stack, "location-provider");
+        redshiftgtk_window_show_source (self, self->latitude_spinner, "lat");
+        redshiftgtk_window_show_source (self, self->longtitude_spinner, "lon");
+        redshiftgtk_window_show_source (self, self->day_brightness_spinner, "brightness-day");
+        redshiftgtk_window_show_source (self, self->night_brightness_spinner, "brightness-night");
+        redshiftgtk_window_show_source (self, self->day_gamma_r_spinner, "gamma-day");
+        redshiftgtk_window_show_source (self, self->day_gamma_g_spinner, "gamma-day");
+        redshiftgtk_window_show_source (self, self->day_gamma_b_spinner, "gamma-day");
+        redshiftgtk_window_show_source (self, self->night_gamma_r_spinner, "gamma-night");
+        redshiftgtk_window_show_source (self, self->night_gamma_g_spinner, "gamma-night");
+        redshiftgtk_window_show_source (self, self->night_gamma_b_spinner, "gamma-night");
+        redshiftgtk_window_show_source (self, self->method_combobox, "adjustment-method");
+        redshiftgtk_window_show_source (self, self->transition_switch, "fade");
+}
+
+static void
+redshiftgtk_window_populate_controls (RedshiftGtkWindow *self)
+{
+        REDSHIFTGTK_TRACE_SPAN ("populate_controls");
+
+        /* Controls are bound to the model, so this is all it takes */
+        self->loading_settings = TRUE;
+        redshiftgtk_settings_model_load (self->settings, self->backend);
+        self->loading_settings = FALSE;
+        redshiftgtk_window_populate_profiles (self);
+        redshiftgtk_window_populate_sources (self);
+}
 
-        /* Night brightness */
-        gtk_spin_button_set_value (self->night_brightness_spinner,
-                redshiftgtk_backend_get_brightness (self->backend,
-                                                    TIME_PERIOD_NIGHT));
-
-        /* Night gamma */
-        gamma = redshiftgtk_backend_get_gamma (self->backend, TIME_PERIOD_NIGHT);
-        if (gamma) {
-                gtk_spin_button_set_value (self->night_gamma_r_spinner,
-                                           g_array_index (gamma, gdouble, 0));
-                gtk_spin_button_set_value (self->night_gamma_g_spinner,
-                                           g_array_index (gamma, gdouble, 1));
-                gtk_spin_button_set_value (self->night_gamma_b_spinner,
-                                           g_array_index (gamma, gdouble, 2));
+static void
+backend_changed_cb (RedshiftGtkBackend *backend,
+                    gpointer            data)
+{
+        RedshiftGtkWindow *self = data;
+
+        /* Someone else changed the settings, only changed values update */
+        redshiftgtk_window_populate_controls (self);
+}
+
+static gboolean
+location_provider_to_child_name (GBinding     *binding,
+                                 const GValue *from_value,
+                                 GValue       *to_value,
+                                 gpointer      user_data)
+{
+        switch (g_value_get_int (from_value)) {
+        case LOCATION_PROVIDER_MANUAL:
+                g_value_set_string (to_value, "manual");
+                break;
+        default:
+                g_value_set_string (to_value, "automatic");
         }
 
-        /* Adjustment method */
-        AdjustmentMethod method = redshiftgtk_backend_get_adjustment_method (self->backend);
-        gtk_combo_box_set_active (GTK_COMBO_BOX (self->method_combobox), method);
+        return TRUE;
+}
 
-        /* Smooth transition policy */
-        gtk_switch_set_active (self->transition_switch,
-                               redshiftgtk_backend_get_smooth_transition (self->backend));
+static gboolean
+child_name_to_location_provider (GBinding     *binding,
+                                 const GValue *from_value,
+                                 GValue       *to_value,
+                                 gpointer      user_data)
+{
+        if (g_strcmp0 (g_value_get_string (from_value), "manual") == 0)
+                g_value_set_int (to_value, LOCATION_PROVIDER_MANUAL);
+        else
+                g_value_set_int (to_value, LOCATION_PROVIDER_AUTO);
 
-        /* Autostart policy */
-        gtk_switch_set_active (self->autostart_switch,
-                               redshiftgtk_backend_get_autostart (self->backend));
+        return TRUE;
 }
 
 static void
-adjustment_value_changed_cb (GtkAdjustment *adjustment, gpointer data)
+redshiftgtk_window_bind_controls (RedshiftGtkWindow *self,
+                                  GtkAdjustment     *day_adjustment,
+                                  GtkAdjustment     *night_adjustment)
 {
-        GtkSpinButton *entry = data;
-        gdouble value = gtk_adjustment_get_value (adjustment);
-        gtk_spin_button_set_value (entry, value);
+        const GBindingFlags flags = G_BINDING_BIDIRECTIONAL | G_BINDING_SYNC_CREATE;
+        GObject *settings = G_OBJECT (self->settings);
+
+        /* Temperatures. The spin buttons share these adjustments,
+         * so binding the adjustment covers both controls.
+         */
+        g_object_bind_property (settings, "temp-day",
+                                day_adjustment, "value", flags);
+        g_object_bind_property (settings, "temp-night",
+                                night_adjustment, "value", flags);
+
+        /* Location */
+        g_object_bind_property_full (settings, "location-provider",
+                                     self->location_stack, "visible-child-name",
+                                     flags,
+                                     location_provider_to_child_name,
+                                     child_name_to_location_provider,
+                                     NULL, NULL);
+        g_object_bind_property (settings, "latitude",
+                                self->latitude_spinner, "value", flags);
+        g_object_bind_property (settings, "longtitude",
+                                self->longtitude_spinner, "value", flags);
+
+        /* Day brightness and gamma */
+        g_object_bind_property (settings, "brightness-day",
+                                self->day_brightness_spinner, "value", flags);
+        g_object_bind_property (settings, "gamma-day-red",
+                                self->day_gamma_r_spinner, "value", flags);
+        g_object_bind_property (settings, "gamma-day-green",
+                                self->day_gamma_g_spinner, "value", flags);
+        g_object_bind_property (settings, "gamma-day-blue",
+                                self->day_gamma_b_spinner, "value", flags);
+
+        /* Night brightness and gamma */
+        g_object_bind_property (settings, "brightness-night",
+                                self->night_brightness_spinner, "value", flags);
+        g_object_bind_property (settings, "gamma-night-red",
+                                self->night_gamma_r_spinner, "value", flags);
+        g_object_bind_property (settings, "gamma-night-green",
+                                self->night_gamma_g_spinner, "value", flags);
+        g_object_bind_property (settings, "gamma-night-blue",
+                                self->night_gamma_b_spinner, "value", flags);
+
+        /* Adjustment method, transition and autostart policies */
+        g_object_bind_property (settings, "adjustment-method",
+                                self->method_combobox, "active", flags);
+        g_object_bind_property (settings, "smooth-transition",
+                                self->transition_switch, "active", flags);
+        g_object_bind_property (settings, "autostart",
+                                self->autostart_switch, "active", flags);
+
+        /* Sliders only need to redraw when their value really changed */
+        REDSHIFTGTK_SIGNAL_CONNECT_SWAPPED (settings, "notify::temp-day",
+                                            redshiftgtk_radial_slider_update,
+                                            self->day_temp_slider);
+        REDSHIFTGTK_SIGNAL_CONNECT_SWAPPED (settings, "notify::temp-night",
+                                            redshiftgtk_radial_slider_update,
+                                            self->night_temp_slider);
 }
 
 static void
-spinner_value_changed_cb (GtkSpinButton *spinner, gpointer data)
+redshiftgtk_window_end_preview (RedshiftGtkWindow *self)
+{
+        if (!self->previewing)
+                return;
+
+        redshiftgtk_backend_end_preview (self->backend);
+        self->previewing = FALSE;
+}
+
+static gboolean
+preview_tick_cb (GtkWidget     *widget,
+                 GdkFrameClock *frame_clock,
+                 gpointer       data)
+{
+        RedshiftGtkWindow *self = data;
+        TimePeriod period;
+
+        /* At most one preview per frame, with whatever value is current */
+        if (!self->preview_pending)
+                return G_SOURCE_CONTINUE;
+
+        self->preview_pending = FALSE;
+        self->previewing = TRUE;
+
+        period = (self->preview_slider == self->day_temp_slider) ?
+                        TIME_PERIOD_DAY : TIME_PERIOD_NIGHT;
+        redshiftgtk_backend_preview_temperature (self->backend, period,
+                redshiftgtk_radial_slider_get_value (self->preview_slider));
+
+        return G_SOURCE_CONTINUE;
+}
+
+static void
+preview_value_changed_cb (GObject    *object,
+                          GParamSpec *pspec,
+                          gpointer    data)
+{
+        RedshiftGtkWindow *self = data;
+
+        if (self->preview_slider)
+                self->preview_pending = TRUE;
+}
+
+static gboolean
+slider_button_press_cb (GtkWidget      *widget,
+                        GdkEventButton *event,
+                        gpointer        data)
+{
+        RedshiftGtkWindow *self = data;
+
+        if (event->button != GDK_BUTTON_PRIMARY || self->preview_tick_id)
+                return GDK_EVENT_PROPAGATE;
+
+        self->preview_slider = REDSHIFTGTK_RADIAL_SLIDER (widget);
+        self->preview_tick_id = gtk_widget_add_tick_callback (widget,
+                                                              preview_tick_cb,
+                                                              self, NULL);
+
+        return GDK_EVENT_PROPAGATE;
+}
+
+static gboolean
+slider_button_release_cb (GtkWidget      *widget,
+                          GdkEventButton *event,
+                          gpointer        data)
 {
-        RadialSlider *slider = data;
-        redshiftgtk_radial_slider_update(slider);
+        RedshiftGtkWindow *self = data;
+
+        if (event->button != GDK_BUTTON_PRIMARY || !self->preview_tick_id)
+                return GDK_EVENT_PROPAGATE;
+
+        /* Send the final position, the preview stays on screen
+         * until the changes are applied or the window is closed
+         */
+        preview_tick_cb (widget, NULL, self);
+
+        gtk_widget_remove_tick_callback (widget, self->preview_tick_id);
+        self->preview_tick_id = 0;
+        self->preview_slider = NULL;
+
+        return GDK_EVENT_PROPAGATE;
 }
 
 static void
@@ -261,19 +578,19 @@ redshiftgtk_window_show_try_again_dialog (RedshiftGtkWindow *self,
 
         gtk_widget_show_all (dialog);
 
-        g_signal_connect (GTK_DIALOG (dialog), "response",
-                          G_CALLBACK (try_again_dialog_response_cb),
-                          callback);
+        REDSHIFTGTK_SIGNAL_CONNECT (GTK_DIALOG (dialog), "response",
+                                    try_again_dialog_response_cb,
+                                    callback);
 }
 
 static void
 backend_set_autostart_cb (RedshiftGtkWindow *self)
 {
         g_autoptr (GError) error = NULL;
+        gboolean autostart;
 
-        redshiftgtk_backend_set_autostart (self->backend,
-                gtk_switch_get_active (self->autostart_switch),
-                &error);
+        g_object_get (self->settings, "autostart", &autostart, NULL);
+        redshiftgtk_backend_set_autostart (self->backend, autostart, &error);
 
         if (error) {
                 g_warning ("redshiftgtk_backend_set_autostart: %s\n", error->message);
@@ -281,130 +598,265 @@ backend_set_autostart_cb (RedshiftGtkWindow *self)
                                                           _("Could not enable autostart"),
                                                           error->message,
                                                           &backend_set_autostart_cb);
-                gtk_switch_set_active (self->autostart_switch, FALSE);
+                g_object_set (self->settings, "autostart", FALSE, NULL);
         }
 }
 
+/* The launcher is written after Apply returned, this is where
+ * that can still fail
+ */
 static void
-backend_apply_changes_cb (RedshiftGtkWindow *self)
+backend_autostart_failed_cb (RedshiftGtkBackend *backend,
+                             const gchar        *message,
+                             gpointer            data)
 {
-        g_autoptr (GError) error = NULL;
+        RedshiftGtkWindow *self = data;
 
-        redshiftgtk_backend_apply_changes (self->backend, &error);
+        g_warning ("redshiftgtk_backend_set_autostart: %s\n", message);
+        redshiftgtk_window_show_try_again_dialog (self,
+                                                  _("Could not change autostart"),
+                                                  message,
+                                                  &backend_set_autostart_cb);
+}
 
-        if (error) {
-                g_warning ("redshiftgtk_backend_apply_changes: %s\n", error->message);
-                redshiftgtk_window_show_try_again_dialog (self,
-                                                          _("Could not apply changes"),
-                                                          error->message,
-                                                          &backend_set_autostart_cb);
+static void
+redshiftgtk_window_ask_foreign (RedshiftGtkWindow *self);
+
+static void
+foreign_dialog_response_cb (GtkDialog *dialog,
+                            gint       response_id,
+                            gpointer   data)
+{
+        RedshiftGtkWindow *self = data;
+        RedshiftGtkProcess *process = g_ptr_array_index (self->foreign, 0);
+
+        gtk_widget_destroy (GTK_WIDGET (dialog));
+
+        if (response_id == GTK_RESPONSE_ACCEPT) {
+                g_autoptr (GError) error = NULL;
+
+                redshiftgtk_backend_adopt (self->backend, process->pid, &error);
+                if (error)
+                        g_warning ("redshiftgtk_backend_adopt: %s\n", error->message);
+        } else {
+                redshiftgtk_backend_leave (self->backend, process->pid);
         }
+
+        g_ptr_array_remove_index (self->foreign, 0);
+        redshiftgtk_window_ask_foreign (self);
+}
+
+/* Adopted instances are stopped and replaced along with our own,
+ * the ones left alone are never touched
+ */
+static void
+redshiftgtk_window_ask_foreign (RedshiftGtkWindow *self)
+{
+        RedshiftGtkProcess *process;
+        g_autofree gchar *message = NULL;
+        GtkWidget *dialog;
+        GtkWidget *content_area;
+        GtkWidget *label;
+
+        if (self->foreign->len == 0)
+                return;
+
+        process = g_ptr_array_index (self->foreign, 0);
+
+        dialog = gtk_dialog_new_with_buttons (_("Another redshift is running"),
+                                              GTK_WINDOW (self),
+                                              GTK_DIALOG_MODAL,
+                                              _("Adopt"),
+                                              GTK_RESPONSE_ACCEPT,
+                                              _("Leave"),
+                                              GTK_RESPONSE_REJECT,
+                                              NULL);
+
+        content_area = gtk_dialog_get_content_area (GTK_DIALOG (dialog));
+        gtk_widget_set_margin_top (content_area, 3);
+        gtk_widget_set_margin_start (content_area, 3);
+        gtk_widget_set_margin_end (content_area, 3);
+        gtk_widget_set_margin_bottom (content_area, 3);
+
+        message = g_strdup_printf (_("“%s” (process %d) was not started by RedshiftGtk.\n"
+                                     "Adopt it to stop or replace it with your settings, "
+                                     "RedshiftGtk won't start another while it runs."),
+                                   process->cmdline, (gint) process->pid);
+        label = gtk_label_new (message);
+        gtk_widget_set_margin_top (label, 20);
+        gtk_widget_set_margin_start (label, 20);
+        gtk_widget_set_margin_end (label, 20);
+        gtk_widget_set_margin_bottom (label, 20);
+        gtk_container_add (GTK_CONTAINER (content_area), label);
+
+        gtk_widget_show_all (dialog);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (GTK_DIALOG (dialog), "response",
+                                    foreign_dialog_response_cb,
+                                    self);
 }
 
+static void redshiftgtk_window_apply (RedshiftGtkWindow *self);
+
 static void
-backend_start_cb (RedshiftGtkWindow *self)
+apply_finished_cb (GObject      *source_object,
+                   GAsyncResult *result,
+                   gpointer      user_data)
 {
+        g_autoptr (RedshiftGtkWindow) self = user_data;
         g_autoptr (GError) error = NULL;
+        ApplyStage stage;
 
-        redshiftgtk_backend_start (self->backend, &error);
+        /* Closed in the meantime */
+        if (!self->apply)
+                return;
 
-        if (error) {
-                g_warning ("redshiftgtk_backend_start: %s\n", error->message);
+        if (redshiftgtk_apply_pipeline_run_finish (self->apply, result, &stage, &error)) {
+                /* The new instance replaced the preview */
+                redshiftgtk_window_end_preview (self);
+                return;
+        }
+
+        /* Superseded or stopped, whoever did that takes it from here */
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                return;
+
+        g_warning ("redshiftgtk_apply_pipeline_run\n\
+        %s: %s\n", redshiftgtk_apply_stage_name (stage), error->message);
+
+        switch (stage) {
+        case APPLY_STAGE_AUTOSTART:
+                redshiftgtk_window_show_try_again_dialog (self,
+                                                          _("Could not enable autostart"),
+                                                          error->message,
+                                                          &backend_set_autostart_cb);
+                break;
+        case APPLY_STAGE_START:
+                redshiftgtk_window_end_preview (self);
                 redshiftgtk_window_show_try_again_dialog (self,
                                                           _("Could not start redshift"),
                                                           error->message,
-                                                          &backend_start_cb);
+                                                          &redshiftgtk_window_apply);
+                break;
+        default:
+                redshiftgtk_window_end_preview (self);
+                redshiftgtk_window_show_try_again_dialog (self,
+                                                          _("Could not apply changes"),
+                                                          error->message,
+                                                          &redshiftgtk_window_apply);
+                break;
         }
 }
 
+/* Runs in the background, another click supersedes it */
+static void
+redshiftgtk_window_apply (RedshiftGtkWindow *self)
+{
+        REDSHIFTGTK_TRACE_SPAN ("apply");
+
+        redshiftgtk_apply_pipeline_run (self->apply, APPLY_FLAGS_NONE,
+                                        apply_finished_cb, g_object_ref (self));
+}
+
 static void
 apply_button_clicked_cb (GtkWidget *widget, gpointer data)
 {
-        RedshiftGtkWindow *self = data;
+        redshiftgtk_window_apply (REDSHIFTGTK_WINDOW (data));
+}
 
-        /* Stop before applying settings */
-        redshiftgtk_backend_stop (self->backend);
+/* Due from a burst of changes with auto-apply */
+static void
+scheduled_run_cb (RedshiftGtkApplyPipeline *pipeline,
+                  ApplyFlags                flags,
+                  gpointer                  data)
+{
+        REDSHIFTGTK_TRACE_SPAN ("auto_apply");
 
-        /* Day temperature */
-        redshiftgtk_backend_set_temperature(self->backend,
-                TIME_PERIOD_DAY,
-                redshiftgtk_radial_slider_get_value(self->day_temp_slider));
+        redshiftgtk_apply_pipeline_run (pipeline, flags,
+                                        apply_finished_cb, g_object_ref (data));
+}
 
-        /* Night temperature */
-        redshiftgtk_backend_set_temperature(self->backend,
-                TIME_PERIOD_NIGHT,
-                redshiftgtk_radial_slider_get_value(self->night_temp_slider));
-
-        /* Location provider */
-        if (g_strcmp0 (gtk_stack_get_visible_child_name (self->location_stack), "manual") == 0)
-                redshiftgtk_backend_set_location_provider (self->backend,
-                                                           LOCATION_PROVIDER_MANUAL);
-        else
-                redshiftgtk_backend_set_location_provider (self->backend,
-                                                           LOCATION_PROVIDER_AUTO);
+static void
+settings_notify_cb (GObject    *object,
+                    GParamSpec *pspec,
+                    gpointer    data)
+{
+        RedshiftGtkWindow *self = data;
 
-        /* Latitude and longtitude */
-        redshiftgtk_backend_set_latitude (self->backend,
-                gtk_spin_button_get_value (self->latitude_spinner));
-        redshiftgtk_backend_set_longtitude (self->backend,
-                gtk_spin_button_get_value (self->longtitude_spinner));
+        /* Values from the backend are already applied */
+        if (self->loading_settings ||
+            !gtk_switch_get_active (self->auto_apply_switch))
+                return;
 
-        /* Day brightenss */
-        redshiftgtk_backend_set_brightness (self->backend,
-                TIME_PERIOD_DAY,
-                gtk_spin_button_get_value (self->day_brightness_spinner));
+        redshiftgtk_apply_pipeline_schedule (self->apply, scheduled_run_cb, self);
+}
 
-        /* Day gamma */
-        redshiftgtk_backend_set_gamma (self->backend,
-                TIME_PERIOD_DAY,
-                gtk_spin_button_get_value (self->day_gamma_r_spinner),
-                gtk_spin_button_get_value (self->day_gamma_g_spinner),
-                gtk_spin_button_get_value (self->day_gamma_b_spinner));
+static void
+cancel_button_clicked_cb (GtkWidget *widget, gpointer data)
+{
+        RedshiftGtkWindow *self = data;
 
-        /* Night brightness */
-        redshiftgtk_backend_set_brightness (self->backend,
-                TIME_PERIOD_NIGHT,
-                gtk_spin_button_get_value (self->night_brightness_spinner));
+        gtk_window_close (GTK_WINDOW (self));
+}
 
-        /* Night gamma */
-        redshiftgtk_backend_set_gamma (self->backend,
-                TIME_PERIOD_NIGHT,
-                gtk_spin_button_get_value (self->night_gamma_r_spinner),
-                gtk_spin_button_get_value (self->night_gamma_g_spinner),
-                gtk_spin_button_get_value (self->night_gamma_b_spinner));
+static void
+stop_button_clicked_cb (GtkWidget *widget, gpointer data)
+{
+        RedshiftGtkWindow *self = data;
 
-        /* Adjustment method */
-        AdjustmentMethod method = gtk_combo_box_get_active (
-                GTK_COMBO_BOX (self->method_combobox));
-        redshiftgtk_backend_set_adjustment_method (self->backend, method);
+        /* An apply still on its way would start it again */
+        redshiftgtk_apply_pipeline_unschedule (self->apply);
+        redshiftgtk_apply_pipeline_cancel (self->apply);
+        redshiftgtk_window_end_preview (self);
+        redshiftgtk_backend_stop (self->backend);
+}
 
-        /* Smooth transition policy */
-        redshiftgtk_backend_set_smooth_transition (self->backend,
-                gtk_switch_get_active (self->transition_switch));
+static void
+redshiftgtk_window_switch_profile (RedshiftGtkWindow *self,
+                                   const gchar       *name)
+{
+        g_autoptr (GError) error = NULL;
 
-        /* Autostart policy */
-        backend_set_autostart_cb (self);
+        redshiftgtk_window_end_preview (self);
 
-        /* Apply settings */
-        backend_apply_changes_cb (self);
+        /* The backend says "changed" and the controls follow */
+        redshiftgtk_backend_switch_profile (self->backend, name, &error);
 
-        /* Start again with new settings */
-        backend_start_cb (self);
+        if (error) {
+                g_warning ("redshiftgtk_backend_switch_profile: %s\n", error->message);
+                redshiftgtk_window_populate_profiles (self);
+        }
 }
 
 static void
-cancel_button_clicked_cb (GtkWidget *widget, gpointer data)
+profile_combobox_changed_cb (GtkComboBox *combobox,
+                             gpointer     data)
 {
         RedshiftGtkWindow *self = data;
+        const gchar *name;
 
-        gtk_window_close (GTK_WINDOW (self));
+        if (self->populating_profiles)
+                return;
+
+        /* Typing into the entry doesn't select anything */
+        name = gtk_combo_box_get_active_id (combobox);
+        if (!name)
+                return;
+
+        redshiftgtk_window_switch_profile (self, name);
 }
 
 static void
-stop_button_clicked_cb (GtkWidget *widget, gpointer data)
+profile_entry_activate_cb (GtkEntry *entry,
+                           gpointer  data)
 {
         RedshiftGtkWindow *self = data;
-        redshiftgtk_backend_stop (self->backend);
+        const gchar *name = gtk_entry_get_text (entry);
+
+        if (*name == '\0')
+                return;
+
+        redshiftgtk_window_switch_profile (self, name);
 }
 
 static void
@@ -438,11 +890,11 @@ redshiftgtk_window_init (RedshiftGtkWindow *self)
         GtkStyleContext *style_ctx;
         GdkScreen *screen;
         g_autoptr(GtkCssProvider) provider = NULL;
-        gdouble value;
         gchar *image_resource_path;
 
         gtk_widget_init_template (GTK_WIDGET (self));
-        self->backend = redshiftgtk_redshift_wrapper_new();
+
+        self->settings = redshiftgtk_settings_model_new ();
 
         /* Have it always be initialized */
         image_resource_path = "/com/github/cybre/RedshiftGtk/images/";
@@ -461,9 +913,7 @@ redshiftgtk_window_init (RedshiftGtkWindow *self)
 
         /* Find them */
         /* Day temperature */
-        value = redshiftgtk_backend_get_temperature(self->backend,
-                                                    TIME_PERIOD_DAY);
-        day_adjustment = gtk_adjustment_new (value, 1000.00, 12000.00,
+        day_adjustment = gtk_adjustment_new (6500.00, 1000.00, 25000.00,
                                              50.00, 100.0, 0);
         radial = redshiftgtk_radial_slider_new (day_adjustment, 256.0);
         redshiftgtk_radial_slider_set_bg_path (radial,
@@ -487,9 +937,7 @@ redshiftgtk_window_init (RedshiftGtkWindow *self)
         gtk_overlay_add_overlay (self->day_overlay, GTK_WIDGET (day_entry));
 
         /* Night temperature */
-        value = redshiftgtk_backend_get_temperature(self->backend,
-                                                    TIME_PERIOD_NIGHT);
-        night_adjustment = gtk_adjustment_new (value, 1000.00, 12000.00,
+        night_adjustment = gtk_adjustment_new (4500.00, 1000.00, 25000.00,
                                                50.00, 100.0, 0);
         radial = redshiftgtk_radial_slider_new (night_adjustment, 256.0);
         redshiftgtk_radial_slider_set_bg_path (radial,
@@ -512,42 +960,143 @@ redshiftgtk_window_init (RedshiftGtkWindow *self)
         gtk_widget_set_valign (night_entry, GTK_ALIGN_CENTER);
         gtk_overlay_add_overlay (self->night_overlay, GTK_WIDGET (night_entry));
 
-        /* Set initial values */
-        redshiftgtk_window_populate_controls (self);
+        /* Values arrive once the backend is known */
+        redshiftgtk_window_bind_controls (self, day_adjustment, night_adjustment);
 
         /* Bring them all */
         gtk_widget_show_all (GTK_WIDGET (self));
 
         /* In the darkness bind them */
-        g_signal_connect (G_OBJECT (day_adjustment), "value-changed",
-                          G_CALLBACK (adjustment_value_changed_cb),
-                          day_entry);
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self->settings), "notify::temp-day",
+                                    preview_value_changed_cb,
+                                    self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self->settings), "notify::temp-night",
+                                    preview_value_changed_cb,
+                                    self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self->day_temp_slider), "button-press-event",
+                                    slider_button_press_cb,
+                                    self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self->day_temp_slider), "button-release-event",
+                                    slider_button_release_cb,
+                                    self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self->night_temp_slider), "button-press-event",
+                                    slider_button_press_cb,
+                                    self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self->night_temp_slider), "button-release-event",
+                                    slider_button_release_cb,
+                                    self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self->stop_button), "clicked",
+                                    stop_button_clicked_cb,
+                                    self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self->apply_button), "clicked",
+                                    apply_button_clicked_cb,
+                                    self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self->cancel_button), "clicked",
+                                    cancel_button_clicked_cb,
+                                    self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self->profile_combobox), "changed",
+                                    profile_combobox_changed_cb,
+                                    self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (gtk_bin_get_child (GTK_BIN (self->profile_combobox))),
+                                    "activate",
+                                    profile_entry_activate_cb,
+                                    self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self), "notify::scale-factor",
+                                    window_scale_factor_changed_cb,
+                                    NULL);
+}
 
-        g_signal_connect (G_OBJECT (day_entry), "value-changed",
-                          G_CALLBACK (spinner_value_changed_cb),
-                          self->day_temp_slider);
+static gboolean
+redshiftgtk_window_has_preferences (void)
+{
+        GSettingsSchemaSource *source = g_settings_schema_source_get_default ();
+        g_autoptr (GSettingsSchema) schema = NULL;
 
-        g_signal_connect (G_OBJECT (night_adjustment), "value-changed",
-                          G_CALLBACK (adjustment_value_changed_cb),
-                          night_entry);
+        if (!source)
+                return FALSE;
 
-        g_signal_connect (G_OBJECT (night_entry), "value-changed",
-                          G_CALLBACK (spinner_value_changed_cb),
-                          self->night_temp_slider);
+        schema = g_settings_schema_source_lookup (source, REDSHIFTGTK_GSETTINGS_SCHEMA_ID, TRUE);
 
-        g_signal_connect (G_OBJECT (self->stop_button), "clicked",
-                          G_CALLBACK (stop_button_clicked_cb),
-                          self);
+        return schema != NULL;
+}
 
-        g_signal_connect (G_OBJECT (self->apply_button), "clicked",
-                          G_CALLBACK (apply_button_clicked_cb),
-                          self);
+static void
+redshiftgtk_window_constructed (GObject *object)
+{
+        RedshiftGtkWindow *self = REDSHIFTGTK_WINDOW (object);
 
-        g_signal_connect (G_OBJECT (self->cancel_button), "clicked",
-                          G_CALLBACK (cancel_button_clicked_cb),
-                          self);
+        G_OBJECT_CLASS (redshiftgtk_window_parent_class)->constructed (object);
 
-        g_signal_connect (G_OBJECT (self), "notify::scale-factor",
-                          G_CALLBACK (window_scale_factor_changed_cb),
-                          NULL);
+        /* Use the daemon if it runs, it already has everything loaded */
+        if (!self->backend)
+                self->backend = redshiftgtk_dbus_client_new (NULL, NULL);
+        if (!self->backend) {
+                g_autoptr (GError) error = NULL;
+
+                self->backend = redshiftgtk_backend_new_local ();
+
+                /* Without the daemon we serve the hotkey socket ourselves */
+                self->control = redshiftgtk_control_server_new (self->backend);
+                if (!redshiftgtk_control_server_start (self->control, NULL, &error)) {
+                        g_debug ("redshiftgtk_control_server_start: %s\n", error->message);
+                        g_clear_object (&self->control);
+                }
+        }
+
+        self->apply = redshiftgtk_apply_pipeline_new (self->backend, self->settings);
+
+        /* Nothing to apply with, or remember auto-apply in, otherwise */
+        REDSHIFTGTK_SIGNAL_CONNECT (G_OBJECT (self->settings), "notify",
+                                    settings_notify_cb,
+                                    self);
+        g_object_bind_property (self->auto_apply_switch, "active",
+                                self->apply_button, "visible",
+                                G_BINDING_SYNC_CREATE | G_BINDING_INVERT_BOOLEAN);
+        if (redshiftgtk_window_has_preferences ()) {
+                self->preferences = g_settings_new (REDSHIFTGTK_GSETTINGS_SCHEMA_ID);
+                g_settings_bind (self->preferences, "auto-apply",
+                                 self->auto_apply_switch, "active",
+                                 G_SETTINGS_BIND_DEFAULT);
+        } else {
+                gtk_widget_set_sensitive (GTK_WIDGET (self->auto_apply_switch), FALSE);
+        }
+
+        /* Set initial values */
+        redshiftgtk_window_populate_controls (self);
+
+        self->foreign = redshiftgtk_backend_list_foreign (self->backend);
+        redshiftgtk_window_ask_foreign (self);
+
+        REDSHIFTGTK_SIGNAL_CONNECT_OBJECT (G_OBJECT (self->backend), "changed",
+                                           backend_changed_cb,
+                                           self, 0);
+        REDSHIFTGTK_SIGNAL_CONNECT_OBJECT (G_OBJECT (self->backend), "autostart-failed",
+                                           backend_autostart_failed_cb,
+                                           self, 0);
+}
+
+/**
+ * redshiftgtk_window_new_with_backend
+ *
+ * A window on @backend instead of the daemon or the user's settings
+ */
+GtkWidget*
+redshiftgtk_window_new_with_backend (GtkApplication     *application,
+                                     RedshiftGtkBackend *backend)
+{
+        return g_object_new (REDSHIFTGTK_TYPE_WINDOW,
+                             "application", application,
+                             "backend", backend,
+                             NULL);
 }
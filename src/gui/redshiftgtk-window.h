@@ -19,6 +19,8 @@
 
 #include <gtk/gtk.h>
 
+#include "backend/redshiftgtk-backend.h"
+
 G_BEGIN_DECLS
 
 #define REDSHIFTGTK_TYPE_WINDOW (redshiftgtk_window_get_type())
@@ -26,4 +28,8 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (RedshiftGtkWindow, redshiftgtk_window,
                       REDSHIFTGTK, WINDOW, GtkApplicationWindow)
 
+GtkWidget*
+redshiftgtk_window_new_with_backend (GtkApplication     *application,
+                                     RedshiftGtkBackend *backend);
+
 G_END_DECLS
@@ -18,6 +18,9 @@
 #include <glib/gi18n.h>
 
 #include <gui/redshiftgtk-window.h>
+#include <backend/redshiftgtk-metrics.h>
+#include <backend/redshiftgtk-stall-monitor.h>
+#include <backend/redshiftgtk-trace.h>
 #include "redshiftgtk-config.h"
 
 static void
@@ -41,6 +44,17 @@ on_activate (GtkApplication *app)
         gtk_window_present (window);
 }
 
+static gint
+on_handle_local_options (GApplication *app,
+                         GVariantDict *options)
+{
+        if (g_variant_dict_contains (options, "profile"))
+                redshiftgtk_trace_init (TRUE);
+
+        /* Carry on as usual */
+        return -1;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -51,8 +65,18 @@ main (int argc, char *argv[])
         bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
         textdomain (GETTEXT_PACKAGE);
 
+        /* Before anything connects, so every handler gets a name */
+        redshiftgtk_stall_monitor_start_from_env ();
+        redshiftgtk_trace_init (FALSE);
+        redshiftgtk_metrics_start_from_env ("redshiftgtk");
+
         app = gtk_application_new ("com.github.cybre.RedshiftGtk", G_APPLICATION_FLAGS_NONE);
-        g_signal_connect (app, "activate", G_CALLBACK (on_activate), NULL);
+        g_application_add_main_option (G_APPLICATION (app), "profile", 0,
+                                       G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
+                                       _("Print how long loading, applying and drawing take"),
+                                       NULL);
+        REDSHIFTGTK_SIGNAL_CONNECT (app, "handle-local-options", on_handle_local_options, NULL);
+        REDSHIFTGTK_SIGNAL_CONNECT (app, "activate", on_activate, NULL);
 
         return g_application_run (G_APPLICATION (app), argc, argv);
 }
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "backend/redshiftgtk-backend.h"
+#include "backend/redshiftgtk-control-server.h"
+#include "backend/redshiftgtk-redshift-wrapper.h"
+
+#define ITERATIONS 2000
+
+/* Every set spawns a redshift, the stand-in one in tests/data/bin */
+#define SPAWN_ITERATIONS 200
+
+typedef struct {
+        gchar *socket_path;
+        GMainContext *context;
+        GMainLoop *loop;
+        GMutex mutex;
+        GCond cond;
+        gboolean ready;
+} Server;
+
+static gpointer
+server_thread_func (gpointer data)
+{
+        Server *server = data;
+        g_autoptr (RedshiftGtkBackend) backend = NULL;
+        g_autoptr (RedshiftGtkControlServer) control = NULL;
+        g_autoptr (GError) error = NULL;
+
+        g_main_context_push_thread_default (server->context);
+
+        backend = redshiftgtk_redshift_wrapper_new ();
+        redshiftgtk_redshift_wrapper_set_config_path (backend,
+                g_build_filename (TEST_DATA_DIR, "redshift.conf", NULL));
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (backend), &error);
+        g_assert_no_error (error);
+
+        /* Running, so that set and nudge have something to hand over to */
+        redshiftgtk_backend_start (backend, &error);
+        g_assert_no_error (error);
+
+        control = redshiftgtk_control_server_new (backend);
+        redshiftgtk_control_server_start (control, server->socket_path, &error);
+        g_assert_no_error (error);
+
+        g_mutex_lock (&server->mutex);
+        server->ready = TRUE;
+        g_cond_signal (&server->cond);
+        g_mutex_unlock (&server->mutex);
+
+        g_main_loop_run (server->loop);
+
+        /* Commits whatever nudge is still pending, before the stop */
+        redshiftgtk_control_server_stop (control);
+        g_clear_object (&control);
+        redshiftgtk_backend_stop (backend);
+        g_main_context_pop_thread_default (server->context);
+
+        return NULL;
+}
+
+static gint
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+        gint64 x = *(const gint64 *) a;
+        gint64 y = *(const gint64 *) b;
+
+        return (x > y) - (x < y);
+}
+
+static void
+report (const gchar *name,
+        gint64      *times,
+        guint        count)
+{
+        qsort (times, count, sizeof (gint64), compare_times);
+        g_print ("%-28s median %5" G_GINT64_FORMAT " us   p99 %5" G_GINT64_FORMAT " us   max %5" G_GINT64_FORMAT " us\n",
+                 name,
+                 times[count / 2],
+                 times[count * 99 / 100],
+                 times[count - 1]);
+}
+
+/* Over the open connection, alternating between two commands so
+ * that every one of them changes something
+ */
+static void
+run_command (const gchar      *name,
+             GOutputStream    *output,
+             GDataInputStream *input,
+             const gchar      *even,
+             const gchar      *odd,
+             gint64           *times)
+{
+        guint i;
+
+        for (i = 0; i < SPAWN_ITERATIONS; i++) {
+                const gchar *command = i % 2 ? odd : even;
+                g_autofree gchar *reply = NULL;
+                g_autoptr (GError) error = NULL;
+                gint64 start = g_get_monotonic_time ();
+
+                g_output_stream_write_all (output, command, strlen (command), NULL, NULL, &error);
+                g_assert_no_error (error);
+                reply = g_data_input_stream_read_line (input, NULL, NULL, &error);
+                g_assert_no_error (error);
+                g_assert (g_str_has_prefix (reply, "OK"));
+
+                times[i] = g_get_monotonic_time () - start;
+        }
+        report (name, times, SPAWN_ITERATIONS);
+}
+
+static gboolean
+quit_loop_cb (gpointer data)
+{
+        g_main_loop_quit (data);
+
+        return G_SOURCE_REMOVE;
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_autofree gchar *tmp_dir = NULL;
+        g_autoptr (GSocketClient) socket_client = NULL;
+        g_autoptr (GSocketAddress) address = NULL;
+        g_autoptr (GSocketConnection) connection = NULL;
+        g_autoptr (GDataInputStream) input = NULL;
+        g_autoptr (GError) error = NULL;
+        static gint64 times[ITERATIONS];
+        g_autofree gchar *path = NULL;
+        GOutputStream *output;
+        GThread *thread;
+        Server server = { 0 };
+        guint i;
+
+        tmp_dir = g_dir_make_tmp ("redshiftgtk-bench-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        /* Before the server thread exists, setenv is not thread safe */
+        path = g_strconcat (TEST_DATA_DIR, "bin", G_SEARCHPATH_SEPARATOR_S,
+                            g_getenv ("PATH"), NULL);
+        g_setenv ("PATH", path, TRUE);
+
+        server.socket_path = g_build_filename (tmp_dir, "control.sock", NULL);
+        server.context = g_main_context_new ();
+        server.loop = g_main_loop_new (server.context, FALSE);
+        g_mutex_init (&server.mutex);
+        g_cond_init (&server.cond);
+
+        thread = g_thread_new ("server", server_thread_func, &server);
+
+        g_mutex_lock (&server.mutex);
+        while (!server.ready)
+                g_cond_wait (&server.cond, &server.mutex);
+        g_mutex_unlock (&server.mutex);
+
+        /* What a hotkey pays: connect, one command, disconnect */
+        for (i = 0; i < ITERATIONS; i++) {
+                g_autofree gchar *reply = NULL;
+                gint64 start = g_get_monotonic_time ();
+
+                reply = redshiftgtk_control_send (server.socket_path, "query", &error);
+                g_assert_no_error (error);
+                g_assert (g_str_has_prefix (reply, "OK"));
+
+                times[i] = g_get_monotonic_time () - start;
+        }
+        report ("query, new connection", times, ITERATIONS);
+
+        /* Protocol and dispatch alone, over an open connection */
+        socket_client = g_socket_client_new ();
+        address = g_unix_socket_address_new (server.socket_path);
+        connection = g_socket_client_connect (socket_client, G_SOCKET_CONNECTABLE (address),
+                                              NULL, &error);
+        g_assert_no_error (error);
+        output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+        input = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+
+        for (i = 0; i < ITERATIONS; i++) {
+                g_autofree gchar *reply = NULL;
+                gint64 start = g_get_monotonic_time ();
+
+                g_output_stream_write_all (output, "query\n", 6, NULL, NULL, &error);
+                g_assert_no_error (error);
+                reply = g_data_input_stream_read_line (input, NULL, NULL, &error);
+                g_assert_no_error (error);
+                g_assert (g_str_has_prefix (reply, "OK"));
+
+                times[i] = g_get_monotonic_time () - start;
+        }
+        report ("query, open connection", times, ITERATIONS);
+
+        /* A hand-over to a new instance every time */
+        run_command ("set, open connection", output, input,
+                     "set 3500\n", "set 4000\n", times);
+
+        /* A one-shot preview, one hand-over once the burst is over */
+        run_command ("nudge, open connection", output, input,
+                     "nudge -100\n", "nudge +100\n", times);
+
+        g_io_stream_close (G_IO_STREAM (connection), NULL, NULL);
+
+        g_main_context_invoke (server.context, quit_loop_cb, server.loop);
+        g_thread_join (thread);
+
+        g_main_loop_unref (server.loop);
+        g_main_context_unref (server.context);
+        g_rmdir (tmp_dir);
+        g_free (server.socket_path);
+
+        return 0;
+}
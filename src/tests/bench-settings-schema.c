@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "backend/redshiftgtk-settings-schema.h"
+
+#define ITERATIONS 100000
+
+/* Count heap allocations by standing in for the allocator. glibc lets a
+ * program replace malloc and friends as long as all of them are replaced.
+ */
+#ifdef __GLIBC__
+#define COUNT_ALLOCATIONS 1
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void __libc_free (void *ptr);
+
+static volatile gsize allocations;
+
+void *
+malloc (size_t size)
+{
+        allocations++;
+        return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n,
+        size_t size)
+{
+        allocations++;
+        return __libc_calloc (n, size);
+}
+
+void *
+realloc (void   *ptr,
+         size_t  size)
+{
+        allocations++;
+        return __libc_realloc (ptr, size);
+}
+
+void
+free (void *ptr)
+{
+        __libc_free (ptr);
+}
+#else
+static gsize allocations;
+#endif
+
+/* What get_gamma used to do for every call */
+static gboolean
+legacy_parse_gamma (GKeyFile     *config,
+                    SettingValue  value)
+{
+        g_autofree gchar *string = NULL;
+        g_auto (GStrv) parts = NULL;
+
+        string = g_key_file_get_string (config, "redshift", "gamma-night", NULL);
+        if (!string || !strstr (string, ":"))
+                return FALSE;
+
+        parts = g_strsplit (string, ":", 3);
+        if (g_strv_length (parts) != 3)
+                return FALSE;
+
+        sscanf (parts[0], "%lf", &value[0]);
+        sscanf (parts[1], "%lf", &value[1]);
+        sscanf (parts[2], "%lf", &value[2]);
+
+        return TRUE;
+}
+
+static void
+report (const gchar *name,
+        gint64       elapsed,
+        gsize        counted)
+{
+        g_print ("%-24s %8.1f ns/call", name, (gdouble) elapsed * 1000 / ITERATIONS);
+#ifdef COUNT_ALLOCATIONS
+        g_print ("   %6.2f allocations/call", (gdouble) counted / ITERATIONS);
+#endif
+        g_print ("\n");
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_autoptr (GKeyFile) config = g_key_file_new ();
+        const gchar *raw = "0.4:0.5:0.6";
+        SettingValue value;
+        gint64 start;
+        gsize before, counted;
+        guint i;
+
+        g_key_file_set_value (config, "redshift", "gamma-night", raw);
+
+        before = allocations;
+        start = g_get_monotonic_time ();
+        for (i = 0; i < ITERATIONS; i++)
+                g_assert (legacy_parse_gamma (config, value));
+        report ("strsplit + sscanf", g_get_monotonic_time () - start, allocations - before);
+
+        before = allocations;
+        start = g_get_monotonic_time ();
+        for (i = 0; i < ITERATIONS; i++)
+                redshiftgtk_settings_schema_read (SETTING_GAMMA_NIGHT, config, value);
+        report ("schema read", g_get_monotonic_time () - start, allocations - before);
+
+        before = allocations;
+        start = g_get_monotonic_time ();
+        for (i = 0; i < ITERATIONS; i++)
+                g_assert (redshiftgtk_settings_schema_parse_value (SETTING_GAMMA_NIGHT, raw, value));
+        counted = allocations - before;
+        report ("schema parse", g_get_monotonic_time () - start, counted);
+
+#ifdef COUNT_ALLOCATIONS
+        /* The parser itself must never touch the heap */
+        g_assert_cmpuint (counted, ==, 0);
+#endif
+
+        return 0;
+}
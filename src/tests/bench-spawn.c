@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/redshiftgtk-spawn.h"
+
+#define ITERATIONS 200
+
+/* About what a GTK window with its theme, fonts and icons keeps
+ * resident, override with the first argument in MiB
+ */
+#define DEFAULT_BALLAST_MIB 256
+
+typedef GSubprocess* (*SpawnFunc) (const gchar * const *argv,
+                                   GSubprocessFlags     flags,
+                                   GError             **error);
+
+static gint
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+        gint64 x = *(const gint64 *) a;
+        gint64 y = *(const gint64 *) b;
+
+        return (x > y) - (x < y);
+}
+
+static void
+report (const gchar *name,
+        gint64      *times)
+{
+        qsort (times, ITERATIONS, sizeof (gint64), compare_times);
+        g_print ("%-36s median %5" G_GINT64_FORMAT " us   p99 %5" G_GINT64_FORMAT " us   max %5" G_GINT64_FORMAT " us\n",
+                 name,
+                 times[ITERATIONS / 2],
+                 times[ITERATIONS * 99 / 100],
+                 times[ITERATIONS - 1]);
+}
+
+/* How long the caller, the main loop, is held up. Waiting for the
+ * child to exit is not part of it.
+ */
+static void
+run_spawn (const gchar *name,
+           SpawnFunc    spawn,
+           gint64      *times)
+{
+        const gchar * const argv[] = { "true", NULL };
+        guint i;
+
+        for (i = 0; i < ITERATIONS; i++) {
+                g_autoptr (GSubprocess) process = NULL;
+                g_autoptr (GError) error = NULL;
+                gint64 start;
+
+                start = g_get_monotonic_time ();
+                process = spawn (argv, G_SUBPROCESS_FLAGS_NONE, &error);
+                times[i] = g_get_monotonic_time () - start;
+                g_assert_no_error (error);
+
+                g_subprocess_wait (process, NULL, &error);
+                g_assert_no_error (error);
+        }
+        report (name, times);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_autofree gchar *plain_name = NULL;
+        g_autofree gchar *lean_name = NULL;
+        g_autofree guint8 *ballast = NULL;
+        static gint64 times[ITERATIONS];
+        gsize size;
+
+        run_spawn ("g_subprocess_newv, bare", g_subprocess_newv, times);
+        run_spawn ("redshiftgtk_spawnv, bare", redshiftgtk_spawnv, times);
+
+        /* Resident, not just reserved: every page has to be mapped
+         * for fork to copy its page table entry
+         */
+        size = (argc > 1 ? g_ascii_strtoull (argv[1], NULL, 10) : DEFAULT_BALLAST_MIB) << 20;
+        ballast = g_malloc (size);
+        memset (ballast, 0x5a, size);
+
+        plain_name = g_strdup_printf ("g_subprocess_newv, %" G_GSIZE_FORMAT " MiB", size >> 20);
+        lean_name = g_strdup_printf ("redshiftgtk_spawnv, %" G_GSIZE_FORMAT " MiB", size >> 20);
+        run_spawn (plain_name, g_subprocess_newv, times);
+        run_spawn (lean_name, redshiftgtk_spawnv, times);
+
+        return 0;
+}
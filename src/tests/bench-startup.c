@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <glib/gstdio.h>
+
+#include "backend/redshiftgtk-backend.h"
+#include "backend/redshiftgtk-redshift-wrapper.h"
+#include "backend/redshiftgtk-settings-cache.h"
+
+#define ITERATIONS 500
+
+#define PROFILE \
+        "; Reading in the evening\n" \
+        "[profile:%u]\n" \
+        "temp-day=%u\n" \
+        "temp-night=3400\n" \
+        "brightness-day=0.9\n" \
+        "gamma-night=0.9:0.85:0.8\n" \
+        "fade=0\n"
+
+/* A config the size of one that grew over time */
+static gchar*
+config_new (void)
+{
+        GString *config = g_string_new ("; Global settings for redshift\n"
+                                        "[redshift]\n"
+                                        "temp-day=5700\n"
+                                        "temp-night=3500\n"
+                                        "fade=1\n"
+                                        "gamma-day=0.8:0.7:0.8\n"
+                                        "gamma-night=0.6\n"
+                                        "location-provider=manual\n"
+                                        "adjustment-method=randr\n"
+                                        "\n"
+                                        "[manual]\n"
+                                        "lat=48.1\n"
+                                        "lon=11.6\n"
+                                        "\n"
+                                        "[randr]\n"
+                                        "screen=0\n");
+        guint i;
+
+        for (i = 0; i < 16; i++)
+                g_string_append_printf (config, PROFILE, i, 4000 + i * 100);
+
+        return g_string_free (config, FALSE);
+}
+
+static gint
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+        gint64 x = *(const gint64 *) a;
+        gint64 y = *(const gint64 *) b;
+
+        return (x > y) - (x < y);
+}
+
+static void
+report (const gchar *name,
+        gint64      *times)
+{
+        qsort (times, ITERATIONS, sizeof (gint64), compare_times);
+        g_print ("%-28s median %5" G_GINT64_FORMAT " us   p99 %5" G_GINT64_FORMAT " us   max %5" G_GINT64_FORMAT " us\n",
+                 name,
+                 times[ITERATIONS / 2],
+                 times[ITERATIONS * 99 / 100],
+                 times[ITERATIONS - 1]);
+}
+
+/* Everything a window or the daemon waits for before it can show
+ * a single value: construct the backend, which loads the config
+ */
+static void
+run_startup (const gchar *name,
+             const gchar *cache_path,
+             gboolean     cached,
+             gint64      *times)
+{
+        guint i;
+
+        for (i = 0; i < ITERATIONS; i++) {
+                g_autoptr (RedshiftGtkBackend) backend = NULL;
+                gint64 start;
+
+                if (!cached)
+                        g_unlink (cache_path);
+
+                start = g_get_monotonic_time ();
+                backend = redshiftgtk_redshift_wrapper_new ();
+                g_assert_cmpfloat (redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_DAY),
+                                   ==, 5700);
+                times[i] = g_get_monotonic_time () - start;
+        }
+        report (name, times);
+}
+
+/* The same, without what construction does besides loading */
+static void
+run_load (const gchar                *name,
+          RedshiftGtkRedshiftWrapper *wrapper,
+          const gchar                *cache_path,
+          gboolean                    cached,
+          gint64                     *times)
+{
+        g_autoptr (GError) error = NULL;
+        guint i;
+
+        for (i = 0; i < ITERATIONS; i++) {
+                gint64 start;
+
+                if (!cached)
+                        g_unlink (cache_path);
+
+                start = g_get_monotonic_time ();
+                redshiftgtk_redshift_wrapper_load_config (wrapper, &error);
+                g_assert_no_error (error);
+                times[i] = g_get_monotonic_time () - start;
+        }
+        report (name, times);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_autofree gchar *tmp_dir = NULL;
+        g_autofree gchar *cache_home = NULL;
+        g_autofree gchar *config_path = NULL;
+        g_autofree gchar *cache_path = NULL;
+        g_autofree gchar *config = NULL;
+        g_autoptr (RedshiftGtkBackend) backend = NULL;
+        g_autoptr (GError) error = NULL;
+        static gint64 times[ITERATIONS];
+
+        /* Stay out of the real config and cache, before GLib
+         * gets to look at either
+         */
+        tmp_dir = g_dir_make_tmp ("redshiftgtk-bench-XXXXXX", &error);
+        g_assert_no_error (error);
+        cache_home = g_build_filename (tmp_dir, "cache", NULL);
+        g_setenv ("XDG_CONFIG_HOME", tmp_dir, TRUE);
+        g_setenv ("XDG_CACHE_HOME", cache_home, TRUE);
+
+        config_path = g_build_filename (tmp_dir, "redshift.conf", NULL);
+        config = config_new ();
+        g_file_set_contents (config_path, config, -1, &error);
+        g_assert_no_error (error);
+
+        cache_path = redshiftgtk_settings_cache_get_path (config_path);
+
+        run_startup ("startup, cache miss", cache_path, FALSE, times);
+        run_startup ("startup, cache hit", cache_path, TRUE, times);
+
+        backend = redshiftgtk_redshift_wrapper_new ();
+        run_load ("load_config, cache miss", REDSHIFTGTK_REDSHIFT_WRAPPER (backend),
+                  cache_path, FALSE, times);
+        run_load ("load_config, cache hit", REDSHIFTGTK_REDSHIFT_WRAPPER (backend),
+                  cache_path, TRUE, times);
+        g_clear_object (&backend);
+
+        g_unlink (cache_path);
+        g_unlink (config_path);
+
+        return 0;
+}
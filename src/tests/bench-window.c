@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <gtk/gtk.h>
+
+#include "gui/redshiftgtk-window.h"
+#include "mock-backend.h"
+
+#define ITERATIONS 200
+
+/* No latency for a local backend, a D-Bus round trip for the daemon */
+static const gulong latencies[] = { 0, 100 };
+
+static gint
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+        gint64 x = *(const gint64 *) a;
+        gint64 y = *(const gint64 *) b;
+
+        return (x > y) - (x < y);
+}
+
+static void
+report (const gchar *name,
+        gulong       latency,
+        gint64      *times,
+        gint64      *backend_times)
+{
+        g_autofree gchar *label = g_strdup_printf ("%s, %lu us", name, latency);
+        gint64 window_times[ITERATIONS];
+        guint i;
+
+        /* What is left once the backend's share is taken out */
+        for (i = 0; i < ITERATIONS; i++)
+                window_times[i] = times[i] - backend_times[i];
+
+        qsort (times, ITERATIONS, sizeof (gint64), compare_times);
+        qsort (backend_times, ITERATIONS, sizeof (gint64), compare_times);
+        qsort (window_times, ITERATIONS, sizeof (gint64), compare_times);
+
+        g_print ("%-28s median %6" G_GINT64_FORMAT " us   backend %6" G_GINT64_FORMAT " us   window %6" G_GINT64_FORMAT " us   p99 %6" G_GINT64_FORMAT " us\n",
+                 label,
+                 times[ITERATIONS / 2],
+                 backend_times[ITERATIONS / 2],
+                 window_times[ITERATIONS / 2],
+                 window_times[ITERATIONS * 99 / 100]);
+}
+
+static void
+flush_events (void)
+{
+        while (gtk_events_pending ())
+                gtk_main_iteration ();
+}
+
+/* Template children are named after their id in the .ui file */
+static GtkWidget*
+find_widget (GtkWidget   *widget,
+             const gchar *name)
+{
+        g_autoptr (GList) children = NULL;
+        GList *l;
+
+        if (g_strcmp0 (gtk_buildable_get_name (GTK_BUILDABLE (widget)), name) == 0)
+                return widget;
+
+        if (!GTK_IS_CONTAINER (widget))
+                return NULL;
+
+        children = gtk_container_get_children (GTK_CONTAINER (widget));
+        for (l = children; l; l = l->next) {
+                GtkWidget *found = find_widget (l->data, name);
+
+                if (found)
+                        return found;
+        }
+
+        return NULL;
+}
+
+/* Everything up to the first values on screen */
+static void
+run_construct (gulong  latency,
+               gint64 *times,
+               gint64 *backend_times)
+{
+        guint i;
+
+        for (i = 0; i < ITERATIONS; i++) {
+                g_autoptr (RedshiftGtkBackend) backend = redshiftgtk_mock_backend_new (latency);
+                GtkWidget *window;
+                gint64 start;
+
+                start = g_get_monotonic_time ();
+                window = redshiftgtk_window_new_with_backend (NULL, backend);
+                times[i] = g_get_monotonic_time () - start;
+                backend_times[i] = redshiftgtk_mock_backend_get_time_spent (REDSHIFTGTK_MOCK_BACKEND (backend));
+
+                gtk_widget_destroy (window);
+                flush_events ();
+        }
+        report ("construct", latency, times, backend_times);
+}
+
+/* What a "changed" from the backend costs, all controls reloaded */
+static void
+run_populate (gulong  latency,
+              gint64 *times,
+              gint64 *backend_times)
+{
+        g_autoptr (RedshiftGtkBackend) backend = redshiftgtk_mock_backend_new (latency);
+        RedshiftGtkMockBackend *mock = REDSHIFTGTK_MOCK_BACKEND (backend);
+        GtkWidget *window;
+        guint i;
+
+        window = redshiftgtk_window_new_with_backend (NULL, backend);
+        flush_events ();
+
+        for (i = 0; i < ITERATIONS; i++) {
+                gint64 start;
+
+                redshiftgtk_mock_backend_reset_statistics (mock);
+
+                start = g_get_monotonic_time ();
+                g_signal_emit_by_name (backend, "changed");
+                times[i] = g_get_monotonic_time () - start;
+                backend_times[i] = redshiftgtk_mock_backend_get_time_spent (mock);
+
+                flush_events ();
+        }
+        report ("populate_controls", latency, times, backend_times);
+
+        gtk_widget_destroy (window);
+        flush_events ();
+}
+
+/* One changed control, then Apply: stop, commit, apply, reload, start */
+static void
+run_apply (gulong  latency,
+           gint64 *times,
+           gint64 *backend_times)
+{
+        g_autoptr (RedshiftGtkBackend) backend = redshiftgtk_mock_backend_new (latency);
+        RedshiftGtkMockBackend *mock = REDSHIFTGTK_MOCK_BACKEND (backend);
+        GtkWidget *window;
+        GtkWidget *brightness;
+        GtkWidget *apply;
+        guint i;
+
+        window = redshiftgtk_window_new_with_backend (NULL, backend);
+        flush_events ();
+
+        brightness = find_widget (window, "day_brightness_spinner");
+        apply = find_widget (window, "apply_button");
+        g_assert_nonnull (brightness);
+        g_assert_nonnull (apply);
+
+        for (i = 0; i < ITERATIONS; i++) {
+                gint64 start;
+
+                gtk_spin_button_set_value (GTK_SPIN_BUTTON (brightness), i % 2 ? 0.8 : 0.9);
+                flush_events ();
+                redshiftgtk_mock_backend_reset_statistics (mock);
+
+                start = g_get_monotonic_time ();
+                gtk_button_clicked (GTK_BUTTON (apply));
+                times[i] = g_get_monotonic_time () - start;
+                backend_times[i] = redshiftgtk_mock_backend_get_time_spent (mock);
+
+                flush_events ();
+        }
+        report ("apply", latency, times, backend_times);
+
+        gtk_widget_destroy (window);
+        flush_events ();
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        static gint64 times[ITERATIONS];
+        static gint64 backend_times[ITERATIONS];
+        guint i;
+
+        /* Xvfb through xvfb-run, or GDK_BACKEND=broadway with broadwayd */
+        if (!gtk_init_check (&argc, &argv)) {
+                g_printerr ("No display to run on\n");
+                return 77;
+        }
+
+        for (i = 0; i < G_N_ELEMENTS (latencies); i++) {
+                run_construct (latencies[i], times, backend_times);
+                run_populate (latencies[i], times, backend_times);
+                run_apply (latencies[i], times, backend_times);
+        }
+
+        return 0;
+}
@@ -0,0 +1,44 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "backend/redshiftgtk-settings-schema.h"
+
+/* libFuzzer entry point, also usable by other engines that speak the
+ * same interface
+ */
+int
+LLVMFuzzerTestOneInput (const uint8_t *data,
+                        size_t         size)
+{
+        g_autofree gchar *string = NULL;
+        SettingValue value;
+        Setting setting;
+        gdouble number;
+        guint i;
+
+        /* The parsers work on NUL-terminated key file values */
+        string = g_strndup ((const gchar *) data, size);
+
+        if (redshiftgtk_settings_schema_parse_number (string, &number))
+                g_assert (!isnan (number));
+
+        if (redshiftgtk_settings_schema_parse_gamma (string, value)) {
+                for (i = 0; i < SETTING_COMPONENTS; i++)
+                        g_assert (!isnan (value[i]));
+        }
+
+        /* Whatever comes in, what goes out is in range */
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+
+                redshiftgtk_settings_schema_parse_value (setting, string, value);
+
+                for (i = 0; i < SETTING_COMPONENTS; i++) {
+                        g_assert (value[i] >= info->minimum);
+                        g_assert (value[i] <= info->maximum);
+                }
+        }
+
+        return 0;
+}
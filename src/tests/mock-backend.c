@@ -0,0 +1,674 @@
+#include <string.h>
+#include <gio/gio.h>
+
+#include "backend/redshiftgtk-settings-schema.h"
+#include "mock-backend.h"
+
+struct _RedshiftGtkMockBackend
+{
+        GObject parent_instance;
+
+        /* Microseconds each call takes */
+        gulong latency;
+
+        SettingValue values[N_SETTINGS];
+        guint32 modified;
+        gchar *profile;
+        GPtrArray *profiles;
+        /* "OUTPUT KEY" to value */
+        GHashTable *output_settings;
+        gboolean running;
+        gboolean previewing;
+        gboolean autostart;
+        gboolean fail_autostart;
+
+        gint64 time_spent;
+        guint calls;
+        guint starts;
+        guint applies;
+};
+
+/* No outputs are lit, their settings are kept all the same */
+static GPtrArray*
+redshiftgtk_mock_backend_list_outputs (RedshiftGtkBackend *backend)
+{
+        CALL_BEGIN (backend);
+        CALL_END;
+
+        return g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_output_free);
+}
+
+static gchar*
+redshiftgtk_mock_backend_get_output_setting (RedshiftGtkBackend *backend,
+                                             const gchar        *output,
+                                             const gchar        *key)
+{
+        g_autofree gchar *id = g_strconcat (output, " ", key, NULL);
+        gchar *value;
+
+        CALL_BEGIN (backend);
+        value = g_strdup (g_hash_table_lookup (self->output_settings, id));
+        CALL_END;
+
+        return value;
+}
+
+static void
+redshiftgtk_mock_backend_set_output_setting (RedshiftGtkBackend *backend,
+                                             const gchar        *output,
+                                             const gchar        *key,
+                                             const gchar        *value,
+                                             GError            **error)
+{
+        SettingValue parsed;
+        Setting setting;
+        gboolean valid;
+
+        CALL_BEGIN (backend);
+        valid = *output &&
+                redshiftgtk_settings_schema_find (key, &setting) &&
+                redshiftgtk_settings_schema_is_per_output (setting) &&
+                (!value || redshiftgtk_settings_schema_parse_value (setting, value, parsed));
+        if (valid && value)
+                g_hash_table_insert (self->output_settings,
+                                     g_strconcat (output, " ", key, NULL), g_strdup (value));
+        else if (valid) {
+                g_autofree gchar *id = g_strconcat (output, " ", key, NULL);
+
+                g_hash_table_remove (self->output_settings, id);
+        }
+        CALL_END;
+
+        if (!valid) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                             "Can not set %s of %s", key, output);
+                return;
+        }
+
+        g_signal_emit_by_name (self, "changed");
+}
+
+static void
+redshiftgtk_backend_iface_init (RedshiftGtkBackendInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (RedshiftGtkMockBackend,
+                         redshiftgtk_mock_backend,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (REDSHIFTGTK_TYPE_BACKEND,
+                                                redshiftgtk_backend_iface_init))
+
+/* Every method starts with CALL_BEGIN and ends with CALL_END */
+#define CALL_BEGIN(backend) \
+        RedshiftGtkMockBackend *self = REDSHIFTGTK_MOCK_BACKEND (backend); \
+        gint64 call_start = g_get_monotonic_time (); \
+        if (self->latency) \
+                g_usleep (self->latency)
+
+#define CALL_END \
+        self->calls++; \
+        self->time_spent += g_get_monotonic_time () - call_start
+
+static void
+redshiftgtk_mock_backend_finalize (GObject *object)
+{
+        RedshiftGtkMockBackend *self = REDSHIFTGTK_MOCK_BACKEND (object);
+
+        g_free (self->profile);
+        g_ptr_array_unref (self->profiles);
+        g_hash_table_unref (self->output_settings);
+
+        G_OBJECT_CLASS (redshiftgtk_mock_backend_parent_class)->finalize (object);
+}
+
+static void
+redshiftgtk_mock_backend_class_init (RedshiftGtkMockBackendClass *klass)
+{
+        GObjectClass *obj_class = G_OBJECT_CLASS (klass);
+
+        obj_class->finalize = redshiftgtk_mock_backend_finalize;
+}
+
+static void
+redshiftgtk_mock_backend_init (RedshiftGtkMockBackend *self)
+{
+        Setting setting;
+
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                gdouble fallback = redshiftgtk_settings_schema_lookup (setting)->fallback;
+
+                self->values[setting][0] = fallback;
+                self->values[setting][1] = fallback;
+                self->values[setting][2] = fallback;
+        }
+
+        self->profiles = g_ptr_array_new_with_free_func (g_free);
+        self->output_settings = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                       g_free, g_free);
+}
+
+RedshiftGtkBackend*
+redshiftgtk_mock_backend_new (gulong latency)
+{
+        RedshiftGtkMockBackend *self = g_object_new (REDSHIFTGTK_TYPE_MOCK_BACKEND, NULL);
+
+        self->latency = latency;
+
+        return REDSHIFTGTK_BACKEND (self);
+}
+
+/* Time spent in calls since construction or the last reset,
+ * injected latency included
+ */
+gint64
+redshiftgtk_mock_backend_get_time_spent (RedshiftGtkMockBackend *self)
+{
+        return self->time_spent;
+}
+
+guint
+redshiftgtk_mock_backend_get_calls (RedshiftGtkMockBackend *self)
+{
+        return self->calls;
+}
+
+/* start() and apply_changes() calls alone */
+guint
+redshiftgtk_mock_backend_get_starts (RedshiftGtkMockBackend *self)
+{
+        return self->starts;
+}
+
+guint
+redshiftgtk_mock_backend_get_applies (RedshiftGtkMockBackend *self)
+{
+        return self->applies;
+}
+
+gboolean
+redshiftgtk_mock_backend_is_previewing (RedshiftGtkMockBackend *self)
+{
+        return self->previewing;
+}
+
+void
+redshiftgtk_mock_backend_reset_statistics (RedshiftGtkMockBackend *self)
+{
+        self->time_spent = 0;
+        self->calls = 0;
+        self->starts = 0;
+        self->applies = 0;
+}
+
+/* Like a launcher that can't be written */
+void
+redshiftgtk_mock_backend_fail_autostart (RedshiftGtkMockBackend *self,
+                                         gboolean                fail)
+{
+        self->fail_autostart = fail;
+}
+
+static void
+redshiftgtk_mock_backend_store (RedshiftGtkMockBackend *self,
+                                Setting                 setting,
+                                gdouble                 red,
+                                gdouble                 green,
+                                gdouble                 blue)
+{
+        SettingValue value = { red, green, blue };
+
+        redshiftgtk_settings_schema_validate (setting, value);
+        if (memcmp (self->values[setting], value, sizeof (SettingValue)) == 0)
+                return;
+
+        memcpy (self->values[setting], value, sizeof (SettingValue));
+        self->modified |= 1u << setting;
+}
+
+static void
+redshiftgtk_mock_backend_start (RedshiftGtkBackend *backend,
+                                GError            **error)
+{
+        CALL_BEGIN (backend);
+        /* Like the real ones, the new instance replaces any preview */
+        self->running = TRUE;
+        self->previewing = FALSE;
+        self->starts++;
+        CALL_END;
+}
+
+static void
+redshiftgtk_mock_backend_stop (RedshiftGtkBackend *backend)
+{
+        CALL_BEGIN (backend);
+        self->running = FALSE;
+        CALL_END;
+}
+
+static gboolean
+redshiftgtk_mock_backend_is_running (RedshiftGtkBackend *backend)
+{
+        gboolean running;
+
+        CALL_BEGIN (backend);
+        running = self->running;
+        CALL_END;
+
+        return running;
+}
+
+static gdouble
+redshiftgtk_mock_backend_get_temperature (RedshiftGtkBackend *backend,
+                                          TimePeriod          period)
+{
+        gdouble temperature;
+
+        CALL_BEGIN (backend);
+        temperature = self->values[SETTING_TEMP_DAY + period][0];
+        CALL_END;
+
+        return temperature;
+}
+
+static void
+redshiftgtk_mock_backend_set_temperature (RedshiftGtkBackend *backend,
+                                          TimePeriod          period,
+                                          gdouble             temperature)
+{
+        CALL_BEGIN (backend);
+        redshiftgtk_mock_backend_store (self, SETTING_TEMP_DAY + period,
+                                        temperature, temperature, temperature);
+        CALL_END;
+}
+
+static LocationProvider
+redshiftgtk_mock_backend_get_location_provider (RedshiftGtkBackend *backend)
+{
+        LocationProvider provider;
+
+        CALL_BEGIN (backend);
+        provider = (LocationProvider) self->values[SETTING_LOCATION_PROVIDER][0];
+        CALL_END;
+
+        return provider;
+}
+
+static void
+redshiftgtk_mock_backend_set_location_provider (RedshiftGtkBackend *backend,
+                                                LocationProvider    provider)
+{
+        CALL_BEGIN (backend);
+        redshiftgtk_mock_backend_store (self, SETTING_LOCATION_PROVIDER,
+                                        provider, provider, provider);
+        CALL_END;
+}
+
+static gdouble
+redshiftgtk_mock_backend_get_latitude (RedshiftGtkBackend *backend)
+{
+        gdouble latitude;
+
+        CALL_BEGIN (backend);
+        latitude = self->values[SETTING_LATITUDE][0];
+        CALL_END;
+
+        return latitude;
+}
+
+static void
+redshiftgtk_mock_backend_set_latitude (RedshiftGtkBackend *backend,
+                                       gdouble             latitude)
+{
+        CALL_BEGIN (backend);
+        redshiftgtk_mock_backend_store (self, SETTING_LATITUDE,
+                                        latitude, latitude, latitude);
+        CALL_END;
+}
+
+static gdouble
+redshiftgtk_mock_backend_get_longtitude (RedshiftGtkBackend *backend)
+{
+        gdouble longtitude;
+
+        CALL_BEGIN (backend);
+        longtitude = self->values[SETTING_LONGTITUDE][0];
+        CALL_END;
+
+        return longtitude;
+}
+
+static void
+redshiftgtk_mock_backend_set_longtitude (RedshiftGtkBackend *backend,
+                                         gdouble             longtitude)
+{
+        CALL_BEGIN (backend);
+        redshiftgtk_mock_backend_store (self, SETTING_LONGTITUDE,
+                                        longtitude, longtitude, longtitude);
+        CALL_END;
+}
+
+static gdouble
+redshiftgtk_mock_backend_get_brightness (RedshiftGtkBackend *backend,
+                                         TimePeriod          period)
+{
+        gdouble brightness;
+
+        CALL_BEGIN (backend);
+        brightness = self->values[SETTING_BRIGHTNESS_DAY + period][0];
+        CALL_END;
+
+        return brightness;
+}
+
+static void
+redshiftgtk_mock_backend_set_brightness (RedshiftGtkBackend *backend,
+                                         TimePeriod          period,
+                                         gdouble             brightness)
+{
+        CALL_BEGIN (backend);
+        redshiftgtk_mock_backend_store (self, SETTING_BRIGHTNESS_DAY + period,
+                                        brightness, brightness, brightness);
+        CALL_END;
+}
+
+static GArray*
+redshiftgtk_mock_backend_get_gamma (RedshiftGtkBackend *backend,
+                                    TimePeriod          period)
+{
+        GArray *gamma;
+
+        CALL_BEGIN (backend);
+        gamma = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), SETTING_COMPONENTS);
+        g_array_append_vals (gamma, self->values[SETTING_GAMMA_DAY + period],
+                             SETTING_COMPONENTS);
+        CALL_END;
+
+        return gamma;
+}
+
+static void
+redshiftgtk_mock_backend_set_gamma (RedshiftGtkBackend *backend,
+                                    TimePeriod          period,
+                                    gdouble             red,
+                                    gdouble             green,
+                                    gdouble             blue)
+{
+        CALL_BEGIN (backend);
+        redshiftgtk_mock_backend_store (self, SETTING_GAMMA_DAY + period,
+                                        red, green, blue);
+        CALL_END;
+}
+
+static AdjustmentMethod
+redshiftgtk_mock_backend_get_adjustment_method (RedshiftGtkBackend *backend)
+{
+        AdjustmentMethod method;
+
+        CALL_BEGIN (backend);
+        method = (AdjustmentMethod) self->values[SETTING_ADJUSTMENT_METHOD][0];
+        CALL_END;
+
+        return method;
+}
+
+static void
+redshiftgtk_mock_backend_set_adjustment_method (RedshiftGtkBackend *backend,
+                                                AdjustmentMethod    method)
+{
+        CALL_BEGIN (backend);
+        redshiftgtk_mock_backend_store (self, SETTING_ADJUSTMENT_METHOD,
+                                        method, method, method);
+        CALL_END;
+}
+
+static gboolean
+redshiftgtk_mock_backend_get_smooth_transition (RedshiftGtkBackend *backend)
+{
+        gboolean transition;
+
+        CALL_BEGIN (backend);
+        transition = self->values[SETTING_FADE][0] != 0;
+        CALL_END;
+
+        return transition;
+}
+
+static void
+redshiftgtk_mock_backend_set_smooth_transition (RedshiftGtkBackend *backend,
+                                                gboolean            transition)
+{
+        CALL_BEGIN (backend);
+        redshiftgtk_mock_backend_store (self, SETTING_FADE,
+                                        transition, transition, transition);
+        CALL_END;
+}
+
+static gboolean
+redshiftgtk_mock_backend_get_autostart (RedshiftGtkBackend *backend)
+{
+        gboolean autostart;
+
+        CALL_BEGIN (backend);
+        autostart = self->autostart;
+        CALL_END;
+
+        return autostart;
+}
+
+static void
+redshiftgtk_mock_backend_set_autostart (RedshiftGtkBackend *backend,
+                                        gboolean            autostart,
+                                        GError            **error)
+{
+        CALL_BEGIN (backend);
+        if (self->fail_autostart)
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED,
+                                     "Autostart is disabled");
+        else
+                self->autostart = autostart;
+        CALL_END;
+}
+
+static void
+redshiftgtk_mock_backend_apply_changes (RedshiftGtkBackend *backend,
+                                        GError            **error)
+{
+        gboolean modified;
+
+        CALL_BEGIN (backend);
+        modified = self->modified != 0;
+        self->modified = 0;
+        self->applies++;
+        CALL_END;
+
+        /* Like the real ones, outside of the time spent in here */
+        if (modified)
+                g_signal_emit_by_name (self, "changed");
+}
+
+static void
+redshiftgtk_mock_backend_preview_temperature (RedshiftGtkBackend *backend,
+                                              TimePeriod          period,
+                                              gdouble             temperature)
+{
+        CALL_BEGIN (backend);
+        self->previewing = TRUE;
+        CALL_END;
+}
+
+static void
+redshiftgtk_mock_backend_end_preview (RedshiftGtkBackend *backend)
+{
+        CALL_BEGIN (backend);
+        self->previewing = FALSE;
+        CALL_END;
+}
+
+static gchar**
+redshiftgtk_mock_backend_list_profiles (RedshiftGtkBackend *backend)
+{
+        gchar **profiles;
+        guint i;
+
+        CALL_BEGIN (backend);
+        profiles = g_new0 (gchar *, self->profiles->len + 1);
+        for (i = 0; i < self->profiles->len; i++)
+                profiles[i] = g_strdup (g_ptr_array_index (self->profiles, i));
+        CALL_END;
+
+        return profiles;
+}
+
+static const gchar*
+redshiftgtk_mock_backend_get_profile (RedshiftGtkBackend *backend)
+{
+        const gchar *profile;
+
+        CALL_BEGIN (backend);
+        profile = self->profile;
+        CALL_END;
+
+        return profile;
+}
+
+static gboolean
+redshiftgtk_mock_backend_has_profile (RedshiftGtkMockBackend *self,
+                                      const gchar            *name)
+{
+        guint i;
+
+        for (i = 0; i < self->profiles->len; i++) {
+                if (g_strcmp0 (g_ptr_array_index (self->profiles, i), name) == 0)
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+static void
+redshiftgtk_mock_backend_switch_profile (RedshiftGtkBackend *backend,
+                                         const gchar        *name,
+                                         GError            **error)
+{
+        gboolean changed;
+
+        CALL_BEGIN (backend);
+
+        /* One set of values shared by every profile, names are enough */
+        if (name && *name && !redshiftgtk_mock_backend_has_profile (self, name))
+                g_ptr_array_add (self->profiles, g_strdup (name));
+
+        changed = g_strcmp0 (self->profile, name && *name ? name : NULL) != 0;
+        g_free (self->profile);
+        self->profile = name && *name ? g_strdup (name) : NULL;
+
+        CALL_END;
+
+        if (changed)
+                g_signal_emit_by_name (self, "changed");
+}
+
+static void
+redshiftgtk_mock_backend_set_override (RedshiftGtkBackend *backend,
+                                       const gchar        *key,
+                                       const gchar        *value,
+                                       GError            **error)
+{
+        SettingValue parsed;
+        Setting setting;
+        gboolean valid;
+
+        CALL_BEGIN (backend);
+        valid = redshiftgtk_settings_schema_find (key, &setting) &&
+                value && redshiftgtk_settings_schema_parse_value (setting, value, parsed);
+        if (valid)
+                memcpy (self->values[setting], parsed, sizeof (SettingValue));
+        CALL_END;
+
+        if (!valid) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                             "Can not override %s", key);
+                return;
+        }
+
+        g_signal_emit_by_name (self, "changed");
+}
+
+static ConfigLayer
+redshiftgtk_mock_backend_get_source (RedshiftGtkBackend *backend,
+                                     const gchar        *key)
+{
+        CALL_BEGIN (backend);
+        CALL_END;
+
+        return CONFIG_LAYER_USER;
+}
+
+/* Nothing runs besides the mock itself */
+static GPtrArray*
+redshiftgtk_mock_backend_list_foreign (RedshiftGtkBackend *backend)
+{
+        CALL_BEGIN (backend);
+        CALL_END;
+
+        return g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_process_free);
+}
+
+static void
+redshiftgtk_mock_backend_adopt (RedshiftGtkBackend *backend,
+                                GPid                pid,
+                                GError            **error)
+{
+        CALL_BEGIN (backend);
+        CALL_END;
+
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                     "No process %d", pid);
+}
+
+static void
+redshiftgtk_mock_backend_leave (RedshiftGtkBackend *backend,
+                                GPid                pid)
+{
+        CALL_BEGIN (backend);
+        CALL_END;
+}
+
+static void
+redshiftgtk_backend_iface_init (RedshiftGtkBackendInterface *iface)
+{
+        iface->start = redshiftgtk_mock_backend_start;
+        iface->stop = redshiftgtk_mock_backend_stop;
+        iface->is_running = redshiftgtk_mock_backend_is_running;
+        iface->get_temperature = redshiftgtk_mock_backend_get_temperature;
+        iface->set_temperature = redshiftgtk_mock_backend_set_temperature;
+        iface->get_location_provider = redshiftgtk_mock_backend_get_location_provider;
+        iface->set_location_provider = redshiftgtk_mock_backend_set_location_provider;
+        iface->get_latitude = redshiftgtk_mock_backend_get_latitude;
+        iface->set_latitude = redshiftgtk_mock_backend_set_latitude;
+        iface->get_longtitude = redshiftgtk_mock_backend_get_longtitude;
+        iface->set_longtitude = redshiftgtk_mock_backend_set_longtitude;
+        iface->get_brightness = redshiftgtk_mock_backend_get_brightness;
+        iface->set_brightness = redshiftgtk_mock_backend_set_brightness;
+        iface->get_gamma = redshiftgtk_mock_backend_get_gamma;
+        iface->set_gamma = redshiftgtk_mock_backend_set_gamma;
+        iface->get_adjustment_method = redshiftgtk_mock_backend_get_adjustment_method;
+        iface->set_adjustment_method = redshiftgtk_mock_backend_set_adjustment_method;
+        iface->get_smooth_transition = redshiftgtk_mock_backend_get_smooth_transition;
+        iface->set_smooth_transition = redshiftgtk_mock_backend_set_smooth_transition;
+        iface->get_autostart = redshiftgtk_mock_backend_get_autostart;
+        iface->set_autostart = redshiftgtk_mock_backend_set_autostart;
+        iface->apply_changes = redshiftgtk_mock_backend_apply_changes;
+        iface->preview_temperature = redshiftgtk_mock_backend_preview_temperature;
+        iface->end_preview = redshiftgtk_mock_backend_end_preview;
+        iface->list_profiles = redshiftgtk_mock_backend_list_profiles;
+        iface->get_profile = redshiftgtk_mock_backend_get_profile;
+        iface->switch_profile = redshiftgtk_mock_backend_switch_profile;
+        iface->set_override = redshiftgtk_mock_backend_set_override;
+        iface->get_source = redshiftgtk_mock_backend_get_source;
+        iface->list_foreign = redshiftgtk_mock_backend_list_foreign;
+        iface->adopt = redshiftgtk_mock_backend_adopt;
+        iface->leave = redshiftgtk_mock_backend_leave;
+        iface->list_outputs = redshiftgtk_mock_backend_list_outputs;
+        iface->get_output_setting = redshiftgtk_mock_backend_get_output_setting;
+        iface->set_output_setting = redshiftgtk_mock_backend_set_output_setting;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "backend/redshiftgtk-backend.h"
+
+G_BEGIN_DECLS
+
+/* Settings in memory and no redshift, every call takes as long as
+ * the latency it was given. Tells how long the callers spent in it,
+ * so whatever surrounds the calls can be timed on its own.
+ */
+#define REDSHIFTGTK_TYPE_MOCK_BACKEND redshiftgtk_mock_backend_get_type ()
+G_DECLARE_FINAL_TYPE (RedshiftGtkMockBackend, redshiftgtk_mock_backend,
+                      REDSHIFTGTK, MOCK_BACKEND, GObject)
+
+RedshiftGtkBackend*
+redshiftgtk_mock_backend_new              (gulong                  latency);
+
+gint64
+redshiftgtk_mock_backend_get_time_spent   (RedshiftGtkMockBackend *self);
+guint
+redshiftgtk_mock_backend_get_calls        (RedshiftGtkMockBackend *self);
+guint
+redshiftgtk_mock_backend_get_starts       (RedshiftGtkMockBackend *self);
+guint
+redshiftgtk_mock_backend_get_applies      (RedshiftGtkMockBackend *self);
+gboolean
+redshiftgtk_mock_backend_is_previewing    (RedshiftGtkMockBackend *self);
+void
+redshiftgtk_mock_backend_reset_statistics (RedshiftGtkMockBackend *self);
+void
+redshiftgtk_mock_backend_fail_autostart   (RedshiftGtkMockBackend *self,
+                                           gboolean                fail);
+
+G_END_DECLS
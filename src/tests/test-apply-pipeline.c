@@ -0,0 +1,443 @@
+#include "backend/redshiftgtk-apply-pipeline.h"
+#include "mock-backend.h"
+
+typedef struct {
+        RedshiftGtkBackend *backend;
+        RedshiftGtkSettingsModel *settings;
+        RedshiftGtkApplyPipeline *pipeline;
+} PipelineFixture;
+
+typedef struct {
+        RedshiftGtkApplyPipeline *pipeline;
+        gboolean finished;
+        gboolean success;
+        ApplyStage stage;
+        GError *error;
+} RunResult;
+
+static void
+pipeline_fixture_set_up (PipelineFixture *fixture,
+                         gconstpointer    user_data)
+{
+        fixture->backend = redshiftgtk_mock_backend_new (0);
+        fixture->settings = redshiftgtk_settings_model_new ();
+        redshiftgtk_settings_model_load (fixture->settings, fixture->backend);
+        fixture->pipeline = redshiftgtk_apply_pipeline_new (fixture->backend,
+                                                            fixture->settings);
+}
+
+static void
+pipeline_fixture_tear_down (PipelineFixture *fixture,
+                            gconstpointer    user_data)
+{
+        redshiftgtk_apply_pipeline_free (fixture->pipeline);
+        g_object_unref (fixture->settings);
+        g_object_unref (fixture->backend);
+}
+
+static void
+run_finished_cb (GObject      *source_object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+        RunResult *run = user_data;
+
+        run->success = redshiftgtk_apply_pipeline_run_finish (run->pipeline, result,
+                                                              &run->stage, &run->error);
+        run->finished = TRUE;
+}
+
+static void
+run_with_flags (PipelineFixture *fixture,
+                ApplyFlags       flags,
+                RunResult       *result)
+{
+        result->pipeline = fixture->pipeline;
+        redshiftgtk_apply_pipeline_run (fixture->pipeline, flags, run_finished_cb, result);
+}
+
+static void
+run (PipelineFixture *fixture,
+     RunResult       *result)
+{
+        run_with_flags (fixture, APPLY_FLAGS_NONE, result);
+}
+
+static void
+wait_for (RunResult *result)
+{
+        while (!result->finished)
+                g_main_context_iteration (NULL, TRUE);
+}
+
+static guint
+starts (PipelineFixture *fixture)
+{
+        return redshiftgtk_mock_backend_get_starts (REDSHIFTGTK_MOCK_BACKEND (fixture->backend));
+}
+
+static guint
+applies (PipelineFixture *fixture)
+{
+        return redshiftgtk_mock_backend_get_applies (REDSHIFTGTK_MOCK_BACKEND (fixture->backend));
+}
+
+static void
+test_apply_pipeline_run (PipelineFixture *fixture,
+                         gconstpointer    user_data)
+{
+        RunResult result = { 0, };
+
+        g_object_set (fixture->settings, "temp-night", 3300.0, "autostart", TRUE, NULL);
+
+        run (fixture, &result);
+        g_assert_true (redshiftgtk_apply_pipeline_is_running (fixture->pipeline));
+        /* Nothing happens before the main loop gets to it */
+        g_assert_cmpuint (starts (fixture), ==, 0);
+
+        wait_for (&result);
+        g_assert_no_error (result.error);
+        g_assert_true (result.success);
+        g_assert_false (redshiftgtk_apply_pipeline_is_running (fixture->pipeline));
+
+        g_assert_cmpuint (applies (fixture), ==, 1);
+        g_assert_cmpuint (starts (fixture), ==, 1);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend, TIME_PERIOD_NIGHT),
+                           ==, 3300.0);
+        g_assert_true (redshiftgtk_backend_get_autostart (fixture->backend));
+}
+
+static void
+test_apply_pipeline_supersede (PipelineFixture *fixture,
+                               gconstpointer    user_data)
+{
+        RunResult first = { 0, };
+        RunResult second = { 0, };
+
+        g_object_set (fixture->settings, "temp-night", 3300.0, NULL);
+        run (fixture, &first);
+
+        /* Clicked again before the first one got anywhere */
+        g_object_set (fixture->settings, "temp-night", 3100.0, NULL);
+        run (fixture, &second);
+
+        wait_for (&second);
+        wait_for (&first);
+
+        g_assert_error (first.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+        g_assert_no_error (second.error);
+        g_assert_true (second.success);
+
+        /* Only the second one persisted and started anything */
+        g_assert_cmpuint (applies (fixture), ==, 1);
+        g_assert_cmpuint (starts (fixture), ==, 1);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend, TIME_PERIOD_NIGHT),
+                           ==, 3100.0);
+
+        g_error_free (first.error);
+}
+
+static void
+test_apply_pipeline_unchanged (PipelineFixture *fixture,
+                               gconstpointer    user_data)
+{
+        RunResult first = { 0, };
+        RunResult second = { 0, };
+
+        run (fixture, &first);
+        wait_for (&first);
+        g_assert_true (first.success);
+
+        /* Nothing to write, redshift is started all the same */
+        run (fixture, &second);
+        wait_for (&second);
+        g_assert_true (second.success);
+
+        g_assert_cmpuint (applies (fixture), ==, 1);
+        g_assert_cmpuint (starts (fixture), ==, 2);
+}
+
+/* What auto-apply does: start right away, write later */
+static void
+test_apply_pipeline_deferred (PipelineFixture *fixture,
+                              gconstpointer    user_data)
+{
+        RunResult commit = { 0, };
+        RunResult persist = { 0, };
+
+        g_object_set (fixture->settings, "temp-night", 3300.0, "autostart", TRUE, NULL);
+
+        run_with_flags (fixture, APPLY_FLAGS_NO_PERSIST, &commit);
+        wait_for (&commit);
+        g_assert_true (commit.success);
+        g_assert_cmpuint (applies (fixture), ==, 0);
+        g_assert_cmpuint (starts (fixture), ==, 1);
+        g_assert_false (redshiftgtk_backend_get_autostart (fixture->backend));
+
+        run_with_flags (fixture, APPLY_FLAGS_NO_START, &persist);
+        wait_for (&persist);
+        g_assert_true (persist.success);
+        g_assert_cmpuint (applies (fixture), ==, 1);
+        g_assert_cmpuint (starts (fixture), ==, 1);
+        g_assert_true (redshiftgtk_backend_get_autostart (fixture->backend));
+}
+
+static void
+test_apply_pipeline_cancel (PipelineFixture *fixture,
+                            gconstpointer    user_data)
+{
+        RunResult result = { 0, };
+
+        run (fixture, &result);
+        redshiftgtk_apply_pipeline_cancel (fixture->pipeline);
+        g_assert_false (redshiftgtk_apply_pipeline_is_running (fixture->pipeline));
+
+        wait_for (&result);
+        g_assert_error (result.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+        g_assert_cmpuint (starts (fixture), ==, 0);
+
+        g_error_free (result.error);
+}
+
+static void
+test_apply_pipeline_flush (PipelineFixture *fixture,
+                           gconstpointer    user_data)
+{
+        RunResult result = { 0, };
+
+        run (fixture, &result);
+        redshiftgtk_apply_pipeline_flush (fixture->pipeline);
+
+        /* Done without the main loop, which only reports it */
+        g_assert_false (redshiftgtk_apply_pipeline_is_running (fixture->pipeline));
+        g_assert_cmpuint (starts (fixture), ==, 1);
+
+        wait_for (&result);
+        g_assert_no_error (result.error);
+        g_assert_true (result.success);
+        g_assert_cmpuint (starts (fixture), ==, 1);
+}
+
+/* Runs the window would start, and how they went */
+typedef struct {
+        RedshiftGtkApplyPipeline *pipeline;
+        GArray *flags;          /* ApplyFlags */
+        RunResult results[8];
+} Scheduled;
+
+static void
+scheduled_run_cb (RedshiftGtkApplyPipeline *pipeline,
+                  ApplyFlags                flags,
+                  gpointer                  user_data)
+{
+        Scheduled *scheduled = user_data;
+        RunResult *result = &scheduled->results[scheduled->flags->len];
+
+        g_assert_cmpuint (scheduled->flags->len, <, G_N_ELEMENTS (scheduled->results));
+        g_array_append_val (scheduled->flags, flags);
+
+        result->pipeline = pipeline;
+        redshiftgtk_apply_pipeline_run (pipeline, flags, run_finished_cb, result);
+}
+
+static void
+wait_ms (guint ms)
+{
+        gint64 deadline = g_get_monotonic_time () + ms * G_TIME_SPAN_MILLISECOND;
+
+        while (g_get_monotonic_time () < deadline) {
+                g_main_context_iteration (NULL, FALSE);
+                g_usleep (1000);
+        }
+}
+
+/* A dragged slider: one start once it settles, one write later */
+static void
+test_apply_pipeline_schedule (PipelineFixture *fixture,
+                              gconstpointer    user_data)
+{
+        Scheduled scheduled = { 0, };
+        gdouble temperature;
+
+        scheduled.flags = g_array_new (FALSE, FALSE, sizeof (ApplyFlags));
+        redshiftgtk_apply_pipeline_set_delays (fixture->pipeline, 100, 500);
+
+        for (temperature = 3000; temperature <= 3900; temperature += 100) {
+                g_object_set (fixture->settings, "temp-night", temperature, NULL);
+                redshiftgtk_apply_pipeline_schedule (fixture->pipeline, scheduled_run_cb, &scheduled);
+                wait_ms (5);
+        }
+        g_assert_cmpuint (scheduled.flags->len, ==, 0);
+
+        wait_ms (200);
+        g_assert_cmpuint (scheduled.flags->len, ==, 1);
+        g_assert_cmpint (g_array_index (scheduled.flags, ApplyFlags, 0), ==, APPLY_FLAGS_NO_PERSIST);
+        wait_for (&scheduled.results[0]);
+        g_assert_true (scheduled.results[0].success);
+        g_assert_cmpuint (starts (fixture), ==, 1);
+        g_assert_cmpuint (applies (fixture), ==, 0);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend, TIME_PERIOD_NIGHT),
+                           ==, 3900.0);
+
+        wait_ms (600);
+        g_assert_cmpuint (scheduled.flags->len, ==, 2);
+        g_assert_cmpint (g_array_index (scheduled.flags, ApplyFlags, 1), ==, APPLY_FLAGS_NO_START);
+        wait_for (&scheduled.results[1]);
+        g_assert_true (scheduled.results[1].success);
+        g_assert_cmpuint (starts (fixture), ==, 1);
+        g_assert_cmpuint (applies (fixture), ==, 1);
+
+        /* Nothing left over for a closing window */
+        g_assert_false (redshiftgtk_apply_pipeline_run_scheduled (fixture->pipeline));
+        g_assert_cmpuint (scheduled.flags->len, ==, 2);
+
+        g_array_unref (scheduled.flags);
+}
+
+/* Closed right after a change, it is applied in full */
+static void
+test_apply_pipeline_run_scheduled (PipelineFixture *fixture,
+                                   gconstpointer    user_data)
+{
+        Scheduled scheduled = { 0, };
+
+        scheduled.flags = g_array_new (FALSE, FALSE, sizeof (ApplyFlags));
+
+        g_object_set (fixture->settings, "temp-night", 3300.0, NULL);
+        redshiftgtk_apply_pipeline_schedule (fixture->pipeline, scheduled_run_cb, &scheduled);
+        g_assert_true (redshiftgtk_apply_pipeline_run_scheduled (fixture->pipeline));
+        g_assert_cmpuint (scheduled.flags->len, ==, 1);
+        g_assert_cmpint (g_array_index (scheduled.flags, ApplyFlags, 0), ==, APPLY_FLAGS_NONE);
+
+        redshiftgtk_apply_pipeline_flush (fixture->pipeline);
+        g_assert_cmpuint (starts (fixture), ==, 1);
+        g_assert_cmpuint (applies (fixture), ==, 1);
+        wait_for (&scheduled.results[0]);
+
+        /* Stop drops a start that is still to come */
+        redshiftgtk_apply_pipeline_schedule (fixture->pipeline, scheduled_run_cb, &scheduled);
+        redshiftgtk_apply_pipeline_unschedule (fixture->pipeline);
+        g_assert_false (redshiftgtk_apply_pipeline_run_scheduled (fixture->pipeline));
+        g_assert_cmpuint (scheduled.flags->len, ==, 1);
+
+        g_array_unref (scheduled.flags);
+}
+
+/* What the window does on every change with auto-apply */
+static void
+settings_notify_cb (GObject    *object,
+                    GParamSpec *pspec,
+                    gpointer    user_data)
+{
+        Scheduled *scheduled = user_data;
+
+        redshiftgtk_apply_pipeline_schedule (scheduled->pipeline, scheduled_run_cb, scheduled);
+}
+
+/* Autostart is switched back off, which isn't a change to apply */
+static void
+test_apply_pipeline_autostart_failed (PipelineFixture *fixture,
+                                      gconstpointer    user_data)
+{
+        RunResult result = { 0, };
+        Scheduled scheduled = { 0, };
+        gboolean autostart = TRUE;
+
+        scheduled.pipeline = fixture->pipeline;
+        scheduled.flags = g_array_new (FALSE, FALSE, sizeof (ApplyFlags));
+        redshiftgtk_apply_pipeline_set_delays (fixture->pipeline, 10, 50);
+        redshiftgtk_mock_backend_fail_autostart (REDSHIFTGTK_MOCK_BACKEND (fixture->backend), TRUE);
+
+        g_object_set (fixture->settings, "autostart", TRUE, NULL);
+        g_signal_connect (fixture->settings, "notify",
+                          G_CALLBACK (settings_notify_cb), &scheduled);
+
+        run (fixture, &result);
+        wait_for (&result);
+        g_assert_false (result.success);
+        g_assert_cmpint (result.stage, ==, APPLY_STAGE_AUTOSTART);
+        g_assert_error (result.error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED);
+        g_clear_error (&result.error);
+
+        g_object_get (fixture->settings, "autostart", &autostart, NULL);
+        g_assert_false (autostart);
+
+        wait_ms (100);
+        g_assert_cmpuint (scheduled.flags->len, ==, 0);
+        g_assert_cmpuint (starts (fixture), ==, 1);
+
+        g_signal_handlers_disconnect_by_data (fixture->settings, &scheduled);
+        g_array_unref (scheduled.flags);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add ("/Backend/ApplyPipeline/run",
+                    PipelineFixture,
+                    NULL,
+                    pipeline_fixture_set_up,
+                    test_apply_pipeline_run,
+                    pipeline_fixture_tear_down);
+
+        g_test_add ("/Backend/ApplyPipeline/supersede",
+                    PipelineFixture,
+                    NULL,
+                    pipeline_fixture_set_up,
+                    test_apply_pipeline_supersede,
+                    pipeline_fixture_tear_down);
+
+        g_test_add ("/Backend/ApplyPipeline/unchanged",
+                    PipelineFixture,
+                    NULL,
+                    pipeline_fixture_set_up,
+                    test_apply_pipeline_unchanged,
+                    pipeline_fixture_tear_down);
+
+        g_test_add ("/Backend/ApplyPipeline/deferred",
+                    PipelineFixture,
+                    NULL,
+                    pipeline_fixture_set_up,
+                    test_apply_pipeline_deferred,
+                    pipeline_fixture_tear_down);
+
+        g_test_add ("/Backend/ApplyPipeline/cancel",
+                    PipelineFixture,
+                    NULL,
+                    pipeline_fixture_set_up,
+                    test_apply_pipeline_cancel,
+                    pipeline_fixture_tear_down);
+
+        g_test_add ("/Backend/ApplyPipeline/flush",
+                    PipelineFixture,
+                    NULL,
+                    pipeline_fixture_set_up,
+                    test_apply_pipeline_flush,
+                    pipeline_fixture_tear_down);
+
+        g_test_add ("/Backend/ApplyPipeline/schedule",
+                    PipelineFixture,
+                    NULL,
+                    pipeline_fixture_set_up,
+                    test_apply_pipeline_schedule,
+                    pipeline_fixture_tear_down);
+
+        g_test_add ("/Backend/ApplyPipeline/run-scheduled",
+                    PipelineFixture,
+                    NULL,
+                    pipeline_fixture_set_up,
+                    test_apply_pipeline_run_scheduled,
+                    pipeline_fixture_tear_down);
+
+        g_test_add ("/Backend/ApplyPipeline/autostart-failed",
+                    PipelineFixture,
+                    NULL,
+                    pipeline_fixture_set_up,
+                    test_apply_pipeline_autostart_failed,
+                    pipeline_fixture_tear_down);
+
+        return g_test_run ();
+}
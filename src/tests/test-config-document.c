@@ -0,0 +1,172 @@
+#include <string.h>
+
+#include "backend/redshiftgtk-config-document.h"
+
+#define HAND_WRITTEN \
+        "; Written by hand, keep it that way\n" \
+        "[redshift]\n" \
+        "temp-day = 5500    \n" \
+        "# night is warmer\n" \
+        "temp-night=4500\n" \
+        "\n" \
+        "[manual]\n" \
+        "lat=45.38\n"
+
+static void
+assert_document (RedshiftGtkConfigDocument *document,
+                 const gchar               *expected)
+{
+        const gchar *data;
+        gsize length;
+
+        data = redshiftgtk_config_document_get_data (document, &length);
+        g_assert_cmpuint (length, ==, strlen (expected));
+        g_assert_cmpstr (data, ==, expected);
+}
+
+static void
+test_config_document_untouched (void)
+{
+        g_autoptr (RedshiftGtkConfigDocument) document = NULL;
+
+        document = redshiftgtk_config_document_new (HAND_WRITTEN, strlen (HAND_WRITTEN));
+
+        g_assert_false (redshiftgtk_config_document_set (document, "redshift", "temp-night", "4500"));
+        g_assert_false (redshiftgtk_config_document_set (document, "manual", "lon", NULL));
+        g_assert_false (redshiftgtk_config_document_is_modified (document));
+        assert_document (document, HAND_WRITTEN);
+}
+
+static void
+test_config_document_patch_value (void)
+{
+        g_autoptr (RedshiftGtkConfigDocument) document = NULL;
+
+        document = redshiftgtk_config_document_new (HAND_WRITTEN, strlen (HAND_WRITTEN));
+
+        /* Spacing around the value stays as the user wrote it */
+        g_assert_true (redshiftgtk_config_document_set (document, "redshift", "temp-day", "6000"));
+        g_assert_true (redshiftgtk_config_document_set (document, "redshift", "temp-night", "3500"));
+        g_assert_true (redshiftgtk_config_document_is_modified (document));
+
+        assert_document (document,
+                         "; Written by hand, keep it that way\n"
+                         "[redshift]\n"
+                         "temp-day = 6000    \n"
+                         "# night is warmer\n"
+                         "temp-night=3500\n"
+                         "\n"
+                         "[manual]\n"
+                         "lat=45.38\n");
+
+        redshiftgtk_config_document_mark_saved (document);
+        g_assert_false (redshiftgtk_config_document_is_modified (document));
+}
+
+static void
+test_config_document_add_key (void)
+{
+        g_autoptr (RedshiftGtkConfigDocument) document = NULL;
+
+        document = redshiftgtk_config_document_new (HAND_WRITTEN, strlen (HAND_WRITTEN));
+
+        g_assert_true (redshiftgtk_config_document_set (document, "redshift", "fade", "1"));
+        g_assert_true (redshiftgtk_config_document_set (document, "manual", "lon", "20.38"));
+
+        assert_document (document,
+                         "; Written by hand, keep it that way\n"
+                         "[redshift]\n"
+                         "temp-day = 5500    \n"
+                         "# night is warmer\n"
+                         "temp-night=4500\n"
+                         "fade=1\n"
+                         "\n"
+                         "[manual]\n"
+                         "lat=45.38\n"
+                         "lon=20.38\n");
+}
+
+static void
+test_config_document_add_group (void)
+{
+        g_autoptr (RedshiftGtkConfigDocument) document = NULL;
+
+        document = redshiftgtk_config_document_new ("[redshift]\nfade=0", strlen ("[redshift]\nfade=0"));
+        g_assert_true (redshiftgtk_config_document_set (document, "manual", "lat", "1.00"));
+        assert_document (document, "[redshift]\nfade=0\n\n[manual]\nlat=1.00\n");
+
+        g_clear_pointer (&document, redshiftgtk_config_document_free);
+
+        document = redshiftgtk_config_document_new ("", 0);
+        g_assert_true (redshiftgtk_config_document_set (document, "redshift", "fade", "1"));
+        assert_document (document, "[redshift]\nfade=1\n");
+}
+
+static void
+test_config_document_remove_key (void)
+{
+        g_autoptr (RedshiftGtkConfigDocument) document = NULL;
+
+        document = redshiftgtk_config_document_new (HAND_WRITTEN, strlen (HAND_WRITTEN));
+
+        g_assert_true (redshiftgtk_config_document_set (document, "redshift", "temp-day", NULL));
+
+        assert_document (document,
+                         "; Written by hand, keep it that way\n"
+                         "[redshift]\n"
+                         "# night is warmer\n"
+                         "temp-night=4500\n"
+                         "\n"
+                         "[manual]\n"
+                         "lat=45.38\n");
+}
+
+/* A hand-edited file may say it twice, both have to go */
+static void
+test_config_document_remove_duplicate_key (void)
+{
+        g_autoptr (RedshiftGtkConfigDocument) document = NULL;
+        const gchar *data = "[redshift]\ntemp-day=5000\ntemp-night=4000\ntemp-day=5500\n";
+
+        document = redshiftgtk_config_document_new (data, strlen (data));
+
+        g_assert_true (redshiftgtk_config_document_set (document, "redshift", "temp-day", NULL));
+        assert_document (document, "[redshift]\ntemp-night=4000\n");
+        g_assert_false (redshiftgtk_config_document_set (document, "redshift", "temp-day", NULL));
+}
+
+static void
+test_config_document_crlf (void)
+{
+        g_autoptr (RedshiftGtkConfigDocument) document = NULL;
+        const gchar *data = "[redshift]\r\ntemp-day=5500\r\n";
+
+        document = redshiftgtk_config_document_new (data, strlen (data));
+
+        g_assert_true (redshiftgtk_config_document_set (document, "redshift", "temp-day", "6500"));
+        assert_document (document, "[redshift]\r\ntemp-day=6500\r\n");
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/Backend/ConfigDocument/untouched",
+                         test_config_document_untouched);
+        g_test_add_func ("/Backend/ConfigDocument/patch-value",
+                         test_config_document_patch_value);
+        g_test_add_func ("/Backend/ConfigDocument/add-key",
+                         test_config_document_add_key);
+        g_test_add_func ("/Backend/ConfigDocument/add-group",
+                         test_config_document_add_group);
+        g_test_add_func ("/Backend/ConfigDocument/remove-key",
+                         test_config_document_remove_key);
+        g_test_add_func ("/Backend/ConfigDocument/remove-duplicate-key",
+                         test_config_document_remove_duplicate_key);
+        g_test_add_func ("/Backend/ConfigDocument/crlf",
+                         test_config_document_crlf);
+
+        return g_test_run ();
+}
@@ -0,0 +1,216 @@
+#include "backend/redshiftgtk-control-server.h"
+#include "mock-backend.h"
+
+typedef struct {
+        RedshiftGtkBackend *backend;
+        RedshiftGtkControlServer *control;
+} ControlFixture;
+
+/* Running, the way the window or --apply leaves it */
+static void
+control_fixture_set_up (ControlFixture *fixture,
+                        gconstpointer   user_data)
+{
+        fixture->backend = redshiftgtk_mock_backend_new (0);
+        redshiftgtk_backend_start (fixture->backend, NULL);
+        redshiftgtk_mock_backend_reset_statistics (REDSHIFTGTK_MOCK_BACKEND (fixture->backend));
+        fixture->control = redshiftgtk_control_server_new (fixture->backend);
+}
+
+static void
+control_fixture_tear_down (ControlFixture *fixture,
+                           gconstpointer   user_data)
+{
+        g_clear_object (&fixture->control);
+        g_clear_object (&fixture->backend);
+}
+
+static void
+assert_reply (ControlFixture *fixture,
+              const gchar    *command,
+              const gchar    *expected)
+{
+        g_autofree gchar *reply = redshiftgtk_control_server_handle (fixture->control, command);
+
+        g_assert_cmpstr (reply, ==, expected);
+}
+
+static gboolean
+timeout_cb (gpointer user_data)
+{
+        g_assert_not_reached ();
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+wait_for_starts (RedshiftGtkMockBackend *mock,
+                 guint                   starts)
+{
+        guint timeout_id = g_timeout_add_seconds (5, timeout_cb, NULL);
+
+        while (redshiftgtk_mock_backend_get_starts (mock) < starts)
+                g_main_context_iteration (NULL, TRUE);
+        g_source_remove (timeout_id);
+}
+
+static void
+test_control_server_set (ControlFixture *fixture,
+                         gconstpointer   user_data)
+{
+        RedshiftGtkMockBackend *mock = REDSHIFTGTK_MOCK_BACKEND (fixture->backend);
+
+        assert_reply (fixture, "set 3500", "OK temp-night=3500");
+        assert_reply (fixture, "  set   day\t6000 ", "OK temp-day=6000");
+        assert_reply (fixture, "query", "OK temp-day=6000 temp-night=3500 enabled=1");
+
+        /* Out of range is clamped, not refused */
+        assert_reply (fixture, "set 100", "OK temp-night=1000");
+
+        /* Handed to a new instance every time, never previewed */
+        g_assert_cmpuint (redshiftgtk_mock_backend_get_starts (mock), ==, 3);
+        g_assert_false (redshiftgtk_mock_backend_is_previewing (mock));
+}
+
+static void
+test_control_server_nudge (ControlFixture *fixture,
+                           gconstpointer   user_data)
+{
+        RedshiftGtkMockBackend *mock = REDSHIFTGTK_MOCK_BACKEND (fixture->backend);
+
+        assert_reply (fixture, "set 3500", "OK temp-night=3500");
+        redshiftgtk_mock_backend_reset_statistics (mock);
+
+        /* A held down key, every step builds on the previous one */
+        assert_reply (fixture, "nudge -500", "OK temp-night=3000");
+        assert_reply (fixture, "nudge -500", "OK temp-night=2500");
+        assert_reply (fixture, "nudge day +250", "OK temp-day=6750");
+        assert_reply (fixture, "query", "OK temp-day=6750 temp-night=2500 enabled=1");
+
+        /* Previewed only, until the burst is over */
+        g_assert_true (redshiftgtk_mock_backend_is_previewing (mock));
+        g_assert_cmpuint (redshiftgtk_mock_backend_get_starts (mock), ==, 0);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_NIGHT), ==, 3500);
+
+        /* Then handed over once */
+        wait_for_starts (mock, 1);
+        g_assert_false (redshiftgtk_mock_backend_is_previewing (mock));
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_NIGHT), ==, 2500);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_DAY), ==, 6750);
+
+        /* A set during a burst takes it over right away */
+        assert_reply (fixture, "nudge +500", "OK temp-night=3000");
+        assert_reply (fixture, "set day 6000", "OK temp-day=6000");
+        g_assert_cmpuint (redshiftgtk_mock_backend_get_starts (mock), ==, 2);
+        g_assert_false (redshiftgtk_mock_backend_is_previewing (mock));
+        assert_reply (fixture, "query", "OK temp-day=6000 temp-night=3000 enabled=1");
+
+        /* Nothing left to commit */
+        g_usleep (G_USEC_PER_SEC);
+        while (g_main_context_iteration (NULL, FALSE));
+        g_assert_cmpuint (redshiftgtk_mock_backend_get_starts (mock), ==, 2);
+}
+
+static void
+test_control_server_toggle (ControlFixture *fixture,
+                            gconstpointer   user_data)
+{
+        RedshiftGtkMockBackend *mock = REDSHIFTGTK_MOCK_BACKEND (fixture->backend);
+
+        assert_reply (fixture, "toggle", "OK enabled=0");
+
+        /* Remembered for when it is back on */
+        assert_reply (fixture, "set 4000", "OK temp-night=4000");
+        g_assert_cmpuint (redshiftgtk_mock_backend_get_starts (mock), ==, 0);
+
+        assert_reply (fixture, "toggle", "OK enabled=1");
+        g_assert_cmpuint (redshiftgtk_mock_backend_get_starts (mock), ==, 1);
+        assert_reply (fixture, "query", "OK temp-day=6500 temp-night=4000 enabled=1");
+
+        /* Off in the middle of a burst, kept but not previewed */
+        assert_reply (fixture, "nudge -500", "OK temp-night=3500");
+        assert_reply (fixture, "toggle", "OK enabled=0");
+        g_assert_false (redshiftgtk_mock_backend_is_previewing (mock));
+        assert_reply (fixture, "query", "OK temp-day=6500 temp-night=3500 enabled=0");
+        g_assert_cmpuint (redshiftgtk_mock_backend_get_starts (mock), ==, 1);
+}
+
+/* Started without redshift running, the first toggle turns it on */
+static void
+test_control_server_stopped (ControlFixture *fixture,
+                             gconstpointer   user_data)
+{
+        RedshiftGtkMockBackend *mock = REDSHIFTGTK_MOCK_BACKEND (fixture->backend);
+
+        redshiftgtk_backend_stop (fixture->backend);
+        assert_reply (fixture, "query", "OK temp-day=6500 temp-night=4500 enabled=0");
+
+        assert_reply (fixture, "nudge -500", "OK temp-night=4000");
+        g_assert_false (redshiftgtk_mock_backend_is_previewing (mock));
+
+        assert_reply (fixture, "toggle", "OK enabled=1");
+        g_assert_cmpuint (redshiftgtk_mock_backend_get_starts (mock), ==, 1);
+        assert_reply (fixture, "query", "OK temp-day=6500 temp-night=4000 enabled=1");
+}
+
+static void
+test_control_server_errors (ControlFixture *fixture,
+                            gconstpointer   user_data)
+{
+        assert_reply (fixture, "", "ERR empty command");
+        assert_reply (fixture, "dim", "ERR unknown command dim");
+        assert_reply (fixture, "set evening 3000", "ERR unknown period evening");
+        assert_reply (fixture, "set", "ERR usage: set [day|night] VALUE");
+        assert_reply (fixture, "nudge warmer", "ERR not a number: warmer");
+        assert_reply (fixture, "set day 3000 now", "ERR usage: set [day|night] VALUE");
+        assert_reply (fixture, "set day 3000 now please", "ERR too many arguments");
+        g_assert_cmpuint (redshiftgtk_mock_backend_get_starts (REDSHIFTGTK_MOCK_BACKEND (fixture->backend)),
+                          ==, 0);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add ("/Backend/ControlServer/set",
+                    ControlFixture,
+                    NULL,
+                    control_fixture_set_up,
+                    test_control_server_set,
+                    control_fixture_tear_down);
+
+        g_test_add ("/Backend/ControlServer/nudge",
+                    ControlFixture,
+                    NULL,
+                    control_fixture_set_up,
+                    test_control_server_nudge,
+                    control_fixture_tear_down);
+
+        g_test_add ("/Backend/ControlServer/toggle",
+                    ControlFixture,
+                    NULL,
+                    control_fixture_set_up,
+                    test_control_server_toggle,
+                    control_fixture_tear_down);
+
+        g_test_add ("/Backend/ControlServer/stopped",
+                    ControlFixture,
+                    NULL,
+                    control_fixture_set_up,
+                    test_control_server_stopped,
+                    control_fixture_tear_down);
+
+        g_test_add ("/Backend/ControlServer/errors",
+                    ControlFixture,
+                    NULL,
+                    control_fixture_set_up,
+                    test_control_server_errors,
+                    control_fixture_tear_down);
+
+        return g_test_run ();
+}
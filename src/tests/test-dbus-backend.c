@@ -0,0 +1,350 @@
+#include <glib/gstdio.h>
+
+#include "backend/redshiftgtk-backend.h"
+#include "backend/redshiftgtk-dbus-client.h"
+#include "backend/redshiftgtk-dbus-service.h"
+#include "backend/redshiftgtk-redshift-wrapper.h"
+#include "mock-backend.h"
+
+typedef struct {
+        GTestDBus *bus;
+        gchar *tmp_dir;
+        gchar *config_path;
+
+        /* The service lives in its own thread, like a separate daemon
+         * would, so that the synchronous client calls can be answered
+         */
+        GThread *thread;
+        GMainContext *context;
+        GMainLoop *loop;
+        GMutex mutex;
+        GCond cond;
+        gboolean ready;
+
+        RedshiftGtkBackend *client;
+        guint changed;
+} ObjectFixture;
+
+static gpointer
+service_thread_func (gpointer data)
+{
+        ObjectFixture *fixture = data;
+        g_autoptr (GDBusConnection) connection = NULL;
+        g_autoptr (RedshiftGtkBackend) backend = NULL;
+        g_autoptr (RedshiftGtkDBusService) service = NULL;
+        g_autoptr (GVariant) reply = NULL;
+        g_autoptr (GError) error = NULL;
+
+        g_main_context_push_thread_default (fixture->context);
+
+        connection = g_dbus_connection_new_for_address_sync (g_test_dbus_get_bus_address (fixture->bus),
+                                                             G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                             NULL, NULL, &error);
+        g_assert_no_error (error);
+
+        backend = redshiftgtk_redshift_wrapper_new ();
+        redshiftgtk_redshift_wrapper_set_config_path (backend, g_strdup (fixture->config_path));
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (backend), &error);
+        g_assert_no_error (error);
+
+        service = redshiftgtk_dbus_service_new (backend);
+        redshiftgtk_dbus_service_export (service, connection, &error);
+        g_assert_no_error (error);
+
+        reply = g_dbus_connection_call_sync (connection,
+                                             "org.freedesktop.DBus",
+                                             "/org/freedesktop/DBus",
+                                             "org.freedesktop.DBus",
+                                             "RequestName",
+                                             g_variant_new ("(su)", REDSHIFTGTK_DBUS_NAME, 0),
+                                             G_VARIANT_TYPE ("(u)"),
+                                             G_DBUS_CALL_FLAGS_NONE,
+                                             -1, NULL, &error);
+        g_assert_no_error (error);
+
+        g_mutex_lock (&fixture->mutex);
+        fixture->ready = TRUE;
+        g_cond_signal (&fixture->cond);
+        g_mutex_unlock (&fixture->mutex);
+
+        g_main_loop_run (fixture->loop);
+
+        redshiftgtk_dbus_service_unexport (service);
+        g_main_context_pop_thread_default (fixture->context);
+
+        return NULL;
+}
+
+static void
+client_changed_cb (RedshiftGtkBackend *backend,
+                   gpointer            user_data)
+{
+        ObjectFixture *fixture = user_data;
+
+        fixture->changed++;
+}
+
+static void
+dbus_backend_fixture_set_up (ObjectFixture *fixture,
+                             gconstpointer  user_data)
+{
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *contents = NULL;
+        g_autofree gchar *data_config_path = NULL;
+
+        fixture->bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+        g_test_dbus_up (fixture->bus);
+
+        /* Work on a copy, applying changes writes the file */
+        fixture->tmp_dir = g_dir_make_tmp ("redshiftgtk-XXXXXX", &error);
+        g_assert_no_error (error);
+        fixture->config_path = g_build_filename (fixture->tmp_dir, "redshift.conf", NULL);
+
+        data_config_path = g_build_filename (TEST_DATA_DIR, "redshift.conf", NULL);
+        g_file_get_contents (data_config_path, &contents, NULL, &error);
+        g_assert_no_error (error);
+        g_file_set_contents (fixture->config_path, contents, -1, &error);
+        g_assert_no_error (error);
+
+        fixture->context = g_main_context_new ();
+        fixture->loop = g_main_loop_new (fixture->context, FALSE);
+        g_mutex_init (&fixture->mutex);
+        g_cond_init (&fixture->cond);
+
+        fixture->thread = g_thread_new ("service", service_thread_func, fixture);
+
+        g_mutex_lock (&fixture->mutex);
+        while (!fixture->ready)
+                g_cond_wait (&fixture->cond, &fixture->mutex);
+        g_mutex_unlock (&fixture->mutex);
+
+        fixture->client = redshiftgtk_dbus_client_new (NULL, &error);
+        g_assert_no_error (error);
+        g_assert (REDSHIFTGTK_IS_BACKEND (fixture->client));
+
+        g_signal_connect (fixture->client, "changed",
+                          G_CALLBACK (client_changed_cb), fixture);
+}
+
+static gboolean
+quit_loop_cb (gpointer data)
+{
+        g_main_loop_quit (data);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+dbus_backend_fixture_tear_down (ObjectFixture *fixture,
+                                gconstpointer  user_data)
+{
+        g_clear_object (&fixture->client);
+
+        g_main_context_invoke (fixture->context, quit_loop_cb, fixture->loop);
+        g_thread_join (fixture->thread);
+
+        g_main_loop_unref (fixture->loop);
+        g_main_context_unref (fixture->context);
+        g_mutex_clear (&fixture->mutex);
+        g_cond_clear (&fixture->cond);
+
+        g_test_dbus_down (fixture->bus);
+        g_clear_object (&fixture->bus);
+
+        g_unlink (fixture->config_path);
+        g_rmdir (fixture->tmp_dir);
+        g_free (fixture->config_path);
+        g_free (fixture->tmp_dir);
+}
+
+static void
+test_dbus_backend_snapshot (ObjectFixture *fixture,
+                            gconstpointer  user_data)
+{
+        g_autoptr (GArray) gamma = NULL;
+
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->client,
+                                                                TIME_PERIOD_DAY), ==, 5500);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->client,
+                                                                TIME_PERIOD_NIGHT), ==, 4500);
+        g_assert (redshiftgtk_backend_get_location_provider (fixture->client) == LOCATION_PROVIDER_MANUAL);
+        g_assert_cmpfloat (redshiftgtk_backend_get_latitude (fixture->client), ==, 45.38);
+        g_assert (redshiftgtk_backend_get_adjustment_method (fixture->client) == ADJUSTMENT_METHOD_RANDR);
+
+        gamma = redshiftgtk_backend_get_gamma (fixture->client, TIME_PERIOD_NIGHT);
+        g_assert (gamma != NULL);
+        g_assert_cmpfloat (g_array_index (gamma, gdouble, 0), ==, 0.4);
+        g_assert_cmpfloat (g_array_index (gamma, gdouble, 1), ==, 0.5);
+        g_assert_cmpfloat (g_array_index (gamma, gdouble, 2), ==, 0.6);
+}
+
+static void
+test_dbus_backend_set_is_local (ObjectFixture *fixture,
+                                gconstpointer  user_data)
+{
+        redshiftgtk_backend_set_temperature (fixture->client, TIME_PERIOD_NIGHT, 3500);
+
+        /* Visible right away, without a round-trip */
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->client,
+                                                                TIME_PERIOD_NIGHT), ==, 3500);
+}
+
+static gboolean
+timeout_cb (gpointer data)
+{
+        g_assert_not_reached ();
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+test_dbus_backend_apply_changes (ObjectFixture *fixture,
+                                 gconstpointer  user_data)
+{
+        g_autoptr (GKeyFile) config = g_key_file_new ();
+        g_autoptr (GError) error = NULL;
+        guint timeout_id;
+
+        redshiftgtk_backend_set_temperature (fixture->client, TIME_PERIOD_NIGHT, 3500);
+        redshiftgtk_backend_apply_changes (fixture->client, &error);
+        g_assert_no_error (error);
+
+        /* The daemon wrote the file */
+        g_key_file_load_from_file (config, fixture->config_path, G_KEY_FILE_NONE, &error);
+        g_assert_no_error (error);
+        g_assert_cmpfloat (g_key_file_get_double (config, "redshift", "temp-night", NULL), ==, 3500);
+
+        /* And told everyone about it */
+        timeout_id = g_timeout_add_seconds (5, timeout_cb, NULL);
+        while (fixture->changed == 0)
+                g_main_context_iteration (NULL, TRUE);
+        g_source_remove (timeout_id);
+
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->client,
+                                                                TIME_PERIOD_NIGHT), ==, 3500);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->client,
+                                                                TIME_PERIOD_DAY), ==, 5500);
+}
+
+static void
+wait_for_previewing (RedshiftGtkMockBackend *backend,
+                     gboolean                previewing)
+{
+        guint timeout_id = g_timeout_add_seconds (5, timeout_cb, NULL);
+
+        while (redshiftgtk_mock_backend_is_previewing (backend) != previewing)
+                g_main_context_iteration (NULL, TRUE);
+        g_source_remove (timeout_id);
+}
+
+/* A window that goes away mid-preview, without ending it */
+static void
+test_dbus_backend_preview_owner (void)
+{
+        g_autoptr (GTestDBus) bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+        g_autoptr (GDBusConnection) service_connection = NULL;
+        g_autoptr (GDBusConnection) window_connection = NULL;
+        g_autoptr (RedshiftGtkBackend) backend = NULL;
+        g_autoptr (RedshiftGtkDBusService) service = NULL;
+        g_autoptr (GError) error = NULL;
+        const GDBusConnectionFlags flags = G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                           G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION;
+
+        g_test_dbus_up (bus);
+
+        service_connection = g_dbus_connection_new_for_address_sync (g_test_dbus_get_bus_address (bus),
+                                                                     flags, NULL, NULL, &error);
+        g_assert_no_error (error);
+        window_connection = g_dbus_connection_new_for_address_sync (g_test_dbus_get_bus_address (bus),
+                                                                    flags, NULL, NULL, &error);
+        g_assert_no_error (error);
+
+        backend = redshiftgtk_mock_backend_new (0);
+        service = redshiftgtk_dbus_service_new (backend);
+        redshiftgtk_dbus_service_export (service, service_connection, &error);
+        g_assert_no_error (error);
+
+        /* Answered from this thread, so not waited for synchronously */
+        g_dbus_connection_call (window_connection,
+                                g_dbus_connection_get_unique_name (service_connection),
+                                REDSHIFTGTK_DBUS_OBJECT_PATH,
+                                "com.github.cybre.RedshiftGtk.Backend",
+                                "PreviewTemperature",
+                                g_variant_new ("(ud)", TIME_PERIOD_NIGHT, 3000.0),
+                                NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+        wait_for_previewing (REDSHIFTGTK_MOCK_BACKEND (backend), TRUE);
+
+        g_dbus_connection_close_sync (window_connection, NULL, &error);
+        g_assert_no_error (error);
+        wait_for_previewing (REDSHIFTGTK_MOCK_BACKEND (backend), FALSE);
+
+        redshiftgtk_dbus_service_unexport (service);
+        g_clear_object (&service);
+        g_clear_object (&service_connection);
+        g_test_dbus_down (bus);
+}
+
+/* Nothing to connect to, and nothing gets autolaunched */
+static void
+test_dbus_backend_no_bus (void)
+{
+        g_autofree gchar *old_address = g_strdup (g_getenv ("DBUS_SESSION_BUS_ADDRESS"));
+        g_autofree gchar *old_runtime_dir = g_strdup (g_getenv ("XDG_RUNTIME_DIR"));
+        g_autofree gchar *runtime_dir = NULL;
+        g_autoptr (RedshiftGtkBackend) client = NULL;
+        g_autoptr (GError) error = NULL;
+
+        runtime_dir = g_dir_make_tmp ("redshiftgtk-XXXXXX", &error);
+        g_assert_no_error (error);
+        g_unsetenv ("DBUS_SESSION_BUS_ADDRESS");
+        g_setenv ("XDG_RUNTIME_DIR", runtime_dir, TRUE);
+
+        client = redshiftgtk_dbus_client_new (NULL, &error);
+        g_assert_no_error (error);
+        g_assert_null (client);
+
+        if (old_address)
+                g_setenv ("DBUS_SESSION_BUS_ADDRESS", old_address, TRUE);
+        if (old_runtime_dir)
+                g_setenv ("XDG_RUNTIME_DIR", old_runtime_dir, TRUE);
+        else
+                g_unsetenv ("XDG_RUNTIME_DIR");
+        g_rmdir (runtime_dir);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add ("/Backend/DBus/snapshot",
+                    ObjectFixture,
+                    NULL,
+                    dbus_backend_fixture_set_up,
+                    test_dbus_backend_snapshot,
+                    dbus_backend_fixture_tear_down);
+
+        g_test_add ("/Backend/DBus/set-is-local",
+                    ObjectFixture,
+                    NULL,
+                    dbus_backend_fixture_set_up,
+                    test_dbus_backend_set_is_local,
+                    dbus_backend_fixture_tear_down);
+
+        g_test_add ("/Backend/DBus/apply-changes",
+                    ObjectFixture,
+                    NULL,
+                    dbus_backend_fixture_set_up,
+                    test_dbus_backend_apply_changes,
+                    dbus_backend_fixture_tear_down);
+
+        g_test_add_func ("/Backend/DBus/preview-owner",
+                         test_dbus_backend_preview_owner);
+
+        g_test_add_func ("/Backend/DBus/no-bus",
+                         test_dbus_backend_no_bus);
+
+        return g_test_run ();
+}
@@ -0,0 +1,348 @@
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "backend/redshiftgtk-gsettings-backend.h"
+#include "backend/redshiftgtk-settings-schema.h"
+
+#define SETTINGS_SCHEMA_ID REDSHIFTGTK_GSETTINGS_SCHEMA_ID ".Settings"
+#define SETTINGS_PATH "/com/github/cybre/RedshiftGtk/settings/"
+#define PROFILE_PATH "/com/github/cybre/RedshiftGtk/profiles/reading/"
+
+typedef struct {
+        RedshiftGtkBackend *backend;
+        guint changed;
+} BackendFixture;
+
+static void
+reset_path (const gchar *path)
+{
+        g_autoptr (GSettings) settings = g_settings_new_with_path (SETTINGS_SCHEMA_ID, path);
+        Setting setting;
+
+        for (setting = 0; setting < N_SETTINGS; setting++)
+                g_settings_reset (settings, redshiftgtk_settings_schema_lookup (setting)->key);
+}
+
+static void
+flush_events (void)
+{
+        while (g_main_context_iteration (NULL, FALSE));
+}
+
+static void
+changed_cb (RedshiftGtkBackend *backend,
+            BackendFixture     *fixture)
+{
+        fixture->changed++;
+}
+
+static void
+backend_fixture_set_up (BackendFixture *fixture,
+                        gconstpointer   user_data)
+{
+        g_autoptr (GSettings) root = g_settings_new (REDSHIFTGTK_GSETTINGS_SCHEMA_ID);
+
+        /* The memory backend lives as long as the process */
+        g_settings_reset (root, "profiles");
+        reset_path (SETTINGS_PATH);
+        reset_path (PROFILE_PATH);
+        flush_events ();
+
+        fixture->backend = redshiftgtk_gsettings_backend_new ();
+        fixture->changed = 0;
+        g_signal_connect (fixture->backend, "changed", G_CALLBACK (changed_cb), fixture);
+}
+
+static void
+backend_fixture_tear_down (BackendFixture *fixture,
+                           gconstpointer   user_data)
+{
+        g_clear_object (&fixture->backend);
+}
+
+static void
+test_gsettings_backend_defaults (BackendFixture *fixture,
+                                 gconstpointer   user_data)
+{
+        RedshiftGtkBackend *backend = fixture->backend;
+        g_autoptr (GArray) gamma = NULL;
+
+        /* The schema and redshiftgtk-settings-schema.c agree */
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_DAY), ==,
+                           redshiftgtk_settings_schema_lookup (SETTING_TEMP_DAY)->fallback);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_NIGHT), ==,
+                           redshiftgtk_settings_schema_lookup (SETTING_TEMP_NIGHT)->fallback);
+        g_assert_cmpfloat (redshiftgtk_backend_get_brightness (backend, TIME_PERIOD_NIGHT), ==,
+                           redshiftgtk_settings_schema_lookup (SETTING_BRIGHTNESS_NIGHT)->fallback);
+        g_assert_cmpint (redshiftgtk_backend_get_location_provider (backend), ==,
+                         redshiftgtk_settings_schema_lookup (SETTING_LOCATION_PROVIDER)->fallback);
+        g_assert_cmpint (redshiftgtk_backend_get_adjustment_method (backend), ==,
+                         redshiftgtk_settings_schema_lookup (SETTING_ADJUSTMENT_METHOD)->fallback);
+        g_assert_false (redshiftgtk_backend_get_smooth_transition (backend));
+
+        gamma = redshiftgtk_backend_get_gamma (backend, TIME_PERIOD_DAY);
+        g_assert_cmpfloat (g_array_index (gamma, gdouble, 0), ==,
+                           redshiftgtk_settings_schema_lookup (SETTING_GAMMA_DAY)->fallback);
+
+        g_assert_cmpint (redshiftgtk_backend_get_source (backend, "temp-day"), ==,
+                         CONFIG_LAYER_DEFAULT);
+}
+
+static void
+test_gsettings_backend_apply (BackendFixture *fixture,
+                              gconstpointer   user_data)
+{
+        RedshiftGtkBackend *backend = fixture->backend;
+        g_autoptr (RedshiftGtkBackend) other = NULL;
+        g_autoptr (GSettings) settings = NULL;
+        g_autoptr (GArray) gamma = NULL;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *method = NULL;
+
+        settings = g_settings_new_with_path (SETTINGS_SCHEMA_ID, SETTINGS_PATH);
+
+        redshiftgtk_backend_set_temperature (backend, TIME_PERIOD_NIGHT, 3500);
+        redshiftgtk_backend_set_gamma (backend, TIME_PERIOD_DAY, 0.9, 0.8, 0.7);
+        redshiftgtk_backend_set_adjustment_method (backend, ADJUSTMENT_METHOD_RANDR);
+        /* Out of range, clamped before it reaches GSettings */
+        redshiftgtk_backend_set_brightness (backend, TIME_PERIOD_DAY, 5);
+
+        /* Nothing is written before apply */
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_NIGHT), ==, 3500);
+        g_assert_cmpfloat (g_settings_get_double (settings, "temp-night"), ==, 4500);
+
+        redshiftgtk_backend_apply_changes (backend, &error);
+        g_assert_no_error (error);
+        flush_events ();
+        g_assert_cmpuint (fixture->changed, ==, 1);
+
+        g_assert_cmpfloat (g_settings_get_double (settings, "temp-night"), ==, 3500);
+        g_assert_cmpfloat (g_settings_get_double (settings, "brightness-day"), ==, 1.0);
+        method = g_settings_get_string (settings, "adjustment-method");
+        g_assert_cmpstr (method, ==, "randr");
+
+        other = redshiftgtk_gsettings_backend_new ();
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (other, TIME_PERIOD_NIGHT), ==, 3500);
+        g_assert_cmpint (redshiftgtk_backend_get_adjustment_method (other), ==,
+                         ADJUSTMENT_METHOD_RANDR);
+        g_assert_cmpint (redshiftgtk_backend_get_source (other, "temp-night"), ==,
+                         CONFIG_LAYER_USER);
+
+        gamma = redshiftgtk_backend_get_gamma (other, TIME_PERIOD_DAY);
+        g_assert_cmpfloat (g_array_index (gamma, gdouble, 0), ==, 0.9);
+        g_assert_cmpfloat (g_array_index (gamma, gdouble, 1), ==, 0.8);
+        g_assert_cmpfloat (g_array_index (gamma, gdouble, 2), ==, 0.7);
+
+        /* Nothing left to apply, nothing to announce */
+        redshiftgtk_backend_apply_changes (backend, &error);
+        g_assert_no_error (error);
+        flush_events ();
+        g_assert_cmpuint (fixture->changed, ==, 1);
+}
+
+static void
+test_gsettings_backend_external_change (BackendFixture *fixture,
+                                        gconstpointer   user_data)
+{
+        RedshiftGtkBackend *backend = fixture->backend;
+        g_autoptr (GSettings) settings = NULL;
+
+        settings = g_settings_new_with_path (SETTINGS_SCHEMA_ID, SETTINGS_PATH);
+
+        /* Like dconf-editor or another instance would */
+        g_settings_set_double (settings, "temp-day", 5200);
+        g_settings_set_boolean (settings, "fade", TRUE);
+        flush_events ();
+
+        g_assert_cmpuint (fixture->changed, ==, 2);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_DAY), ==, 5200);
+        g_assert_true (redshiftgtk_backend_get_smooth_transition (backend));
+
+        /* Writing what it has already is no change */
+        g_settings_set_double (settings, "temp-day", 5200);
+        flush_events ();
+        g_assert_cmpuint (fixture->changed, ==, 2);
+}
+
+static void
+test_gsettings_backend_profiles (BackendFixture *fixture,
+                                 gconstpointer   user_data)
+{
+        RedshiftGtkBackend *backend = fixture->backend;
+        g_autoptr (RedshiftGtkBackend) other = NULL;
+        g_autoptr (GSettings) root = NULL;
+        g_autoptr (GSettings) settings = NULL;
+        g_auto (GStrv) profiles = NULL;
+        g_auto (GStrv) listed = NULL;
+        g_autoptr (GError) error = NULL;
+
+        redshiftgtk_backend_set_temperature (backend, TIME_PERIOD_DAY, 5800);
+
+        /* Starts out as a copy of the active settings */
+        redshiftgtk_backend_switch_profile (backend, "reading", &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (redshiftgtk_backend_get_profile (backend), ==, "reading");
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_DAY), ==, 5800);
+
+        redshiftgtk_backend_set_temperature (backend, TIME_PERIOD_DAY, 4200);
+
+        profiles = redshiftgtk_backend_list_profiles (backend);
+        g_assert_cmpuint (g_strv_length (profiles), ==, 1);
+        g_assert_cmpstr (profiles[0], ==, "reading");
+
+        redshiftgtk_backend_switch_profile (backend, "a/b", &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+        g_clear_error (&error);
+
+        redshiftgtk_backend_apply_changes (backend, &error);
+        g_assert_no_error (error);
+        flush_events ();
+
+        root = g_settings_new (REDSHIFTGTK_GSETTINGS_SCHEMA_ID);
+        listed = g_settings_get_strv (root, "profiles");
+        g_assert_cmpuint (g_strv_length (listed), ==, 1);
+        g_assert_cmpstr (listed[0], ==, "reading");
+
+        settings = g_settings_new_with_path (SETTINGS_SCHEMA_ID, PROFILE_PATH);
+        g_assert_cmpfloat (g_settings_get_double (settings, "temp-day"), ==, 4200);
+
+        /* Another instance sees the profile, starting on the defaults */
+        other = redshiftgtk_gsettings_backend_new ();
+        g_assert_null (redshiftgtk_backend_get_profile (other));
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (other, TIME_PERIOD_DAY), ==, 5800);
+        redshiftgtk_backend_switch_profile (other, "reading", &error);
+        g_assert_no_error (error);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (other, TIME_PERIOD_DAY), ==, 4200);
+
+        /* Dropping it from the list falls back to the defaults */
+        g_settings_reset (root, "profiles");
+        flush_events ();
+        g_assert_null (redshiftgtk_backend_get_profile (other));
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (other, TIME_PERIOD_DAY), ==, 5800);
+}
+
+static void
+test_gsettings_backend_override (BackendFixture *fixture,
+                                 gconstpointer   user_data)
+{
+        RedshiftGtkBackend *backend = fixture->backend;
+        g_autoptr (GSettings) settings = NULL;
+        g_autoptr (GError) error = NULL;
+
+        settings = g_settings_new_with_path (SETTINGS_SCHEMA_ID, SETTINGS_PATH);
+
+        redshiftgtk_backend_set_override (backend, "temp-night", "3000", &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (fixture->changed, ==, 1);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_NIGHT), ==, 3000);
+        g_assert_cmpint (redshiftgtk_backend_get_source (backend, "temp-night"), ==,
+                         CONFIG_LAYER_RUNTIME);
+
+        /* Overrides stay in memory */
+        redshiftgtk_backend_apply_changes (backend, &error);
+        g_assert_no_error (error);
+        g_assert_null (g_settings_get_user_value (settings, "temp-night"));
+
+        redshiftgtk_backend_set_override (backend, "temp-night", NULL, &error);
+        g_assert_no_error (error);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_NIGHT), ==, 4500);
+
+        redshiftgtk_backend_set_override (backend, "no-such-key", "1", &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+        g_clear_error (&error);
+
+        redshiftgtk_backend_set_override (backend, "temp-night", "warm", &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+}
+
+static void
+test_gsettings_backend_override_new_profile (BackendFixture *fixture,
+                                             gconstpointer   user_data)
+{
+        RedshiftGtkBackend *backend = fixture->backend;
+        g_autoptr (GSettings) settings = NULL;
+        g_autoptr (GVariant) saved = NULL;
+        g_autoptr (GError) error = NULL;
+
+        redshiftgtk_backend_set_override (backend, "temp-night", "3000", &error);
+        g_assert_no_error (error);
+
+        /* A new profile is seeded without the override... */
+        redshiftgtk_backend_switch_profile (backend, "reading", &error);
+        g_assert_no_error (error);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_NIGHT), ==, 4500);
+        g_assert_cmpint (redshiftgtk_backend_get_source (backend, "temp-night"), !=,
+                         CONFIG_LAYER_RUNTIME);
+
+        redshiftgtk_backend_apply_changes (backend, &error);
+        g_assert_no_error (error);
+
+        settings = g_settings_new_with_path (SETTINGS_SCHEMA_ID, PROFILE_PATH);
+        saved = g_settings_get_value (settings, "temp-night");
+        g_assert_cmpfloat (g_variant_get_double (saved), ==, 4500);
+
+        /* ...and the one it was made from has none left either */
+        redshiftgtk_backend_switch_profile (backend, NULL, &error);
+        g_assert_no_error (error);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (backend, TIME_PERIOD_NIGHT), ==, 4500);
+}
+
+/* Only start and autostart write the runner's file */
+static void
+test_gsettings_backend_read_only (BackendFixture *fixture,
+                                  gconstpointer   user_data)
+{
+        g_autofree gchar *path = NULL;
+        g_autoptr (GPtrArray) outputs = NULL;
+
+        path = g_build_filename (g_get_user_data_dir (), "redshiftgtk", "redshift.conf", NULL);
+        g_remove (path);
+
+        redshiftgtk_backend_get_autostart (fixture->backend);
+        outputs = redshiftgtk_backend_list_outputs (fixture->backend);
+
+        g_assert_false (g_file_test (path, G_FILE_TEST_EXISTS));
+}
+
+static void
+add_backend_test (const gchar *path,
+                  void (*test) (BackendFixture *, gconstpointer))
+{
+        g_test_add (path,
+                    BackendFixture,
+                    NULL,
+                    backend_fixture_set_up,
+                    test,
+                    backend_fixture_tear_down);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_autofree gchar *home = NULL;
+
+        /* The runner writes its redshift.conf and launcher here */
+        home = g_dir_make_tmp ("redshiftgtk-gsettings-XXXXXX", NULL);
+        g_assert (home != NULL);
+        g_setenv ("XDG_CONFIG_HOME", home, TRUE);
+        g_setenv ("XDG_DATA_HOME", home, TRUE);
+        g_setenv ("GSETTINGS_BACKEND", "memory", TRUE);
+
+        g_test_init (&argc, &argv, NULL);
+
+        /* GSETTINGS_SCHEMA_DIR points at the schema compiled in the build */
+        g_assert_true (redshiftgtk_gsettings_backend_is_available ());
+
+        add_backend_test ("/Backend/GSettings/defaults", test_gsettings_backend_defaults);
+        add_backend_test ("/Backend/GSettings/apply", test_gsettings_backend_apply);
+        add_backend_test ("/Backend/GSettings/external-change",
+                          test_gsettings_backend_external_change);
+        add_backend_test ("/Backend/GSettings/profiles", test_gsettings_backend_profiles);
+        add_backend_test ("/Backend/GSettings/override", test_gsettings_backend_override);
+        add_backend_test ("/Backend/GSettings/override-new-profile",
+                          test_gsettings_backend_override_new_profile);
+        add_backend_test ("/Backend/GSettings/read-only", test_gsettings_backend_read_only);
+
+        return g_test_run ();
+}
@@ -0,0 +1,184 @@
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "backend/redshiftgtk-metrics.h"
+
+typedef struct {
+        gchar *directory;
+        gchar *path;
+} MetricsFixture;
+
+static void
+metrics_fixture_set_up (MetricsFixture *fixture,
+                        gconstpointer   user_data)
+{
+        g_autoptr (GError) error = NULL;
+
+        fixture->directory = g_dir_make_tmp ("redshiftgtk-metrics-XXXXXX", &error);
+        g_assert_no_error (error);
+        fixture->path = g_build_filename (fixture->directory, "test.prom", NULL);
+
+        redshiftgtk_metrics_reset ();
+}
+
+static void
+metrics_fixture_tear_down (MetricsFixture *fixture,
+                           gconstpointer   user_data)
+{
+        redshiftgtk_metrics_stop ();
+
+        g_unlink (fixture->path);
+        g_rmdir (fixture->directory);
+
+        g_free (fixture->path);
+        g_free (fixture->directory);
+}
+
+static gchar*
+read_metrics (const gchar *path)
+{
+        g_autoptr (GError) error = NULL;
+        gchar *contents = NULL;
+
+        g_file_get_contents (path, &contents, NULL, &error);
+        g_assert_no_error (error);
+
+        return contents;
+}
+
+static void
+assert_has_line (const gchar *contents,
+                 const gchar *line)
+{
+        g_autofree gchar *needle = g_strconcat ("\n", line, "\n", NULL);
+
+        if (!strstr (contents, needle))
+                g_error ("Missing “%s” in\n%s", line, contents);
+}
+
+static void
+test_metrics_format (MetricsFixture *fixture,
+                     gconstpointer   user_data)
+{
+        g_autofree gchar *contents = NULL;
+
+        redshiftgtk_metrics_count (METRIC_SPAWNS, 1);
+        redshiftgtk_metrics_count (METRIC_SPAWNS, 2);
+        redshiftgtk_metrics_count_write (120);
+        redshiftgtk_metrics_count_write (80);
+        g_assert_cmpuint (redshiftgtk_metrics_get (METRIC_SPAWNS), ==, 3);
+
+        redshiftgtk_metrics_observe (METRIC_APPLY_DURATION, 0.001);
+        redshiftgtk_metrics_observe (METRIC_APPLY_DURATION, 0.02);
+        redshiftgtk_metrics_observe (METRIC_APPLY_DURATION, 60);
+
+        contents = redshiftgtk_metrics_format ();
+
+        assert_has_line (contents, "# TYPE redshiftgtk_spawns counter");
+        assert_has_line (contents, "redshiftgtk_spawns_total 3");
+        assert_has_line (contents, "redshiftgtk_config_writes_total 2");
+        assert_has_line (contents, "# UNIT redshiftgtk_config_written_bytes bytes");
+        assert_has_line (contents, "redshiftgtk_config_written_bytes_total 200");
+        assert_has_line (contents, "redshiftgtk_applies_total 0");
+
+        /* Buckets are cumulative, bounds inclusive */
+        assert_has_line (contents, "# TYPE redshiftgtk_apply_duration_seconds histogram");
+        assert_has_line (contents, "redshiftgtk_apply_duration_seconds_bucket{le=\"0.001\"} 1");
+        assert_has_line (contents, "redshiftgtk_apply_duration_seconds_bucket{le=\"0.01\"} 1");
+        assert_has_line (contents, "redshiftgtk_apply_duration_seconds_bucket{le=\"0.025\"} 2");
+        assert_has_line (contents, "redshiftgtk_apply_duration_seconds_bucket{le=\"2.5\"} 2");
+        assert_has_line (contents, "redshiftgtk_apply_duration_seconds_bucket{le=\"+Inf\"} 3");
+        assert_has_line (contents, "redshiftgtk_apply_duration_seconds_count 3");
+
+        g_assert_true (g_str_has_prefix (contents, "# TYPE "));
+        g_assert_true (g_str_has_suffix (contents, "\n# EOF\n"));
+}
+
+static void
+test_metrics_flush (MetricsFixture *fixture,
+                    gconstpointer   user_data)
+{
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *first = NULL;
+        g_autofree gchar *second = NULL;
+        g_autofree gchar *third = NULL;
+        GStatBuf before, after;
+
+        g_assert_true (redshiftgtk_metrics_start (fixture->path, "test", 0));
+        redshiftgtk_metrics_count (METRIC_APPLIES, 1);
+
+        g_assert_true (redshiftgtk_metrics_flush (&error));
+        g_assert_no_error (error);
+        first = read_metrics (fixture->path);
+        assert_has_line (first, "redshiftgtk_applies_total{program=\"test\"} 1");
+        assert_has_line (first, "redshiftgtk_apply_duration_seconds_bucket{program=\"test\",le=\"+Inf\"} 0");
+
+        /* Nothing changed, nothing is written */
+        g_assert_cmpint (g_stat (fixture->path, &before), ==, 0);
+        g_assert_true (redshiftgtk_metrics_flush (&error));
+        g_assert_cmpint (g_stat (fixture->path, &after), ==, 0);
+        g_assert_cmpuint (before.st_ino, ==, after.st_ino);
+
+        /* A new file renamed over the old one, never rewritten in place */
+        redshiftgtk_metrics_count (METRIC_APPLIES, 1);
+        g_assert_true (redshiftgtk_metrics_flush (&error));
+        g_assert_cmpint (g_stat (fixture->path, &after), ==, 0);
+        g_assert_cmpuint (before.st_ino, !=, after.st_ino);
+        second = read_metrics (fixture->path);
+        assert_has_line (second, "redshiftgtk_applies_total{program=\"test\"} 2");
+
+        /* Stopping writes what is left */
+        redshiftgtk_metrics_count (METRIC_KILLS, 1);
+        redshiftgtk_metrics_stop ();
+        third = read_metrics (fixture->path);
+        assert_has_line (third, "redshiftgtk_kills_total{program=\"test\"} 1");
+}
+
+static void
+test_metrics_directory (MetricsFixture *fixture,
+                        gconstpointer   user_data)
+{
+        g_autofree gchar *path = g_build_filename (fixture->directory, "redshiftgtk-test.prom", NULL);
+        g_autofree gchar *contents = NULL;
+
+        g_setenv (REDSHIFTGTK_METRICS_ENV, fixture->directory, TRUE);
+        g_assert_true (redshiftgtk_metrics_start_from_env ("redshiftgtk-test"));
+        redshiftgtk_metrics_stop ();
+        g_unsetenv (REDSHIFTGTK_METRICS_ENV);
+
+        contents = read_metrics (path);
+        assert_has_line (contents, "redshiftgtk_redraws_total{program=\"redshiftgtk-test\"} 0");
+        g_unlink (path);
+
+        g_assert_false (redshiftgtk_metrics_start_from_env ("redshiftgtk-test"));
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add ("/Backend/Metrics/format",
+                    MetricsFixture,
+                    NULL,
+                    metrics_fixture_set_up,
+                    test_metrics_format,
+                    metrics_fixture_tear_down);
+
+        g_test_add ("/Backend/Metrics/flush",
+                    MetricsFixture,
+                    NULL,
+                    metrics_fixture_set_up,
+                    test_metrics_flush,
+                    metrics_fixture_tear_down);
+
+        g_test_add ("/Backend/Metrics/directory",
+                    MetricsFixture,
+                    NULL,
+                    metrics_fixture_set_up,
+                    test_metrics_directory,
+                    metrics_fixture_tear_down);
+
+        return g_test_run ();
+}
@@ -0,0 +1,215 @@
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "backend/redshiftgtk-process-scan.h"
+
+typedef struct {
+        gchar *directory;
+        RedshiftGtkProcessScan *scan;
+} ScanFixture;
+
+static void
+scan_fixture_set_up (ScanFixture   *fixture,
+                     gconstpointer  user_data)
+{
+        g_autoptr (GError) error = NULL;
+
+        fixture->directory = g_dir_make_tmp ("redshiftgtk-proc-XXXXXX", &error);
+        g_assert_no_error (error);
+        fixture->scan = redshiftgtk_process_scan_new (fixture->directory);
+}
+
+static void
+scan_fixture_tear_down (ScanFixture   *fixture,
+                        gconstpointer  user_data)
+{
+        g_autoptr (GDir) dir = g_dir_open (fixture->directory, 0, NULL);
+        const gchar *entry;
+
+        while (dir && (entry = g_dir_read_name (dir))) {
+                g_autofree gchar *process = g_build_filename (fixture->directory, entry, NULL);
+                g_autofree gchar *comm = g_build_filename (process, "comm", NULL);
+                g_autofree gchar *cmdline = g_build_filename (process, "cmdline", NULL);
+
+                g_unlink (comm);
+                g_unlink (cmdline);
+                g_rmdir (process);
+        }
+        g_rmdir (fixture->directory);
+
+        redshiftgtk_process_scan_free (fixture->scan);
+        g_free (fixture->directory);
+}
+
+/* A /proc/PID of ours, @cmdline with spaces for the NULs */
+static void
+add_process (ScanFixture *fixture,
+             GPid         pid,
+             const gchar *comm,
+             const gchar *cmdline)
+{
+        g_autofree gchar *process = g_strdup_printf ("%s/%d", fixture->directory, pid);
+        g_autofree gchar *comm_path = g_build_filename (process, "comm", NULL);
+        g_autofree gchar *cmdline_path = g_build_filename (process, "cmdline", NULL);
+        g_autofree gchar *arguments = g_strconcat (cmdline, " ", NULL);
+        g_autofree gchar *name = g_strconcat (comm, "\n", NULL);
+        g_autoptr (GError) error = NULL;
+
+        g_strdelimit (arguments, " ", '\0');
+
+        g_mkdir (process, 0700);
+        g_file_set_contents (comm_path, name, -1, &error);
+        g_assert_no_error (error);
+        g_file_set_contents (cmdline_path, arguments, *cmdline ? strlen (cmdline) + 1 : 0, &error);
+        g_assert_no_error (error);
+}
+
+static void
+test_process_scan_match (ScanFixture   *fixture,
+                         gconstpointer  user_data)
+{
+        GPtrArray *processes;
+        RedshiftGtkProcess *process;
+
+        add_process (fixture, 100, "redshift", "redshift -l 48.1:11.6 -t 6500:3500");
+        add_process (fixture, 101, "redshift-gtk", "/usr/bin/python3 /usr/bin/redshift-gtk");
+        add_process (fixture, 102, "bash", "bash");
+        add_process (fixture, 103, "redshift", "redshift -x");
+        add_process (fixture, 104, "redshift", "redshift -O3500");
+        add_process (fixture, 105, "redshift", "redshift -P -O 3500");
+        add_process (fixture, 106, "redshift", "");
+        add_process (fixture, getpid (), "redshift", "redshift");
+
+        processes = redshiftgtk_process_scan_get (fixture->scan);
+        g_assert_cmpuint (processes->len, ==, 2);
+
+        /* Directory order is not pid order */
+        process = g_ptr_array_index (processes, 0);
+        if (process->pid != 100)
+                process = g_ptr_array_index (processes, 1);
+        g_assert_cmpint (process->pid, ==, 100);
+        g_assert_cmpstr (process->name, ==, "redshift");
+        g_assert_cmpstr (process->cmdline, ==, "redshift -l 48.1:11.6 -t 6500:3500");
+
+        g_assert_true (redshiftgtk_process_scan_is_redshift (fixture->scan, 101));
+        g_assert_false (redshiftgtk_process_scan_is_redshift (fixture->scan, 102));
+        g_assert_false (redshiftgtk_process_scan_is_redshift (fixture->scan, 107));
+}
+
+static void
+test_process_scan_cache (ScanFixture   *fixture,
+                         gconstpointer  user_data)
+{
+        GPtrArray *processes;
+
+        add_process (fixture, 100, "redshift", "redshift");
+
+        processes = redshiftgtk_process_scan_get (fixture->scan);
+        g_assert_cmpuint (processes->len, ==, 1);
+        g_assert_cmpuint (redshiftgtk_process_scan_get_scans (fixture->scan), ==, 1);
+
+        /* Not seen before an invalidation, nothing reads /proc twice */
+        add_process (fixture, 200, "redshift", "redshift -m randr");
+        processes = redshiftgtk_process_scan_get (fixture->scan);
+        g_assert_cmpuint (processes->len, ==, 1);
+        g_assert_cmpuint (redshiftgtk_process_scan_get_scans (fixture->scan), ==, 1);
+
+        redshiftgtk_process_scan_invalidate (fixture->scan);
+        processes = redshiftgtk_process_scan_get (fixture->scan);
+        g_assert_cmpuint (processes->len, ==, 2);
+        g_assert_cmpuint (redshiftgtk_process_scan_get_scans (fixture->scan), ==, 2);
+}
+
+static gboolean
+log_contains (const gchar *log_path,
+              const gchar *line)
+{
+        gint64 deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+
+        while (g_get_monotonic_time () < deadline) {
+                g_autofree gchar *contents = NULL;
+
+                if (g_file_get_contents (log_path, &contents, NULL, NULL) &&
+                    strstr (contents, line))
+                        return TRUE;
+
+                g_main_context_iteration (NULL, FALSE);
+                g_usleep (10000);
+        }
+
+        return FALSE;
+}
+
+/* The real thing, against the stand-in in data/bin */
+static void
+test_process_scan_terminate (void)
+{
+        g_autoptr (RedshiftGtkProcessScan) scan = redshiftgtk_process_scan_new (NULL);
+        g_autoptr (GSubprocess) process = NULL;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *directory = NULL;
+        g_autofree gchar *log_path = NULL;
+        g_autofree gchar *restore = NULL;
+        GPtrArray *processes;
+        GPid pid;
+        gboolean found = FALSE;
+        guint i;
+
+        directory = g_dir_make_tmp ("redshiftgtk-proc-XXXXXX", &error);
+        g_assert_no_error (error);
+        log_path = g_build_filename (directory, "redshift.log", NULL);
+        g_setenv ("REDSHIFT_LOG", log_path, TRUE);
+
+        process = g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, &error,
+                                    TEST_DATA_DIR "bin/redshift", "-c", "/dev/null", NULL);
+        g_assert_no_error (error);
+        pid = g_ascii_strtoll (g_subprocess_get_identifier (process), NULL, 10);
+        g_assert_true (log_contains (log_path, " -c "));
+
+        processes = redshiftgtk_process_scan_get (scan);
+        for (i = 0; i < processes->len; i++) {
+                RedshiftGtkProcess *found_process = g_ptr_array_index (processes, i);
+
+                if (found_process->pid == pid)
+                        found = TRUE;
+        }
+        g_assert_true (found);
+
+        /* Asked to quit, so it restores the ramps on its way out */
+        g_assert_true (redshiftgtk_process_scan_terminate (scan, pid, PROCESS_SCAN_GRACE_PERIOD));
+        restore = g_strdup_printf ("%d restore", pid);
+        g_assert_true (log_contains (log_path, restore));
+
+        g_subprocess_wait (process, NULL, &error);
+        g_assert_no_error (error);
+        g_assert_false (redshiftgtk_process_scan_terminate (scan, pid, PROCESS_SCAN_GRACE_PERIOD));
+
+        g_unlink (log_path);
+        g_rmdir (directory);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add ("/Backend/ProcessScan/match",
+                    ScanFixture,
+                    NULL,
+                    scan_fixture_set_up,
+                    test_process_scan_match,
+                    scan_fixture_tear_down);
+
+        g_test_add ("/Backend/ProcessScan/cache",
+                    ScanFixture,
+                    NULL,
+                    scan_fixture_set_up,
+                    test_process_scan_cache,
+                    scan_fixture_tear_down);
+
+        g_test_add_func ("/Backend/ProcessScan/terminate",
+                         test_process_scan_terminate);
+
+        return g_test_run ();
+}
@@ -0,0 +1,124 @@
+#include "backend/redshiftgtk-ramp-sink.h"
+
+static const gdouble neutral_gamma[3] = { 1.0, 1.0, 1.0 };
+
+static void
+test_ramp_fill_neutral (void)
+{
+        g_autoptr (RedshiftGtkRamp) ramp = redshiftgtk_ramp_new (256);
+        guint i;
+
+        /* 6500K at full brightness leaves the screen alone */
+        redshiftgtk_ramp_fill (ramp, RAMP_NEUTRAL_TEMPERATURE, 1.0, neutral_gamma);
+
+        for (i = 0; i < ramp->size; i++) {
+                g_assert_cmpuint (ramp->red[i], ==, i * 256);
+                g_assert_cmpuint (ramp->green[i], ==, i * 256);
+                g_assert_cmpuint (ramp->blue[i], ==, i * 256);
+        }
+}
+
+static void
+test_ramp_fill_warm (void)
+{
+        g_autoptr (RedshiftGtkRamp) ramp = redshiftgtk_ramp_new (1024);
+        g_autoptr (RedshiftGtkRamp) dim = redshiftgtk_ramp_new (1024);
+        guint last = ramp->size - 1;
+        guint i;
+
+        redshiftgtk_ramp_fill (ramp, 3500, 1.0, neutral_gamma);
+        redshiftgtk_ramp_fill (dim, 3500, 0.5, neutral_gamma);
+
+        /* Red stays, blue goes first */
+        g_assert_cmpuint (ramp->red[last], >, ramp->green[last]);
+        g_assert_cmpuint (ramp->green[last], >, ramp->blue[last]);
+
+        for (i = 1; i < ramp->size; i++) {
+                g_assert_cmpuint (ramp->red[i], >=, ramp->red[i - 1]);
+                g_assert_cmpuint (ramp->blue[i], >=, ramp->blue[i - 1]);
+                g_assert_cmpuint (dim->red[i], <, ramp->red[i]);
+        }
+}
+
+static void
+test_ramp_hash (void)
+{
+        g_autoptr (RedshiftGtkRamp) first = redshiftgtk_ramp_new (256);
+        g_autoptr (RedshiftGtkRamp) again = redshiftgtk_ramp_new (256);
+        g_autoptr (RedshiftGtkRamp) other = redshiftgtk_ramp_new (256);
+        g_autoptr (RedshiftGtkRamp) larger = redshiftgtk_ramp_new (1024);
+
+        redshiftgtk_ramp_fill (first, 4500, 0.9, neutral_gamma);
+        redshiftgtk_ramp_fill (again, 4500, 0.9, neutral_gamma);
+        redshiftgtk_ramp_fill (other, 4400, 0.9, neutral_gamma);
+        redshiftgtk_ramp_fill (larger, 4500, 0.9, neutral_gamma);
+
+        g_assert_cmpuint (redshiftgtk_ramp_hash (first), ==, redshiftgtk_ramp_hash (again));
+        g_assert_cmpuint (redshiftgtk_ramp_hash (first), !=, redshiftgtk_ramp_hash (other));
+        g_assert_cmpuint (redshiftgtk_ramp_hash (first), !=, redshiftgtk_ramp_hash (larger));
+}
+
+static void
+test_ramp_sink_offer (void)
+{
+        g_autoptr (RedshiftGtkRampSink) sink = redshiftgtk_ramp_sink_new ();
+        g_autoptr (RedshiftGtkRamp) warm = redshiftgtk_ramp_new (256);
+        g_autoptr (RedshiftGtkRamp) warmer = redshiftgtk_ramp_new (256);
+
+        redshiftgtk_ramp_fill (warm, 4500, 1.0, neutral_gamma);
+        redshiftgtk_ramp_fill (warmer, 3500, 1.0, neutral_gamma);
+
+        g_assert_true (redshiftgtk_ramp_sink_offer (sink, "DP-1", warm));
+        g_assert_false (redshiftgtk_ramp_sink_offer (sink, "DP-1", warm));
+        g_assert_false (redshiftgtk_ramp_sink_offer (sink, "DP-1", warm));
+
+        /* Every output has its own */
+        g_assert_true (redshiftgtk_ramp_sink_offer (sink, "HDMI-1", warm));
+
+        g_assert_true (redshiftgtk_ramp_sink_offer (sink, "DP-1", warmer));
+        g_assert_true (redshiftgtk_ramp_sink_offer (sink, "DP-1", warm));
+
+        g_assert_cmpuint (redshiftgtk_ramp_sink_get_sent (sink), ==, 4);
+        g_assert_cmpuint (redshiftgtk_ramp_sink_get_skipped (sink), ==, 2);
+}
+
+static void
+test_ramp_sink_forget (void)
+{
+        g_autoptr (RedshiftGtkRampSink) sink = redshiftgtk_ramp_sink_new ();
+        g_autoptr (RedshiftGtkRamp) ramp = redshiftgtk_ramp_new (256);
+
+        redshiftgtk_ramp_fill (ramp, 4500, 1.0, neutral_gamma);
+
+        g_assert_true (redshiftgtk_ramp_sink_offer (sink, "DP-1", ramp));
+        g_assert_true (redshiftgtk_ramp_sink_offer (sink, "HDMI-1", ramp));
+
+        /* Someone else set the ramps, ours may be gone */
+        redshiftgtk_ramp_sink_forget (sink, "DP-1");
+        g_assert_true (redshiftgtk_ramp_sink_offer (sink, "DP-1", ramp));
+        g_assert_false (redshiftgtk_ramp_sink_offer (sink, "HDMI-1", ramp));
+
+        redshiftgtk_ramp_sink_forget (sink, NULL);
+        g_assert_true (redshiftgtk_ramp_sink_offer (sink, "DP-1", ramp));
+        g_assert_true (redshiftgtk_ramp_sink_offer (sink, "HDMI-1", ramp));
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/Backend/RampSink/fill-neutral",
+                         test_ramp_fill_neutral);
+        g_test_add_func ("/Backend/RampSink/fill-warm",
+                         test_ramp_fill_warm);
+        g_test_add_func ("/Backend/RampSink/hash",
+                         test_ramp_hash);
+        g_test_add_func ("/Backend/RampSink/offer",
+                         test_ramp_sink_offer);
+        g_test_add_func ("/Backend/RampSink/forget",
+                         test_ramp_sink_forget);
+
+        return g_test_run ();
+}
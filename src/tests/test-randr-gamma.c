@@ -0,0 +1,168 @@
+#include <gio/gio.h>
+
+#include "backend/redshiftgtk-randr-gamma.h"
+
+typedef struct {
+        RedshiftGtkRandrGamma *randr;
+        RedshiftGtkOutput *output;
+} GammaFixture;
+
+static void
+gamma_fixture_set_up (GammaFixture  *fixture,
+                      gconstpointer  user_data)
+{
+        g_autoptr (GError) error = NULL;
+        GPtrArray *outputs;
+
+        /* Meant for the Xvfb meson starts it under */
+        fixture->randr = redshiftgtk_randr_gamma_new (NULL, &error);
+        if (!fixture->randr) {
+                g_test_skip (error->message);
+                return;
+        }
+
+        outputs = redshiftgtk_randr_gamma_get_outputs (fixture->randr, &error);
+        g_assert_no_error (error);
+        if (outputs->len == 0) {
+                g_test_skip ("No lit CRTC");
+                return;
+        }
+
+        fixture->output = g_ptr_array_index (outputs, 0);
+}
+
+static void
+gamma_fixture_tear_down (GammaFixture  *fixture,
+                         gconstpointer  user_data)
+{
+        if (fixture->output)
+                redshiftgtk_randr_gamma_reset (fixture->randr, NULL, NULL);
+
+        g_clear_pointer (&fixture->randr, redshiftgtk_randr_gamma_free);
+}
+
+static void
+test_randr_gamma_outputs (GammaFixture  *fixture,
+                          gconstpointer  user_data)
+{
+        g_autoptr (GError) error = NULL;
+        GPtrArray *outputs;
+
+        if (!fixture->output)
+                return;
+
+        g_assert_cmpuint (fixture->output->ramp_size, >, 0);
+        g_assert_true (fixture->output->name && *fixture->output->name);
+        g_assert_cmpuint (redshiftgtk_randr_gamma_get_queries (fixture->randr), ==, 1);
+
+        /* Kept until the X server says otherwise */
+        outputs = redshiftgtk_randr_gamma_get_outputs (fixture->randr, &error);
+        g_assert_no_error (error);
+        g_assert_true (g_ptr_array_index (outputs, 0) == fixture->output);
+        g_assert_cmpuint (redshiftgtk_randr_gamma_get_queries (fixture->randr), ==, 1);
+}
+
+/* Entry @i of @size the way redshift's colorramp_fill() computes it
+ * at 6500K, brightness 1 and gamma 1, what redshift -x leaves
+ */
+static guint16
+redshift_neutral_entry (guint i,
+                        guint size)
+{
+        gdouble value = (gdouble) i / size;
+
+        return (guint16) CLAMP (value * (G_MAXUINT16 + 1.0), 0, G_MAXUINT16);
+}
+
+static void
+test_randr_gamma_reset (GammaFixture  *fixture,
+                        gconstpointer  user_data)
+{
+        g_autoptr (RedshiftGtkRamp) ramp = NULL;
+        g_autoptr (GError) error = NULL;
+        guint i;
+
+        if (!fixture->output)
+                return;
+
+        g_assert_true (redshiftgtk_randr_gamma_reset (fixture->randr, fixture->output->name,
+                                                      &error));
+        g_assert_no_error (error);
+
+        /* What the X server has is what redshift would have set */
+        ramp = redshiftgtk_randr_gamma_get_ramp (fixture->randr, fixture->output->name, &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (ramp->size, ==, fixture->output->ramp_size);
+        for (i = 0; i < ramp->size; i++) {
+                g_assert_cmpuint (ramp->red[i], ==, redshift_neutral_entry (i, ramp->size));
+                g_assert_cmpuint (ramp->green[i], ==, redshift_neutral_entry (i, ramp->size));
+                g_assert_cmpuint (ramp->blue[i], ==, redshift_neutral_entry (i, ramp->size));
+        }
+
+        /* Every lit output at once */
+        g_assert_true (redshiftgtk_randr_gamma_reset (fixture->randr, NULL, &error));
+        g_assert_no_error (error);
+}
+
+static void
+test_randr_gamma_skip (GammaFixture  *fixture,
+                       gconstpointer  user_data)
+{
+        RedshiftGtkRampSink *sink;
+        g_autoptr (GError) error = NULL;
+        guint64 sent;
+
+        if (!fixture->output)
+                return;
+
+        sink = redshiftgtk_randr_gamma_get_sink (fixture->randr);
+
+        redshiftgtk_randr_gamma_reset (fixture->randr, fixture->output->name, &error);
+        g_assert_no_error (error);
+        sent = redshiftgtk_ramp_sink_get_sent (sink);
+
+        /* A second stop in a row */
+        redshiftgtk_randr_gamma_reset (fixture->randr, fixture->output->name, &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (redshiftgtk_ramp_sink_get_sent (sink), ==, sent);
+        g_assert_cmpuint (redshiftgtk_ramp_sink_get_skipped (sink), ==, 1);
+
+        /* Someone else may have set the ramps since */
+        redshiftgtk_randr_gamma_forget (fixture->randr);
+        redshiftgtk_randr_gamma_reset (fixture->randr, fixture->output->name, &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (redshiftgtk_ramp_sink_get_sent (sink), ==, sent + 1);
+
+        redshiftgtk_randr_gamma_reset (fixture->randr, "No such output", &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add ("/Backend/RandrGamma/outputs",
+                    GammaFixture,
+                    NULL,
+                    gamma_fixture_set_up,
+                    test_randr_gamma_outputs,
+                    gamma_fixture_tear_down);
+
+        g_test_add ("/Backend/RandrGamma/reset",
+                    GammaFixture,
+                    NULL,
+                    gamma_fixture_set_up,
+                    test_randr_gamma_reset,
+                    gamma_fixture_tear_down);
+
+        g_test_add ("/Backend/RandrGamma/skip",
+                    GammaFixture,
+                    NULL,
+                    gamma_fixture_set_up,
+                    test_randr_gamma_skip,
+                    gamma_fixture_tear_down);
+
+        return g_test_run ();
+}
@@ -1,5 +1,12 @@
+#include <signal.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
 #include "backend/redshiftgtk-backend.h"
+#include "backend/redshiftgtk-metrics.h"
 #include "backend/redshiftgtk-redshift-wrapper.h"
+#include "backend/redshiftgtk-settings-cache.h"
+#include "backend/redshiftgtk-spawn.h"
 
 typedef struct {
         RedshiftGtkBackend *backend;
@@ -29,7 +36,13 @@ static void
 redshift_wrapper_fixture_tear_down (ObjectFixture *fixture,
                                     gconstpointer  user_data)
 {
+        g_autofree gchar *launcher = NULL;
+
         g_clear_object (&fixture->backend);
+
+        launcher = g_build_filename (g_get_user_config_dir (),
+                                     "autostart", "redshiftgtk.desktop", NULL);
+        g_remove (launcher);
 }
 
 static void
@@ -259,10 +272,1268 @@ test_redshift_wrapper_set_smooth_transition (ObjectFixture *fixture,
         g_assert (transition == FALSE);
 }
 
+static gboolean
+launcher_is_hidden (const gchar *launcher,
+                    gboolean    *hidden)
+{
+        g_autoptr (GKeyFile) desktop = g_key_file_new ();
+        g_autoptr (GError) error = NULL;
+
+        if (!g_key_file_load_from_file (desktop, launcher, G_KEY_FILE_NONE, NULL))
+                return FALSE;
+
+        *hidden = g_key_file_get_boolean (desktop, "Desktop Entry", "Hidden", &error);
+
+        return error == NULL;
+}
+
+static void
+wait_for_launcher (const gchar *launcher,
+                   gboolean     hidden)
+{
+        gint64 deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+        gboolean value = !hidden;
+
+        while (!launcher_is_hidden (launcher, &value) || value != hidden) {
+                g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+                g_main_context_iteration (NULL, FALSE);
+                g_usleep (1000);
+        }
+}
+
+static void
+wait_for_autostart (RedshiftGtkBackend *backend,
+                    gboolean            autostart)
+{
+        gint64 deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+
+        while (redshiftgtk_backend_get_autostart (backend) != autostart) {
+                g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+                g_main_context_iteration (NULL, FALSE);
+                g_usleep (1000);
+        }
+}
+
+static void
+test_redshift_wrapper_set_autostart (ObjectFixture *fixture,
+                                     gconstpointer  user_data)
+{
+        g_autofree gchar *launcher = NULL;
+        g_autoptr (GError) error = NULL;
+
+        launcher = g_build_filename (g_get_user_config_dir (),
+                                     "autostart", "redshiftgtk.desktop", NULL);
+
+        g_assert_false (redshiftgtk_backend_get_autostart (fixture->backend));
+
+        /* The cached state flips at once, the launcher follows */
+        redshiftgtk_backend_set_autostart (fixture->backend, TRUE, &error);
+        g_assert_no_error (error);
+        g_assert_true (redshiftgtk_backend_get_autostart (fixture->backend));
+        wait_for_launcher (launcher, FALSE);
+
+        redshiftgtk_backend_set_autostart (fixture->backend, FALSE, &error);
+        g_assert_no_error (error);
+        g_assert_false (redshiftgtk_backend_get_autostart (fixture->backend));
+        wait_for_launcher (launcher, TRUE);
+}
+
+/* Everything the tests left in @path, and @path itself */
+static void
+remove_tree (const gchar *path)
+{
+        g_autoptr (GDir) dir = g_dir_open (path, 0, NULL);
+        const gchar *entry;
+
+        while (dir && (entry = g_dir_read_name (dir))) {
+                g_autofree gchar *child = g_build_filename (path, entry, NULL);
+
+                if (g_file_test (child, G_FILE_TEST_IS_DIR) &&
+                    !g_file_test (child, G_FILE_TEST_IS_SYMLINK))
+                        remove_tree (child);
+                else
+                        g_unlink (child);
+        }
+
+        g_rmdir (path);
+}
+
+static void
+autostart_failed_cb (RedshiftGtkBackend  *backend,
+                     const gchar         *message,
+                     gchar              **failure)
+{
+        g_free (*failure);
+        *failure = g_strdup (message);
+}
+
+/* Only finds out after set_autostart returned */
+static void
+test_redshift_wrapper_autostart_failed (ObjectFixture *fixture,
+                                        gconstpointer  user_data)
+{
+        g_autofree gchar *directory = NULL;
+        g_autofree gchar *failure = NULL;
+        g_autoptr (GError) error = NULL;
+        gint64 deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+
+        /* A file where ~/.config/autostart should be */
+        directory = g_build_filename (g_get_user_config_dir (), "autostart", NULL);
+        remove_tree (directory);
+        g_file_set_contents (directory, "", 0, &error);
+        g_assert_no_error (error);
+
+        g_signal_connect (fixture->backend, "autostart-failed",
+                          G_CALLBACK (autostart_failed_cb), &failure);
+
+        redshiftgtk_backend_set_autostart (fixture->backend, TRUE, &error);
+        g_assert_no_error (error);
+
+        while (!failure) {
+                g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+                g_main_context_iteration (NULL, FALSE);
+                g_usleep (1000);
+        }
+
+        /* Back to what is on disk */
+        wait_for_autostart (fixture->backend, FALSE);
+
+        g_remove (directory);
+}
+
+static void
+count_changed_cb (RedshiftGtkBackend *backend,
+                  guint              *count)
+{
+        (*count)++;
+}
+
+static void
+test_redshift_wrapper_autostart_monitor (ObjectFixture *fixture,
+                                         gconstpointer  user_data)
+{
+        g_autofree gchar *directory = NULL;
+        g_autofree gchar *launcher = NULL;
+        g_autoptr (GError) error = NULL;
+        guint changed = 0;
+
+        directory = g_build_filename (g_get_user_config_dir (), "autostart", NULL);
+        launcher = g_build_filename (directory, "redshiftgtk.desktop", NULL);
+        g_mkdir_with_parents (directory, 0775);
+
+        g_signal_connect (fixture->backend, "changed",
+                          G_CALLBACK (count_changed_cb), &changed);
+
+        /* Someone else enables us */
+        g_file_set_contents (launcher,
+                             "[Desktop Entry]\nName=RedshiftGtkAutostart\n"
+                             "Exec=redshift\nType=Application\nHidden=false\n",
+                             -1, &error);
+        g_assert_no_error (error);
+        wait_for_autostart (fixture->backend, TRUE);
+        g_assert_cmpuint (changed, ==, 1);
+
+        /* ...and removes the launcher again */
+        g_remove (launcher);
+        wait_for_autostart (fixture->backend, FALSE);
+        g_assert_cmpuint (changed, ==, 2);
+}
+
+static void
+test_redshift_wrapper_apply_keeps_file (ObjectFixture *fixture,
+                                        gconstpointer  user_data)
+{
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *contents = NULL;
+
+        path = g_build_filename (g_get_user_config_dir (), "hand-written.conf", NULL);
+        g_file_set_contents (path,
+                             "# Mine\n[redshift]\ntemp-day = 5500 ; warm enough\n"
+                             "temp-night=4500\n",
+                             -1, &error);
+        g_assert_no_error (error);
+
+        redshiftgtk_redshift_wrapper_set_config_path (fixture->backend, g_strdup (path));
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  &error);
+        g_assert_no_error (error);
+
+        redshiftgtk_backend_set_temperature (fixture->backend, TIME_PERIOD_NIGHT, 3500);
+        redshiftgtk_backend_apply_changes (fixture->backend, &error);
+        g_assert_no_error (error);
+
+        g_file_get_contents (path, &contents, NULL, &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (contents, ==,
+                         "# Mine\n[redshift]\ntemp-day = 5500 ; warm enough\n"
+                         "temp-night=3500\n");
+
+        g_remove (path);
+}
+
+/* Long enough for a one-shot preview to come and go */
+static void
+settle (void)
+{
+        gint64 deadline = g_get_monotonic_time () + G_USEC_PER_SEC / 2;
+
+        while (g_get_monotonic_time () < deadline) {
+                g_main_context_iteration (NULL, FALSE);
+                g_usleep (10000);
+        }
+}
+
+/* Stop, and give our instances time to exit. A new wrapper takes
+ * over what is still running with its arguments.
+ */
+static void
+stop_instances (RedshiftGtkBackend *backend)
+{
+        redshiftgtk_backend_stop (backend);
+        settle ();
+}
+
+/* Lines of the stand-in's log once @n_instances long-running ones
+ * started, as "PID ARGS"
+ */
+static gchar**
+wait_for_instances (const gchar *log_path,
+                    guint        n_instances)
+{
+        gint64 deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+
+        while (g_get_monotonic_time () < deadline) {
+                g_autofree gchar *contents = NULL;
+                g_auto (GStrv) lines = NULL;
+                guint found = 0;
+                guint i;
+
+                if (g_file_get_contents (log_path, &contents, NULL, NULL)) {
+                        lines = g_strsplit (contents, "\n", -1);
+                        for (i = 0; lines[i] != NULL; i++) {
+                                if (strstr (lines[i], " -c "))
+                                        found++;
+                        }
+                        if (found >= n_instances)
+                                return g_steal_pointer (&lines);
+                }
+
+                g_main_context_iteration (NULL, FALSE);
+                g_usleep (10000);
+        }
+
+        g_error ("Only part of %u redshift instances started", n_instances);
+        return NULL;
+}
+
+static void
+test_redshift_wrapper_handoff (ObjectFixture *fixture,
+                               gconstpointer  user_data)
+{
+        g_autofree gchar *old_path = g_strdup (g_getenv ("PATH"));
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *log_path = NULL;
+        g_auto (GStrv) lines = NULL;
+        g_autoptr (GError) error = NULL;
+        gint64 deadline;
+        gint first = 0;
+        gint second = 0;
+        guint i;
+
+        /* A stand-in for redshift, logging what it is asked */
+        path = g_strconcat (TEST_DATA_DIR, "bin", G_SEARCHPATH_SEPARATOR_S, old_path, NULL);
+        log_path = g_build_filename (g_get_user_config_dir (), "redshift.log", NULL);
+        g_setenv ("PATH", path, TRUE);
+        g_setenv ("REDSHIFT_LOG", log_path, TRUE);
+        g_setenv (REDSHIFTGTK_SPAWN_KEEP_ENV, "REDSHIFT_LOG", TRUE);
+
+        redshiftgtk_backend_start (fixture->backend, &error);
+        g_assert_no_error (error);
+        g_strfreev (wait_for_instances (log_path, 1));
+
+        /* Apply with something running, the way the window does it */
+        redshiftgtk_backend_set_temperature (fixture->backend, TIME_PERIOD_NIGHT, 3300);
+        redshiftgtk_backend_start (fixture->backend, &error);
+        g_assert_no_error (error);
+        lines = wait_for_instances (log_path, 2);
+
+        for (i = 0; lines[i] != NULL; i++) {
+                /* Neither a reset nor an instance allowed to restore
+                 * its ramps on the way out
+                 */
+                g_assert_null (strstr (lines[i], " -x"));
+                g_assert_false (g_str_has_suffix (lines[i], " restore"));
+
+                if (!strstr (lines[i], " -c "))
+                        continue;
+
+                if (!first) {
+                        first = g_ascii_strtoll (lines[i], NULL, 10);
+                        g_assert_null (strstr (lines[i], " -r "));
+                } else {
+                        second = g_ascii_strtoll (lines[i], NULL, 10);
+                        /* No fade in from neutral either */
+                        g_assert_nonnull (strstr (lines[i], " -r "));
+                }
+        }
+        g_assert_cmpint (first, >, 0);
+        g_assert_cmpint (second, >, 0);
+
+        /* The old instance is gone, the new one stays */
+        deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+        while (kill (first, 0) == 0 && g_get_monotonic_time () < deadline)
+                g_usleep (10000);
+        g_assert_cmpint (kill (first, 0), !=, 0);
+        g_assert_cmpint (kill (second, 0), ==, 0);
+
+        stop_instances (fixture->backend);
+
+        g_setenv ("PATH", old_path, TRUE);
+        g_unsetenv ("REDSHIFT_LOG");
+        g_unsetenv (REDSHIFTGTK_SPAWN_KEEP_ENV);
+        g_remove (log_path);
+}
+
+/* A redshift that died left neutral ramps behind, the next start is a
+ * cold one and fades in
+ */
+static void
+test_redshift_wrapper_restart_after_exit (ObjectFixture *fixture,
+                                          gconstpointer  user_data)
+{
+        g_autofree gchar *old_path = g_strdup (g_getenv ("PATH"));
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *log_path = NULL;
+        g_auto (GStrv) lines = NULL;
+        g_autoptr (GError) error = NULL;
+        gint first = 0;
+        guint i;
+
+        path = g_strconcat (TEST_DATA_DIR, "bin", G_SEARCHPATH_SEPARATOR_S, old_path, NULL);
+        log_path = g_build_filename (g_get_user_config_dir (), "redshift.log", NULL);
+        g_setenv ("PATH", path, TRUE);
+        g_setenv ("REDSHIFT_LOG", log_path, TRUE);
+        g_setenv (REDSHIFTGTK_SPAWN_KEEP_ENV, "REDSHIFT_LOG", TRUE);
+
+        redshiftgtk_backend_start (fixture->backend, &error);
+        g_assert_no_error (error);
+        lines = wait_for_instances (log_path, 1);
+
+        for (i = 0; lines[i] != NULL; i++) {
+                if (strstr (lines[i], " -c "))
+                        first = g_ascii_strtoll (lines[i], NULL, 10);
+        }
+        g_assert_cmpint (first, >, 0);
+        g_clear_pointer (&lines, g_strfreev);
+
+        kill (first, SIGKILL);
+        settle ();
+
+        redshiftgtk_backend_start (fixture->backend, &error);
+        g_assert_no_error (error);
+        lines = wait_for_instances (log_path, 2);
+
+        for (i = 0; lines[i] != NULL; i++) {
+                if (strstr (lines[i], " -c "))
+                        g_assert_null (strstr (lines[i], " -r "));
+        }
+
+        stop_instances (fixture->backend);
+
+        g_setenv ("PATH", old_path, TRUE);
+        g_unsetenv ("REDSHIFT_LOG");
+        g_unsetenv (REDSHIFTGTK_SPAWN_KEEP_ENV);
+        g_remove (log_path);
+}
+
+static void
+test_redshift_wrapper_switch_profile (ObjectFixture *fixture,
+                                      gconstpointer  user_data)
+{
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *path = NULL;
+        g_auto (GStrv) profiles = NULL;
+        guint changed = 0;
+
+        path = g_build_filename (g_get_user_config_dir (), "profiles.conf", NULL);
+        g_file_set_contents (path,
+                             "[redshift]\ntemp-day=5500\ntemp-night=3800\n"
+                             "[profile:Reading]\ntemp-day=4000\nbrightness-night=0.5\n"
+                             "[profile:Late shift]\ntemp-night=2500\n",
+                             -1, &error);
+        g_assert_no_error (error);
+
+        redshiftgtk_redshift_wrapper_set_config_path (fixture->backend, g_strdup (path));
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  &error);
+        g_assert_no_error (error);
+
+        profiles = redshiftgtk_backend_list_profiles (fixture->backend);
+        g_assert_cmpuint (g_strv_length (profiles), ==, 2);
+        g_assert_cmpstr (profiles[0], ==, "Late shift");
+        g_assert_cmpstr (profiles[1], ==, "Reading");
+        g_assert_null (redshiftgtk_backend_get_profile (fixture->backend));
+
+        g_signal_connect (fixture->backend, "changed",
+                          G_CALLBACK (count_changed_cb), &changed);
+
+        redshiftgtk_backend_switch_profile (fixture->backend, "Reading", &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (redshiftgtk_backend_get_profile (fixture->backend), ==, "Reading");
+        g_assert_cmpuint (changed, ==, 1);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_DAY), ==, 4000);
+        g_assert_cmpfloat (redshiftgtk_backend_get_brightness (fixture->backend,
+                                                               TIME_PERIOD_NIGHT), ==, 0.5);
+
+        /* Keys a profile leaves out get the defaults redshift would use */
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_NIGHT), ==, 4500);
+
+        /* Switching to the active profile is a no-op */
+        redshiftgtk_backend_switch_profile (fixture->backend, "Reading", &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (changed, ==, 1);
+
+        redshiftgtk_backend_switch_profile (fixture->backend, NULL, &error);
+        g_assert_no_error (error);
+        g_assert_null (redshiftgtk_backend_get_profile (fixture->backend));
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_DAY), ==, 5500);
+
+        redshiftgtk_backend_switch_profile (fixture->backend, "Bad]name", &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+        g_assert_null (redshiftgtk_backend_get_profile (fixture->backend));
+
+        g_remove (path);
+}
+
+static void
+test_redshift_wrapper_new_profile (ObjectFixture *fixture,
+                                   gconstpointer  user_data)
+{
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *contents = NULL;
+        g_autoptr (GKeyFile) config = NULL;
+
+        path = g_build_filename (g_get_user_config_dir (), "new-profile.conf", NULL);
+        g_file_set_contents (path, "[redshift]\ntemp-day=5500\n", -1, &error);
+        g_assert_no_error (error);
+
+        redshiftgtk_redshift_wrapper_set_config_path (fixture->backend, g_strdup (path));
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  &error);
+        g_assert_no_error (error);
+
+        /* A new profile starts out as a copy of the active one */
+        redshiftgtk_backend_switch_profile (fixture->backend, "Photo", &error);
+        g_assert_no_error (error);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_DAY), ==, 5500);
+
+        redshiftgtk_backend_set_temperature (fixture->backend, TIME_PERIOD_DAY, 6500);
+        redshiftgtk_backend_apply_changes (fixture->backend, &error);
+        g_assert_no_error (error);
+
+        g_file_get_contents (path, &contents, NULL, &error);
+        g_assert_no_error (error);
+        g_assert (g_str_has_prefix (contents, "[redshift]\ntemp-day=5500\n"));
+
+        config = g_key_file_new ();
+        g_key_file_load_from_data (config, contents, -1, G_KEY_FILE_NONE, &error);
+        g_assert_no_error (error);
+        g_assert_cmpint (g_key_file_get_integer (config, "profile:Photo", "temp-day", NULL),
+                         ==, 6500);
+
+        /* Reloading keeps the same profile active */
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (redshiftgtk_backend_get_profile (fixture->backend), ==, "Photo");
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_DAY), ==, 6500);
+
+        g_remove (path);
+}
+
+static void
+test_redshift_wrapper_config_layers (ObjectFixture *fixture,
+                                     gconstpointer  user_data)
+{
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *system_path = NULL;
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *contents = NULL;
+        guint changed = 0;
+
+        system_path = g_build_filename (g_get_system_config_dirs ()[0], "redshift.conf", NULL);
+        g_file_set_contents (system_path,
+                             "[redshift]\ntemp-day=6100\ntemp-night=4100\n"
+                             "[manual]\nlat=48.20\n",
+                             -1, &error);
+        g_assert_no_error (error);
+
+        path = g_build_filename (g_get_user_config_dir (), "layered.conf", NULL);
+        g_file_set_contents (path, "[redshift]\ntemp-night=3800\n", -1, &error);
+        g_assert_no_error (error);
+
+        redshiftgtk_redshift_wrapper_set_config_path (fixture->backend, g_strdup (path));
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  &error);
+        g_assert_no_error (error);
+
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_DAY), ==, 6100);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_NIGHT), ==, 3800);
+        g_assert_cmpfloat (redshiftgtk_backend_get_latitude (fixture->backend), ==, 48.2);
+        g_assert_cmpint (redshiftgtk_backend_get_source (fixture->backend, "temp-day"),
+                         ==, CONFIG_LAYER_SYSTEM);
+        g_assert_cmpint (redshiftgtk_backend_get_source (fixture->backend, "temp-night"),
+                         ==, CONFIG_LAYER_USER);
+        g_assert_cmpint (redshiftgtk_backend_get_source (fixture->backend, "fade"),
+                         ==, CONFIG_LAYER_DEFAULT);
+
+        g_signal_connect (fixture->backend, "changed",
+                          G_CALLBACK (count_changed_cb), &changed);
+
+        redshiftgtk_backend_set_override (fixture->backend, "temp-night", "3000", &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (changed, ==, 1);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_NIGHT), ==, 3000);
+        g_assert_cmpint (redshiftgtk_backend_get_source (fixture->backend, "temp-night"),
+                         ==, CONFIG_LAYER_RUNTIME);
+
+        redshiftgtk_backend_set_override (fixture->backend, "temp-night", "warm", &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+        g_clear_error (&error);
+        redshiftgtk_backend_set_override (fixture->backend, "no-such-key", "1", &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+        g_clear_error (&error);
+
+        /* Overrides and system values are never written to the user file */
+        redshiftgtk_backend_set_temperature (fixture->backend, TIME_PERIOD_DAY, 6100);
+        redshiftgtk_backend_apply_changes (fixture->backend, &error);
+        g_assert_no_error (error);
+        g_file_get_contents (path, &contents, NULL, &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (contents, ==, "[redshift]\ntemp-night=3800\n");
+
+        /* Overrides survive a reload */
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  &error);
+        g_assert_no_error (error);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_NIGHT), ==, 3000);
+
+        /* Setting a value on purpose replaces the override */
+        redshiftgtk_backend_set_temperature (fixture->backend, TIME_PERIOD_NIGHT, 3200);
+        g_assert_cmpint (redshiftgtk_backend_get_source (fixture->backend, "temp-night"),
+                         ==, CONFIG_LAYER_USER);
+
+        redshiftgtk_backend_set_override (fixture->backend, "temp-night", NULL, &error);
+        g_assert_no_error (error);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_NIGHT), ==, 3200);
+
+        g_remove (system_path);
+        g_remove (path);
+}
+
+/* Every cache write renames a new file into place */
+static guint64
+get_inode (const gchar *path)
+{
+        GStatBuf buf;
+
+        g_assert_cmpint (g_stat (path, &buf), ==, 0);
+
+        return buf.st_ino;
+}
+
+static RedshiftGtkBackend*
+load_wrapper (const gchar *path)
+{
+        RedshiftGtkBackend *backend = redshiftgtk_redshift_wrapper_new ();
+        g_autoptr (GError) error = NULL;
+
+        redshiftgtk_redshift_wrapper_set_config_path (backend, g_strdup (path));
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (backend), &error);
+        g_assert_no_error (error);
+
+        return backend;
+}
+
+static void
+test_redshift_wrapper_settings_cache (ObjectFixture *fixture,
+                                      gconstpointer  user_data)
+{
+        g_autoptr (RedshiftGtkBackend) first = NULL;
+        g_autoptr (RedshiftGtkBackend) second = NULL;
+        g_autoptr (RedshiftGtkBackend) third = NULL;
+        g_autoptr (RedshiftGtkBackend) fourth = NULL;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *cache_path = NULL;
+        g_auto (GStrv) profiles = NULL;
+        guint64 inode;
+
+        path = g_build_filename (g_get_user_config_dir (), "cached.conf", NULL);
+        g_file_set_contents (path,
+                             "[redshift]\ntemp-day=5200\n"
+                             "[profile:Reading]\ntemp-day=4200\n",
+                             -1, &error);
+        g_assert_no_error (error);
+
+        cache_path = redshiftgtk_settings_cache_get_path (path);
+        g_remove (cache_path);
+
+        /* A miss parses the file and leaves a cache behind */
+        first = load_wrapper (path);
+        inode = get_inode (cache_path);
+
+        /* A hit doesn't write it again, and knows everything the file did */
+        second = load_wrapper (path);
+        g_assert_cmpuint (get_inode (cache_path), ==, inode);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (second, TIME_PERIOD_DAY),
+                           ==, 5200);
+        profiles = redshiftgtk_backend_list_profiles (second);
+        g_assert_cmpuint (g_strv_length (profiles), ==, 1);
+        g_assert_cmpstr (profiles[0], ==, "Reading");
+        redshiftgtk_backend_switch_profile (second, "Reading", &error);
+        g_assert_no_error (error);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (second, TIME_PERIOD_DAY),
+                           ==, 4200);
+
+        /* Applying keeps the cache warm */
+        redshiftgtk_backend_switch_profile (second, NULL, &error);
+        g_assert_no_error (error);
+        redshiftgtk_backend_set_temperature (second, TIME_PERIOD_DAY, 5300);
+        redshiftgtk_backend_apply_changes (second, &error);
+        g_assert_no_error (error);
+        inode = get_inode (cache_path);
+
+        third = load_wrapper (path);
+        g_assert_cmpuint (get_inode (cache_path), ==, inode);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (third, TIME_PERIOD_DAY),
+                           ==, 5300);
+
+        /* An edit behind our back makes it stale */
+        g_file_set_contents (path, "[redshift]\ntemp-day=5400\n", -1, &error);
+        g_assert_no_error (error);
+
+        fourth = load_wrapper (path);
+        g_assert_cmpuint (get_inode (cache_path), !=, inode);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fourth, TIME_PERIOD_DAY),
+                           ==, 5400);
+
+        g_remove (cache_path);
+        g_remove (path);
+}
+
+static void
+test_redshift_wrapper_output_settings (ObjectFixture *fixture,
+                                       gconstpointer  user_data)
+{
+        g_autoptr (GError) error = NULL;
+        g_autoptr (GKeyFile) config = NULL;
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *value = NULL;
+        g_autofree gchar *unset = NULL;
+        g_auto (GStrv) profiles = NULL;
+        guint changed = 0;
+
+        path = g_build_filename (g_get_user_config_dir (), "outputs.conf", NULL);
+        g_file_set_contents (path,
+                             "[redshift]\ntemp-day=5500\ntemp-night=3800\n"
+                             "[output:DP-1]\ntemp-night=3000\n",
+                             -1, &error);
+        g_assert_no_error (error);
+
+        redshiftgtk_redshift_wrapper_set_config_path (fixture->backend, g_strdup (path));
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  &error);
+        g_assert_no_error (error);
+
+        /* An output's own values leave the profile alone */
+        value = redshiftgtk_backend_get_output_setting (fixture->backend, "DP-1", "temp-night");
+        g_assert_cmpstr (value, ==, "3000");
+        unset = redshiftgtk_backend_get_output_setting (fixture->backend, "DP-1", "temp-day");
+        g_assert_null (unset);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_NIGHT), ==, 3800);
+        profiles = redshiftgtk_backend_list_profiles (fixture->backend);
+        g_assert_cmpuint (g_strv_length (profiles), ==, 0);
+
+        g_signal_connect (fixture->backend, "changed",
+                          G_CALLBACK (count_changed_cb), &changed);
+
+        redshiftgtk_backend_set_output_setting (fixture->backend, "HDMI-1", "temp-day", "5000",
+                                                &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (changed, ==, 1);
+
+        /* Where the sun is can't differ between screens */
+        redshiftgtk_backend_set_output_setting (fixture->backend, "HDMI-1", "lat", "10", &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+        g_clear_error (&error);
+        redshiftgtk_backend_set_output_setting (fixture->backend, "HDMI-1", "temp-day", "warm",
+                                                &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+        g_clear_error (&error);
+        redshiftgtk_backend_set_output_setting (fixture->backend, "Bad]name", "temp-day", "5000",
+                                                &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+        g_clear_error (&error);
+        g_assert_cmpuint (changed, ==, 1);
+
+        redshiftgtk_backend_set_output_setting (fixture->backend, "DP-1", "temp-night", NULL,
+                                                &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (changed, ==, 2);
+
+        redshiftgtk_backend_apply_changes (fixture->backend, &error);
+        g_assert_no_error (error);
+
+        config = g_key_file_new ();
+        g_key_file_load_from_file (config, path, G_KEY_FILE_NONE, &error);
+        g_assert_no_error (error);
+        g_assert_cmpint (g_key_file_get_integer (config, "output:HDMI-1", "temp-day", NULL),
+                         ==, 5000);
+        g_assert_false (g_key_file_has_key (config, "output:DP-1", "temp-night", NULL));
+        g_assert_cmpint (g_key_file_get_integer (config, "redshift", "temp-night", NULL),
+                         ==, 3800);
+
+        g_remove (path);
+}
+
+/* The instance that adjusts @crtc, 0 if none was started */
+static gint
+find_instance (gchar       **lines,
+               guint         crtc,
+               gboolean     *handoff)
+{
+        g_autofree gchar *config = g_strdup_printf ("redshiftgtk-runtime-crtc%u.conf", crtc);
+        gint pid = 0;
+        guint i;
+
+        for (i = 0; lines[i] != NULL; i++) {
+                if (!strstr (lines[i], " -c ") || !strstr (lines[i], config))
+                        continue;
+
+                pid = g_ascii_strtoll (lines[i], NULL, 10);
+                *handoff = strstr (lines[i], " -r ") != NULL;
+        }
+
+        return pid;
+}
+
+static void
+test_redshift_wrapper_output_instances (ObjectFixture *fixture,
+                                        gconstpointer  user_data)
+{
+        g_autoptr (GPtrArray) outputs = NULL;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *old_path = g_strdup (g_getenv ("PATH"));
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *config_path = NULL;
+        g_autofree gchar *log_path = NULL;
+        g_auto (GStrv) lines = NULL;
+        g_auto (GStrv) relines = NULL;
+        gboolean handoff;
+        gint64 deadline;
+        gint left;
+        gint right;
+        gint replaced;
+
+        config_path = g_build_filename (g_get_user_config_dir (), "instances.conf", NULL);
+        g_file_set_contents (config_path,
+                             "[redshift]\ntemp-night=3800\n"
+                             "[output:DP-1]\ntemp-night=3000\n",
+                             -1, &error);
+        g_assert_no_error (error);
+        redshiftgtk_redshift_wrapper_set_config_path (fixture->backend, g_strdup (config_path));
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  &error);
+        g_assert_no_error (error);
+
+        /* Two screens, whatever the X server at hand has */
+        outputs = g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_output_free);
+        g_ptr_array_add (outputs, redshiftgtk_output_new ("DP-1", 0, 1024));
+        g_ptr_array_add (outputs, redshiftgtk_output_new ("HDMI-1", 1, 256));
+        redshiftgtk_redshift_wrapper_set_outputs (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  outputs);
+
+        path = g_strconcat (TEST_DATA_DIR, "bin", G_SEARCHPATH_SEPARATOR_S, old_path, NULL);
+        log_path = g_build_filename (g_get_user_config_dir (), "instances.log", NULL);
+        g_setenv ("PATH", path, TRUE);
+        g_setenv ("REDSHIFT_LOG", log_path, TRUE);
+        g_setenv (REDSHIFTGTK_SPAWN_KEEP_ENV, "REDSHIFT_LOG", TRUE);
+
+        redshiftgtk_backend_start (fixture->backend, &error);
+        g_assert_no_error (error);
+        lines = wait_for_instances (log_path, 2);
+        left = find_instance (lines, 0, &handoff);
+        right = find_instance (lines, 1, &handoff);
+        g_assert_cmpint (left, >, 0);
+        g_assert_cmpint (right, >, 0);
+
+        /* Changing one output restarts its redshift alone */
+        redshiftgtk_backend_set_output_setting (fixture->backend, "HDMI-1", "temp-night", "3200",
+                                                &error);
+        g_assert_no_error (error);
+        redshiftgtk_backend_start (fixture->backend, &error);
+        g_assert_no_error (error);
+        relines = wait_for_instances (log_path, 3);
+        g_assert_cmpint (find_instance (relines, 0, &handoff), ==, left);
+        replaced = find_instance (relines, 1, &handoff);
+        g_assert_cmpint (replaced, !=, right);
+        g_assert_true (handoff);
+
+        deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+        while (kill (right, 0) == 0 && g_get_monotonic_time () < deadline)
+                g_usleep (10000);
+        g_assert_cmpint (kill (right, 0), !=, 0);
+        g_assert_cmpint (kill (left, 0), ==, 0);
+        g_assert_cmpint (kill (replaced, 0), ==, 0);
+
+        /* Nothing changed, nothing restarts */
+        redshiftgtk_backend_start (fixture->backend, &error);
+        g_assert_no_error (error);
+        g_usleep (G_USEC_PER_SEC / 2);
+        g_strfreev (relines);
+        relines = wait_for_instances (log_path, 3);
+        g_assert_cmpint (find_instance (relines, 1, &handoff), ==, replaced);
+
+        stop_instances (fixture->backend);
+
+        g_setenv ("PATH", old_path, TRUE);
+        g_unsetenv ("REDSHIFT_LOG");
+        g_unsetenv (REDSHIFTGTK_SPAWN_KEEP_ENV);
+        g_remove (log_path);
+        g_remove (config_path);
+}
+
+/* One output's redshift can't start: the one started for the other
+ * output goes again, and what ran before keeps running
+ */
+static void
+test_redshift_wrapper_output_instances_rollback (ObjectFixture *fixture,
+                                                 gconstpointer  user_data)
+{
+        g_autoptr (GPtrArray) outputs = NULL;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *old_path = g_strdup (g_getenv ("PATH"));
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *config_path = NULL;
+        g_autofree gchar *log_path = NULL;
+        g_autofree gchar *blocked = NULL;
+        g_auto (GStrv) lines = NULL;
+        g_auto (GStrv) relines = NULL;
+        gboolean handoff;
+        gint64 deadline;
+        gint left;
+        gint right;
+        gint aborted;
+
+        config_path = g_build_filename (g_get_user_config_dir (), "rollback.conf", NULL);
+        g_file_set_contents (config_path,
+                             "[redshift]\ntemp-night=3800\n"
+                             "[output:DP-1]\ntemp-night=3000\n",
+                             -1, &error);
+        g_assert_no_error (error);
+        redshiftgtk_redshift_wrapper_set_config_path (fixture->backend, g_strdup (config_path));
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  &error);
+        g_assert_no_error (error);
+
+        outputs = g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_output_free);
+        g_ptr_array_add (outputs, redshiftgtk_output_new ("DP-1", 0, 1024));
+        g_ptr_array_add (outputs, redshiftgtk_output_new ("HDMI-1", 1, 256));
+        redshiftgtk_redshift_wrapper_set_outputs (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  outputs);
+
+        path = g_strconcat (TEST_DATA_DIR, "bin", G_SEARCHPATH_SEPARATOR_S, old_path, NULL);
+        log_path = g_build_filename (g_get_user_config_dir (), "rollback.log", NULL);
+        g_setenv ("PATH", path, TRUE);
+        g_setenv ("REDSHIFT_LOG", log_path, TRUE);
+        g_setenv (REDSHIFTGTK_SPAWN_KEEP_ENV, "REDSHIFT_LOG", TRUE);
+
+        redshiftgtk_backend_start (fixture->backend, &error);
+        g_assert_no_error (error);
+        lines = wait_for_instances (log_path, 2);
+        left = find_instance (lines, 0, &handoff);
+        right = find_instance (lines, 1, &handoff);
+
+        /* The second output's runtime config can't be written */
+        blocked = g_build_filename (g_get_user_runtime_dir (), "redshiftgtk-runtime-crtc1.conf", NULL);
+        g_remove (blocked);
+        g_assert_cmpint (g_mkdir (blocked, 0700), ==, 0);
+
+        redshiftgtk_backend_set_output_setting (fixture->backend, "DP-1", "temp-night", "2800",
+                                                &error);
+        g_assert_no_error (error);
+        redshiftgtk_backend_set_output_setting (fixture->backend, "HDMI-1", "temp-night", "3200",
+                                                &error);
+        g_assert_no_error (error);
+        redshiftgtk_backend_start (fixture->backend, &error);
+        g_assert_nonnull (error);
+        g_clear_error (&error);
+
+        relines = wait_for_instances (log_path, 3);
+        aborted = find_instance (relines, 0, &handoff);
+        g_assert_cmpint (aborted, !=, left);
+
+        deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+        while (kill (aborted, 0) == 0 && g_get_monotonic_time () < deadline)
+                g_usleep (10000);
+        g_assert_cmpint (kill (aborted, 0), !=, 0);
+        g_assert_cmpint (kill (left, 0), ==, 0);
+        g_assert_cmpint (kill (right, 0), ==, 0);
+
+        /* Nothing was handed over, the next start replaces both */
+        g_rmdir (blocked);
+        redshiftgtk_backend_start (fixture->backend, &error);
+        g_assert_no_error (error);
+        g_strfreev (relines);
+        relines = wait_for_instances (log_path, 5);
+        g_assert_cmpint (find_instance (relines, 0, &handoff), !=, aborted);
+        g_assert_cmpint (find_instance (relines, 1, &handoff), !=, right);
+
+        stop_instances (fixture->backend);
+
+        g_setenv ("PATH", old_path, TRUE);
+        g_unsetenv ("REDSHIFT_LOG");
+        g_unsetenv (REDSHIFTGTK_SPAWN_KEEP_ENV);
+        g_remove (log_path);
+        g_remove (config_path);
+}
+
+/* Lines of the stand-in's log with @argument in them */
+static guint
+count_calls (const gchar *log_path,
+             const gchar *argument)
+{
+        g_autofree gchar *contents = NULL;
+        g_auto (GStrv) lines = NULL;
+        guint found = 0;
+        guint i;
+
+        if (!g_file_get_contents (log_path, &contents, NULL, NULL))
+                return 0;
+
+        lines = g_strsplit (contents, "\n", -1);
+        for (i = 0; lines[i] != NULL; i++) {
+                if (strstr (lines[i], argument))
+                        found++;
+        }
+
+        return found;
+}
+
+static void
+test_redshift_wrapper_preview_ramps (ObjectFixture *fixture,
+                                     gconstpointer  user_data)
+{
+        g_autoptr (GPtrArray) outputs = NULL;
+        g_autofree gchar *old_path = g_strdup (g_getenv ("PATH"));
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *log_path = NULL;
+        guint64 skipped;
+
+        outputs = g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_output_free);
+        g_ptr_array_add (outputs, redshiftgtk_output_new ("DP-1", 0, 1024));
+        redshiftgtk_redshift_wrapper_set_outputs (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  outputs);
+
+        path = g_strconcat (TEST_DATA_DIR, "bin", G_SEARCHPATH_SEPARATOR_S, old_path, NULL);
+        log_path = g_build_filename (g_get_user_config_dir (), "preview.log", NULL);
+        g_setenv ("PATH", path, TRUE);
+        g_setenv ("REDSHIFT_LOG", log_path, TRUE);
+        g_setenv (REDSHIFTGTK_SPAWN_KEEP_ENV, "REDSHIFT_LOG", TRUE);
+
+        skipped = redshiftgtk_metrics_get (METRIC_RAMPS_SKIPPED);
+
+        /* A slider moving by less than redshift can tell apart */
+        redshiftgtk_backend_preview_temperature (fixture->backend, TIME_PERIOD_NIGHT, 4000.2);
+        settle ();
+        redshiftgtk_backend_preview_temperature (fixture->backend, TIME_PERIOD_NIGHT, 4000.4);
+        settle ();
+        g_assert_cmpuint (count_calls (log_path, " -O "), ==, 1);
+        g_assert_cmpuint (redshiftgtk_metrics_get (METRIC_RAMPS_SKIPPED), ==, skipped + 1);
+
+        redshiftgtk_backend_preview_temperature (fixture->backend, TIME_PERIOD_NIGHT, 3000);
+        settle ();
+        g_assert_cmpuint (count_calls (log_path, " -O "), ==, 2);
+
+        /* Once the screen was reset, the same value is sent again */
+        redshiftgtk_backend_end_preview (fixture->backend);
+        settle ();
+        redshiftgtk_backend_preview_temperature (fixture->backend, TIME_PERIOD_NIGHT, 3000);
+        settle ();
+        g_assert_cmpuint (count_calls (log_path, " -O "), ==, 3);
+
+        redshiftgtk_backend_end_preview (fixture->backend);
+        settle ();
+
+        g_setenv ("PATH", old_path, TRUE);
+        g_unsetenv ("REDSHIFT_LOG");
+        g_unsetenv (REDSHIFTGTK_SPAWN_KEEP_ENV);
+        g_remove (log_path);
+}
+
+/* A dragged slider: one preview in flight, the values that arrive
+ * meanwhile replace each other and only the newest is sent after it
+ */
+static void
+test_redshift_wrapper_preview_coalesce (ObjectFixture *fixture,
+                                        gconstpointer  user_data)
+{
+        g_autoptr (GPtrArray) outputs = NULL;
+        g_autofree gchar *old_path = g_strdup (g_getenv ("PATH"));
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *log_path = NULL;
+        guint temperature;
+
+        outputs = g_ptr_array_new_with_free_func ((GDestroyNotify) redshiftgtk_output_free);
+        g_ptr_array_add (outputs, redshiftgtk_output_new ("DP-1", 0, 1024));
+        redshiftgtk_redshift_wrapper_set_outputs (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  outputs);
+
+        path = g_strconcat (TEST_DATA_DIR, "bin", G_SEARCHPATH_SEPARATOR_S, old_path, NULL);
+        log_path = g_build_filename (g_get_user_config_dir (), "coalesce.log", NULL);
+        g_setenv ("PATH", path, TRUE);
+        g_setenv ("REDSHIFT_LOG", log_path, TRUE);
+        g_setenv (REDSHIFTGTK_SPAWN_KEEP_ENV, "REDSHIFT_LOG", TRUE);
+
+        /* Faster than any redshift exits, nothing runs in between */
+        for (temperature = 3000; temperature <= 3900; temperature += 100)
+                redshiftgtk_backend_preview_temperature (fixture->backend, TIME_PERIOD_NIGHT,
+                                                         temperature);
+        settle ();
+
+        g_assert_cmpuint (count_calls (log_path, " -O "), ==, 2);
+        g_assert_cmpuint (count_calls (log_path, " -O 3000 "), ==, 1);
+        g_assert_cmpuint (count_calls (log_path, " -O 3900 "), ==, 1);
+
+        redshiftgtk_backend_end_preview (fixture->backend);
+        settle ();
+
+        g_setenv ("PATH", old_path, TRUE);
+        g_unsetenv ("REDSHIFT_LOG");
+        g_unsetenv (REDSHIFTGTK_SPAWN_KEEP_ENV);
+        g_remove (log_path);
+}
+
+static gboolean
+has_pid (GPtrArray *processes,
+         GPid       pid)
+{
+        guint i;
+
+        for (i = 0; i < processes->len; i++) {
+                if (((RedshiftGtkProcess *) g_ptr_array_index (processes, i))->pid == pid)
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+/* What our launcher started is ours, what the user left alone keeps
+ * the screen to itself
+ */
+static void
+test_redshift_wrapper_foreign (ObjectFixture *fixture,
+                               gconstpointer  user_data)
+{
+        g_autoptr (GSubprocess) autostarted = NULL;
+        g_autoptr (GSubprocess) other = NULL;
+        g_autoptr (GPtrArray) foreign = NULL;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *old_path = g_strdup (g_getenv ("PATH"));
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *log_path = NULL;
+        gint64 deadline;
+        GPid autostarted_pid;
+        GPid other_pid;
+
+        path = g_strconcat (TEST_DATA_DIR, "bin", G_SEARCHPATH_SEPARATOR_S, old_path, NULL);
+        log_path = g_build_filename (g_get_user_config_dir (), "foreign.log", NULL);
+        g_setenv ("PATH", path, TRUE);
+        g_setenv ("REDSHIFT_LOG", log_path, TRUE);
+        g_setenv (REDSHIFTGTK_SPAWN_KEEP_ENV, "REDSHIFT_LOG", TRUE);
+
+        /* The launcher's Exec for this config, and one of the user's own */
+        autostarted = g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, &error,
+                                        "redshift", "-c", fixture->data_config_path, NULL);
+        g_assert_no_error (error);
+        other = g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, &error,
+                                  "redshift", "-l", "1:1", NULL);
+        g_assert_no_error (error);
+        autostarted_pid = g_ascii_strtoll (g_subprocess_get_identifier (autostarted), NULL, 10);
+        other_pid = g_ascii_strtoll (g_subprocess_get_identifier (other), NULL, 10);
+
+        deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+        while ((count_calls (log_path, " -c ") == 0 || count_calls (log_path, " -l ") == 0) &&
+               g_get_monotonic_time () < deadline)
+                g_usleep (10000);
+
+        foreign = redshiftgtk_backend_list_foreign (fixture->backend);
+        g_assert_false (has_pid (foreign, autostarted_pid));
+        g_assert_true (has_pid (foreign, other_pid));
+
+        /* Nothing is spawned next to the one left alone */
+        redshiftgtk_backend_leave (fixture->backend, other_pid);
+        redshiftgtk_backend_start (fixture->backend, &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_EXISTS);
+        g_clear_error (&error);
+        g_assert_cmpuint (count_calls (log_path, " -c "), ==, 1);
+
+        /* Both go with stop once the other one is adopted too */
+        redshiftgtk_backend_adopt (fixture->backend, other_pid, &error);
+        g_assert_no_error (error);
+        stop_instances (fixture->backend);
+
+        g_subprocess_wait (autostarted, NULL, &error);
+        g_assert_no_error (error);
+        g_subprocess_wait (other, NULL, &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (count_calls (log_path, " restore"), ==, 2);
+
+        g_setenv ("PATH", old_path, TRUE);
+        g_unsetenv ("REDSHIFT_LOG");
+        g_unsetenv (REDSHIFTGTK_SPAWN_KEEP_ENV);
+        g_remove (log_path);
+}
+
+/* The redshift a window started with the user's own redshift.conf
+ * outlives it. The next window or the CLI takes it over instead of
+ * reporting it, running next to it or leaving it behind on stop.
+ */
+static void
+test_redshift_wrapper_previous_session (ObjectFixture *fixture,
+                                        gconstpointer  user_data)
+{
+        g_autoptr (RedshiftGtkBackend) previous = NULL;
+        g_autoptr (RedshiftGtkBackend) backend = NULL;
+        g_autoptr (GPtrArray) foreign = NULL;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *old_path = g_strdup (g_getenv ("PATH"));
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *log_path = NULL;
+        g_autofree gchar *config_path = NULL;
+        g_auto (GStrv) lines = NULL;
+        gint64 deadline;
+        gint first = 0;
+        gint second = 0;
+        guint i;
+
+        path = g_strconcat (TEST_DATA_DIR, "bin", G_SEARCHPATH_SEPARATOR_S, old_path, NULL);
+        log_path = g_build_filename (g_get_user_config_dir (), "session.log", NULL);
+        config_path = g_build_filename (g_get_user_config_dir (), "redshift.conf", NULL);
+        g_setenv ("PATH", path, TRUE);
+        g_setenv ("REDSHIFT_LOG", log_path, TRUE);
+        g_setenv (REDSHIFTGTK_SPAWN_KEEP_ENV, "REDSHIFT_LOG", TRUE);
+
+        /* Started, then the window closes without stopping it */
+        previous = redshiftgtk_redshift_wrapper_new ();
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (previous), &error);
+        g_assert_no_error (error);
+        redshiftgtk_backend_start (previous, &error);
+        g_assert_no_error (error);
+        lines = wait_for_instances (log_path, 1);
+        g_clear_object (&previous);
+
+        for (i = 0; lines[i] != NULL; i++) {
+                if (strstr (lines[i], " -c "))
+                        first = g_ascii_strtoll (lines[i], NULL, 10);
+        }
+        g_assert_cmpint (first, >, 0);
+        g_clear_pointer (&lines, g_strfreev);
+
+        backend = redshiftgtk_redshift_wrapper_new ();
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (backend), &error);
+        g_assert_no_error (error);
+
+        /* Not someone else's, and asking twice changes nothing */
+        foreign = redshiftgtk_backend_list_foreign (backend);
+        g_assert_false (has_pid (foreign, first));
+        g_clear_pointer (&foreign, g_ptr_array_unref);
+        foreign = redshiftgtk_backend_list_foreign (backend);
+        g_assert_false (has_pid (foreign, first));
+        g_assert_true (redshiftgtk_backend_is_running (backend));
+
+        /* Handed over from, not run next to */
+        redshiftgtk_backend_start (backend, &error);
+        g_assert_no_error (error);
+        lines = wait_for_instances (log_path, 2);
+
+        for (i = 0; lines[i] != NULL; i++) {
+                if (strstr (lines[i], " -c ") &&
+                    g_ascii_strtoll (lines[i], NULL, 10) != first) {
+                        second = g_ascii_strtoll (lines[i], NULL, 10);
+                        g_assert_nonnull (strstr (lines[i], " -r "));
+                }
+        }
+        g_assert_cmpint (second, >, 0);
+
+        deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+        while (kill (first, 0) == 0 && g_get_monotonic_time () < deadline)
+                g_usleep (10000);
+        g_assert_cmpint (kill (first, 0), !=, 0);
+        g_clear_object (&backend);
+
+        /* Like redshiftgtk-cli --stop, in a process of its own */
+        backend = redshiftgtk_redshift_wrapper_new ();
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (backend), &error);
+        g_assert_no_error (error);
+        stop_instances (backend);
+
+        deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+        while (kill (second, 0) == 0 && g_get_monotonic_time () < deadline)
+                g_usleep (10000);
+        g_assert_cmpint (kill (second, 0), !=, 0);
+        g_assert_cmpuint (count_calls (log_path, " restore"), ==, 1);
+        g_assert_cmpuint (count_calls (log_path, " -x"), ==, 0);
+
+        g_setenv ("PATH", old_path, TRUE);
+        g_unsetenv ("REDSHIFT_LOG");
+        g_unsetenv (REDSHIFTGTK_SPAWN_KEEP_ENV);
+        g_remove (log_path);
+        g_remove (config_path);
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
 {
+        g_autofree gchar *config_home = NULL;
+        g_autofree gchar *config_dirs = NULL;
+        g_autofree gchar *cache_home = NULL;
+        g_autofree gchar *runtime_dir = NULL;
+        gint result;
+
+        /* Keep launchers and configs out of the real home directory */
+        config_home = g_dir_make_tmp ("redshiftgtk-test-XXXXXX", NULL);
+        g_assert (config_home != NULL);
+        g_setenv ("XDG_CONFIG_HOME", config_home, TRUE);
+
+        /* Stands in for /etc/xdg */
+        config_dirs = g_build_filename (config_home, "xdg", NULL);
+        g_mkdir_with_parents (config_dirs, 0700);
+        g_setenv ("XDG_CONFIG_DIRS", config_dirs, TRUE);
+
+        cache_home = g_build_filename (config_home, "cache", NULL);
+        g_setenv ("XDG_CACHE_HOME", cache_home, TRUE);
+
+        /* Runtime configs, a test blocks one of them */
+        runtime_dir = g_build_filename (config_home, "runtime", NULL);
+        g_mkdir_with_parents (runtime_dir, 0700);
+        g_setenv ("XDG_RUNTIME_DIR", runtime_dir, TRUE);
+
         g_test_init (&argc, &argv, NULL);
 
         g_test_add ("/Backend/RedshiftWrapper/get-config-path",
@@ -433,6 +1704,128 @@ main (gint   argc,
                     test_redshift_wrapper_set_smooth_transition,
                     redshift_wrapper_fixture_tear_down);
 
-        return g_test_run ();
+        g_test_add ("/Backend/RedshiftWrapper/apply-keeps-file",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_apply_keeps_file,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/handoff",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_handoff,
+                    redshift_wrapper_fixture_tear_down);
+        g_test_add ("/Backend/RedshiftWrapper/restart-after-exit",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_restart_after_exit,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/switch-profile",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_switch_profile,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/new-profile",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_new_profile,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/config-layers",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_config_layers,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/settings-cache",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_settings_cache,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/output-settings",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_output_settings,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/output-instances",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_output_instances,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/output-instances-rollback",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_output_instances_rollback,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/preview-ramps",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_preview_ramps,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/preview-coalesce",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_preview_coalesce,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/foreign",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_foreign,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/previous-session",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_previous_session,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/set-autostart",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_set_autostart,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/autostart-monitor",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_autostart_monitor,
+                    redshift_wrapper_fixture_tear_down);
+
+        g_test_add ("/Backend/RedshiftWrapper/autostart-failed",
+                    ObjectFixture,
+                    NULL,
+                    redshift_wrapper_fixture_set_up,
+                    test_redshift_wrapper_autostart_failed,
+                    redshift_wrapper_fixture_tear_down);
+
+        result = g_test_run ();
+
+        remove_tree (config_home);
+
+        return result;
 }
 
@@ -0,0 +1,178 @@
+#include <glib/gstdio.h>
+
+#include "backend/redshiftgtk-settings-cache.h"
+
+typedef struct {
+        gchar *directory;
+        gchar *config_path;
+        gchar *cache_path;
+        const gchar *sources[2];
+} CacheFixture;
+
+static void
+cache_fixture_set_up (CacheFixture  *fixture,
+                      gconstpointer  user_data)
+{
+        g_autoptr (GError) error = NULL;
+
+        fixture->directory = g_dir_make_tmp ("redshiftgtk-cache-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        fixture->config_path = g_build_filename (fixture->directory, "redshift.conf", NULL);
+        fixture->cache_path = g_build_filename (fixture->directory, "cache", "settings", NULL);
+        fixture->sources[0] = fixture->config_path;
+        fixture->sources[1] = NULL;
+
+        g_file_set_contents (fixture->config_path, "[redshift]\ntemp-day=5500\n", -1, &error);
+        g_assert_no_error (error);
+}
+
+static void
+cache_fixture_tear_down (CacheFixture  *fixture,
+                         gconstpointer  user_data)
+{
+        g_autofree gchar *cache_directory = g_path_get_dirname (fixture->cache_path);
+
+        g_unlink (fixture->cache_path);
+        g_rmdir (cache_directory);
+        g_unlink (fixture->config_path);
+        g_rmdir (fixture->directory);
+
+        g_free (fixture->cache_path);
+        g_free (fixture->config_path);
+        g_free (fixture->directory);
+}
+
+static GVariant*
+cache_fixture_stamp (CacheFixture *fixture)
+{
+        return g_variant_ref_sink (redshiftgtk_settings_cache_stamp (fixture->sources));
+}
+
+static GVariant*
+profiles_new (gdouble temperature)
+{
+        return g_variant_new_parsed ("[('', [(byte 0x02, byte 0x00, %d, %d, %d)])]",
+                                     temperature, temperature, temperature);
+}
+
+static void
+save (CacheFixture *fixture,
+      GVariant     *stamps,
+      gdouble       temperature)
+{
+        g_autoptr (GError) error = NULL;
+
+        g_assert_true (redshiftgtk_settings_cache_save (fixture->cache_path, stamps,
+                                                        profiles_new (temperature), &error));
+        g_assert_no_error (error);
+}
+
+static void
+test_settings_cache_hit (CacheFixture  *fixture,
+                         gconstpointer  user_data)
+{
+        g_autoptr (GVariant) stamps = cache_fixture_stamp (fixture);
+        g_autoptr (GVariant) profiles = NULL;
+        g_autoptr (GVariant) expected = NULL;
+
+        g_assert_null (redshiftgtk_settings_cache_load (fixture->cache_path, stamps));
+
+        save (fixture, stamps, 5500);
+
+        profiles = redshiftgtk_settings_cache_load (fixture->cache_path, stamps);
+        g_assert_nonnull (profiles);
+        g_assert_true (g_variant_is_of_type (profiles, SETTINGS_CACHE_PROFILES_TYPE));
+
+        expected = g_variant_ref_sink (profiles_new (5500));
+        g_assert_true (g_variant_equal (profiles, expected));
+}
+
+static void
+test_settings_cache_stale (CacheFixture  *fixture,
+                           gconstpointer  user_data)
+{
+        g_autoptr (GVariant) stamps = cache_fixture_stamp (fixture);
+        g_autoptr (GVariant) edited = NULL;
+        g_autoptr (GVariant) missing = NULL;
+        g_autoptr (GError) error = NULL;
+
+        save (fixture, stamps, 5500);
+
+        /* Same size, so only the mtime or inode can tell */
+        g_file_set_contents (fixture->config_path, "[redshift]\ntemp-day=5600\n", -1, &error);
+        g_assert_no_error (error);
+
+        edited = cache_fixture_stamp (fixture);
+        g_assert_false (g_variant_equal (stamps, edited));
+        g_assert_null (redshiftgtk_settings_cache_load (fixture->cache_path, edited));
+
+        /* A file that went away is a change too */
+        g_unlink (fixture->config_path);
+        missing = cache_fixture_stamp (fixture);
+        g_assert_null (redshiftgtk_settings_cache_load (fixture->cache_path, missing));
+}
+
+static void
+test_settings_cache_corrupt (CacheFixture  *fixture,
+                             gconstpointer  user_data)
+{
+        g_autoptr (GVariant) stamps = cache_fixture_stamp (fixture);
+        g_autoptr (GError) error = NULL;
+        const gchar *garbage[] = { "", "garbage", "\xff\xff\xff\xff\x00\x01\x02" };
+        guint i;
+
+        save (fixture, stamps, 5500);
+
+        for (i = 0; i < G_N_ELEMENTS (garbage); i++) {
+                g_file_set_contents (fixture->cache_path, garbage[i], -1, &error);
+                g_assert_no_error (error);
+
+                g_assert_null (redshiftgtk_settings_cache_load (fixture->cache_path, stamps));
+        }
+}
+
+static void
+test_settings_cache_path (void)
+{
+        g_autofree gchar *first = redshiftgtk_settings_cache_get_path ("/a/redshift.conf");
+        g_autofree gchar *again = redshiftgtk_settings_cache_get_path ("/a/redshift.conf");
+        g_autofree gchar *other = redshiftgtk_settings_cache_get_path ("/b/redshift.conf");
+
+        g_assert_true (g_str_has_prefix (first, g_get_user_cache_dir ()));
+        g_assert_cmpstr (first, ==, again);
+        g_assert_cmpstr (first, !=, other);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add ("/Backend/SettingsCache/hit",
+                    CacheFixture,
+                    NULL,
+                    cache_fixture_set_up,
+                    test_settings_cache_hit,
+                    cache_fixture_tear_down);
+
+        g_test_add ("/Backend/SettingsCache/stale",
+                    CacheFixture,
+                    NULL,
+                    cache_fixture_set_up,
+                    test_settings_cache_stale,
+                    cache_fixture_tear_down);
+
+        g_test_add ("/Backend/SettingsCache/corrupt",
+                    CacheFixture,
+                    NULL,
+                    cache_fixture_set_up,
+                    test_settings_cache_corrupt,
+                    cache_fixture_tear_down);
+
+        g_test_add_func ("/Backend/SettingsCache/path",
+                         test_settings_cache_path);
+
+        return g_test_run ();
+}
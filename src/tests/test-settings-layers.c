@@ -0,0 +1,237 @@
+#include "backend/redshiftgtk-settings-layers.h"
+
+static GKeyFile*
+key_file_new (const gchar *data)
+{
+        GKeyFile *config = g_key_file_new ();
+        g_autoptr (GError) error = NULL;
+
+        g_key_file_load_from_data (config, data, -1, G_KEY_FILE_NONE, &error);
+        g_assert_no_error (error);
+
+        return config;
+}
+
+static void
+test_settings_layers_defaults (void)
+{
+        g_autoptr (RedshiftGtkSettingsLayers) layers = redshiftgtk_settings_layers_new ();
+        Setting setting;
+
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+
+                g_assert_cmpfloat (redshiftgtk_settings_layers_get (layers, setting)[0],
+                                   ==, info->fallback);
+                g_assert_cmpint (redshiftgtk_settings_layers_get_source (layers, setting),
+                                 ==, CONFIG_LAYER_DEFAULT);
+                g_assert_null (redshiftgtk_settings_layers_get_layer (layers,
+                                                                      CONFIG_LAYER_USER,
+                                                                      setting));
+        }
+}
+
+static void
+test_settings_layers_priority (void)
+{
+        g_autoptr (RedshiftGtkSettingsLayers) layers = redshiftgtk_settings_layers_new ();
+        SettingValue system = { 5000, 5000, 5000 };
+        SettingValue user = { 4000, 4000, 4000 };
+        SettingValue runtime = { 3000, 3000, 3000 };
+
+        g_assert_true (redshiftgtk_settings_layers_set (layers, CONFIG_LAYER_USER,
+                                                        SETTING_TEMP_NIGHT, user));
+        g_assert_cmpfloat (redshiftgtk_settings_layers_get (layers, SETTING_TEMP_NIGHT)[0],
+                           ==, 4000);
+
+        /* Hidden under the user's value, the merged view stays */
+        g_assert_false (redshiftgtk_settings_layers_set (layers, CONFIG_LAYER_SYSTEM,
+                                                         SETTING_TEMP_NIGHT, system));
+        g_assert_cmpint (redshiftgtk_settings_layers_get_source (layers, SETTING_TEMP_NIGHT),
+                         ==, CONFIG_LAYER_USER);
+
+        g_assert_true (redshiftgtk_settings_layers_set (layers, CONFIG_LAYER_RUNTIME,
+                                                        SETTING_TEMP_NIGHT, runtime));
+        g_assert_cmpfloat (redshiftgtk_settings_layers_get (layers, SETTING_TEMP_NIGHT)[0],
+                           ==, 3000);
+        g_assert_cmpint (redshiftgtk_settings_layers_get_source (layers, SETTING_TEMP_NIGHT),
+                         ==, CONFIG_LAYER_RUNTIME);
+
+        /* Peeling them off again uncovers each layer in turn */
+        g_assert_true (redshiftgtk_settings_layers_unset (layers, CONFIG_LAYER_RUNTIME,
+                                                          SETTING_TEMP_NIGHT));
+        g_assert_true (redshiftgtk_settings_layers_unset (layers, CONFIG_LAYER_USER,
+                                                          SETTING_TEMP_NIGHT));
+        g_assert_cmpfloat (redshiftgtk_settings_layers_get (layers, SETTING_TEMP_NIGHT)[0],
+                           ==, 5000);
+        g_assert_cmpint (redshiftgtk_settings_layers_get_source (layers, SETTING_TEMP_NIGHT),
+                         ==, CONFIG_LAYER_SYSTEM);
+        g_assert_false (redshiftgtk_settings_layers_unset (layers, CONFIG_LAYER_USER,
+                                                           SETTING_TEMP_NIGHT));
+
+        /* Other settings never moved */
+        g_assert_cmpint (redshiftgtk_settings_layers_get_source (layers, SETTING_TEMP_DAY),
+                         ==, CONFIG_LAYER_DEFAULT);
+}
+
+static void
+test_settings_layers_load (void)
+{
+        g_autoptr (RedshiftGtkSettingsLayers) layers = redshiftgtk_settings_layers_new ();
+        g_autoptr (GKeyFile) system = NULL;
+        g_autoptr (GKeyFile) user = NULL;
+        g_autoptr (GKeyFile) edited = NULL;
+        guint32 changed;
+
+        system = key_file_new ("[redshift]\ntemp-day=6000\ntemp-night=4000\n"
+                               "[manual]\nlat=48.2\n");
+        user = key_file_new ("[redshift]\ntemp-night=3500\ngamma-day=0.9:0.8:0.7\n");
+
+        changed = redshiftgtk_settings_layers_load (layers, CONFIG_LAYER_SYSTEM, system, NULL);
+        g_assert_cmphex (changed, ==, (1u << SETTING_TEMP_DAY) |
+                                      (1u << SETTING_TEMP_NIGHT) |
+                                      (1u << SETTING_LATITUDE));
+
+        /* temp-night moves from the system to the user value */
+        changed = redshiftgtk_settings_layers_load (layers, CONFIG_LAYER_USER, user, NULL);
+        g_assert_cmphex (changed, ==, (1u << SETTING_TEMP_NIGHT) |
+                                      (1u << SETTING_GAMMA_DAY));
+
+        g_assert_cmpint (redshiftgtk_settings_layers_get_source (layers, SETTING_TEMP_DAY),
+                         ==, CONFIG_LAYER_SYSTEM);
+        g_assert_cmpint (redshiftgtk_settings_layers_get_source (layers, SETTING_TEMP_NIGHT),
+                         ==, CONFIG_LAYER_USER);
+        g_assert_cmpfloat (redshiftgtk_settings_layers_get (layers, SETTING_GAMMA_DAY)[2],
+                           ==, 0.7);
+
+        /* Loading the same thing again touches nothing */
+        g_assert_cmphex (redshiftgtk_settings_layers_load (layers, CONFIG_LAYER_USER,
+                                                           user, NULL), ==, 0);
+
+        /* Only what the edit changed is merged again. A value that
+         * doesn't parse uncovers the system one...
+         */
+        edited = key_file_new ("[redshift]\ntemp-night=bogus\ngamma-day=0.9:0.8:0.7\n");
+        changed = redshiftgtk_settings_layers_load (layers, CONFIG_LAYER_USER, edited, NULL);
+        g_assert_cmphex (changed, ==, 1u << SETTING_TEMP_NIGHT);
+        g_assert_cmpfloat (redshiftgtk_settings_layers_get (layers, SETTING_TEMP_NIGHT)[0],
+                           ==, 4000);
+        g_key_file_unref (edited);
+
+        /* ...one out of range is clamped */
+        edited = key_file_new ("[redshift]\ntemp-night=99999\ngamma-day=0.9:0.8:0.7\n");
+        g_test_expect_message (NULL, G_LOG_LEVEL_WARNING, "*temp-night*out of range*");
+        changed = redshiftgtk_settings_layers_load (layers, CONFIG_LAYER_USER, edited, NULL);
+        g_test_assert_expected_messages ();
+        g_assert_cmphex (changed, ==, 1u << SETTING_TEMP_NIGHT);
+        g_assert_cmpfloat (redshiftgtk_settings_layers_get (layers, SETTING_TEMP_NIGHT)[0],
+                           ==, 25000);
+
+        /* No file at all empties the layer */
+        changed = redshiftgtk_settings_layers_load (layers, CONFIG_LAYER_SYSTEM, NULL, NULL);
+        g_assert_cmphex (changed, ==, (1u << SETTING_TEMP_DAY) |
+                                      (1u << SETTING_TEMP_NIGHT) |
+                                      (1u << SETTING_LATITUDE));
+}
+
+static void
+test_settings_layers_load_group (void)
+{
+        g_autoptr (RedshiftGtkSettingsLayers) layers = redshiftgtk_settings_layers_new ();
+        g_autoptr (GKeyFile) user = NULL;
+
+        user = key_file_new ("[redshift]\ntemp-day=6000\n"
+                             "[profile:Reading]\ntemp-day=4200\nlat=10\n");
+
+        redshiftgtk_settings_layers_load (layers, CONFIG_LAYER_USER, user, "profile:Reading");
+
+        g_assert_cmpfloat (redshiftgtk_settings_layers_get (layers, SETTING_TEMP_DAY)[0],
+                           ==, 4200);
+        g_assert_cmpfloat (redshiftgtk_settings_layers_get (layers, SETTING_LATITUDE)[0],
+                           ==, 10);
+}
+
+static void
+test_settings_layers_serialize (void)
+{
+        g_autoptr (RedshiftGtkSettingsLayers) layers = redshiftgtk_settings_layers_new ();
+        g_autoptr (RedshiftGtkSettingsLayers) copy = redshiftgtk_settings_layers_new ();
+        g_autoptr (GVariant) values = NULL;
+        SettingValue system = { 6000, 6000, 6000 };
+        SettingValue gamma = { 0.9, 0.8, 0.7 };
+        SettingValue runtime = { 3000, 3000, 3000 };
+        SettingValue kept = { 5200, 5200, 5200 };
+        Setting setting;
+
+        redshiftgtk_settings_layers_set (layers, CONFIG_LAYER_SYSTEM, SETTING_TEMP_DAY, system);
+        redshiftgtk_settings_layers_set (layers, CONFIG_LAYER_USER, SETTING_GAMMA_NIGHT, gamma);
+        redshiftgtk_settings_layers_set (layers, CONFIG_LAYER_RUNTIME, SETTING_TEMP_NIGHT, runtime);
+
+        values = g_variant_ref_sink (redshiftgtk_settings_layers_serialize (layers));
+        g_assert_true (g_variant_is_of_type (values, SETTINGS_LAYERS_VARIANT_TYPE));
+
+        /* Overrides aren't part of it, and survive loading one */
+        g_assert_cmpuint (g_variant_n_children (values), ==, 2);
+        redshiftgtk_settings_layers_set (copy, CONFIG_LAYER_RUNTIME, SETTING_TEMP_NIGHT, kept);
+
+        g_assert_cmphex (redshiftgtk_settings_layers_deserialize (copy, values), ==,
+                         (1u << SETTING_TEMP_DAY) | (1u << SETTING_GAMMA_NIGHT));
+
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                if (setting == SETTING_TEMP_NIGHT)
+                        continue;
+
+                g_assert_cmpmem (redshiftgtk_settings_layers_get (copy, setting), sizeof (SettingValue),
+                                 redshiftgtk_settings_layers_get (layers, setting), sizeof (SettingValue));
+                g_assert_cmpint (redshiftgtk_settings_layers_get_source (copy, setting), ==,
+                                 redshiftgtk_settings_layers_get_source (layers, setting));
+        }
+        g_assert_cmpfloat (redshiftgtk_settings_layers_get (copy, SETTING_TEMP_NIGHT)[0],
+                           ==, 5200);
+
+        /* Again, with nothing to change */
+        g_assert_cmphex (redshiftgtk_settings_layers_deserialize (copy, values), ==, 0);
+}
+
+static void
+test_settings_layers_deserialize_invalid (void)
+{
+        g_autoptr (RedshiftGtkSettingsLayers) layers = redshiftgtk_settings_layers_new ();
+        g_autoptr (GVariant) values = NULL;
+
+        /* Unknown setting, a layer that never comes from a file and
+         * a value out of range
+         */
+        values = g_variant_ref_sink (g_variant_new_parsed ("[(byte 0x02, byte 0xff, 1.0, 1.0, 1.0),"
+                                                           " (byte 0x03, byte 0x00, 4000.0, 4000.0, 4000.0),"
+                                                           " (byte 0x02, byte 0x00, 99999.0, 99999.0, 99999.0)]"));
+
+        g_assert_cmphex (redshiftgtk_settings_layers_deserialize (layers, values), ==,
+                         1u << SETTING_TEMP_DAY);
+        g_assert_cmpint (redshiftgtk_settings_layers_get_source (layers, SETTING_TEMP_DAY),
+                         ==, CONFIG_LAYER_USER);
+        g_assert_cmpfloat (redshiftgtk_settings_layers_get (layers, SETTING_TEMP_DAY)[0],
+                           ==, redshiftgtk_settings_schema_lookup (SETTING_TEMP_DAY)->maximum);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/Backend/SettingsLayers/defaults",
+                         test_settings_layers_defaults);
+        g_test_add_func ("/Backend/SettingsLayers/priority",
+                         test_settings_layers_priority);
+        g_test_add_func ("/Backend/SettingsLayers/load",
+                         test_settings_layers_load);
+        g_test_add_func ("/Backend/SettingsLayers/load-group",
+                         test_settings_layers_load_group);
+        g_test_add_func ("/Backend/SettingsLayers/serialize",
+                         test_settings_layers_serialize);
+        g_test_add_func ("/Backend/SettingsLayers/deserialize-invalid",
+                         test_settings_layers_deserialize_invalid);
+
+        return g_test_run ();
+}
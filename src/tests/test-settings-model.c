@@ -0,0 +1,159 @@
+#include "backend/redshiftgtk-backend.h"
+#include "backend/redshiftgtk-redshift-wrapper.h"
+#include "backend/redshiftgtk-settings-model.h"
+
+typedef struct {
+        RedshiftGtkBackend *backend;
+        RedshiftGtkSettingsModel *settings;
+        GHashTable *notifications;
+} ObjectFixture;
+
+static void
+settings_model_notify_cb (GObject    *object,
+                          GParamSpec *pspec,
+                          gpointer    user_data)
+{
+        GHashTable *notifications = user_data;
+        const gchar *name = g_param_spec_get_name (pspec);
+        guint count = GPOINTER_TO_UINT (g_hash_table_lookup (notifications, name));
+
+        g_hash_table_insert (notifications, (gpointer) name, GUINT_TO_POINTER (count + 1));
+}
+
+static void
+settings_model_fixture_set_up (ObjectFixture *fixture,
+                               gconstpointer  user_data)
+{
+        g_autoptr (GError) error = NULL;
+
+        fixture->backend = redshiftgtk_redshift_wrapper_new ();
+        redshiftgtk_redshift_wrapper_set_config_path (fixture->backend,
+                g_build_filename (TEST_DATA_DIR, "redshift.conf", NULL));
+        redshiftgtk_redshift_wrapper_load_config (REDSHIFTGTK_REDSHIFT_WRAPPER (fixture->backend),
+                                                  &error);
+        g_assert_no_error (error);
+
+        fixture->settings = redshiftgtk_settings_model_new ();
+        fixture->notifications = g_hash_table_new (g_str_hash, g_str_equal);
+        g_signal_connect (fixture->settings, "notify",
+                          G_CALLBACK (settings_model_notify_cb),
+                          fixture->notifications);
+}
+
+static void
+settings_model_fixture_tear_down (ObjectFixture *fixture,
+                                  gconstpointer  user_data)
+{
+        g_clear_object (&fixture->settings);
+        g_clear_object (&fixture->backend);
+        g_clear_pointer (&fixture->notifications, g_hash_table_unref);
+}
+
+static void
+test_settings_model_load (ObjectFixture *fixture,
+                          gconstpointer  user_data)
+{
+        gdouble temp_day, gamma_night_blue;
+        gint provider;
+
+        redshiftgtk_settings_model_load (fixture->settings, fixture->backend);
+
+        g_object_get (fixture->settings,
+                      "temp-day", &temp_day,
+                      "gamma-night-blue", &gamma_night_blue,
+                      "location-provider", &provider,
+                      NULL);
+        g_assert_cmpfloat (temp_day, ==, 5500);
+        g_assert_cmpfloat (gamma_night_blue, ==, 0.6);
+        g_assert_cmpint (provider, ==, LOCATION_PROVIDER_MANUAL);
+}
+
+static void
+test_settings_model_load_notifies_once (ObjectFixture *fixture,
+                                        gconstpointer  user_data)
+{
+        GHashTableIter iter;
+        gpointer count;
+
+        redshiftgtk_settings_model_load (fixture->settings, fixture->backend);
+
+        /* Every changed property is announced exactly once */
+        g_assert_cmpuint (GPOINTER_TO_UINT (g_hash_table_lookup (fixture->notifications,
+                                                                 "temp-day")), ==, 1);
+        g_hash_table_iter_init (&iter, fixture->notifications);
+        while (g_hash_table_iter_next (&iter, NULL, &count))
+                g_assert_cmpuint (GPOINTER_TO_UINT (count), ==, 1);
+
+        /* Loading the same values again announces nothing */
+        g_hash_table_remove_all (fixture->notifications);
+        redshiftgtk_settings_model_load (fixture->settings, fixture->backend);
+        g_assert_cmpuint (g_hash_table_size (fixture->notifications), ==, 0);
+}
+
+static void
+test_settings_model_set_same_value (ObjectFixture *fixture,
+                                    gconstpointer  user_data)
+{
+        g_object_set (fixture->settings, "temp-night", 3500.0, NULL);
+        g_object_set (fixture->settings, "temp-night", 3500.0, NULL);
+
+        g_assert_cmpuint (GPOINTER_TO_UINT (g_hash_table_lookup (fixture->notifications,
+                                                                 "temp-night")), ==, 1);
+}
+
+static void
+test_settings_model_commit (ObjectFixture *fixture,
+                            gconstpointer  user_data)
+{
+        redshiftgtk_settings_model_load (fixture->settings, fixture->backend);
+        g_object_set (fixture->settings,
+                      "temp-night", 3500.0,
+                      "brightness-day", 0.5,
+                      NULL);
+
+        redshiftgtk_settings_model_commit (fixture->settings, fixture->backend);
+
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_NIGHT), ==, 3500);
+        g_assert_cmpfloat (redshiftgtk_backend_get_brightness (fixture->backend,
+                                                               TIME_PERIOD_DAY), ==, 0.5);
+        g_assert_cmpfloat (redshiftgtk_backend_get_temperature (fixture->backend,
+                                                                TIME_PERIOD_DAY), ==, 5500);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add ("/Backend/SettingsModel/load",
+                    ObjectFixture,
+                    NULL,
+                    settings_model_fixture_set_up,
+                    test_settings_model_load,
+                    settings_model_fixture_tear_down);
+
+        g_test_add ("/Backend/SettingsModel/load-notifies-once",
+                    ObjectFixture,
+                    NULL,
+                    settings_model_fixture_set_up,
+                    test_settings_model_load_notifies_once,
+                    settings_model_fixture_tear_down);
+
+        g_test_add ("/Backend/SettingsModel/set-same-value",
+                    ObjectFixture,
+                    NULL,
+                    settings_model_fixture_set_up,
+                    test_settings_model_set_same_value,
+                    settings_model_fixture_tear_down);
+
+        g_test_add ("/Backend/SettingsModel/commit",
+                    ObjectFixture,
+                    NULL,
+                    settings_model_fixture_set_up,
+                    test_settings_model_commit,
+                    settings_model_fixture_tear_down);
+
+        return g_test_run ();
+}
@@ -0,0 +1,254 @@
+#include <math.h>
+
+#include "enums.h"
+#include "backend/redshiftgtk-settings-schema.h"
+
+/* A value inside the range of @setting that survives the file format */
+static void
+settings_schema_sample (Setting      setting,
+                        SettingValue value)
+{
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+
+        switch (info->type) {
+        case SETTING_TYPE_CHOICE:
+        case SETTING_TYPE_FLAG:
+                value[0] = value[1] = value[2] = info->maximum;
+                break;
+        case SETTING_TYPE_GAMMA:
+                value[0] = info->minimum;
+                value[1] = round ((info->minimum + info->maximum) * 10) / 20;
+                value[2] = info->maximum;
+                break;
+        default:
+                value[0] = value[1] = value[2] = round ((info->minimum + info->maximum) / 2);
+        }
+}
+
+static void
+test_settings_schema_fallback (gconstpointer user_data)
+{
+        Setting setting = GPOINTER_TO_UINT (user_data);
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        g_autoptr (GKeyFile) config = g_key_file_new ();
+        SettingValue value;
+
+        redshiftgtk_settings_schema_read (setting, config, value);
+
+        g_assert_cmpfloat (value[0], ==, info->fallback);
+        g_assert_cmpfloat (value[1], ==, info->fallback);
+        g_assert_cmpfloat (value[2], ==, info->fallback);
+}
+
+static void
+test_settings_schema_round_trip (gconstpointer user_data)
+{
+        Setting setting = GPOINTER_TO_UINT (user_data);
+        g_autoptr (GKeyFile) config = g_key_file_new ();
+        SettingValue written, read;
+        guint i;
+
+        settings_schema_sample (setting, written);
+        redshiftgtk_settings_schema_write (setting, config, written);
+        redshiftgtk_settings_schema_read (setting, config, read);
+
+        for (i = 0; i < SETTING_COMPONENTS; i++)
+                g_assert_cmpfloat (fabs (read[i] - written[i]), <, 0.001);
+}
+
+static void
+test_settings_schema_out_of_range (gconstpointer user_data)
+{
+        Setting setting = GPOINTER_TO_UINT (user_data);
+        const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+        g_autoptr (GKeyFile) config = g_key_file_new ();
+        SettingValue value;
+
+        /* Hand-edited numbers out of range are clamped with a warning... */
+        g_key_file_set_value (config, info->group, info->key, "12345678");
+        if (info->type != SETTING_TYPE_CHOICE)
+                g_test_expect_message (NULL, G_LOG_LEVEL_WARNING, "*out of range*");
+        redshiftgtk_settings_schema_read (setting, config, value);
+        g_test_assert_expected_messages ();
+        g_assert_cmpfloat (value[0], ==, info->type == SETTING_TYPE_CHOICE ?
+                                         info->fallback : info->maximum);
+
+        /* ...nonsense gives the default... */
+        g_key_file_set_value (config, info->group, info->key, "bogus");
+        redshiftgtk_settings_schema_read (setting, config, value);
+        g_assert_cmpfloat (value[0], ==, info->fallback);
+
+        /* ...and values set from code are clamped quietly */
+        value[0] = value[1] = value[2] = info->maximum + 1;
+        redshiftgtk_settings_schema_validate (setting, value);
+
+        switch (info->type) {
+        case SETTING_TYPE_CHOICE:
+                g_assert_cmpfloat (value[0], ==, info->fallback);
+                break;
+        default:
+                g_assert_cmpfloat (value[0], ==, info->maximum);
+        }
+}
+
+static void
+test_settings_schema_gamma_above_one (void)
+{
+        g_autoptr (GKeyFile) config = g_key_file_new ();
+        SettingValue value;
+
+        /* redshift takes gammas up to 10, brightening the midtones */
+        g_key_file_set_value (config, "redshift", "gamma-day", "1.2");
+        redshiftgtk_settings_schema_read (SETTING_GAMMA_DAY, config, value);
+
+        g_assert_cmpfloat (value[0], ==, 1.2);
+        g_assert_cmpfloat (value[1], ==, 1.2);
+        g_assert_cmpfloat (value[2], ==, 1.2);
+
+        g_key_file_set_value (config, "redshift", "gamma-night", "1.2:0.8:12");
+        g_test_expect_message (NULL, G_LOG_LEVEL_WARNING, "*gamma-night*out of range*");
+        redshiftgtk_settings_schema_read (SETTING_GAMMA_NIGHT, config, value);
+        g_test_assert_expected_messages ();
+
+        g_assert_cmpfloat (value[0], ==, 1.2);
+        g_assert_cmpfloat (value[1], ==, 0.8);
+        g_assert_cmpfloat (value[2], ==, 10.0);
+}
+
+static void
+test_settings_schema_latitude_is_number (void)
+{
+        g_autoptr (GKeyFile) config = g_key_file_new ();
+        g_autoptr (GError) error = NULL;
+        SettingValue value = { 14.33, 14.33, 14.33 };
+        gdouble latitude;
+
+        redshiftgtk_settings_schema_write (SETTING_LATITUDE, config, value);
+
+        latitude = g_key_file_get_double (config, "manual", "lat", &error);
+        g_assert_no_error (error);
+        g_assert_cmpfloat (latitude, ==, 14.33);
+}
+
+static void
+test_settings_schema_fade_is_flag (void)
+{
+        g_autoptr (GKeyFile) config = g_key_file_new ();
+        g_autofree gchar *fade = NULL;
+        SettingValue value = { TRUE, TRUE, TRUE };
+
+        redshiftgtk_settings_schema_write (SETTING_FADE, config, value);
+
+        fade = g_key_file_get_value (config, "redshift", "fade", NULL);
+        g_assert_cmpstr (fade, ==, "1");
+
+        redshiftgtk_settings_schema_read (SETTING_FADE, config, value);
+        g_assert_cmpfloat (value[0], ==, TRUE);
+}
+
+static void
+test_settings_schema_gamma_single (void)
+{
+        g_autoptr (GKeyFile) config = g_key_file_new ();
+        SettingValue value;
+
+        g_key_file_set_value (config, "redshift", "gamma-night", "0.8");
+        redshiftgtk_settings_schema_read (SETTING_GAMMA_NIGHT, config, value);
+
+        g_assert_cmpfloat (value[0], ==, 0.8);
+        g_assert_cmpfloat (value[1], ==, 0.8);
+        g_assert_cmpfloat (value[2], ==, 0.8);
+}
+
+static void
+test_settings_schema_gamma_grammar (void)
+{
+        static const gchar * const valid[] = {
+                "0.8", "0.1:0.2:0.3", " 1:1:1 ", "1.:.5:0.25", "1e-1:1:1",
+        };
+        static const gchar * const invalid[] = {
+                "", ":", "0.1:0.2", "0.1:0.2:0.3:0.4", "0.1::0.3", "0.1:0.2:",
+                "inf", "nan", "0x1", "0.1 : 0.2 : 0.3", "0,5", "1.0abc", "-",
+        };
+        SettingValue value;
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (valid); i++)
+                g_assert_true (redshiftgtk_settings_schema_parse_gamma (valid[i], value));
+
+        for (i = 0; i < G_N_ELEMENTS (invalid); i++)
+                g_assert_false (redshiftgtk_settings_schema_parse_gamma (invalid[i], value));
+}
+
+static void
+test_settings_schema_number_grammar (void)
+{
+        gdouble value;
+
+        g_assert_true (redshiftgtk_settings_schema_parse_number ("6500", &value));
+        g_assert_cmpfloat (value, ==, 6500);
+        g_assert_true (redshiftgtk_settings_schema_parse_number (" -45.5 ", &value));
+        g_assert_cmpfloat (value, ==, -45.5);
+
+        g_assert_false (redshiftgtk_settings_schema_parse_number ("", &value));
+        g_assert_false (redshiftgtk_settings_schema_parse_number ("infinity", &value));
+        g_assert_false (redshiftgtk_settings_schema_parse_number ("0x10", &value));
+        g_assert_false (redshiftgtk_settings_schema_parse_number ("65 00", &value));
+}
+
+static void
+test_settings_schema_automatic_method (void)
+{
+        g_autoptr (GKeyFile) config = g_key_file_new ();
+        SettingValue value = { ADJUSTMENT_METHOD_AUTO, 0, 0 };
+
+        g_key_file_set_value (config, "redshift", "adjustment-method", "randr");
+        redshiftgtk_settings_schema_write (SETTING_ADJUSTMENT_METHOD, config, value);
+
+        g_assert_false (g_key_file_has_key (config, "redshift", "adjustment-method", NULL));
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        Setting setting;
+
+        g_test_init (&argc, &argv, NULL);
+
+        /* Every row of the schema gets the same checks */
+        for (setting = 0; setting < N_SETTINGS; setting++) {
+                const SettingInfo *info = redshiftgtk_settings_schema_lookup (setting);
+                g_autofree gchar *fallback = NULL;
+                g_autofree gchar *round_trip = NULL;
+                g_autofree gchar *out_of_range = NULL;
+
+                fallback = g_strdup_printf ("/Backend/SettingsSchema/%s/fallback", info->key);
+                round_trip = g_strdup_printf ("/Backend/SettingsSchema/%s/round-trip", info->key);
+                out_of_range = g_strdup_printf ("/Backend/SettingsSchema/%s/out-of-range", info->key);
+
+                g_test_add_data_func (fallback, GUINT_TO_POINTER (setting),
+                                      test_settings_schema_fallback);
+                g_test_add_data_func (round_trip, GUINT_TO_POINTER (setting),
+                                      test_settings_schema_round_trip);
+                g_test_add_data_func (out_of_range, GUINT_TO_POINTER (setting),
+                                      test_settings_schema_out_of_range);
+        }
+
+        g_test_add_func ("/Backend/SettingsSchema/gamma-above-one",
+                         test_settings_schema_gamma_above_one);
+        g_test_add_func ("/Backend/SettingsSchema/latitude-is-number",
+                         test_settings_schema_latitude_is_number);
+        g_test_add_func ("/Backend/SettingsSchema/fade-is-flag",
+                         test_settings_schema_fade_is_flag);
+        g_test_add_func ("/Backend/SettingsSchema/gamma-single",
+                         test_settings_schema_gamma_single);
+        g_test_add_func ("/Backend/SettingsSchema/gamma-grammar",
+                         test_settings_schema_gamma_grammar);
+        g_test_add_func ("/Backend/SettingsSchema/number-grammar",
+                         test_settings_schema_number_grammar);
+        g_test_add_func ("/Backend/SettingsSchema/automatic-method",
+                         test_settings_schema_automatic_method);
+
+        return g_test_run ();
+}
@@ -0,0 +1,87 @@
+#include <string.h>
+
+#include "backend/redshiftgtk-spawn.h"
+
+static void
+test_spawn_environ (void)
+{
+        g_auto (GStrv) envp = NULL;
+
+        g_setenv ("DISPLAY", ":7", TRUE);
+        g_setenv ("TZ", "Europe/Berlin", TRUE);
+        g_setenv ("REDSHIFTGTK_TEST_SECRET", "1", TRUE);
+        g_setenv ("REDSHIFTGTK_TEST_WANTED", "2", TRUE);
+        g_unsetenv (REDSHIFTGTK_SPAWN_KEEP_ENV);
+
+        envp = redshiftgtk_spawn_get_environ ();
+        g_assert_cmpstr (g_environ_getenv (envp, "DISPLAY"), ==, ":7");
+        g_assert_cmpstr (g_environ_getenv (envp, "PATH"), ==, g_getenv ("PATH"));
+        /* dawn-time and dusk-time are local times */
+        g_assert_cmpstr (g_environ_getenv (envp, "TZ"), ==, "Europe/Berlin");
+        g_assert_null (g_environ_getenv (envp, "REDSHIFTGTK_TEST_SECRET"));
+        g_assert_null (g_environ_getenv (envp, "G_DEBUG"));
+        g_clear_pointer (&envp, g_strfreev);
+
+        /* Asked for by name, empty entries are no names */
+        g_setenv (REDSHIFTGTK_SPAWN_KEEP_ENV, "::REDSHIFTGTK_TEST_WANTED:", TRUE);
+        envp = redshiftgtk_spawn_get_environ ();
+        g_assert_cmpstr (g_environ_getenv (envp, "REDSHIFTGTK_TEST_WANTED"), ==, "2");
+        g_assert_null (g_environ_getenv (envp, "REDSHIFTGTK_TEST_SECRET"));
+
+        g_unsetenv (REDSHIFTGTK_SPAWN_KEEP_ENV);
+        g_unsetenv ("TZ");
+        g_unsetenv ("REDSHIFTGTK_TEST_SECRET");
+        g_unsetenv ("REDSHIFTGTK_TEST_WANTED");
+}
+
+/* What the child actually sees */
+static void
+test_spawn_child (void)
+{
+        g_autoptr (GSubprocess) process = NULL;
+        g_autoptr (GError) error = NULL;
+        g_autofree gchar *output = NULL;
+
+        g_setenv ("REDSHIFTGTK_TEST_SECRET", "1", TRUE);
+
+        process = redshiftgtk_spawn (G_SUBPROCESS_FLAGS_STDOUT_PIPE, &error,
+                                     "env", NULL);
+        g_assert_no_error (error);
+        g_subprocess_communicate_utf8 (process, NULL, NULL, &output, NULL, &error);
+        g_assert_no_error (error);
+        g_assert_true (g_subprocess_get_successful (process));
+
+        g_assert_nonnull (strstr (output, "PATH="));
+        g_assert_null (strstr (output, "REDSHIFTGTK_TEST_SECRET="));
+        g_assert_null (strstr (output, "G_TEST_SRCDIR="));
+
+        g_unsetenv ("REDSHIFTGTK_TEST_SECRET");
+}
+
+static void
+test_spawn_missing (void)
+{
+        g_autoptr (GSubprocess) process = NULL;
+        g_autoptr (GError) error = NULL;
+
+        process = redshiftgtk_spawn (G_SUBPROCESS_FLAGS_NONE, &error,
+                                     "redshiftgtk-no-such-program", NULL);
+        g_assert_null (process);
+        g_assert_nonnull (error);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/Backend/Spawn/environ",
+                         test_spawn_environ);
+        g_test_add_func ("/Backend/Spawn/child",
+                         test_spawn_child);
+        g_test_add_func ("/Backend/Spawn/missing",
+                         test_spawn_missing);
+
+        return g_test_run ();
+}
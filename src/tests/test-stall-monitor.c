@@ -0,0 +1,163 @@
+#include <gio/gio.h>
+
+#include "backend/redshiftgtk-stall-monitor.h"
+
+#define THRESHOLD 50
+#define STALL (4 * THRESHOLD * 1000)
+
+static gboolean
+quit_cb (gpointer data)
+{
+        g_main_loop_quit (data);
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Let the heartbeat catch up with whatever @func does */
+static void
+run_in_main_loop (GSourceFunc func,
+                  gpointer    data)
+{
+        g_autoptr (GMainLoop) loop = g_main_loop_new (NULL, FALSE);
+
+        g_idle_add (func, data);
+        g_timeout_add (STALL / 1000 + 10 * THRESHOLD, quit_cb, loop);
+        g_main_loop_run (loop);
+}
+
+static gboolean
+lookup_stats (const gchar *name,
+              guint       *count,
+              gint64      *longest)
+{
+        RedshiftGtkStallMonitor *monitor = redshiftgtk_stall_monitor_get_default ();
+        g_autoptr (GVariant) stats = redshiftgtk_stall_monitor_get_stats (monitor);
+        gint64 total;
+
+        g_assert_true (g_variant_is_of_type (stats, STALL_MONITOR_STATS_TYPE));
+
+        return g_variant_lookup (stats, name, "(uxx)", count, &total, longest);
+}
+
+static void
+slow_cancelled_cb (GCancellable *cancellable,
+                   gpointer      data)
+{
+        g_usleep (STALL);
+}
+
+static void
+fast_cancelled_cb (GCancellable *cancellable,
+                   gpointer      data)
+{
+}
+
+static gboolean
+cancel_cb (gpointer data)
+{
+        g_cancellable_cancel (data);
+
+        return G_SOURCE_REMOVE;
+}
+
+static gboolean
+unmarked_cb (gpointer data)
+{
+        g_usleep (STALL);
+
+        return G_SOURCE_REMOVE;
+}
+
+static gboolean
+marked_cb (gpointer data)
+{
+        redshiftgtk_stall_monitor_enter ("outer");
+        redshiftgtk_stall_monitor_enter ("inner");
+        redshiftgtk_stall_monitor_leave ();
+        /* Back in the outer one when it stalls */
+        g_usleep (STALL);
+        redshiftgtk_stall_monitor_leave ();
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+test_stall_monitor_signal (void)
+{
+        RedshiftGtkStallMonitor *monitor = redshiftgtk_stall_monitor_get_default ();
+        g_autoptr (GCancellable) cancellable = g_cancellable_new ();
+        guint stalls = redshiftgtk_stall_monitor_get_stall_count (monitor);
+        guint count = 0;
+        gint64 longest = 0;
+
+        REDSHIFTGTK_SIGNAL_CONNECT (cancellable, "cancelled", slow_cancelled_cb, NULL);
+        run_in_main_loop (cancel_cb, cancellable);
+
+        g_assert_cmpuint (redshiftgtk_stall_monitor_get_stall_count (monitor), ==, stalls + 1);
+        g_assert_true (lookup_stats ("slow_cancelled_cb", &count, &longest));
+        g_assert_cmpuint (count, ==, 1);
+        g_assert_cmpint (longest, >=, STALL - THRESHOLD * 1000);
+        g_assert_cmpint (redshiftgtk_stall_monitor_get_longest_stall (monitor), >=, longest);
+}
+
+static void
+test_stall_monitor_quiet (void)
+{
+        RedshiftGtkStallMonitor *monitor = redshiftgtk_stall_monitor_get_default ();
+        g_autoptr (GCancellable) cancellable = g_cancellable_new ();
+        guint stalls = redshiftgtk_stall_monitor_get_stall_count (monitor);
+        guint count;
+        gint64 longest;
+
+        REDSHIFTGTK_SIGNAL_CONNECT (cancellable, "cancelled", fast_cancelled_cb, NULL);
+        run_in_main_loop (cancel_cb, cancellable);
+
+        g_assert_cmpuint (redshiftgtk_stall_monitor_get_stall_count (monitor), ==, stalls);
+        g_assert_false (lookup_stats ("fast_cancelled_cb", &count, &longest));
+}
+
+static void
+test_stall_monitor_unattributed (void)
+{
+        guint count = 0;
+        gint64 longest;
+
+        run_in_main_loop (unmarked_cb, NULL);
+
+        g_assert_true (lookup_stats ("(unattributed)", &count, &longest));
+        g_assert_cmpuint (count, ==, 1);
+}
+
+static void
+test_stall_monitor_nested (void)
+{
+        guint count = 0;
+        gint64 longest;
+
+        run_in_main_loop (marked_cb, NULL);
+
+        g_assert_true (lookup_stats ("outer", &count, &longest));
+        g_assert_cmpuint (count, ==, 1);
+        g_assert_false (lookup_stats ("inner", &count, &longest));
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        /* Connections only get names once it runs */
+        redshiftgtk_stall_monitor_start_default (THRESHOLD);
+
+        g_test_add_func ("/Backend/StallMonitor/signal",
+                         test_stall_monitor_signal);
+        g_test_add_func ("/Backend/StallMonitor/quiet",
+                         test_stall_monitor_quiet);
+        g_test_add_func ("/Backend/StallMonitor/unattributed",
+                         test_stall_monitor_unattributed);
+        g_test_add_func ("/Backend/StallMonitor/nested",
+                         test_stall_monitor_nested);
+
+        return g_test_run ();
+}